@@ -439,4 +439,26 @@ atomic_cas_u(unsigned *v, unsigned old, unsigned _new)
 #endif
 }
 
+/******************************************************************************/
+/* float operations. */
+
+/* There is no native atomic float add, emulate it with a compare-and-swap
+ * loop on the bit pattern of the value. */
+ATOMIC_INLINE float
+atomic_add_fl(float *p, const float x)
+{
+	union { float f; uint32_t u; } oldval, newval;
+	uint32_t prevval;
+
+	assert(sizeof(float) == sizeof(uint32_t));
+
+	do {
+		oldval.f = *p;
+		newval.f = oldval.f + x;
+		prevval = atomic_cas_uint32((uint32_t *)p, oldval.u, newval.u);
+	} while (prevval != oldval.u);
+
+	return newval.f;
+}
+
 #endif /* __ATOMIC_OPS_H__ */
@@ -102,6 +102,10 @@ void allocateDataBlock( )
 	data[datablocknum - 1] = ( UCHAR * )malloc(HEAP_UNIT * N);
 
 	// Update allocation stack
+	if (stackblocknum == 0)
+	{
+		allocateStackBlock( );
+	}
 	for (int i = 0; i < HEAP_UNIT; i++)
 	{
 		stack[0][i] = (data[datablocknum - 1] + i * N);
@@ -125,26 +129,22 @@ void allocateStackBlock( )
 public:
 /**
  * Constructor
+ *
+ * Blocks are allocated on first use, so allocators for node sizes
+ * that never occur (or octrees that stay empty) cost no memory.
  */
 MemoryAllocator( )
 {
 	HEAP_UNIT = 1 << HEAP_BASE;
 	HEAP_MASK = (1 << HEAP_BASE) - 1;
 
-	data = ( UCHAR ** )malloc(sizeof(UCHAR *) );
-	data[0] = ( UCHAR * )malloc(HEAP_UNIT * N);
-	datablocknum = 1;
+	data = NULL;
+	datablocknum = 0;
 
-	stack = ( UCHAR *** )malloc(sizeof (UCHAR * *) );
-	stack[0] = ( UCHAR ** )malloc(HEAP_UNIT * sizeof (UCHAR *) );
-	stackblocknum = 1;
-	stacksize = HEAP_UNIT;
-	available = HEAP_UNIT;
-
-	for (int i = 0; i < HEAP_UNIT; i++)
-	{
-		stack[0][i] = (data[0] + i * N);
-	}
+	stack = NULL;
+	stackblocknum = 0;
+	stacksize = 0;
+	available = 0;
 }
 
 /**
@@ -29,6 +29,10 @@
 #include <limits>
 #include <time.h>
 
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
 /**
  * Implementations of Octree member functions.
  *
@@ -46,6 +50,10 @@
 #define dc_printf(...) do {} while (0)
 #endif
 
+/* Below this number of triangles (or of output vertices) scan conversion
+ * (or minimizer computation) is done from a single thread */
+#define DC_OMP_LIMIT 1000
+
 Octree::Octree(ModelReader *mr,
                DualConAllocOutput alloc_output_func,
                DualConAddVert add_vert_func,
@@ -96,6 +104,10 @@ Octree::Octree(ModelReader *mr,
 	initMemory();
 	root = (Node *)createInternal(0);
 
+	for (int i = 0; i < 8; i++) {
+		octant_trees[i] = NULL;
+	}
+
 	// Read MC table
 #ifdef IN_VERBOSE_MODE
 	dc_printf("Reading contour table...\n");
@@ -104,8 +116,50 @@ Octree::Octree(ModelReader *mr,
 
 }
 
+Octree::Octree(const Octree *parent)
+	: root(NULL),
+	reader(NULL),
+	cubes(NULL),
+	use_flood_fill(parent->use_flood_fill),
+	use_manifold(parent->use_manifold),
+	hermite_num(parent->hermite_num),
+	mode(parent->mode),
+	alloc_output(NULL),
+	add_vert(NULL),
+	add_quad(NULL),
+	output_mesh(NULL)
+{
+	thresh = parent->thresh;
+	dimen = parent->dimen;
+	range = parent->range;
+	origin[0] = parent->origin[0];
+	origin[1] = parent->origin[1];
+	origin[2] = parent->origin[2];
+	nodeCount = nodeSpace = 0;
+	maxDepth = parent->maxDepth;
+	mindimen = parent->mindimen;
+	minshift = parent->minshift;
+	maxTrianglePerCell = 0;
+
+	/* only the per-instance tables, the shared ones are already built */
+	memcpy(numEdgeTable, parent->numEdgeTable, sizeof(numEdgeTable));
+	memcpy(edgeCountTable, parent->edgeCountTable, sizeof(edgeCountTable));
+
+	initMemory();
+
+	for (int i = 0; i < 8; i++) {
+		octant_trees[i] = NULL;
+	}
+}
+
 Octree::~Octree()
 {
+	/* nodes of the octants may have been moved to the free lists of
+	 * this octree's allocators, so free both at the same time */
+	for (int i = 0; i < 8; i++) {
+		delete octant_trees[i];
+	}
+
 	delete cubes;
 	freeMemory();
 }
@@ -266,88 +320,145 @@ void Octree::addAllTriangles()
 {
 	Triangle *trian;
 	int count = 0;
+	std::vector<GridTriangle> triangles;
+	Node *octants[8];
 
-#if DC_DEBUG
-	int total = reader->getNumTriangles();
-	int unitcount = 1000;
 	dc_printf("\nScan converting to depth %d...\n", maxDepth);
-#endif
 
 	srand(0);
 
+	triangles.reserve(reader->getNumTriangles());
 	while ((trian = reader->getNextTriangle()) != NULL) {
-		// Drop triangles
-		{
-			addTriangle(trian, count);
-		}
+		GridTriangle gtri;
+		projectTriangle(trian, count, &gtri);
+		triangles.push_back(gtri);
 		delete trian;
 
 		count++;
+	}
 
-#if DC_DEBUG
-		if (count % unitcount == 0) {
-			putchar(13);
-
-			switch ((count / unitcount) % 4) {
-				case 0: dc_printf("-");
-					break;
-				case 1: dc_printf("/");
-					break;
-				case 2: dc_printf("|");
-					break;
-				case 3: dc_printf("\\");
-					break;
-			}
-
-			float percent = (float) count / total;
+	/* Triangles only ever touch the subtrees of the root octants they
+	 * intersect, so each octant is built into its own sub-octree from a
+	 * separate thread, inserting triangles in the same order as a serial
+	 * build would. The result doesn't depend on the number of threads. */
+	bool use_threads = false;
+#ifdef _OPENMP
+	use_threads = (count > DC_OMP_LIMIT && omp_get_max_threads() > 1);
+#endif
 
-			/*
-			   int totbars = 50;
-			   int bars =(int)(percent * totbars);
-			   for(int i = 0; i < bars; i ++) {
-			    putchar(219);
-			   }
-			   for(i = bars; i < totbars; i ++) {
-			    putchar(176);
-			   }
-			 */
+	if (use_threads) {
+		for (int i = 0; i < 8; i++) {
+			octant_trees[i] = new Octree(this);
+		}
 
-			dc_printf(" %d triangles: ", count);
-			dc_printf(" %f%% complete.", 100 * percent);
+#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < 8; i++) {
+			octants[i] = octant_trees[i]->addOctantTriangles(triangles, i);
 		}
-#endif
+	}
+	else {
+		for (int i = 0; i < 8; i++) {
+			octants[i] = addOctantTriangles(triangles, i);
+		}
+	}
 
+	/* Merge the octants into the root */
+	int chd_count = 0;
+	for (int i = 0; i < 8; i++) {
+		if (octants[i]) {
+			if (maxDepth == 1)
+				root = (Node *)addLeafChild(&root->internal, i, chd_count, &octants[i]->leaf);
+			else
+				root = (Node *)addInternalChild(&root->internal, i, chd_count, &octants[i]->internal);
+			chd_count++;
+		}
 	}
-	putchar(13);
+
+	dc_printf(" %d triangles\n", count);
 }
 
-/* Prepare a triangle for insertion into the octree; call the other
-   addTriangle() to (recursively) build the octree */
-void Octree::addTriangle(Triangle *trian, int triind)
+/* Project the triangle's coordinates into the grid */
+void Octree::projectTriangle(Triangle *trian, int triind, GridTriangle *gtri) const
 {
 	int i, j;
 
-	/* Project the triangle's coordinates into the grid */
 	for (i = 0; i < 3; i++) {
 		for (j = 0; j < 3; j++)
 			trian->vt[i][j] = dimen * (trian->vt[i][j] - origin[j]) / range;
 	}
 
-	/* Generate projections */
-	int64_t cube[2][3] = {{0, 0, 0}, {dimen, dimen, dimen}};
-	int64_t trig[3][3];
 	for (i = 0; i < 3; i++) {
 		for (j = 0; j < 3; j++)
-			trig[i][j] = (int64_t)(trian->vt[i][j]);
+			gtri->trig[i][j] = (int64_t)(trian->vt[i][j]);
+	}
+	gtri->index = triind;
+
+	/* Same as CubeTriangleIsect::getBoxMask() for the root cube, whose
+	 * first three projection axes are the grid axes */
+	const int64_t mid = dimen >> 1;
+	int bmask[3][2];
+	for (i = 0; i < 3; i++) {
+		int64_t tmin = gtri->trig[0][i], tmax = gtri->trig[0][i];
+		for (j = 1; j < 3; j++) {
+			if (gtri->trig[j][i] < tmin)
+				tmin = gtri->trig[j][i];
+			if (gtri->trig[j][i] > tmax)
+				tmax = gtri->trig[j][i];
+		}
+		bmask[i][0] = (mid >= tmin);
+		bmask[i][1] = (mid < tmax);
 	}
 
-	/* Add triangle to the octree */
-	int64_t errorvec = (int64_t)(0);
-	CubeTriangleIsect *proj = new CubeTriangleIsect(cube, trig, errorvec, triind);
-	root = (Node *)addTriangle(&root->internal, proj, maxDepth);
+	gtri->boxmask = 0;
+	for (i = 0; i < 8; i++) {
+		gtri->boxmask |= ((bmask[0][(i >> 2) & 1] &
+		                   bmask[1][(i >> 1) & 1] &
+		                   bmask[2][i & 1]) << i);
+	}
+}
+
+/* Scan convert all triangles intersecting one octant of the root,
+   returns the octant's node (NULL if nothing intersects it) */
+Node *Octree::addOctantTriangles(const std::vector<GridTriangle> &triangles, int octant)
+{
+	int64_t cube[2][3] = {{0, 0, 0}, {dimen, dimen, dimen}};
+	int off[3] = {(octant >> 2) & 1, (octant >> 1) & 1, octant & 1};
+	Node *node = NULL;
 
-	delete proj->inherit;
-	delete proj;
+	for (size_t t = 0; t < triangles.size(); t++) {
+		const GridTriangle &gtri = triangles[t];
+
+		/* Quick pruning using bounding box */
+		if (!(gtri.boxmask & (1 << octant)))
+			continue;
+
+		/* Generate projections */
+		int64_t trig[3][3];
+		memcpy(trig, gtri.trig, sizeof(trig));
+
+		int64_t errorvec = (int64_t)(0);
+		CubeTriangleIsect proj(cube, trig, errorvec, gtri.index);
+		CubeTriangleIsect subp(&proj);
+		subp.shift(off);
+
+		/* Pruning using intersection test */
+		if (subp.isIntersecting()) {
+			if (maxDepth == 1) {
+				if (!node)
+					node = (Node *)createLeaf(0);
+				node = (Node *)updateCell(&node->leaf, &subp);
+			}
+			else {
+				if (!node)
+					node = (Node *)createInternal(0);
+				node = (Node *)addTriangle(&node->internal, &subp, maxDepth - 1);
+			}
+		}
+
+		delete proj.inherit;
+	}
+
+	return node;
 }
 
 #if 0
@@ -2063,7 +2174,36 @@ void Octree::writeOut()
 	actualVerts = 0;
 	actualQuads = 0;
 
-	generateMinimizer(root, st, dimen, maxDepth, offset);
+	std::vector<MinimizerCell> cells;
+	generateMinimizer(root, st, dimen, maxDepth, offset, cells);
+
+	/* Minimizers are independent from each other, compute them in
+	 * parallel and then output the vertices in traversal order */
+	const int totcell = (int)cells.size();
+	std::vector<float> minimizers(3 * cells.size());
+
+#pragma omp parallel for schedule(dynamic, 64) if (totcell > DC_OMP_LIMIT)
+	for (int i = 0; i < totcell; i++) {
+		const MinimizerCell &cell = cells[i];
+		int cst[3] = {cell.st[0], cell.st[1], cell.st[2]};
+		float *rvalue = &minimizers[3 * i];
+
+		rvalue[0] = (float) cst[0] + cell.len / 2;
+		rvalue[1] = (float) cst[1] + cell.len / 2;
+		rvalue[2] = (float) cst[2] + cell.len / 2;
+		computeMinimizer(cell.leaf, cst, cell.len, rvalue);
+
+		for (int j = 0; j < 3; j++) {
+			rvalue[j] = rvalue[j] * range / dimen + origin[j];
+		}
+	}
+
+	for (int i = 0; i < totcell; i++) {
+		for (int j = 0; j < cells[i].mult; j++) {
+			add_vert(output_mesh, &minimizers[3 * i]);
+		}
+	}
+
 	cellProcContour(root, 0, maxDepth);
 	dc_printf("Vertices written: %d Quads written: %d \n", offset, actualQuads);
 }
@@ -2257,27 +2397,15 @@ void Octree::computeMinimizer(const LeafNode *leaf, int st[3], int len,
 	}
 }
 
-void Octree::generateMinimizer(Node *node, int st[3], int len, int height, int& offset)
+/* Assign vertex indices to the leaf cells and gather the cells that
+   output vertices, the minimizers are computed afterwards */
+void Octree::generateMinimizer(Node *node, int st[3], int len, int height, int& offset,
+                               std::vector<MinimizerCell> &cells)
 {
-	int i, j;
+	int i;
 
 	if (height == 0) {
 		// Leaf cell, generate
-
-		// First, find minimizer
-		float rvalue[3];
-		rvalue[0] = (float) st[0] + len / 2;
-		rvalue[1] = (float) st[1] + len / 2;
-		rvalue[2] = (float) st[2] + len / 2;
-		computeMinimizer(&node->leaf, st, len, rvalue);
-
-		// Update
-		//float fnst[3];
-		for (j = 0; j < 3; j++) {
-			rvalue[j] = rvalue[j] * range / dimen + origin[j];
-			//fnst[j] = st[j] * range / dimen + origin[j];
-		}
-
 		int mult = 0, smask = getSignMask(&node->leaf);
 
 		if (use_manifold) {
@@ -2289,8 +2417,15 @@ void Octree::generateMinimizer(Node *node, int st[3], int len, int height, int&
 			}
 		}
 
-		for (j = 0; j < mult; j++) {
-			add_vert(output_mesh, rvalue);
+		if (mult > 0) {
+			MinimizerCell cell;
+			cell.leaf = &node->leaf;
+			cell.st[0] = st[0];
+			cell.st[1] = st[1];
+			cell.st[2] = st[2];
+			cell.len = len;
+			cell.mult = mult;
+			cells.push_back(cell);
 		}
 
 		// Store the index
@@ -2310,7 +2445,7 @@ void Octree::generateMinimizer(Node *node, int st[3], int len, int height, int&
 				nst[2] = st[2] + vertmap[i][2] * len;
 
 				generateMinimizer(node->internal.get_child(count),
-				                  nst, len, height - 1, offset);
+				                  nst, len, height - 1, offset, cells);
 				count++;
 			}
 		}
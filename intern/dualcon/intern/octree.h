@@ -27,6 +27,7 @@
 #include <cstring>
 #include <stdio.h>
 #include <math.h>
+#include <vector>
 #include "GeoCommon.h"
 #include "Projections.h"
 #include "ModelReader.h"
@@ -210,6 +211,33 @@ struct PathElement {
 	PathElement *next;
 };
 
+/**
+ * Triangle projected into the grid, kept between reading the model and
+ * scan converting it so the octants of the root can be built in parallel
+ */
+struct GridTriangle {
+	int64_t trig[3][3];
+
+	/// Index of polygon
+	int index;
+
+	/// Octants of the root overlapped by the triangle's bounding box
+	unsigned char boxmask;
+};
+
+/**
+ * Leaf cell that outputs vertices, gathered so minimizers can be
+ * computed in parallel before the vertices are written in order
+ */
+struct MinimizerCell {
+	const LeafNode *leaf;
+	int st[3];
+	int len;
+
+	/// Number of vertices to output for this cell
+	int mult;
+};
+
 struct PathList {
 	// Head
 	PathElement *head;
@@ -238,6 +266,10 @@ class Octree
 	/// Root node
 	Node *root;
 
+	/// Sub-octrees the octants of the root are scan converted into, they
+	/// own the memory of the nodes built from worker threads
+	Octree *octant_trees[8];
+
 	/// Model reader
 	ModelReader *reader;
 
@@ -293,6 +325,15 @@ class Octree
 	 */
 	~Octree();
 
+ private:
+	/**
+	 * Construct an empty octree with the grid of the parent, owning its
+	 * own memory allocators so it can be built from a worker thread
+	 */
+	Octree(const Octree *parent);
+
+ public:
+
 	/**
 	 * Scan convert
 	 */
@@ -336,7 +377,8 @@ class Octree
 	 * Add triangles to the tree
 	 */
 	void addAllTriangles();
-	void addTriangle(Triangle *trian, int triind);
+	void projectTriangle(Triangle *trian, int triind, GridTriangle *gtri) const;
+	Node *addOctantTriangles(const std::vector<GridTriangle> &triangles, int octant);
 	InternalNode *addTriangle(InternalNode *node, CubeTriangleIsect *p, int height);
 
 	/**
@@ -421,7 +463,8 @@ class Octree
 	void writeOut();
 
 	void countIntersection(Node *node, int height, int& nedge, int& ncell, int& nface);
-	void generateMinimizer(Node *node, int st[3], int len, int height, int& offset);
+	void generateMinimizer(Node *node, int st[3], int len, int height, int& offset,
+	                       std::vector<MinimizerCell> &cells);
 	void computeMinimizer(const LeafNode * leaf, int st[3], int len,
 	                      float rvalue[3]) const;
 	/**
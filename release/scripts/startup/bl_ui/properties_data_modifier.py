@@ -846,6 +846,7 @@ class DATA_PT_modifiers(ModifierButtonsPanel, Panel):
         col.label(text="Options:")
         col.prop(md, "use_subsurf_uv")
         col.prop(md, "show_only_control_edges")
+        col.prop(md, "use_incremental")
 
     def SURFACE(self, layout, ob, md):
         layout.label(text="Settings are inside the Physics tab")
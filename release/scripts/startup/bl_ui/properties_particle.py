@@ -511,6 +511,7 @@ class PARTICLE_PT_physics(ParticleButtonsPanel, Panel):
                 split = layout.split()
                 sub = split.row()
                 sub.prop(fluid, "solver", expand=True)
+                split.prop(fluid, "use_grid_search")
 
                 split = layout.split()
 
@@ -294,6 +294,7 @@ class USERPREF_PT_edit(Panel):
         col.separator()
         col.label(text="Playback:")
         col.prop(edit, "use_negative_frames")
+        col.prop(edit, "fcurve_sample_tolerance", text="Sampling Tolerance")
         col.separator()
         col.separator()
         col.separator()
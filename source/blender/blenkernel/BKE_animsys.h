@@ -45,6 +45,7 @@ struct ReportList;
 struct bAction;
 struct bActionGroup;
 struct AnimMapper;
+struct AnimRNAPathCache;
 
 /* ************************************* */
 /* AnimData API */
@@ -142,6 +143,27 @@ typedef void (*ID_AnimData_Edit_Callback)(struct ID *id, struct AnimData *adt, v
 /* Loop over all datablocks applying callback */
 void BKE_animdata_main_cb(struct Main *main, ID_AnimData_Edit_Callback func, void *user_data);
 
+/* Free baked F-Curve samples of an ID, or of all datablocks */
+void BKE_animdata_free_sample_tables(struct ID *id);
+void BKE_animdata_free_sample_tables_main(struct Main *main);
+
+/* ************************************* */
+/* RNA Path Cache */
+
+/* Tag all cached RNA paths as invalid, to be called when data they could point to changes */
+void BKE_animsys_rna_path_cache_tag_invalid(void);
+
+struct AnimRNAPathCache *BKE_animsys_rna_path_cache_new(void);
+void BKE_animsys_rna_path_cache_free(struct AnimRNAPathCache *cache);
+
+/* Resolve path relative to ptr, reusing the result stored for key (F-Curve, driver target...) */
+bool BKE_animsys_rna_path_resolve_cached(struct AnimRNAPathCache *cache, const void *key,
+                                         struct PointerRNA *ptr, const char *path,
+                                         struct PointerRNA *r_ptr, struct PropertyRNA **r_prop, int *r_index);
+
+/* Print and reset hit rates, these are only counted with --debug-depsgraph */
+void BKE_animsys_rna_path_cache_print_stats(void);
+
 /* ************************************* */
 // TODO: overrides, remapping, and path-finding api's
 
@@ -265,8 +265,17 @@ void correct_bezpart(float v1[2], float v2[2], float v3[2], float v4[2]);
 
 /* evaluate fcurve */
 float evaluate_fcurve(struct FCurve *fcu, float evaltime);
+float evaluate_fcurve_ex(struct FCurve *fcu, float evaltime, const float sample_tolerance);
 /* evaluate fcurve and store value */
 void calculate_fcurve(struct FCurve *fcu, float ctime);
+/* evaluate a batch of fcurves for playback and store their values */
+void calculate_fcurves(struct FCurve **fcurves, int totfcurve, float ctime);
+
+/* -------- Baked Samples --------  */
+
+float fcurve_sample_tolerance(void);
+void fcurve_free_sample_table(struct FCurve *fcu);
+void fcurves_free_sample_tables(struct ListBase *list);
 
 /* ************* F-Curve Samples API ******************** */
 
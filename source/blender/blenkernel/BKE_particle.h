@@ -64,6 +64,7 @@ struct SurfaceModifierData;
 struct BVHTreeRay;
 struct BVHTreeRayHit; 
 struct EdgeHash;
+struct PointGrid;
 
 #define PARTICLE_P              ParticleData * pa; int p
 #define LOOP_PARTICLES  for (p = 0, pa = psys->particles; p < psys->totpart; p++, pa++)
@@ -93,6 +94,8 @@ typedef struct SPHData {
 	ParticleData *pa;
 	float mass;
 	struct EdgeHash *eh;
+	/* Neighbor search grids for psys, used instead of the BVH trees with SPH_GRID_SEARCH. */
+	struct PointGrid *grid[10];
 	float *gravity;
 	float hfac;
 	/* Average distance to neighbours (other particles in the support domain),
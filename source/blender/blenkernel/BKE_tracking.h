@@ -223,6 +223,7 @@ bool BKE_autotrack_context_step(struct AutoTrackContext *context);
 void BKE_autotrack_context_sync(struct AutoTrackContext *context);
 void BKE_autotrack_context_sync_user(struct AutoTrackContext *context, struct MovieClipUser *user);
 void BKE_autotrack_context_finish(struct AutoTrackContext *context);
+void BKE_autotrack_context_print_stats(struct AutoTrackContext *context);
 void BKE_autotrack_context_free(struct AutoTrackContext *context);
 
 /* **** Plane tracking **** */
@@ -52,6 +52,7 @@
 #include "BKE_action.h"
 #include "BKE_anim.h"
 #include "BKE_animsys.h"
+#include "BKE_armature.h"
 #include "BKE_constraint.h"
 #include "BKE_deform.h"
 #include "BKE_fcurve.h"
@@ -591,6 +592,7 @@ void BKE_pose_copy_data(bPose **dst, bPose *src, const bool copy_constraints)
 
 	outPose->iksolver = src->iksolver;
 	outPose->ikdata = NULL;
+	outPose->eval_graph = NULL;
 	outPose->ikparam = MEM_dupallocN(src->ikparam);
 	outPose->avs = src->avs;
 	
@@ -781,6 +783,9 @@ void BKE_pose_free_ex(bPose *pose, bool do_id_user)
 		/* free IK solver state */
 		BIK_clear_data(pose);
 		
+		/* free threaded evaluation data */
+		BKE_pose_eval_graph_free(pose);
+		
 		/* free IK solver param */
 		if (pose->ikparam)
 			MEM_freeN(pose->ikparam);
@@ -875,6 +880,9 @@ void BKE_pose_update_constraint_flags(bPose *pose)
 	bPoseChannel *pchan, *parchan;
 	bConstraint *con;
 	
+	/* constraints may have changed, which channels depend on each other */
+	BKE_pose_eval_graph_free(pose);
+	
 	/* clear */
 	for (pchan = pose->chanbase.first; pchan; pchan = pchan->next) {
 		pchan->constflag = 0;
@@ -1336,6 +1344,7 @@ void what_does_obaction(Object *ob, Object *workob, bPose *pose, bAction *act, c
 
 	BLI_strncpy(workob->parsubstr, ob->parsubstr, sizeof(workob->parsubstr));
 	BLI_strncpy(workob->id.name, "OB<ConstrWorkOb>", sizeof(workob->id.name)); /* we don't use real object name, otherwise RNA screws with the real thing */
+	workob->id.flag |= LIB_ANIM_NO_RECALC; /* temporary, also keeps the animation system from caching paths resolved on it */
 	
 	/* if we're given a group to use, it's likely to be more efficient (though a bit more dangerous) */
 	if (agrp) {
@@ -42,7 +42,10 @@
 #include "BLI_blenlib.h"
 #include "BLI_alloca.h"
 #include "BLI_dynstr.h"
+#include "BLI_ghash.h"
 #include "BLI_listbase.h"
+#include "BLI_mempool.h"
+#include "BLI_threads.h"
 
 #include "BLF_translation.h"
 
@@ -73,6 +76,8 @@
 
 #include "nla_private.h"
 
+#include "atomic_ops.h"
+
 /* ***************************************** */
 /* AnimData API */
 
@@ -242,6 +247,10 @@ void BKE_free_animdata(ID *id)
 			/* free overrides */
 			/* TODO... */
 			
+			/* free runtime data */
+			if (adt->rna_cache)
+				BKE_animsys_rna_path_cache_free(adt->rna_cache);
+			
 			/* free animdata now */
 			MEM_freeN(adt);
 			iat->adt = NULL;
@@ -260,6 +269,7 @@ AnimData *BKE_copy_animdata(AnimData *adt, const bool do_action)
 	if (adt == NULL)
 		return NULL;
 	dadt = MEM_dupallocN(adt);
+	dadt->rna_cache = NULL;
 	
 	/* make a copy of action - at worst, user has to delete copies... */
 	if (do_action) {
@@ -827,6 +837,9 @@ void BKE_action_fix_paths_rename(ID *owner_id, bAction *act, const char *prefix,
 	/* free the temp names */
 	MEM_freeN(oldN);
 	MEM_freeN(newN);
+	
+	/* renamed paths resolve to different data now */
+	BKE_animsys_rna_path_cache_tag_invalid();
 }
 
 /* Fix all RNA-Paths in the AnimData block used by the given ID block
@@ -877,6 +890,9 @@ void BKE_animdata_fix_paths_rename(ID *owner_id, AnimData *adt, ID *ref_id, cons
 	/* free the temp names */
 	MEM_freeN(oldN);
 	MEM_freeN(newN);
+	
+	/* renamed paths resolve to different data now */
+	BKE_animsys_rna_path_cache_tag_invalid();
 }
 
 /* *************************** */
@@ -1033,6 +1049,54 @@ void BKE_animdata_main_cb(Main *mainptr, ID_AnimData_Edit_Callback func, void *u
 	ANIMDATA_IDS_CB(mainptr->linestyle.first);
 }
 
+/* Baked F-Curve Samples ---------------------------------------------- */
+
+static void nlastrips_free_sample_tables(ListBase *strips)
+{
+	NlaStrip *strip;
+	
+	for (strip = strips->first; strip; strip = strip->next) {
+		fcurves_free_sample_tables(&strip->fcurves);
+		nlastrips_free_sample_tables(&strip->strips);
+	}
+}
+
+static void animdata_free_sample_tables_cb(ID *UNUSED(id), AnimData *adt, void *UNUSED(user_data))
+{
+	NlaTrack *nlt;
+	
+	fcurves_free_sample_tables(&adt->drivers);
+	for (nlt = adt->nla_tracks.first; nlt; nlt = nlt->next) {
+		nlastrips_free_sample_tables(&nlt->strips);
+	}
+}
+
+/* Free the baked samples of all F-Curves owned by the given ID,
+ * for keyframes edited without updating their F-Curve afterwards */
+void BKE_animdata_free_sample_tables(ID *id)
+{
+	AnimData *adt;
+	
+	if (GS(id->name) == ID_AC) {
+		fcurves_free_sample_tables(&((bAction *)id)->curves);
+	}
+	else if ((adt = BKE_animdata_from_id(id))) {
+		animdata_free_sample_tables_cb(id, adt, NULL);
+	}
+}
+
+/* Free the baked samples of all F-Curves in the database, i.e. when the tolerance they were baked for changes */
+void BKE_animdata_free_sample_tables_main(Main *mainptr)
+{
+	bAction *act;
+	
+	for (act = mainptr->action.first; act; act = act->id.next) {
+		fcurves_free_sample_tables(&act->curves);
+	}
+	
+	BKE_animdata_main_cb(mainptr, animdata_free_sample_tables_cb, NULL);
+}
+
 /* Fix all RNA-Paths throughout the database (directly access the Global.main version)
  * NOTE: it is assumed that the structure we're replacing is <prefix><["><name><"]>
  *      i.e. pose.bones["Bone"]
@@ -1323,6 +1387,186 @@ void BKE_keyingsets_free(ListBase *list)
 	}
 }
 
+/* ***************************************** */
+/* RNA Path Cache */
+
+/* Resolving the RNA path string of every F-Curve and driver target on each frame
+ * is the bulk of playback time for heavily animated rigs, so the result is stored
+ * per F-Curve or driver target. The resolved pointers can dangle as soon as the
+ * data they point into is edited, so all caches are dropped together whenever
+ * the generation below is bumped (on depsgraph tagging, property updates,
+ * freeing of ID-blocks, pose rebuilds and path renames).
+ */
+
+typedef struct AnimRNAPathCacheEntry {
+	const void *owner;    /* data of the pointer the path was resolved relative to */
+	const char *path;     /* only compared, to catch paths that were reallocated */
+	PointerRNA ptr;
+	PropertyRNA *prop;
+	int index;
+	bool ok;
+} AnimRNAPathCacheEntry;
+
+typedef struct AnimRNAPathCache {
+	GHash *entries;       /* (F-Curve, driver target...) -> AnimRNAPathCacheEntry */
+	BLI_mempool *entry_pool;
+	unsigned int generation;
+	SpinLock lock;
+} AnimRNAPathCache;
+
+static unsigned int animsys_rna_path_cache_generation = 1;
+
+/* hit rate, only counted with --debug-depsgraph */
+static unsigned int animsys_rna_path_cache_hits = 0;
+static unsigned int animsys_rna_path_cache_misses = 0;
+
+void BKE_animsys_rna_path_cache_tag_invalid(void)
+{
+	atomic_add_uint32(&animsys_rna_path_cache_generation, 1);
+}
+
+AnimRNAPathCache *BKE_animsys_rna_path_cache_new(void)
+{
+	AnimRNAPathCache *cache = MEM_callocN(sizeof(AnimRNAPathCache), "AnimRNAPathCache");
+	
+	cache->entries = BLI_ghash_ptr_new("AnimRNAPathCache entries");
+	cache->entry_pool = BLI_mempool_create(sizeof(AnimRNAPathCacheEntry), 0, 512, BLI_MEMPOOL_NOP);
+	cache->generation = animsys_rna_path_cache_generation;
+	BLI_spin_init(&cache->lock);
+	
+	return cache;
+}
+
+void BKE_animsys_rna_path_cache_free(AnimRNAPathCache *cache)
+{
+	BLI_ghash_free(cache->entries, NULL, NULL);
+	BLI_mempool_destroy(cache->entry_pool);
+	BLI_spin_end(&cache->lock);
+	MEM_freeN(cache);
+}
+
+/* Resolve path relative to ptr like RNA_path_resolve_property(_full) does,
+ * storing the result under key so following calls for the same key skip the parsing.
+ * r_index is optional, when given the path may end with an array index.
+ */
+bool BKE_animsys_rna_path_resolve_cached(AnimRNAPathCache *cache, const void *key,
+                                         PointerRNA *ptr, const char *path,
+                                         PointerRNA *r_ptr, PropertyRNA **r_prop, int *r_index)
+{
+	const unsigned int generation = animsys_rna_path_cache_generation;
+	AnimRNAPathCacheEntry *entry;
+	PointerRNA new_ptr;
+	PropertyRNA *prop;
+	int index = -1;
+	bool ok;
+	
+	BLI_spin_lock(&cache->lock);
+	
+	/* drop everything once anything was invalidated, this also keeps stale keys from piling up */
+	if (cache->generation != generation) {
+		BLI_ghash_clear(cache->entries, NULL, NULL);
+		BLI_mempool_clear(cache->entry_pool);
+		cache->generation = generation;
+	}
+	
+	entry = BLI_ghash_lookup(cache->entries, key);
+	if (entry && (entry->owner == ptr->data) && (entry->path == path)) {
+		*r_ptr = entry->ptr;
+		*r_prop = entry->prop;
+		if (r_index)
+			*r_index = entry->index;
+		ok = entry->ok;
+		
+		BLI_spin_unlock(&cache->lock);
+		
+		if (G.debug & G_DEBUG_DEPSGRAPH)
+			atomic_add_uint32(&animsys_rna_path_cache_hits, 1);
+		
+		return ok;
+	}
+	
+	BLI_spin_unlock(&cache->lock);
+	
+	if (G.debug & G_DEBUG_DEPSGRAPH)
+		atomic_add_uint32(&animsys_rna_path_cache_misses, 1);
+	
+	/* resolve outside of the lock, path lookups can be slow */
+	if (r_index)
+		ok = RNA_path_resolve_property_full(ptr, path, &new_ptr, &prop, &index);
+	else
+		ok = RNA_path_resolve_property(ptr, path, &new_ptr, &prop);
+	
+	/* ID properties can be removed without any update being sent, so never keep them around */
+	if (ok && RNA_property_is_idprop(prop)) {
+		*r_ptr = new_ptr;
+		*r_prop = prop;
+		if (r_index)
+			*r_index = index;
+		return ok;
+	}
+	
+	BLI_spin_lock(&cache->lock);
+	
+	/* don't store results which may already have been invalidated while resolving */
+	if (cache->generation == generation && generation == animsys_rna_path_cache_generation) {
+		entry = BLI_ghash_lookup(cache->entries, key);
+		if (entry == NULL) {
+			entry = BLI_mempool_alloc(cache->entry_pool);
+			BLI_ghash_insert(cache->entries, (void *)key, entry);
+		}
+		
+		entry->owner = ptr->data;
+		entry->path = path;
+		entry->ptr = new_ptr;
+		entry->prop = prop;
+		entry->index = index;
+		entry->ok = ok;
+	}
+	
+	BLI_spin_unlock(&cache->lock);
+	
+	*r_ptr = new_ptr;
+	*r_prop = prop;
+	if (r_index)
+		*r_index = index;
+	
+	return ok;
+}
+
+void BKE_animsys_rna_path_cache_print_stats(void)
+{
+	const unsigned int hits = animsys_rna_path_cache_hits;
+	const unsigned int misses = animsys_rna_path_cache_misses;
+	
+	if (hits + misses) {
+		printf("Animato: RNA path cache, %u hits, %u misses (%.1f%% hit rate)\n",
+		       hits, misses, 100.0 * (double)hits / (double)(hits + misses));
+	}
+	
+	animsys_rna_path_cache_hits = 0;
+	animsys_rna_path_cache_misses = 0;
+}
+
+/* Get the path cache of the AnimData being evaluated, NULL when caching can't be used */
+static AnimRNAPathCache *animsys_rna_path_cache_ensure(ID *id, AnimData *adt)
+{
+	static ThreadMutex cache_mutex = BLI_MUTEX_INITIALIZER;
+	
+	/* AnimData which is evaluated on some other (temporary) ID-block can't be cached,
+	 * the results point into data of the other ID-block */
+	if ((id->flag & LIB_ANIM_NO_RECALC) || (BKE_animdata_from_id(id) != adt))
+		return NULL;
+	
+	if (adt->rna_cache == NULL) {
+		BLI_mutex_lock(&cache_mutex);
+		if (adt->rna_cache == NULL)
+			adt->rna_cache = BKE_animsys_rna_path_cache_new();
+		BLI_mutex_unlock(&cache_mutex);
+	}
+	
+	return adt->rna_cache;
+}
+
 /* ***************************************** */
 /* Evaluation Data-Setting Backend */
 
@@ -1353,16 +1597,24 @@ static bool animsys_remap_path(AnimMapper *UNUSED(remap), char *path, char **dst
 /* less then 1.0 evaluates to false, use epsilon to avoid float error */
 #define ANIMSYS_FLOAT_AS_BOOL(value) ((value) > ((1.0f - FLT_EPSILON)))
 
-/* Write the given value to a setting using RNA, and return success */
-static bool animsys_write_rna_setting(PointerRNA *ptr, char *path, int array_index, float value)
+/* Write the given value to a setting using RNA, and return success
+ * When a path cache is given, the resolved path is looked up there for key (the F-Curve) */
+static bool animsys_write_rna_setting_ex(PointerRNA *ptr, AnimRNAPathCache *cache, const void *key,
+                                         char *path, int array_index, float value)
 {
 	PropertyRNA *prop;
 	PointerRNA new_ptr;
+	bool ok;
 	
 	//printf("%p %s %i %f\n", ptr, path, array_index, value);
 	
 	/* get property to write to */
-	if (RNA_path_resolve_property(ptr, path, &new_ptr, &prop)) {
+	if (cache)
+		ok = BKE_animsys_rna_path_resolve_cached(cache, key, ptr, path, &new_ptr, &prop, NULL);
+	else
+		ok = RNA_path_resolve_property(ptr, path, &new_ptr, &prop);
+	
+	if (ok) {
 		/* set value - only for animatable numerical values */
 		if (RNA_property_animateable(&new_ptr, prop)) {
 			int array_len = RNA_property_array_length(&new_ptr, prop);
@@ -1483,8 +1735,14 @@ static bool animsys_write_rna_setting(PointerRNA *ptr, char *path, int array_ind
 	}
 }
 
-/* Simple replacement based data-setting of the FCurve using RNA */
-static bool animsys_execute_fcurve(PointerRNA *ptr, AnimMapper *remap, FCurve *fcu)
+static bool animsys_write_rna_setting(PointerRNA *ptr, char *path, int array_index, float value)
+{
+	return animsys_write_rna_setting_ex(ptr, NULL, NULL, path, array_index, value);
+}
+
+/* Simple replacement based data-setting of the FCurve using RNA
+ * The path cache is optional (NULL), see animsys_rna_path_cache_ensure() */
+static bool animsys_execute_fcurve(PointerRNA *ptr, AnimRNAPathCache *cache, AnimMapper *remap, FCurve *fcu)
 {
 	char *path = NULL;
 	bool free_path = false;
@@ -1493,9 +1751,9 @@ static bool animsys_execute_fcurve(PointerRNA *ptr, AnimMapper *remap, FCurve *f
 	/* get path, remapped as appropriate to work in its new environment */
 	free_path = animsys_remap_path(remap, fcu->rna_path, &path);
 	
-	/* write value to setting */
+	/* write value to setting, temp remapped paths can't be cached */
 	if (path)
-		ok = animsys_write_rna_setting(ptr, path, fcu->array_index, fcu->curval);
+		ok = animsys_write_rna_setting_ex(ptr, free_path ? NULL : cache, fcu, path, fcu->array_index, fcu->curval);
 	
 	/* free temp path-info */
 	if (free_path)
@@ -1505,23 +1763,37 @@ static bool animsys_execute_fcurve(PointerRNA *ptr, AnimMapper *remap, FCurve *f
 	return ok;
 }
 
+/* number of F-Curves calculated together before they're written */
+#define ANIMSYS_FCURVE_BATCH 64
+
 /* Evaluate all the F-Curves in the given list 
  * This performs a set of standard checks. If extra checks are required, separate code should be used
  */
-static void animsys_evaluate_fcurves(PointerRNA *ptr, ListBase *list, AnimMapper *remap, float ctime)
+static void animsys_evaluate_fcurves(PointerRNA *ptr, AnimRNAPathCache *cache, ListBase *list, AnimMapper *remap,
+                                     float ctime)
 {
-	FCurve *fcu;
+	FCurve *fcu = list->first;
 	
-	/* calculate then execute each curve */
-	for (fcu = list->first; fcu; fcu = fcu->next) {
-		/* check if this F-Curve doesn't belong to a muted group */
-		if ((fcu->grp == NULL) || (fcu->grp->flag & AGRP_MUTED) == 0) {
-			/* check if this curve should be skipped */
-			if ((fcu->flag & (FCURVE_MUTED | FCURVE_DISABLED)) == 0) {
-				calculate_fcurve(fcu, ctime);
-				animsys_execute_fcurve(ptr, remap, fcu); 
+	/* calculate then execute the curves, in batches for evaluating their baked samples at once */
+	while (fcu) {
+		FCurve *batch[ANIMSYS_FCURVE_BATCH];
+		int batch_len = 0;
+		int i;
+		
+		for (; fcu && (batch_len < ANIMSYS_FCURVE_BATCH); fcu = fcu->next) {
+			/* check if this F-Curve doesn't belong to a muted group */
+			if ((fcu->grp == NULL) || (fcu->grp->flag & AGRP_MUTED) == 0) {
+				/* check if this curve should be skipped */
+				if ((fcu->flag & (FCURVE_MUTED | FCURVE_DISABLED)) == 0) {
+					batch[batch_len++] = fcu;
+				}
 			}
 		}
+		
+		calculate_fcurves(batch, batch_len, ctime);
+		for (i = 0; i < batch_len; i++) {
+			animsys_execute_fcurve(ptr, cache, remap, batch[i]);
+		}
 	}
 }
 
@@ -1529,7 +1801,7 @@ static void animsys_evaluate_fcurves(PointerRNA *ptr, ListBase *list, AnimMapper
 /* Driver Evaluation */
 
 /* Evaluate Drivers */
-static void animsys_evaluate_drivers(PointerRNA *ptr, AnimData *adt, float ctime)
+static void animsys_evaluate_drivers(PointerRNA *ptr, AnimRNAPathCache *cache, AnimData *adt, float ctime)
 {
 	FCurve *fcu;
 	
@@ -1549,7 +1821,7 @@ static void animsys_evaluate_drivers(PointerRNA *ptr, AnimData *adt, float ctime
 				 * NOTE: for 'layering' option later on, we should check if we should remove old value before adding
 				 *       new to only be done when drivers only changed */
 				calculate_fcurve(fcu, ctime);
-				ok = animsys_execute_fcurve(ptr, NULL, fcu);
+				ok = animsys_execute_fcurve(ptr, cache, NULL, fcu);
 				
 				/* clear recalc flag */
 				driver->flag &= ~DRIVER_FLAG_RECALC;
@@ -1617,14 +1889,15 @@ void animsys_evaluate_action_group(PointerRNA *ptr, bAction *act, bActionGroup *
 	for (fcu = agrp->channels.first; (fcu) && (fcu->grp == agrp); fcu = fcu->next) {
 		/* check if this curve should be skipped */
 		if ((fcu->flag & (FCURVE_MUTED | FCURVE_DISABLED)) == 0) {
-			calculate_fcurve(fcu, ctime);
-			animsys_execute_fcurve(ptr, remap, fcu); 
+			calculate_fcurves(&fcu, 1, ctime);
+			animsys_execute_fcurve(ptr, NULL, remap, fcu); 
 		}
 	}
 }
 
 /* Evaluate Action (F-Curve Bag) */
-void animsys_evaluate_action(PointerRNA *ptr, bAction *act, AnimMapper *remap, float ctime)
+static void animsys_evaluate_action_ex(PointerRNA *ptr, AnimRNAPathCache *cache, bAction *act, AnimMapper *remap,
+                                       float ctime)
 {
 	/* check if mapper is appropriate for use here (we set to NULL if it's inappropriate) */
 	if (act == NULL) return;
@@ -1633,7 +1906,12 @@ void animsys_evaluate_action(PointerRNA *ptr, bAction *act, AnimMapper *remap, f
 	action_idcode_patch_check(ptr->id.data, act);
 	
 	/* calculate then execute each curve */
-	animsys_evaluate_fcurves(ptr, &act->curves, remap, ctime);
+	animsys_evaluate_fcurves(ptr, cache, &act->curves, remap, ctime);
+}
+
+void animsys_evaluate_action(PointerRNA *ptr, bAction *act, AnimMapper *remap, float ctime)
+{
+	animsys_evaluate_action_ex(ptr, NULL, act, remap, ctime);
 }
 
 /* ***************************************** */
@@ -1678,7 +1956,7 @@ static void nlastrip_evaluate_controls(NlaStrip *strip, float ctime)
 		RNA_pointer_create(NULL, &RNA_NlaStrip, strip, &strip_ptr);
 		
 		/* execute these settings as per normal */
-		animsys_evaluate_fcurves(&strip_ptr, &strip->fcurves, NULL, ctime);
+		animsys_evaluate_fcurves(&strip_ptr, NULL, &strip->fcurves, NULL, ctime);
 	}
 
 	/* if user can control the evaluation time (using F-Curves), consider the option which allows this time to be clamped
@@ -2075,6 +2353,7 @@ static void nlastrip_evaluate_actionclip(PointerRNA *ptr, ListBase *channels, Li
 	ListBase tmp_modifiers = {NULL, NULL};
 	NlaStrip *strip = nes->strip;
 	FCurve *fcu;
+	const float sample_tolerance = fcurve_sample_tolerance();
 	float evaltime;
 	
 	/* sanity checks for action */
@@ -2110,7 +2389,7 @@ static void nlastrip_evaluate_actionclip(PointerRNA *ptr, ListBase *channels, Li
 		/* evaluate the F-Curve's value for the time given in the strip 
 		 * NOTE: we use the modified time here, since strip's F-Curve Modifiers are applied on top of this 
 		 */
-		value = evaluate_fcurve(fcu, evaltime);
+		value = evaluate_fcurve_ex(fcu, evaltime, sample_tolerance);
 		
 		/* apply strip's F-Curve Modifiers on this value 
 		 * NOTE: we apply the strip's original evaluation time not the modified one (as per standard F-Curve eval)
@@ -2514,6 +2793,7 @@ static void animsys_evaluate_overrides(PointerRNA *ptr, AnimData *adt)
 void BKE_animsys_evaluate_animdata(Scene *scene, ID *id, AnimData *adt, float ctime, short recalc)
 {
 	PointerRNA id_ptr;
+	AnimRNAPathCache *rna_cache;
 	
 	/* sanity checks */
 	if (ELEM(NULL, id, adt))
@@ -2521,6 +2801,7 @@ void BKE_animsys_evaluate_animdata(Scene *scene, ID *id, AnimData *adt, float ct
 	
 	/* get pointer to ID-block for RNA to use */
 	RNA_id_pointer_create(id, &id_ptr);
+	rna_cache = animsys_rna_path_cache_ensure(id, adt);
 	
 	/* recalculate keyframe data:
 	 *	- NLA before Active Action, as Active Action behaves as 'tweaking track'
@@ -2537,7 +2818,7 @@ void BKE_animsys_evaluate_animdata(Scene *scene, ID *id, AnimData *adt, float ct
 		}
 		/* evaluate Active Action only */
 		else if (adt->action)
-			animsys_evaluate_action(&id_ptr, adt->action, adt->remap, ctime);
+			animsys_evaluate_action_ex(&id_ptr, rna_cache, adt->action, adt->remap, ctime);
 		
 		/* reset tag */
 		adt->recalc &= ~ADT_RECALC_ANIM;
@@ -2552,7 +2833,7 @@ void BKE_animsys_evaluate_animdata(Scene *scene, ID *id, AnimData *adt, float ct
 	    /* XXX for now, don't check yet, as depsgraph hasn't been updated */
 	    /* && (adt->recalc & ADT_RECALC_DRIVERS)*/)
 	{
-		animsys_evaluate_drivers(&id_ptr, adt, ctime);
+		animsys_evaluate_drivers(&id_ptr, rna_cache, adt, ctime);
 	}
 	
 	/* always execute 'overrides' 
@@ -39,6 +39,9 @@
 
 #include "BLI_math.h"
 #include "BLI_blenlib.h"
+#include "BLI_edgehash.h"
+#include "BLI_ghash.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "DNA_anim_types.h"
@@ -71,6 +74,8 @@
 #include "BIK_api.h"
 #include "BKE_sketch.h"
 
+#include "atomic_ops.h"
+
 /* **************** Generic Functions, data level *************** */
 
 bArmature *BKE_armature_add(Main *bmain, const char *name)
@@ -1777,6 +1782,10 @@ void BKE_pose_rebuild(Object *ob, bArmature *arm)
 	}
 	pose = ob->pose;
 
+	/* channels and their data may be removed or reallocated below,
+	 * animation paths can be resolved to them */
+	BKE_animsys_rna_path_cache_tag_invalid();
+
 	/* clear */
 	for (pchan = pose->chanbase.first; pchan; pchan = pchan->next) {
 		pchan->bone = NULL;
@@ -2510,6 +2519,349 @@ void BKE_pose_where_is_bone(Scene *scene, Object *ob, bPoseChannel *pchan, float
 	BKE_pose_where_is_bone_tail(pchan);
 }
 
+/* ********************** THREADED POSE EVALUATION ******************* */
+
+/* Channels which don't read each other's results are evaluated concurrently.
+ * Every pair of channels where one reads the other (parent and child, constraint owner and
+ * target) is ordered by their position in the sorted channel list, so the results are the
+ * same as when evaluating the list serially. IK and Spline IK trees are solved from their
+ * root channel, which then writes all channels in the chain, so for channels which may be
+ * part of such a chain, all parents are treated as writing the channel too. Channels with
+ * constraints writing data outside of the pose are kept in list order among each other.
+ *
+ * The graph only depends on the channels and their constraints, it's cached on the pose
+ * and freed by BKE_pose_update_constraint_flags(), which is called on every change of those.
+ */
+
+/* below this many channels serial evaluation is faster */
+#define POSE_THREADED_LIMIT 64
+
+typedef struct PoseEvalChannel {
+	bPoseChannel *pchan;
+	/* to detect changes which didn't go through BKE_pose_update_constraint_flags() */
+	bPoseChannel *parent;
+	void *constraints_last;
+	char constflag;
+	bool in_ik_chain;
+} PoseEvalChannel;
+
+typedef struct PoseEvalGraph {
+	int totchannel;
+	bool has_ik;
+	PoseEvalChannel *channels;     /* in the order of the channel list */
+	int *dependents_offset;        /* totchannel + 1 items, dependents of channel i are in [offset[i], offset[i + 1]) */
+	int *dependents;               /* channels which have to wait for the channel to be evaluated */
+	unsigned int *num_depends;     /* number of channels to wait for */
+	unsigned int *num_pending;     /* during evaluation, number of channels still waited for */
+} PoseEvalGraph;
+
+typedef struct PoseEvalState {
+	Scene *scene;
+	Object *ob;
+	PoseEvalGraph *graph;
+	float ctime;
+} PoseEvalState;
+
+void BKE_pose_eval_graph_free(bPose *pose)
+{
+	PoseEvalGraph *graph = pose->eval_graph;
+
+	if (graph) {
+		MEM_freeN(graph->channels);
+		MEM_freeN(graph->dependents_offset);
+		if (graph->dependents)
+			MEM_freeN(graph->dependents);
+		MEM_freeN(graph->num_depends);
+		MEM_freeN(graph->num_pending);
+		MEM_freeN(graph);
+
+		pose->eval_graph = NULL;
+	}
+}
+
+/* order a and b, and everything which may write them as part of an IK chain */
+static void pose_eval_graph_relation_add(EdgeSet *relations, GHash *chan_index, const PoseEvalChannel *channels,
+                                         bPoseChannel *pchan_a, bPoseChannel *pchan_b)
+{
+	bPoseChannel *a, *b;
+
+	for (a = pchan_a; a; a = a->parent) {
+		const int index_a = GET_INT_FROM_POINTER(BLI_ghash_lookup(chan_index, a));
+
+		for (b = pchan_b; b; b = b->parent) {
+			const int index_b = GET_INT_FROM_POINTER(BLI_ghash_lookup(chan_index, b));
+
+			if (index_a != index_b)
+				BLI_edgeset_add(relations, (unsigned int)index_a, (unsigned int)index_b);
+
+			if (!channels[index_b].in_ik_chain)
+				break;
+		}
+
+		if (!channels[index_a].in_ik_chain)
+			break;
+	}
+}
+
+static PoseEvalGraph *pose_eval_graph_build(Object *ob)
+{
+	bPose *pose = ob->pose;
+	PoseEvalGraph *graph = MEM_callocN(sizeof(PoseEvalGraph), "PoseEvalGraph");
+	PoseEvalChannel *channels;
+	EdgeSet *relations;
+	EdgeSetIterator *esi;
+	GHash *chan_index;
+	bPoseChannel *pchan, *parchan, *pchan_shared_prev = NULL;
+	bConstraint *con;
+	int totchannel = BLI_listbase_count(&pose->chanbase);
+	int totrelation, i;
+
+	graph->totchannel = totchannel;
+	graph->channels = channels = MEM_callocN(sizeof(*channels) * totchannel, "PoseEvalGraph channels");
+
+	chan_index = BLI_ghash_ptr_new_ex(__func__, (unsigned int)totchannel);
+	for (pchan = pose->chanbase.first, i = 0; pchan; pchan = pchan->next, i++) {
+		channels[i].pchan = pchan;
+		channels[i].parent = pchan->parent;
+		channels[i].constraints_last = pchan->constraints.last;
+		channels[i].constflag = pchan->constflag;
+		BLI_ghash_insert(chan_index, pchan, SET_INT_IN_POINTER(i));
+	}
+
+	/* channels which may be part of an IK or Spline IK chain, these go up from the owner */
+	for (i = 0; i < totchannel; i++) {
+		pchan = channels[i].pchan;
+
+		for (con = pchan->constraints.first; con; con = con->next) {
+			if (ELEM(con->type, CONSTRAINT_TYPE_KINEMATIC, CONSTRAINT_TYPE_SPLINEIK)) {
+				graph->has_ik = true;
+
+				for (parchan = pchan; parchan; parchan = parchan->parent) {
+					const int index = GET_INT_FROM_POINTER(BLI_ghash_lookup(chan_index, parchan));
+
+					if (channels[index].in_ik_chain)
+						break;
+					channels[index].in_ik_chain = true;
+				}
+				break;
+			}
+		}
+	}
+
+	/* collect the pairs of channels reading each other */
+	relations = BLI_edgeset_new_ex(__func__, (unsigned int)totchannel * 2);
+
+	for (i = 0; i < totchannel; i++) {
+		bool writes_shared = false;
+
+		pchan = channels[i].pchan;
+
+		/* parents come first in the list, so all IK chain parents are ordered through these already */
+		if (pchan->parent) {
+			const int index_parent = GET_INT_FROM_POINTER(BLI_ghash_lookup(chan_index, pchan->parent));
+			BLI_edgeset_add(relations, (unsigned int)index_parent, (unsigned int)i);
+		}
+
+		for (con = pchan->constraints.first; con; con = con->next) {
+			bConstraintTypeInfo *cti = BKE_constraint_typeinfo_get(con);
+			ListBase targets = {NULL, NULL};
+			bConstraintTarget *ct;
+
+			if (!(cti && cti->get_constraint_targets))
+				continue;
+
+			/* Action constraints evaluate F-Curves of actions which may be shared */
+			if (con->type == CONSTRAINT_TYPE_ACTION)
+				writes_shared = true;
+
+			cti->get_constraint_targets(con, &targets);
+
+			for (ct = targets.first; ct; ct = ct->next) {
+				bPoseChannel *pchan_target;
+
+				/* curve targets can get their path calculated by the constraint (CYCLIC_DEPENDENCY_WORKAROUND) */
+				if (ct->tar && (ct->tar->type == OB_CURVE))
+					writes_shared = true;
+
+				if ((ct->tar != ob) || (ct->subtarget[0] == '\0'))
+					continue;
+
+				pchan_target = BKE_pose_channel_find_name(pose, ct->subtarget);
+				if (pchan_target && (pchan_target != pchan)) {
+					pose_eval_graph_relation_add(relations, chan_index, channels, pchan, pchan_target);
+
+					/* target spaces and B-Bone segments read the neighbors of the target too */
+					if (pchan_target->parent)
+						pose_eval_graph_relation_add(relations, chan_index, channels, pchan, pchan_target->parent);
+					if (pchan_target->child)
+						pose_eval_graph_relation_add(relations, chan_index, channels, pchan, pchan_target->child);
+				}
+			}
+
+			if (cti->flush_constraint_targets)
+				cti->flush_constraint_targets(con, &targets, 1);
+		}
+
+		/* channels writing data outside of the pose are evaluated one after the other */
+		if (writes_shared) {
+			if (pchan_shared_prev)
+				pose_eval_graph_relation_add(relations, chan_index, channels, pchan_shared_prev, pchan);
+			pchan_shared_prev = pchan;
+		}
+	}
+
+	/* the relations point from the channel first in the list to the later one */
+	totrelation = BLI_edgeset_size(relations);
+	graph->dependents_offset = MEM_callocN(sizeof(int) * (totchannel + 1), "PoseEvalGraph dependents_offset");
+	graph->dependents = totrelation ? MEM_mallocN(sizeof(int) * totrelation, "PoseEvalGraph dependents") : NULL;
+	graph->num_depends = MEM_callocN(sizeof(unsigned int) * totchannel, "PoseEvalGraph num_depends");
+	graph->num_pending = MEM_mallocN(sizeof(unsigned int) * totchannel, "PoseEvalGraph num_pending");
+
+	for (esi = BLI_edgesetIterator_new(relations); !BLI_edgesetIterator_isDone(esi); BLI_edgesetIterator_step(esi)) {
+		unsigned int v0, v1;
+
+		BLI_edgesetIterator_getKey(esi, &v0, &v1);
+		graph->dependents_offset[MIN2(v0, v1) + 1]++;
+		graph->num_depends[MAX2(v0, v1)]++;
+	}
+
+	for (i = 0; i < totchannel; i++) {
+		graph->dependents_offset[i + 1] += graph->dependents_offset[i];
+	}
+
+	/* fill using num_pending as counter, it's reset before every evaluation anyway */
+	memset(graph->num_pending, 0, sizeof(unsigned int) * totchannel);
+
+	BLI_edgesetIterator_free(esi);
+
+	for (esi = BLI_edgesetIterator_new(relations); !BLI_edgesetIterator_isDone(esi); BLI_edgesetIterator_step(esi)) {
+		unsigned int v0, v1, first;
+
+		BLI_edgesetIterator_getKey(esi, &v0, &v1);
+		first = MIN2(v0, v1);
+		graph->dependents[graph->dependents_offset[first] + (int)graph->num_pending[first]++] = (int)MAX2(v0, v1);
+	}
+
+	BLI_edgesetIterator_free(esi);
+	BLI_edgeset_free(relations);
+	BLI_ghash_free(chan_index, NULL, NULL);
+
+	return graph;
+}
+
+/* check that nothing changed without the graph being freed */
+static bool pose_eval_graph_is_valid(PoseEvalGraph *graph, bPose *pose)
+{
+	bPoseChannel *pchan;
+	int i;
+
+	for (pchan = pose->chanbase.first, i = 0; pchan; pchan = pchan->next, i++) {
+		const PoseEvalChannel *channel = &graph->channels[i];
+
+		if ((i >= graph->totchannel) ||
+		    (channel->pchan != pchan) ||
+		    (channel->parent != pchan->parent) ||
+		    (channel->constraints_last != pchan->constraints.last) ||
+		    (channel->constflag != pchan->constflag))
+		{
+			return false;
+		}
+	}
+
+	return (i == graph->totchannel);
+}
+
+/* step 4 and 5 of BKE_pose_where_is() for a single channel */
+static void pose_channel_evaluate(Scene *scene, Object *ob, bPoseChannel *pchan, float ctime)
+{
+	/* 4a. if we find an IK root, we handle it separated */
+	if (pchan->flag & POSE_IKTREE) {
+		BIK_execute_tree(scene, ob, pchan, ctime);
+	}
+	/* 4b. if we find a Spline IK root, we handle it separated too */
+	else if (pchan->flag & POSE_IKSPLINE) {
+		splineik_execute_tree(scene, ob, pchan, ctime);
+	}
+	/* 5. otherwise just call the normal solver */
+	else if (!(pchan->flag & POSE_DONE)) {
+		BKE_pose_where_is_bone(scene, ob, pchan, ctime, 1);
+	}
+}
+
+static void pose_eval_task(TaskPool *pool, void *taskdata, int UNUSED(threadid))
+{
+	PoseEvalState *state = BLI_task_pool_userdata(pool);
+	PoseEvalGraph *graph = state->graph;
+	int index = GET_INT_FROM_POINTER(taskdata);
+
+	/* keep evaluating chains of channels in this task, only hand over branches to other threads */
+	while (index != -1) {
+		int next = -1, i;
+
+		pose_channel_evaluate(state->scene, state->ob, graph->channels[index].pchan, state->ctime);
+
+		for (i = graph->dependents_offset[index]; i < graph->dependents_offset[index + 1]; i++) {
+			const int dependent = graph->dependents[i];
+
+			if (atomic_sub_uint32(&graph->num_pending[dependent], 1) == 0) {
+				if (next == -1)
+					next = dependent;
+				else
+					BLI_task_pool_push(pool, pose_eval_task, SET_INT_IN_POINTER(dependent), false, TASK_PRIORITY_HIGH);
+			}
+		}
+
+		index = next;
+	}
+}
+
+/* evaluate the channels on the task scheduler, returns false when they have to be evaluated serially */
+static bool pose_where_is_threaded(Scene *scene, Object *ob, float ctime)
+{
+	bPose *pose = ob->pose;
+	TaskScheduler *task_scheduler = BLI_task_scheduler_get();
+	TaskPool *task_pool;
+	PoseEvalState state;
+	PoseEvalGraph *graph;
+	int i;
+
+	if (BLI_task_scheduler_num_threads(task_scheduler) < 2)
+		return false;
+
+	if (pose->eval_graph && !pose_eval_graph_is_valid(pose->eval_graph, pose))
+		BKE_pose_eval_graph_free(pose);
+
+	if (pose->eval_graph == NULL) {
+		if (BLI_listbase_count_ex(&pose->chanbase, POSE_THREADED_LIMIT) < POSE_THREADED_LIMIT)
+			return false;
+		pose->eval_graph = pose_eval_graph_build(ob);
+	}
+	graph = pose->eval_graph;
+
+	/* iTaSC shares its solver data between all trees of the pose */
+	if (graph->has_ik && (pose->iksolver == IKSOLVER_ITASC))
+		return false;
+
+	state.scene = scene;
+	state.ob = ob;
+	state.graph = graph;
+	state.ctime = ctime;
+
+	memcpy(graph->num_pending, graph->num_depends, sizeof(unsigned int) * graph->totchannel);
+
+	task_pool = BLI_task_pool_create(task_scheduler, &state);
+
+	for (i = 0; i < graph->totchannel; i++) {
+		if (graph->num_depends[i] == 0)
+			BLI_task_pool_push(task_pool, pose_eval_task, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH);
+	}
+
+	BLI_task_pool_work_and_wait(task_pool);
+	BLI_task_pool_free(task_pool);
+
+	return true;
+}
+
 /* This only reads anim data from channels, and writes to channels */
 /* This is the only function adding poses */
 void BKE_pose_where_is(Scene *scene, Object *ob)
@@ -2559,19 +2911,11 @@ void BKE_pose_where_is(Scene *scene, Object *ob)
 		 */
 		splineik_init_tree(scene, ob, ctime);
 
-		/* 3. the main loop, channels are already hierarchical sorted from root to children */
-		for (pchan = ob->pose->chanbase.first; pchan; pchan = pchan->next) {
-			/* 4a. if we find an IK root, we handle it separated */
-			if (pchan->flag & POSE_IKTREE) {
-				BIK_execute_tree(scene, ob, pchan, ctime);
-			}
-			/* 4b. if we find a Spline IK root, we handle it separated too */
-			else if (pchan->flag & POSE_IKSPLINE) {
-				splineik_execute_tree(scene, ob, pchan, ctime);
-			}
-			/* 5. otherwise just call the normal solver */
-			else if (!(pchan->flag & POSE_DONE)) {
-				BKE_pose_where_is_bone(scene, ob, pchan, ctime, 1);
+		/* 3. the main loop, channels are already hierarchical sorted from root to children,
+		 *    independent channels are evaluated in parallel on large poses */
+		if (!pose_where_is_threaded(scene, ob, ctime)) {
+			for (pchan = ob->pose->chanbase.first; pchan; pchan = pchan->next) {
+				pose_channel_evaluate(scene, ob, pchan, ctime);
 			}
 		}
 		/* 6. release the IK tree */
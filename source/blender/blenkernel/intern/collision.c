@@ -699,7 +699,34 @@ static int cloth_bvh_objcollisions_resolve ( ClothModifierData * clmd, Collision
 	return ret;
 }
 
-// cloth - object collisions
+/* Reject self-collision pairs that can never be resolved, before they are stored.
+ * Only reads data that doesn't change during the overlap query, called from multiple threads. */
+static bool cloth_bvh_selfcollision_overlap_cb(void *userdata, int index_a, int index_b, int UNUSED(thread))
+{
+	ClothModifierData *clmd = userdata;
+	Cloth *cloth = clmd->clothObject;
+
+	if (clmd->sim_parms->flags & CLOTH_SIMSETTINGS_FLAG_GOAL) {
+		if ((cloth->verts[index_a].flags & CLOTH_VERT_FLAG_PINNED) &&
+		    (cloth->verts[index_b].flags & CLOTH_VERT_FLAG_PINNED))
+		{
+			return false;
+		}
+	}
+
+	if ((cloth->verts[index_a].flags & CLOTH_VERT_FLAG_NOSELFCOLL) ||
+	    (cloth->verts[index_b].flags & CLOTH_VERT_FLAG_NOSELFCOLL))
+	{
+		return false;
+	}
+
+	if (BLI_edgeset_haskey(cloth->edgeset, (unsigned int)index_a, (unsigned int)index_b)) {
+		return false;
+	}
+
+	return true;
+}
+
 int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, float dt )
 {
 	Cloth *cloth= clmd->clothObject;
@@ -824,7 +851,8 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 	
 				if ( cloth->bvhselftree ) {
 					// search for overlapping collision pairs
-					overlap = BLI_bvhtree_overlap ( cloth->bvhselftree, cloth->bvhselftree, &result );
+					overlap = BLI_bvhtree_overlap_ex(cloth->bvhselftree, cloth->bvhselftree, &result,
+					                                 cloth_bvh_selfcollision_overlap_cb, clmd);
 	
 	// #pragma omp parallel for private(k, i, j) schedule(static)
 					for ( k = 0; k < result; k++ ) {
@@ -837,28 +865,11 @@ int cloth_bvh_objcollision(Object *ob, ClothModifierData *clmd, float step, floa
 	
 						mindistance = clmd->coll_parms->selfepsilon* ( cloth->verts[i].avg_spring_len + cloth->verts[j].avg_spring_len );
 	
-						if ( clmd->sim_parms->flags & CLOTH_SIMSETTINGS_FLAG_GOAL ) {
-							if ( ( cloth->verts [i].flags & CLOTH_VERT_FLAG_PINNED ) &&
-							     ( cloth->verts [j].flags & CLOTH_VERT_FLAG_PINNED ) )
-							{
-								continue;
-							}
-						}
-
-						if ((cloth->verts[i].flags & CLOTH_VERT_FLAG_NOSELFCOLL) ||
-						    (cloth->verts[j].flags & CLOTH_VERT_FLAG_NOSELFCOLL))
-						{
-							continue;
-						}
-	
+						/* pinned, no-self-collision and connected pairs are already rejected by the overlap callback */
 						sub_v3_v3v3(temp, verts[i].tx, verts[j].tx);
 	
 						if ( ( ABS ( temp[0] ) > mindistance ) || ( ABS ( temp[1] ) > mindistance ) || ( ABS ( temp[2] ) > mindistance ) ) continue;
 	
-						if (BLI_edgeset_haskey(cloth->edgeset, i, j)) {
-							continue;
-						}
-	
 						length = normalize_v3(temp );
 	
 						if ( length < mindistance ) {
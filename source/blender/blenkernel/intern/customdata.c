@@ -2591,7 +2591,8 @@ void CustomData_bmesh_free_block_data(CustomData *data, void *block)
 		memset(block, 0, data->totsize);
 }
 
-static void CustomData_bmesh_alloc_block(CustomData *data, void **block)
+/* allocate a block from the layers pool, without initializing it */
+void CustomData_bmesh_alloc_block(CustomData *data, void **block)
 {
 
 	if (*block)
@@ -3053,6 +3054,15 @@ bool CustomData_layertype_is_singleton(int type)
 	return typeInfo->defaultname == NULL;
 }
 
+/**
+ * Layers which own memory referenced by their elements (can't be copied as plain data).
+ */
+bool CustomData_layertype_is_dynamic(int type)
+{
+	const LayerTypeInfo *typeInfo = layerType_getInfo(type);
+	return (typeInfo->free != NULL);
+}
+
 /**
  * \return Maximum number of layers of given \a type, -1 means 'no limit'.
  */
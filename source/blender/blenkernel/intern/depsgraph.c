@@ -1619,6 +1619,9 @@ void DAG_relations_tag_update(Main *bmain)
 {
 	Scene *sce;
 
+	/* relations change when data is added or removed, which resolved animation paths may point to */
+	BKE_animsys_rna_path_cache_tag_invalid();
+
 	for (sce = bmain->scene.first; sce; sce = sce->id.next)
 		dag_scene_free(sce);
 }
@@ -2762,6 +2765,9 @@ void DAG_id_tag_update_ex(Main *bmain, ID *id, short flag)
 		printf("%s: id=%s flag=%d\n", __func__, id->name, flag);
 	}
 
+	/* edited data may have been reallocated */
+	BKE_animsys_rna_path_cache_tag_invalid();
+
 	/* tag ID for update */
 	if (flag) {
 		if (flag & OB_RECALC_OB)
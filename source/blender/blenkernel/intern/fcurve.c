@@ -42,10 +42,12 @@
 #include "DNA_anim_types.h"
 #include "DNA_constraint_types.h"
 #include "DNA_object_types.h"
+#include "DNA_userdef_types.h"
 
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
 #include "BLI_easing.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BLF_translation.h"
@@ -66,6 +68,8 @@
 #include "BPY_extern.h" 
 #endif
 
+#include "atomic_ops.h"
+
 #define SMALL -1.0e-10
 #define SELECT 1
 
@@ -82,11 +86,15 @@ void free_fcurve(FCurve *fcu)
 	/* free curve data */
 	if (fcu->bezt) MEM_freeN(fcu->bezt);
 	if (fcu->fpt)  MEM_freeN(fcu->fpt);
+	fcurve_free_sample_table(fcu);
 	
 	/* free RNA-path, as this were allocated when getting the path string */
 	if (fcu->rna_path)
 		MEM_freeN(fcu->rna_path);
 	
+	/* the F-Curve is used as key for its resolved path */
+	BKE_animsys_rna_path_cache_tag_invalid();
+	
 	/* free extra data - i.e. modifiers, and driver */
 	fcurve_free_driver(fcu);
 	free_fmodifiers(&fcu->modifiers);
@@ -137,6 +145,7 @@ FCurve *copy_fcurve(FCurve *fcu)
 	/* copy curve data */
 	fcu_d->bezt = MEM_dupallocN(fcu_d->bezt);
 	fcu_d->fpt = MEM_dupallocN(fcu_d->fpt);
+	fcu_d->sample_table = NULL;
 	
 	/* copy rna-path */
 	fcu_d->rna_path = MEM_dupallocN(fcu_d->rna_path);
@@ -866,6 +875,9 @@ void calchandles_fcurve(FCurve *fcu)
 	if (ELEM(NULL, fcu, fcu->bezt) || (a < 2) /*|| ELEM(fcu->ipo, BEZT_IPO_CONST, BEZT_IPO_LIN)*/) 
 		return;
 	
+	/* keyframes were edited, bake them again when needed */
+	fcurve_free_sample_table(fcu);
+	
 	/* get initial pointers */
 	bezt = fcu->bezt;
 	prev = NULL;
@@ -924,6 +936,8 @@ void sort_time_fcurve(FCurve *fcu)
 {
 	bool ok = true;
 	
+	fcurve_free_sample_table(fcu);
+	
 	/* keep adjusting order of beztriples until nothing moves (bubble-sort) */
 	while (ok) {
 		ok = 0;
@@ -1027,6 +1041,20 @@ static ID *dtar_id_ensure_proxy_from(ID *id)
 	return id;
 }
 
+static struct AnimRNAPathCache *driver_rna_path_cache_ensure(ChannelDriver *driver)
+{
+	static ThreadMutex cache_mutex = BLI_MUTEX_INITIALIZER;
+	
+	if (driver->rna_cache == NULL) {
+		BLI_mutex_lock(&cache_mutex);
+		if (driver->rna_cache == NULL)
+			driver->rna_cache = BKE_animsys_rna_path_cache_new();
+		BLI_mutex_unlock(&cache_mutex);
+	}
+	
+	return driver->rna_cache;
+}
+
 /* Helper function to obtain a value using RNA from the specified source (for evaluating drivers) */
 static float dtar_get_prop_val(ChannelDriver *driver, DriverTarget *dtar)
 {
@@ -1057,7 +1085,9 @@ static float dtar_get_prop_val(ChannelDriver *driver, DriverTarget *dtar)
 	RNA_id_pointer_create(id, &id_ptr);
 	
 	/* get property to read from, and get value as appropriate */
-	if (RNA_path_resolve_property_full(&id_ptr, dtar->rna_path, &ptr, &prop, &index)) {
+	if (BKE_animsys_rna_path_resolve_cached(driver_rna_path_cache_ensure(driver), dtar,
+	                                        &id_ptr, dtar->rna_path, &ptr, &prop, &index))
+	{
 		if (RNA_property_array_check(prop)) {
 			/* array */
 			if ((index >= 0) && (index < RNA_property_array_length(&ptr, prop))) {
@@ -1529,6 +1559,9 @@ void driver_free_variable(ChannelDriver *driver, DriverVar *dvar)
 	
 	/* remove the variable from the driver */
 	BLI_freelinkN(&driver->variables, dvar);
+	
+	/* its targets are used as keys for their resolved paths */
+	BKE_animsys_rna_path_cache_tag_invalid();
 
 #ifdef WITH_PYTHON
 	/* since driver variables are cached, the expression needs re-compiling too */
@@ -1621,6 +1654,10 @@ void fcurve_free_driver(FCurve *fcu)
 		BPY_DECREF(driver->expr_comp);
 #endif
 
+	/* free resolved paths of targets */
+	if (driver->rna_cache)
+		BKE_animsys_rna_path_cache_free(driver->rna_cache);
+
 	/* free driver itself, then set F-Curve's point to this to NULL (as the curve may still be used) */
 	MEM_freeN(driver);
 	fcu->driver = NULL;
@@ -1639,6 +1676,7 @@ ChannelDriver *fcurve_copy_driver(ChannelDriver *driver)
 	/* copy all data */
 	ndriver = MEM_dupallocN(driver);
 	ndriver->expr_comp = NULL;
+	ndriver->rna_cache = NULL;
 	
 	/* copy variables */
 	BLI_listbase_clear(&ndriver->variables);
@@ -2421,12 +2459,201 @@ static float fcurve_eval_samples(FCurve *fcu, FPoint *fpts, float evaltime)
 	return cvalue;
 }
 
+/* ***************************** F-Curve - Sample Tables ********************************* */
+
+/* Baked sample tables replace the binary search over the keyframes and the Bezier root solving with
+ * a linear interpolation between values sampled at a uniform step between the first and last keyframe.
+ * They're only used on playback, when the user preferences allow an error (U.fcu_sample_tolerance),
+ * built on demand and freed whenever the keyframes are edited (calchandles_fcurve(), sort_time_fcurve(),
+ * or the animation editors tagging the curve for updates). A table is also baked again when the keyframe
+ * array it was made from changed.
+ */
+
+/* finest step tried, in frames */
+#define FCURVE_SAMPLE_STEP_MIN (1.0f / 64.0f)
+/* keep tables for long curves within a sane size, those keep being evaluated exactly */
+#define FCURVE_SAMPLE_TABLE_MAX (1 << 16)
+/* number of curves gathered before their samples are interpolated */
+#define FCURVE_SAMPLE_BATCH 64
+
+typedef struct FCurveSampleTable {
+	/* keyframes the table was baked from, edits not going through the F-Curve API are caught by these */
+	BezTriple *bezt;
+	unsigned int totvert;
+	float tolerance;
+	
+	/* frame range between the first and last keyframe, keyframes outside of it are evaluated exactly */
+	float start, end;
+	float inv_step;
+	int totsample;
+	float *samples;			/* NULL when no step meets the tolerance */
+	
+	/* replaced tables, see fcurve_sample_table_ensure() */
+	struct FCurveSampleTable *stale;
+} FCurveSampleTable;
+
+/* Error allowed for evaluating F-Curves from baked samples, zero when the keyframes must be evaluated exactly */
+float fcurve_sample_tolerance(void)
+{
+	/* renders always get the exact curves */
+	return G.is_rendering ? 0.0f : U.fcu_sample_tolerance;
+}
+
+static bool fcurve_sample_table_is_supported(FCurve *fcu)
+{
+	BezTriple *bezt;
+	unsigned int a;
+	
+	if ((fcu->bezt == NULL) || (fcu->totvert < 2) || (fcu->flag & FCURVE_DISCRETE_VALUES))
+		return false;
+	
+	/* constant interpolation and keyframes on the same frame make jumps in the curve,
+	 * which can't be interpolated within any tolerance */
+	for (a = 0, bezt = fcu->bezt; a < fcu->totvert - 1; a++, bezt++) {
+		if ((bezt->ipo == BEZT_IPO_CONST) || (bezt->vec[1][0] >= (bezt + 1)->vec[1][0]))
+			return false;
+	}
+	
+	return true;
+}
+
+BLI_INLINE float fcurve_sample_table_eval(const FCurveSampleTable *table, float evaltime)
+{
+	const float fi = (evaltime - table->start) * table->inv_step;
+	int i = (int)fi;
+	
+	CLAMP(i, 0, table->totsample - 2);
+	return interpf(table->samples[i + 1], table->samples[i], fi - (float)i);
+}
+
+/* Bake the keyframes, halving the step until the interpolated values are within tolerance
+ * halfway between the samples and on the keyframes. */
+static FCurveSampleTable *fcurve_sample_table_build(FCurve *fcu, float tolerance)
+{
+	FCurveSampleTable *table = MEM_callocN(sizeof(FCurveSampleTable), "FCurveSampleTable");
+	float step;
+	
+	table->bezt = fcu->bezt;
+	table->totvert = fcu->totvert;
+	table->tolerance = tolerance;
+	
+	if (!fcurve_sample_table_is_supported(fcu))
+		return table;
+	
+	table->start = fcu->bezt[0].vec[1][0];
+	table->end = fcu->bezt[fcu->totvert - 1].vec[1][0];
+	
+	for (step = 1.0f; step >= FCURVE_SAMPLE_STEP_MIN; step *= 0.5f) {
+		const float span = table->end - table->start;
+		const int totsample = (int)ceilf(span / step) + 1;
+		float *samples;
+		bool ok = true;
+		unsigned int a;
+		int i;
+		
+		if (totsample > FCURVE_SAMPLE_TABLE_MAX)
+			break;
+		
+		samples = MEM_mallocN(sizeof(float) * (size_t)totsample, "FCurveSampleTable samples");
+		table->totsample = totsample;
+		table->inv_step = (float)(totsample - 1) / span;
+		table->samples = samples;
+		
+		for (i = 0; i < totsample; i++) {
+			samples[i] = fcurve_eval_keyframes(fcu, fcu->bezt, table->start + (float)i / table->inv_step);
+		}
+		
+		for (i = 0; (i < totsample - 1) && ok; i++) {
+			const float evaltime = table->start + ((float)i + 0.5f) / table->inv_step;
+			ok = fabsf(fcurve_sample_table_eval(table, evaltime) - fcurve_eval_keyframes(fcu, fcu->bezt, evaltime)) <=
+			     tolerance;
+		}
+		for (a = 1; (a < fcu->totvert - 1) && ok; a++) {
+			const float *co = fcu->bezt[a].vec[1];
+			ok = fabsf(fcurve_sample_table_eval(table, co[0]) - co[1]) <= tolerance;
+		}
+		
+		if (ok)
+			return table;
+		
+		MEM_freeN(samples);
+		table->samples = NULL;
+	}
+	
+	/* keep the empty table, so the curve isn't baked again on every frame */
+	table->totsample = 0;
+	return table;
+}
+
+static void fcurve_sample_table_free(FCurveSampleTable *table)
+{
+	while (table) {
+		FCurveSampleTable *table_next = table->stale;
+		
+		if (table->samples)
+			MEM_freeN(table->samples);
+		MEM_freeN(table);
+		table = table_next;
+	}
+}
+
+/* Get the baked samples of the F-Curve's keyframes, or NULL when they must be evaluated exactly.
+ * Curves of the same action can be evaluated from several threads, whoever bakes first wins. */
+static const FCurveSampleTable *fcurve_sample_table_ensure(FCurve *fcu, float tolerance)
+{
+	FCurveSampleTable *table = fcu->sample_table;
+	
+	/* bake again when the keyframes or the tolerance changed without the table being freed */
+	while ((table == NULL) || (table->bezt != fcu->bezt) || (table->totvert != fcu->totvert) ||
+	       (table->tolerance != tolerance))
+	{
+		FCurveSampleTable *table_new = fcurve_sample_table_build(fcu, tolerance);
+		
+		table_new->stale = table;
+		if (atomic_cas_z((size_t *)&fcu->sample_table, (size_t)table, (size_t)table_new) == (size_t)table) {
+			/* other threads may still be checking the replaced table, so only its samples
+			 * can go now, it's freed along with the new one */
+			if (table) {
+				MEM_SAFE_FREE(table->samples);
+			}
+			table = table_new;
+		}
+		else {
+			table_new->stale = NULL;
+			fcurve_sample_table_free(table_new);
+			table = fcu->sample_table;
+		}
+	}
+	
+	return table->samples ? table : NULL;
+}
+
+/* Free the baked samples of the F-Curve, needed after its keyframes have been edited */
+void fcurve_free_sample_table(FCurve *fcu)
+{
+	if (fcu->sample_table) {
+		fcurve_sample_table_free(fcu->sample_table);
+		fcu->sample_table = NULL;
+	}
+}
+
+/* Free the baked samples of a list of F-Curves */
+void fcurves_free_sample_tables(ListBase *list)
+{
+	FCurve *fcu;
+	
+	for (fcu = list->first; fcu; fcu = fcu->next) {
+		fcurve_free_sample_table(fcu);
+	}
+}
+
 /* ***************************** F-Curve - Evaluation ********************************* */
 
-/* Evaluate and return the value of the given F-Curve at the specified frame ("evaltime") 
+/* Evaluate and return the value of the given F-Curve at the specified frame ("evaltime"),
+ * keyframes are evaluated from baked samples when 'sample_tolerance' allows an error (see fcurve_sample_tolerance())
  * Note: this is also used for drivers
  */
-float evaluate_fcurve(FCurve *fcu, float evaltime)
+float evaluate_fcurve_ex(FCurve *fcu, float evaltime, const float sample_tolerance)
 {
 	FModifierStackStorage *storage;
 	float cvalue = 0.0f;
@@ -2477,8 +2704,17 @@ float evaluate_fcurve(FCurve *fcu, float evaltime)
 	 *	- 'devaltime' instead of 'evaltime', as this is the time that the last time-modifying 
 	 *	  F-Curve modifier on the stack requested the curve to be evaluated at
 	 */
-	if (fcu->bezt)
-		cvalue = fcurve_eval_keyframes(fcu, fcu->bezt, devaltime);
+	if (fcu->bezt) {
+		const FCurveSampleTable *table = NULL;
+		
+		if (sample_tolerance != 0.0f)
+			table = fcurve_sample_table_ensure(fcu, sample_tolerance);
+		
+		if (table && (devaltime > table->start) && (devaltime < table->end))
+			cvalue = fcurve_sample_table_eval(table, devaltime);
+		else
+			cvalue = fcurve_eval_keyframes(fcu, fcu->bezt, devaltime);
+	}
 	else if (fcu->fpt)
 		cvalue = fcurve_eval_samples(fcu, fcu->fpt, devaltime);
 	
@@ -2497,8 +2733,13 @@ float evaluate_fcurve(FCurve *fcu, float evaltime)
 	return cvalue;
 }
 
-/* Calculate the value of the given F-Curve at the given frame, and set its curval */
-void calculate_fcurve(FCurve *fcu, float ctime)
+/* Evaluate and return the value of the given F-Curve at the specified frame, evaluating the keyframes exactly */
+float evaluate_fcurve(FCurve *fcu, float evaltime)
+{
+	return evaluate_fcurve_ex(fcu, evaltime, 0.0f);
+}
+
+static void calculate_fcurve_ex(FCurve *fcu, float ctime, const float sample_tolerance)
 {
 	/* only calculate + set curval (overriding the existing value) if curve has 
 	 * any data which warrants this...
@@ -2507,7 +2748,69 @@ void calculate_fcurve(FCurve *fcu, float ctime)
 	    list_has_suitable_fmodifier(&fcu->modifiers, 0, FMI_TYPE_GENERATE_CURVE))
 	{
 		/* calculate and set curval (evaluates driver too if necessary) */
-		fcu->curval = evaluate_fcurve(fcu, ctime);
+		fcu->curval = evaluate_fcurve_ex(fcu, ctime, sample_tolerance);
+	}
+}
+
+/* Calculate the value of the given F-Curve at the given frame, and set its curval */
+void calculate_fcurve(FCurve *fcu, float ctime)
+{
+	calculate_fcurve_ex(fcu, ctime, 0.0f);
+}
+
+/* Calculate the values of a batch of F-Curves at the given frame for playback, and set their curval
+ * - plain keyframed curves within the range of their baked samples are gathered first, then interpolated
+ *   in one flat loop, the rest goes through the full evaluation
+ */
+void calculate_fcurves(FCurve **fcurves, int totfcurve, float ctime)
+{
+	const float tolerance = fcurve_sample_tolerance();
+	FCurve *batch_fcurves[FCURVE_SAMPLE_BATCH];
+	float batch_a[FCURVE_SAMPLE_BATCH], batch_b[FCURVE_SAMPLE_BATCH], batch_fac[FCURVE_SAMPLE_BATCH];
+	int batch_len = 0;
+	int i, j;
+	
+	if (tolerance == 0.0f) {
+		for (i = 0; i < totfcurve; i++) {
+			calculate_fcurve(fcurves[i], ctime);
+		}
+		return;
+	}
+	
+	for (i = 0; i < totfcurve; i++) {
+		FCurve *fcu = fcurves[i];
+		const FCurveSampleTable *table = NULL;
+		
+		if (fcu->bezt && (fcu->driver == NULL) && BLI_listbase_is_empty(&fcu->modifiers) &&
+		    (fcu->flag & FCURVE_INT_VALUES) == 0)
+		{
+			table = fcurve_sample_table_ensure(fcu, tolerance);
+		}
+		
+		if (table && (ctime > table->start) && (ctime < table->end)) {
+			const float fi = (ctime - table->start) * table->inv_step;
+			int index = (int)fi;
+			
+			CLAMP(index, 0, table->totsample - 2);
+			batch_fcurves[batch_len] = fcu;
+			batch_a[batch_len] = table->samples[index];
+			batch_b[batch_len] = table->samples[index + 1];
+			batch_fac[batch_len] = fi - (float)index;
+			batch_len++;
+		}
+		else {
+			calculate_fcurve_ex(fcu, ctime, tolerance);
+		}
+		
+		if ((batch_len == FCURVE_SAMPLE_BATCH) || ((i == totfcurve - 1) && batch_len)) {
+			for (j = 0; j < batch_len; j++) {
+				batch_a[j] = interpf(batch_b[j], batch_a[j], batch_fac[j]);
+			}
+			for (j = 0; j < batch_len; j++) {
+				batch_fcurves[j]->curval = batch_a[j];
+			}
+			batch_len = 0;
+		}
 	}
 }
 
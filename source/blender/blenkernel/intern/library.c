@@ -919,6 +919,7 @@ void BKE_libblock_free_ex(Main *bmain, void *idv, bool do_id_user)
 	ListBase *lb = which_libbase(bmain, type);
 
 	DAG_id_type_tag(bmain, type);
+	BKE_animsys_rna_path_cache_tag_invalid();
 
 #ifdef WITH_PYTHON
 	BPY_id_release(id);
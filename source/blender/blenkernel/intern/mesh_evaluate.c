@@ -46,12 +46,15 @@
 #include "BLI_linklist.h"
 #include "BLI_linklist_stack.h"
 #include "BLI_alloca.h"
+#include "BLI_task.h"
 
 #include "BKE_customdata.h"
 #include "BKE_mesh.h"
 #include "BKE_multires.h"
 #include "BKE_report.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_strict_flags.h"
 
 #include "mikktspace.h"
@@ -105,7 +108,6 @@ void BKE_mesh_calc_normals_mapping_ex(
 	float (*pnors)[3] = r_polyNors, (*fnors)[3] = r_faceNors;
 	int i;
 	MFace *mf;
-	MPoly *mp;
 
 	if (numPolys == 0) {
 		if (only_face_normals == false) {
@@ -131,10 +133,7 @@ void BKE_mesh_calc_normals_mapping_ex(
 	}
 	else {
 		/* only calc poly normals */
-		mp = mpolys;
-		for (i = 0; i < numPolys; i++, mp++) {
-			BKE_mesh_calc_poly_normal(mp, mloop + mp->loopstart, mverts, pnors[i]);
-		}
+		BKE_mesh_calc_normals_poly(mverts, numVerts, mloop, mpolys, numLoops, numPolys, pnors, true);
 	}
 
 	if (origIndexFace &&
@@ -161,8 +160,27 @@ void BKE_mesh_calc_normals_mapping_ex(
 	
 }
 
+typedef struct MeshCalcNormalsData {
+	MPoly *mpolys;
+	MLoop *mloop;
+	MVert *mverts;
+	float (*pnors)[3];
+	float (*vnors)[3];
+	bool use_atomic;  /* polys are accumulated from several threads */
+} MeshCalcNormalsData;
+
+static void mesh_calc_normals_poly_task_cb(void *userdata, int pidx)
+{
+	MeshCalcNormalsData *data = userdata;
+	MPoly *mp = &data->mpolys[pidx];
+
+	BKE_mesh_calc_poly_normal(mp, data->mloop + mp->loopstart, data->mverts, data->pnors[pidx]);
+}
+
+/* Note: vertex normals are accumulated with atomic adds when polys are processed from several threads. */
 static void mesh_calc_normals_poly_accum(MPoly *mp, MLoop *ml,
-                                         MVert *mvert, float polyno[3], float (*tnorms)[3])
+                                         MVert *mvert, float polyno[3], float (*tnorms)[3],
+                                         const bool use_atomic)
 {
 	const int nverts = mp->totloop;
 	float (*edgevecbuf)[3] = BLI_array_alloca(edgevecbuf, (size_t)nverts);
@@ -200,68 +218,103 @@ static void mesh_calc_normals_poly_accum(MPoly *mp, MLoop *ml,
 
 		for (i = 0; i < nverts; i++) {
 			const float *cur_edge = edgevecbuf[i];
+			float *vno = tnorms[ml[i].v];
 
 			/* calculate angle between the two poly edges incident on
 			 * this vertex */
 			const float fac = saacos(-dot_v3v3(cur_edge, prev_edge));
 
-			/* accumulate */
-			madd_v3_v3fl(tnorms[ml[i].v], polyno, fac);
+			/* accumulate, other polys using this vertex may be handled concurrently */
+			if (use_atomic) {
+				atomic_add_fl(&vno[0], polyno[0] * fac);
+				atomic_add_fl(&vno[1], polyno[1] * fac);
+				atomic_add_fl(&vno[2], polyno[2] * fac);
+			}
+			else {
+				madd_v3_v3fl(vno, polyno, fac);
+			}
 			prev_edge = cur_edge;
 		}
 	}
 
 }
 
+static void mesh_calc_normals_poly_accum_task_cb(void *userdata, int pidx)
+{
+	MeshCalcNormalsData *data = userdata;
+	MPoly *mp = &data->mpolys[pidx];
+	float tpnor[3];  /* temp poly normal */
+
+	mesh_calc_normals_poly_accum(mp, data->mloop + mp->loopstart, data->mverts,
+	                             data->pnors ? data->pnors[pidx] : tpnor, data->vnors, data->use_atomic);
+}
+
+static void mesh_calc_normals_poly_finalize_task_cb(void *userdata, int vidx)
+{
+	MeshCalcNormalsData *data = userdata;
+	MVert *mv = &data->mverts[vidx];
+	float *no = data->vnors[vidx];
+
+	/* following Mesh convention; we use vertex coordinate itself for normal in this case */
+	if (UNLIKELY(normalize_v3(no) == 0.0f)) {
+		normalize_v3_v3(no, mv->co);
+	}
+
+	normal_float_to_short_v3(mv->no, no);
+}
+
+/**
+ * Calculate poly normals, and vertex normals from the angle weighted sum of their poly normals.
+ * Both passes are run over the task scheduler for meshes above #BKE_MESH_OMP_LIMIT elements.
+ */
 void BKE_mesh_calc_normals_poly(MVert *mverts, int numVerts, MLoop *mloop, MPoly *mpolys,
                                 int UNUSED(numLoops), int numPolys, float (*r_polynors)[3],
                                 const bool only_face_normals)
 {
-	float (*pnors)[3] = r_polynors;
-	float (*tnorms)[3];
-	int i;
-	MPoly *mp;
-
-	if (only_face_normals) {
-		BLI_assert(pnors != NULL);
+	MeshCalcNormalsData data;
+
+	data.mpolys = mpolys;
+	data.mloop = mloop;
+	data.mverts = mverts;
+	data.pnors = r_polynors;
+	data.vnors = NULL;
+	/* polys are only processed concurrently above the threshold and with worker threads,
+	 * otherwise plain adds are used, the compare-and-swap loops are a lot slower */
+	data.use_atomic = (numPolys >= BKE_MESH_OMP_LIMIT &&
+	                   BLI_task_scheduler_num_threads(BLI_task_scheduler_get()) > 1);
 
-#pragma omp parallel for if (numPolys > BKE_MESH_OMP_LIMIT)
-		for (i = 0; i < numPolys; i++) {
-			BKE_mesh_calc_poly_normal(&mpolys[i], mloop + mpolys[i].loopstart, mverts, pnors[i]);
-		}
-		return;
-	}
+#ifdef DEBUG_TIME
+	TIMEIT_START(BKE_mesh_calc_normals_poly);
+#endif
 
-	/* first go through and calculate normals for all the polys */
-	tnorms = MEM_callocN(sizeof(*tnorms) * (size_t)numVerts, __func__);
+	if (only_face_normals) {
+		BLI_assert(r_polynors != NULL);
 
-	if (pnors) {
-		mp = mpolys;
-		for (i = 0; i < numPolys; i++, mp++) {
-			mesh_calc_normals_poly_accum(mp, mloop + mp->loopstart, mverts, pnors[i], tnorms);
+		if (numPolys != 0) {
+			BLI_task_parallel_range_ex(0, numPolys, &data, mesh_calc_normals_poly_task_cb,
+			                           BKE_MESH_OMP_LIMIT, false);
 		}
 	}
 	else {
-		float tpnor[3];  /* temp poly normal */
-		mp = mpolys;
-		for (i = 0; i < numPolys; i++, mp++) {
-			mesh_calc_normals_poly_accum(mp, mloop + mp->loopstart, mverts, tpnor, tnorms);
-		}
-	}
+		/* first go through and calculate normals for all the polys */
+		data.vnors = MEM_callocN(sizeof(*data.vnors) * (size_t)numVerts, __func__);
 
-	/* following Mesh convention; we use vertex coordinate itself for normal in this case */
-	for (i = 0; i < numVerts; i++) {
-		MVert *mv = &mverts[i];
-		float *no = tnorms[i];
+		if (numPolys != 0) {
+			BLI_task_parallel_range_ex(0, numPolys, &data, mesh_calc_normals_poly_accum_task_cb,
+			                           BKE_MESH_OMP_LIMIT, false);
+		}
 
-		if (UNLIKELY(normalize_v3(no) == 0.0f)) {
-			normalize_v3_v3(no, mv->co);
+		if (numVerts != 0) {
+			BLI_task_parallel_range_ex(0, numVerts, &data, mesh_calc_normals_poly_finalize_task_cb,
+			                           BKE_MESH_OMP_LIMIT, false);
 		}
 
-		normal_float_to_short_v3(mv->no, no);
+		MEM_freeN(data.vnors);
 	}
 
-	MEM_freeN(tnorms);
+#ifdef DEBUG_TIME
+	TIMEIT_END(BKE_mesh_calc_normals_poly);
+#endif
 }
 
 void BKE_mesh_calc_normals(Mesh *mesh)
@@ -316,6 +369,209 @@ void BKE_mesh_calc_normals_tessface(MVert *mverts, int numVerts, MFace *mfaces,
 		MEM_freeN(fnors);
 }
 
+#define INDEX_UNSET INT_MIN
+#define INDEX_INVALID -1
+/* See comment about edge_to_loops in BKE_mesh_normals_loop_split(). */
+#define IS_EDGE_SHARP(_e2l) (ELEM((_e2l)[1], INDEX_UNSET, INDEX_INVALID))
+
+typedef struct LoopSplitTaskData {
+	MVert *mverts;
+	MEdge *medges;
+	MLoop *mloops;
+	MPoly *mpolys;
+	float (*loopnors)[3];
+	float (*polynors)[3];
+	int (*edge_to_loops)[2];
+	int *loop_to_poly;
+} LoopSplitTaskData;
+
+/**
+ * Compute the split normals of all sharp fans starting from the loops of a single polygon.
+ *
+ * Each fan of faces is only walked once (from its first sharp edge), so loop-normals written here never
+ * overlap with those of another polygon, which makes it safe to process polygons concurrently.
+ */
+static void mesh_normals_loop_split_poly_task_cb(void *userdata, int mp_index)
+{
+	LoopSplitTaskData *data = userdata;
+	MVert *mverts = data->mverts;
+	MEdge *medges = data->medges;
+	MLoop *mloops = data->mloops;
+	MPoly *mpolys = data->mpolys;
+	float (*r_loopnors)[3] = data->loopnors;
+	float (*polynors)[3] = data->polynors;
+	int (*edge_to_loops)[2] = data->edge_to_loops;
+	const int *loop_to_poly = data->loop_to_poly;
+
+	MPoly *mp = &mpolys[mp_index];
+	MLoop *ml_curr, *ml_prev;
+	float (*lnors)[3];
+	const int ml_last_index = (mp->loopstart + mp->totloop) - 1;
+	int ml_curr_index = mp->loopstart;
+	int ml_prev_index = ml_last_index;
+
+	/* Temp normal stack. */
+	BLI_SMALLSTACK_DECLARE(normal, float *);
+
+	ml_curr = &mloops[ml_curr_index];
+	ml_prev = &mloops[ml_prev_index];
+	lnors = &r_loopnors[ml_curr_index];
+
+	for (; ml_curr_index <= ml_last_index; ml_curr++, ml_curr_index++, lnors++) {
+		const int *e2l_curr = edge_to_loops[ml_curr->e];
+		const int *e2l_prev = edge_to_loops[ml_prev->e];
+
+		if (!IS_EDGE_SHARP(e2l_curr)) {
+			/* A smooth edge.
+			 * We skip it because it is either:
+			 * - in the middle of a 'smooth fan' already computed (or that will be as soon as we hit
+			 *   one of its ends, i.e. one of its two sharp edges), or...
+			 * - the related vertex is a "full smooth" one, in which case pre-populated normals from vertex
+			 *   are just fine!
+			 */
+		}
+		else if (IS_EDGE_SHARP(e2l_prev)) {
+			/* Simple case (both edges around that vertex are sharp in current polygon),
+			 * this vertex just takes its poly normal.
+			 */
+			copy_v3_v3(*lnors, polynors[mp_index]);
+			/* No need to mark loop as done here, we won't run into it again anyway! */
+		}
+		/* We *do not need* to check/tag loops as already computed!
+		 * Due to the fact a loop only links to one of its two edges, a same fan *will never be walked more than
+		 * once!*
+		 * Since we consider edges having neighbor polys with inverted (flipped) normals as sharp, we are sure that
+		 * no fan will be skipped, even only considering the case (sharp curr_edge, smooth prev_edge), and not the
+		 * alternative (smooth curr_edge, sharp prev_edge).
+		 * All this due/thanks to link between normals and loop ordering.
+		 */
+		else {
+			/* Gah... We have to fan around current vertex, until we find the other non-smooth edge,
+			 * and accumulate face normals into the vertex!
+			 * Note in case this vertex has only one sharp edges, this is a waste because the normal is the same as
+			 * the vertex normal, but I do not see any easy way to detect that (would need to count number
+			 * of sharp edges per vertex, I doubt the additional memory usage would be worth it, especially as
+			 * it should not be a common case in real-life meshes anyway).
+			 */
+			const unsigned int mv_pivot_index = ml_curr->v;  /* The vertex we are "fanning" around! */
+			const MVert *mv_pivot = &mverts[mv_pivot_index];
+			const int *e2lfan_curr;
+			float vec_curr[3], vec_prev[3];
+			MLoop *mlfan_curr, *mlfan_next;
+			MPoly *mpfan_next;
+			float lnor[3] = {0.0f, 0.0f, 0.0f};
+			/* mlfan_vert_index: the loop of our current edge might not be the loop of our current vertex! */
+			int mlfan_curr_index, mlfan_vert_index, mpfan_curr_index;
+
+			e2lfan_curr = e2l_prev;
+			mlfan_curr = ml_prev;
+			mlfan_curr_index = ml_prev_index;
+			mlfan_vert_index = ml_curr_index;
+			mpfan_curr_index = mp_index;
+
+			BLI_assert(mlfan_curr_index >= 0);
+			BLI_assert(mlfan_vert_index >= 0);
+			BLI_assert(mpfan_curr_index >= 0);
+
+			/* Only need to compute previous edge's vector once, then we can just reuse old current one! */
+			{
+				const MEdge *me_prev = &medges[ml_curr->e];  /* ml_curr would be mlfan_prev if we needed that one */
+				const MVert *mv_2 = (me_prev->v1 == mv_pivot_index) ? &mverts[me_prev->v2] : &mverts[me_prev->v1];
+
+				sub_v3_v3v3(vec_prev, mv_2->co, mv_pivot->co);
+				normalize_v3(vec_prev);
+			}
+
+			while (true) {
+				/* Compute edge vectors.
+				 * NOTE: We could pre-compute those into an array, in the first iteration, instead of computing them
+				 *       twice (or more) here. However, time gained is not worth memory and time lost,
+				 *       given the fact that this code should not be called that much in real-life meshes...
+				 */
+				{
+					const MEdge *me_curr = &medges[mlfan_curr->e];
+					const MVert *mv_2 = (me_curr->v1 == mv_pivot_index) ? &mverts[me_curr->v2] :
+					                                                      &mverts[me_curr->v1];
+
+					sub_v3_v3v3(vec_curr, mv_2->co, mv_pivot->co);
+					normalize_v3(vec_curr);
+				}
+
+				{
+					/* Code similar to accumulate_vertex_normals_poly. */
+					/* Calculate angle between the two poly edges incident on this vertex. */
+					const float fac = saacos(dot_v3v3(vec_curr, vec_prev));
+					/* Accumulate */
+					madd_v3_v3fl(lnor, polynors[mpfan_curr_index], fac);
+				}
+
+				/* We store here a pointer to all loop-normals processed. */
+				BLI_SMALLSTACK_PUSH(normal, &(r_loopnors[mlfan_vert_index][0]));
+
+				if (IS_EDGE_SHARP(e2lfan_curr)) {
+					/* Current edge is sharp, we have finished with this fan of faces around this vert! */
+					break;
+				}
+
+				copy_v3_v3(vec_prev, vec_curr);
+
+				/* Warning! This is rather complex!
+				 * We have to find our next edge around the vertex (fan mode).
+				 * First we find the next loop, which is either previous or next to mlfan_curr_index, depending
+				 * whether both loops using current edge are in the same direction or not, and whether
+				 * mlfan_curr_index actually uses the vertex we are fanning around!
+				 * mlfan_curr_index is the index of mlfan_next here, and mlfan_next is not the real next one
+				 * (i.e. not the future mlfan_curr)...
+				 */
+				mlfan_curr_index = (e2lfan_curr[0] == mlfan_curr_index) ? e2lfan_curr[1] : e2lfan_curr[0];
+				mpfan_curr_index = loop_to_poly[mlfan_curr_index];
+
+				BLI_assert(mlfan_curr_index >= 0);
+				BLI_assert(mpfan_curr_index >= 0);
+
+				mlfan_next = &mloops[mlfan_curr_index];
+				mpfan_next = &mpolys[mpfan_curr_index];
+				if ((mlfan_curr->v == mlfan_next->v && mlfan_curr->v == mv_pivot_index) ||
+				    (mlfan_curr->v != mlfan_next->v && mlfan_curr->v != mv_pivot_index))
+				{
+					/* We need the previous loop, but current one is our vertex's loop. */
+					mlfan_vert_index = mlfan_curr_index;
+					if (--mlfan_curr_index < mpfan_next->loopstart) {
+						mlfan_curr_index = mpfan_next->loopstart + mpfan_next->totloop - 1;
+					}
+				}
+				else {
+					/* We need the next loop, which is also our vertex's loop. */
+					if (++mlfan_curr_index >= mpfan_next->loopstart + mpfan_next->totloop) {
+						mlfan_curr_index = mpfan_next->loopstart;
+					}
+					mlfan_vert_index = mlfan_curr_index;
+				}
+				mlfan_curr = &mloops[mlfan_curr_index];
+				/* And now we are back in sync, mlfan_curr_index is the index of mlfan_curr! Pff! */
+
+				e2lfan_curr = edge_to_loops[mlfan_curr->e];
+			}
+
+			/* In case we get a zero normal here, just use vertex normal already set! */
+			if (LIKELY(normalize_v3(lnor) != 0.0f)) {
+				/* Copy back the final computed normal into all related loop-normals. */
+				float *nor;
+				while ((nor = BLI_SMALLSTACK_POP(normal))) {
+					copy_v3_v3(nor, lnor);
+				}
+			}
+			else {
+				/* We still have to clear the stack! */
+				while (BLI_SMALLSTACK_POP(normal));
+			}
+		}
+
+		ml_prev = ml_curr;
+		ml_prev_index = ml_curr_index;
+	}
+}
+
 /**
  * Compute split normals, i.e. vertex normals associated with each poly (hence 'loop normals').
  * Useful to materialize sharp edges (or non-smooth faces) without actually modifying the geometry (splitting edges).
@@ -324,11 +580,6 @@ void BKE_mesh_normals_loop_split(MVert *mverts, const int UNUSED(numVerts), MEdg
                                  MLoop *mloops, float (*r_loopnors)[3], const int numLoops,
                                  MPoly *mpolys, float (*polynors)[3], const int numPolys, float split_angle)
 {
-#define INDEX_UNSET INT_MIN
-#define INDEX_INVALID -1
-/* See comment about edge_to_loops below. */
-#define IS_EDGE_SHARP(_e2l) (ELEM((_e2l)[1], INDEX_UNSET, INDEX_INVALID))
-
 	/* Mapping edge -> loops.
 	 * If that edge is used by more than two loops (polys), it is always sharp (and tagged as such, see below).
 	 * We also use the second loop index as a kind of flag: smooth edge: > 0,
@@ -347,8 +598,7 @@ void BKE_mesh_normals_loop_split(MVert *mverts, const int UNUSED(numVerts), MEdg
 	int mp_index;
 	const bool check_angle = (split_angle < (float)M_PI);
 
-	/* Temp normal stack. */
-	BLI_SMALLSTACK_DECLARE(normal, float *);
+	LoopSplitTaskData data;
 
 #ifdef DEBUG_TIME
 	TIMEIT_START(BKE_mesh_normals_loop_split);
@@ -412,170 +662,18 @@ void BKE_mesh_normals_loop_split(MVert *mverts, const int UNUSED(numVerts), MEdg
 	/* We now know edges that can be smoothed (with their vector, and their two loops), and edges that will be hard!
 	 * Now, time to generate the normals.
 	 */
-	for (mp = mpolys, mp_index = 0; mp_index < numPolys; mp++, mp_index++) {
-		MLoop *ml_curr, *ml_prev;
-		float (*lnors)[3];
-		const int ml_last_index = (mp->loopstart + mp->totloop) - 1;
-		int ml_curr_index = mp->loopstart;
-		int ml_prev_index = ml_last_index;
-
-		ml_curr = &mloops[ml_curr_index];
-		ml_prev = &mloops[ml_prev_index];
-		lnors = &r_loopnors[ml_curr_index];
-
-		for (; ml_curr_index <= ml_last_index; ml_curr++, ml_curr_index++, lnors++) {
-			const int *e2l_curr = edge_to_loops[ml_curr->e];
-			const int *e2l_prev = edge_to_loops[ml_prev->e];
-
-			if (!IS_EDGE_SHARP(e2l_curr)) {
-				/* A smooth edge.
-				 * We skip it because it is either:
-				 * - in the middle of a 'smooth fan' already computed (or that will be as soon as we hit
-				 *   one of its ends, i.e. one of its two sharp edges), or...
-				 * - the related vertex is a "full smooth" one, in which case pre-populated normals from vertex
-				 *   are just fine!
-				 */
-			}
-			else if (IS_EDGE_SHARP(e2l_prev)) {
-				/* Simple case (both edges around that vertex are sharp in current polygon),
-				 * this vertex just takes its poly normal.
-				 */
-				copy_v3_v3(*lnors, polynors[mp_index]);
-				/* No need to mark loop as done here, we won't run into it again anyway! */
-			}
-			/* We *do not need* to check/tag loops as already computed!
-			 * Due to the fact a loop only links to one of its two edges, a same fan *will never be walked more than
-			 * once!*
-			 * Since we consider edges having neighbor polys with inverted (flipped) normals as sharp, we are sure that
-			 * no fan will be skipped, even only considering the case (sharp curr_edge, smooth prev_edge), and not the
-			 * alternative (smooth curr_edge, sharp prev_edge).
-			 * All this due/thanks to link between normals and loop ordering.
-			 */
-			else {
-				/* Gah... We have to fan around current vertex, until we find the other non-smooth edge,
-				 * and accumulate face normals into the vertex!
-				 * Note in case this vertex has only one sharp edges, this is a waste because the normal is the same as
-				 * the vertex normal, but I do not see any easy way to detect that (would need to count number
-				 * of sharp edges per vertex, I doubt the additional memory usage would be worth it, especially as
-				 * it should not be a common case in real-life meshes anyway).
-				 */
-				const unsigned int mv_pivot_index = ml_curr->v;  /* The vertex we are "fanning" around! */
-				const MVert *mv_pivot = &mverts[mv_pivot_index];
-				const int *e2lfan_curr;
-				float vec_curr[3], vec_prev[3];
-				MLoop *mlfan_curr, *mlfan_next;
-				MPoly *mpfan_next;
-				float lnor[3] = {0.0f, 0.0f, 0.0f};
-				/* mlfan_vert_index: the loop of our current edge might not be the loop of our current vertex! */
-				int mlfan_curr_index, mlfan_vert_index, mpfan_curr_index;
-
-				e2lfan_curr = e2l_prev;
-				mlfan_curr = ml_prev;
-				mlfan_curr_index = ml_prev_index;
-				mlfan_vert_index = ml_curr_index;
-				mpfan_curr_index = mp_index;
-
-				BLI_assert(mlfan_curr_index >= 0);
-				BLI_assert(mlfan_vert_index >= 0);
-				BLI_assert(mpfan_curr_index >= 0);
-
-				/* Only need to compute previous edge's vector once, then we can just reuse old current one! */
-				{
-					const MEdge *me_prev = &medges[ml_curr->e];  /* ml_curr would be mlfan_prev if we needed that one */
-					const MVert *mv_2 = (me_prev->v1 == mv_pivot_index) ? &mverts[me_prev->v2] : &mverts[me_prev->v1];
-
-					sub_v3_v3v3(vec_prev, mv_2->co, mv_pivot->co);
-					normalize_v3(vec_prev);
-				}
-
-				while (true) {
-					/* Compute edge vectors.
-					 * NOTE: We could pre-compute those into an array, in the first iteration, instead of computing them
-					 *       twice (or more) here. However, time gained is not worth memory and time lost,
-					 *       given the fact that this code should not be called that much in real-life meshes...
-					 */
-					{
-						const MEdge *me_curr = &medges[mlfan_curr->e];
-						const MVert *mv_2 = (me_curr->v1 == mv_pivot_index) ? &mverts[me_curr->v2] :
-						                                                      &mverts[me_curr->v1];
-
-						sub_v3_v3v3(vec_curr, mv_2->co, mv_pivot->co);
-						normalize_v3(vec_curr);
-					}
+	data.mverts = mverts;
+	data.medges = medges;
+	data.mloops = mloops;
+	data.mpolys = mpolys;
+	data.loopnors = r_loopnors;
+	data.polynors = polynors;
+	data.edge_to_loops = edge_to_loops;
+	data.loop_to_poly = loop_to_poly;
 
-					{
-						/* Code similar to accumulate_vertex_normals_poly. */
-						/* Calculate angle between the two poly edges incident on this vertex. */
-						const float fac = saacos(dot_v3v3(vec_curr, vec_prev));
-						/* Accumulate */
-						madd_v3_v3fl(lnor, polynors[mpfan_curr_index], fac);
-					}
-
-					/* We store here a pointer to all loop-normals processed. */
-					BLI_SMALLSTACK_PUSH(normal, &(r_loopnors[mlfan_vert_index][0]));
-
-					if (IS_EDGE_SHARP(e2lfan_curr)) {
-						/* Current edge is sharp, we have finished with this fan of faces around this vert! */
-						break;
-					}
-
-					copy_v3_v3(vec_prev, vec_curr);
-
-					/* Warning! This is rather complex!
-					 * We have to find our next edge around the vertex (fan mode).
-					 * First we find the next loop, which is either previous or next to mlfan_curr_index, depending
-					 * whether both loops using current edge are in the same direction or not, and whether
-					 * mlfan_curr_index actually uses the vertex we are fanning around!
-					 * mlfan_curr_index is the index of mlfan_next here, and mlfan_next is not the real next one
-					 * (i.e. not the future mlfan_curr)...
-					 */
-					mlfan_curr_index = (e2lfan_curr[0] == mlfan_curr_index) ? e2lfan_curr[1] : e2lfan_curr[0];
-					mpfan_curr_index = loop_to_poly[mlfan_curr_index];
-
-					BLI_assert(mlfan_curr_index >= 0);
-					BLI_assert(mpfan_curr_index >= 0);
-
-					mlfan_next = &mloops[mlfan_curr_index];
-					mpfan_next = &mpolys[mpfan_curr_index];
-					if ((mlfan_curr->v == mlfan_next->v && mlfan_curr->v == mv_pivot_index) ||
-					    (mlfan_curr->v != mlfan_next->v && mlfan_curr->v != mv_pivot_index))
-					{
-						/* We need the previous loop, but current one is our vertex's loop. */
-						mlfan_vert_index = mlfan_curr_index;
-						if (--mlfan_curr_index < mpfan_next->loopstart) {
-							mlfan_curr_index = mpfan_next->loopstart + mpfan_next->totloop - 1;
-						}
-					}
-					else {
-						/* We need the next loop, which is also our vertex's loop. */
-						if (++mlfan_curr_index >= mpfan_next->loopstart + mpfan_next->totloop) {
-							mlfan_curr_index = mpfan_next->loopstart;
-						}
-						mlfan_vert_index = mlfan_curr_index;
-					}
-					mlfan_curr = &mloops[mlfan_curr_index];
-					/* And now we are back in sync, mlfan_curr_index is the index of mlfan_curr! Pff! */
-
-					e2lfan_curr = edge_to_loops[mlfan_curr->e];
-				}
-
-				/* In case we get a zero normal here, just use vertex normal already set! */
-				if (LIKELY(normalize_v3(lnor) != 0.0f)) {
-					/* Copy back the final computed normal into all related loop-normals. */
-					float *nor;
-					while ((nor = BLI_SMALLSTACK_POP(normal))) {
-						copy_v3_v3(nor, lnor);
-					}
-				}
-				else {
-					/* We still have to clear the stack! */
-					while (BLI_SMALLSTACK_POP(normal));
-				}
-			}
-
-			ml_prev = ml_curr;
-			ml_prev_index = ml_curr_index;
-		}
+	if (numPolys != 0) {
+		BLI_task_parallel_range_ex(0, numPolys, &data, mesh_normals_loop_split_poly_task_cb,
+		                           BKE_MESH_OMP_LIMIT, false);
 	}
 
 	MEM_freeN(edge_to_loops);
@@ -584,11 +682,11 @@ void BKE_mesh_normals_loop_split(MVert *mverts, const int UNUSED(numVerts), MEdg
 #ifdef DEBUG_TIME
 	TIMEIT_END(BKE_mesh_normals_loop_split);
 #endif
+}
 
 #undef INDEX_UNSET
 #undef INDEX_INVALID
 #undef IS_EDGE_SHARP
-}
 
 
 /** \} */
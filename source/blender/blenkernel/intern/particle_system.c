@@ -40,10 +40,6 @@
 #include <math.h>
 #include <string.h>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
 #include "MEM_guardedalloc.h"
 
 #include "DNA_anim_types.h"
@@ -67,7 +63,9 @@
 #include "BLI_blenlib.h"
 #include "BLI_kdtree.h"
 #include "BLI_kdopbvh.h"
+#include "BLI_pointgrid.h"
 #include "BLI_sort.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_linklist.h"
 
@@ -104,6 +102,9 @@
 #endif // WITH_MOD_FLUID
 
 static ThreadRWMutex psys_bvhtree_rwlock = BLI_RWLOCK_INITIALIZER;
+/* SPH particles are stepped in threads, adding springs may reallocate the springs array */
+static ThreadRWMutex psys_sph_springs_rwlock = BLI_RWLOCK_INITIALIZER;
+static ThreadMutex psys_sph_courant_mutex = BLI_MUTEX_INITIALIZER;
 
 /************************************************/
 /*			Reacting to system events			*/
@@ -2556,8 +2557,9 @@ typedef struct SPHRangeData {
 	int use_size;
 } SPHRangeData;
 
-static void sph_evaluate_func(BVHTree *tree, ParticleSystem **psys, float co[3], SPHRangeData *pfr, float interaction_radius, BVHTree_RangeQuery callback)
+static void sph_evaluate_func(BVHTree *tree, SPHData *sphdata, float co[3], SPHRangeData *pfr, float interaction_radius, BVHTree_RangeQuery callback)
 {
+	ParticleSystem **psys = sphdata->psys;
 	int i;
 
 	pfr->tot_neighbors = 0;
@@ -2571,6 +2573,9 @@ static void sph_evaluate_func(BVHTree *tree, ParticleSystem **psys, float co[3],
 			BLI_bvhtree_range_query(tree, co, interaction_radius, callback, pfr);
 			break;
 		}
+		else if (sphdata->grid[i]) {
+			BLI_pointgrid_range_query(sphdata->grid[i], co, interaction_radius, callback, pfr);
+		}
 		else {
 			BLI_rw_mutex_lock(&psys_bvhtree_rwlock, THREAD_LOCK_READ);
 			
@@ -2687,7 +2692,7 @@ static void sph_force_cb(void *sphdata_v, ParticleKey *state, float *force, floa
 	pfr.pa = pa;
 	pfr.mass = sphdata->mass;
 
-	sph_evaluate_func( NULL, psys, state->co, &pfr, interaction_radius, sph_density_accum_cb);
+	sph_evaluate_func(NULL, sphdata, state->co, &pfr, interaction_radius, sph_density_accum_cb);
 
 	density = data[0];
 	near_density = data[1];
@@ -2733,9 +2738,14 @@ static void sph_force_cb(void *sphdata_v, ParticleKey *state, float *force, floa
 				spring_index = GET_INT_FROM_POINTER(BLI_edgehash_lookup(springhash, index, pfn->index));
 
 				if (spring_index) {
+					float spring_rest_length;
+
+					BLI_rw_mutex_lock(&psys_sph_springs_rwlock, THREAD_LOCK_READ);
 					spring = psys[0]->fluid_springs + spring_index - 1;
+					spring_rest_length = spring->rest_length;
+					BLI_rw_mutex_unlock(&psys_sph_springs_rwlock);
 
-					madd_v3_v3fl(force, vec, -10.f * spring_constant * (1.f - rij/h) * (spring->rest_length - rij));
+					madd_v3_v3fl(force, vec, -10.f * spring_constant * (1.f - rij/h) * (spring_rest_length - rij));
 				}
 				else if (fluid->spring_frames == 0 || (pa->prev_state.time-pa->time) <= fluid->spring_frames) {
 					ParticleSpring temp_spring;
@@ -2745,8 +2755,9 @@ static void sph_force_cb(void *sphdata_v, ParticleKey *state, float *force, floa
 					temp_spring.delete_flag = 0;
 
 					/* sph_spring_add is not thread-safe. - z0r */
-#pragma omp critical
+					BLI_rw_mutex_lock(&psys_sph_springs_rwlock, THREAD_LOCK_WRITE);
 					sph_spring_add(psys[0], &temp_spring);
+					BLI_rw_mutex_unlock(&psys_sph_springs_rwlock);
 				}
 			}
 			else {/* PART_SPRING_HOOKES - Hooke's spring force */
@@ -2859,7 +2870,7 @@ static void sphclassical_force_cb(void *sphdata_v, ParticleKey *state, float *fo
 	pfr.h = h;
 	pfr.pa = pa;
 
-	sph_evaluate_func(NULL, psys, state->co, &pfr, interaction_radius, sphclassical_neighbour_accum_cb);
+	sph_evaluate_func(NULL, sphdata, state->co, &pfr, interaction_radius, sphclassical_neighbour_accum_cb);
 	pressure =  stiffness * (pow7f(pa->sphdensity / rest_density) - 1.0f);
 
 	/* multiply by mass so that we return a force, not accel */
@@ -2937,7 +2948,7 @@ static void sphclassical_calc_dens(ParticleData *pa, float UNUSED(dfra), SPHData
 	pfr.pa = pa;
 	pfr.mass = sphdata->mass;
 
-	sph_evaluate_func( NULL, psys, pa->state.co, &pfr, interaction_radius, sphclassical_density_accum_cb);
+	sph_evaluate_func(NULL, sphdata, pa->state.co, &pfr, interaction_radius, sphclassical_density_accum_cb);
 	pa->sphdensity = MIN2(MAX2(data[0], fluid->rest_density * 0.9f), fluid->rest_density * 1.1f);
 }
 
@@ -2951,6 +2962,9 @@ void psys_sph_init(ParticleSimulationData *sim, SPHData *sphdata)
 	for (i=1, pt=sim->psys->targets.first; i<10; i++, pt=(pt?pt->next:NULL))
 		sphdata->psys[i] = pt ? psys_get_target_system(sim->ob, pt) : NULL;
 
+	for (i=0; i<10; i++)
+		sphdata->grid[i] = NULL;
+
 	if (psys_uses_gravity(sim))
 		sphdata->gravity = sim->scene->physics_settings.gravity;
 	else
@@ -2976,12 +2990,52 @@ void psys_sph_init(ParticleSimulationData *sim, SPHData *sphdata)
 
 }
 
+/* Build uniform grids of the particles to search neighbors in, instead of the BVH trees
+ * (psys_update_particle_bvhtree). Grids are built from scratch for every step, but unlike
+ * the trees building them is linear in the number of particles and runs in threads. */
+static void psys_sph_grids_build(SPHData *sphdata, float cfra)
+{
+	ParticleSettings *part = sphdata->psys[0]->part;
+	SPHFluidSettings *fluid = part->fluid;
+	/* the interaction radius (see sph_force_cb), so a query only visits the cells next to its own */
+	float cell_size = fluid->radius * (fluid->flag & SPH_FAC_RADIUS ? 4.0f * part->size : 1.0f);
+	int i;
+
+	for (i=0; i < 10 && sphdata->psys[i]; i++) {
+		ParticleSystem *psys = sphdata->psys[i];
+		PointGrid *grid = BLI_pointgrid_new((unsigned int)psys->totpart);
+		PARTICLE_P;
+
+		/* same particles and positions as the BVH trees */
+		LOOP_SHOWN_PARTICLES {
+			if (pa->alive == PARS_ALIVE) {
+				if (pa->state.time == cfra)
+					BLI_pointgrid_insert(grid, p, pa->prev_state.co);
+				else
+					BLI_pointgrid_insert(grid, p, pa->state.co);
+			}
+		}
+		BLI_pointgrid_balance(grid, cell_size);
+
+		sphdata->grid[i] = grid;
+	}
+}
+
 void psys_sph_finalise(SPHData *sphdata)
 {
+	int i;
+
 	if (sphdata->eh) {
 		BLI_edgehash_free(sphdata->eh, NULL);
 		sphdata->eh = NULL;
 	}
+
+	for (i=0; i<10; i++) {
+		if (sphdata->grid[i]) {
+			BLI_pointgrid_free(sphdata->grid[i]);
+			sphdata->grid[i] = NULL;
+		}
+	}
 }
 /* Sample the density field at a point in space. */
 void psys_sph_density(BVHTree *tree, SPHData *sphdata, float co[3], float vars[2])
@@ -2998,7 +3052,7 @@ void psys_sph_density(BVHTree *tree, SPHData *sphdata, float co[3], float vars[2
 	pfr.h = interaction_radius * sphdata->hfac;
 	pfr.mass = sphdata->mass;
 
-	sph_evaluate_func(tree, psys, co, &pfr, interaction_radius, sphdata->density_cb);
+	sph_evaluate_func(tree, sphdata, co, &pfr, interaction_radius, sphdata->density_cb);
 
 	vars[0] = pfr.data[0];
 	vars[1] = pfr.data[1];
@@ -4239,6 +4293,102 @@ static float update_timestep(ParticleSystem *psys, ParticleSimulationData *sim,
 		return psys->dt_frac;
 }
 
+/* use threads when stepping at least this many SPH particles */
+#define SPH_THREADED_LIMIT 64
+
+typedef struct DynamicStepSPHTaskData {
+	ParticleSimulationData *sim;
+	SPHData *sphdata;
+	float cfra, dtime, timestep;
+} DynamicStepSPHTaskData;
+
+/* Double density relaxation (Clavet et. al.), one particle. */
+static void dynamics_step_sph_ddr_task_cb(void *userdata, int p)
+{
+	DynamicStepSPHTaskData *data = userdata;
+	ParticleSimulationData *sim = data->sim;
+	ParticleSystem *psys = sim->psys;
+	ParticleSettings *part = psys->part;
+	ParticleData *pa = psys->particles + p;
+	/* the force callbacks store the current particle in the SPH data */
+	SPHData sphdata = *data->sphdata;
+
+	if (pa->state.time <= 0.0f)
+		return;
+
+	/* do global forces & effectors */
+	basic_integrate(sim, p, pa->state.time, data->cfra);
+
+	/* actual fluids calculations */
+	sph_integrate(sim, pa, pa->state.time, &sphdata);
+
+	if (sim->colliders)
+		collision_check(sim, p, pa->state.time, data->cfra);
+
+	/* SPH particles are not physical particles, just interpolation
+	 * particles,  thus rotation has not a direct sense for them */
+	basic_rotate(part, pa, pa->state.time, data->timestep);
+
+	if (part->time_flag & PART_TIME_AUTOSF) {
+		BLI_mutex_lock(&psys_sph_courant_mutex);
+		update_courant_num(sim, pa, data->dtime, &sphdata);
+		BLI_mutex_unlock(&psys_sph_courant_mutex);
+	}
+}
+
+static void dynamics_step_sph_classical_basic_integrate_task_cb(void *userdata, int p)
+{
+	DynamicStepSPHTaskData *data = userdata;
+	ParticleSimulationData *sim = data->sim;
+	ParticleData *pa = sim->psys->particles + p;
+
+	if (pa->state.time <= 0.0f)
+		return;
+
+	basic_integrate(sim, p, pa->state.time, data->cfra);
+}
+
+static void dynamics_step_sph_classical_calc_density_task_cb(void *userdata, int p)
+{
+	DynamicStepSPHTaskData *data = userdata;
+	ParticleData *pa = data->sim->psys->particles + p;
+	SPHData sphdata = *data->sphdata;
+
+	if (pa->state.time <= 0.0f)
+		return;
+
+	sphclassical_calc_dens(pa, pa->state.time, &sphdata);
+}
+
+static void dynamics_step_sph_classical_integrate_task_cb(void *userdata, int p)
+{
+	DynamicStepSPHTaskData *data = userdata;
+	ParticleSimulationData *sim = data->sim;
+	ParticleSystem *psys = sim->psys;
+	ParticleSettings *part = psys->part;
+	ParticleData *pa = psys->particles + p;
+	SPHData sphdata = *data->sphdata;
+
+	if (pa->state.time <= 0.0f)
+		return;
+
+	/* actual fluids calculations */
+	sph_integrate(sim, pa, pa->state.time, &sphdata);
+
+	if (sim->colliders)
+		collision_check(sim, p, pa->state.time, data->cfra);
+
+	/* SPH particles are not physical particles, just interpolation
+	 * particles,  thus rotation has not a direct sense for them */
+	basic_rotate(part, pa, pa->state.time, data->timestep);
+
+	if (part->time_flag & PART_TIME_AUTOSF) {
+		BLI_mutex_lock(&psys_sph_courant_mutex);
+		update_courant_num(sim, pa, data->dtime, &sphdata);
+		BLI_mutex_unlock(&psys_sph_courant_mutex);
+	}
+}
+
 /************************************************/
 /*			System Core							*/
 /************************************************/
@@ -4249,6 +4399,7 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 	ParticleSettings *part=psys->part;
 	RNG *rng;
 	BoidBrainData bbd;
+	SPHData sphdata;
 	ParticleTexture ptex;
 	PARTICLE_P;
 	float timestep;
@@ -4308,6 +4459,16 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 		case PART_PHYS_FLUID:
 		{
 			ParticleTarget *pt = psys->targets.first;
+
+			psys_sph_init(sim, &sphdata);
+
+			if (part->fluid->flag & SPH_GRID_SEARCH) {
+				/* grids of this and the target systems, before the particles are initialized
+				 * so they hold the same particles as the trees would */
+				psys_sph_grids_build(&sphdata, cfra);
+				break;
+			}
+
 			psys_update_particle_bvhtree(psys, cfra);
 			
 			for (; pt; pt=pt->next) {  /* Updating others systems particle tree for fluid-fluid interaction */
@@ -4395,35 +4556,25 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 		}
 		case PART_PHYS_FLUID:
 		{
-			SPHData sphdata;
-			ParticleSettings *part = sim->psys->part;
-			psys_sph_init(sim, &sphdata);
+			DynamicStepSPHTaskData data = {NULL};
+
+			data.sim = sim;
+			data.sphdata = &sphdata;
+			data.cfra = cfra;
+			data.dtime = dtime;
+			data.timestep = timestep;
 
-			if (part->fluid->solver == SPH_SOLVER_DDR) {
+			if (psys->totpart == 0) {
+				/* nothing to step */
+			}
+			else if (part->fluid->solver == SPH_SOLVER_DDR) {
 				/* Apply SPH forces using double-density relaxation algorithm
 				 * (Clavat et. al.) */
-#pragma omp parallel for firstprivate (sphdata) private (pa) schedule(dynamic,5)
-				LOOP_DYNAMIC_PARTICLES {
-					/* do global forces & effectors */
-					basic_integrate(sim, p, pa->state.time, cfra);
-
-					/* actual fluids calculations */
-					sph_integrate(sim, pa, pa->state.time, &sphdata);
-
-					if (sim->colliders)
-						collision_check(sim, p, pa->state.time, cfra);
-
-					/* SPH particles are not physical particles, just interpolation
-					 * particles,  thus rotation has not a direct sense for them */
-					basic_rotate(part, pa, pa->state.time, timestep);
-
-#pragma omp critical
-					if (part->time_flag & PART_TIME_AUTOSF)
-						update_courant_num(sim, pa, dtime, &sphdata);
-				}
+				BLI_task_parallel_range_ex(
+				        0, psys->totpart, &data, dynamics_step_sph_ddr_task_cb,
+				        SPH_THREADED_LIMIT, true);
 
 				sph_springs_modify(psys, timestep);
-
 			}
 			else {
 				/* SPH_SOLVER_CLASSICAL */
@@ -4431,34 +4582,19 @@ static void dynamics_step(ParticleSimulationData *sim, float cfra)
 				 * and Monaghan). Note that, unlike double-density relaxation,
 				 * this algorithm is separated into distinct loops. */
 
-#pragma omp parallel for private (pa) schedule(dynamic,5)
-				LOOP_DYNAMIC_PARTICLES {
-					basic_integrate(sim, p, pa->state.time, cfra);
-				}
+				BLI_task_parallel_range_ex(
+				        0, psys->totpart, &data, dynamics_step_sph_classical_basic_integrate_task_cb,
+				        SPH_THREADED_LIMIT, true);
 
 				/* calculate summation density */
-#pragma omp parallel for firstprivate (sphdata) private (pa) schedule(dynamic,5)
-				LOOP_DYNAMIC_PARTICLES {
-					sphclassical_calc_dens(pa, pa->state.time, &sphdata);
-				}
+				BLI_task_parallel_range_ex(
+				        0, psys->totpart, &data, dynamics_step_sph_classical_calc_density_task_cb,
+				        SPH_THREADED_LIMIT, true);
 
 				/* do global forces & effectors */
-#pragma omp parallel for firstprivate (sphdata) private (pa) schedule(dynamic,5)
-				LOOP_DYNAMIC_PARTICLES {
-					/* actual fluids calculations */
-					sph_integrate(sim, pa, pa->state.time, &sphdata);
-
-					if (sim->colliders)
-						collision_check(sim, p, pa->state.time, cfra);
-				
-					/* SPH particles are not physical particles, just interpolation
-					 * particles,  thus rotation has not a direct sense for them */
-					basic_rotate(part, pa, pa->state.time, timestep);
-
-#pragma omp critical
-					if (part->time_flag & PART_TIME_AUTOSF)
-						update_courant_num(sim, pa, dtime, &sphdata);
-				}
+				BLI_task_parallel_range_ex(
+				        0, psys->totpart, &data, dynamics_step_sph_classical_integrate_task_cb,
+				        SPH_THREADED_LIMIT, true);
 			}
 
 			psys_sph_finalise(&sphdata);
@@ -30,6 +30,7 @@
 #include "BLI_math.h"
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
+#include "BLI_task.h"
 
 #include "BKE_pbvh.h"
 #include "BKE_ccg.h"
@@ -44,19 +45,20 @@
 
 #include "pbvh_intern.h"
 
+#include "atomic_ops.h"
+
 #define LEAF_LIMIT 10000
 
 //#define PERFCNTRS
 
 #define STACK_FIXED_DEPTH   100
 
-/* Setting zero so we can catch bugs in OpenMP/PBVH. */
-#ifdef _OPENMP
-#  ifdef DEBUG
-#    define PBVH_OMP_LIMIT 0
-#  else
-#    define PBVH_OMP_LIMIT 8
-#  endif
+/* Minimum number of nodes to run node loops on the task scheduler,
+ * setting zero so we can catch threading bugs in PBVH. */
+#ifdef DEBUG
+#  define PBVH_THREADED_LIMIT 0
+#else
+#  define PBVH_THREADED_LIMIT 8
 #endif
 
 typedef struct PBVHStack {
@@ -946,18 +948,104 @@ static bool update_search_cb(PBVHNode *node, void *data_v)
 	return 1;
 }
 
+typedef struct PBVHUpdateData {
+	PBVH *bvh;
+	PBVHNode **nodes;
+
+	float (*face_nors)[3];
+	float (*vnor)[3];
+	int flag;
+} PBVHUpdateData;
+
+static void pbvh_update_normals_accum_task_cb(void *userdata, int n)
+{
+	PBVHUpdateData *data = userdata;
+	PBVH *bvh = data->bvh;
+	PBVHNode *node = data->nodes[n];
+	float (*face_nors)[3] = data->face_nors;
+	float (*vnor)[3] = data->vnor;
+
+	if ((node->flag & PBVH_UpdateNormals)) {
+		int i, j, totface, *faces;
+
+		faces = node->prim_indices;
+		totface = node->totprim;
+
+		for (i = 0; i < totface; ++i) {
+			MFace *f = bvh->faces + faces[i];
+			float fn[3];
+			unsigned int *fv = &f->v1;
+			int sides = (f->v4) ? 4 : 3;
+
+			if (f->v4)
+				normal_quad_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
+				               bvh->verts[f->v3].co, bvh->verts[f->v4].co);
+			else
+				normal_tri_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
+				              bvh->verts[f->v3].co);
+
+			for (j = 0; j < sides; ++j) {
+				int v = fv[j];
+
+				if (bvh->verts[v].flag & ME_VERT_PBVH_UPDATE) {
+					/* this seems like it could be very slow but profile
+					 * does not show this, so just leave it for now? */
+					atomic_add_fl(&vnor[v][0], fn[0]);
+					atomic_add_fl(&vnor[v][1], fn[1]);
+					atomic_add_fl(&vnor[v][2], fn[2]);
+				}
+			}
+
+			if (face_nors)
+				copy_v3_v3(face_nors[faces[i]], fn);
+		}
+	}
+}
+
+static void pbvh_update_normals_store_task_cb(void *userdata, int n)
+{
+	PBVHUpdateData *data = userdata;
+	PBVH *bvh = data->bvh;
+	PBVHNode *node = data->nodes[n];
+	float (*vnor)[3] = data->vnor;
+
+	if (node->flag & PBVH_UpdateNormals) {
+		int i, *verts, totvert;
+
+		verts = node->vert_indices;
+		totvert = node->uniq_verts;
+
+		for (i = 0; i < totvert; ++i) {
+			const int v = verts[i];
+			MVert *mvert = &bvh->verts[v];
+
+			if (mvert->flag & ME_VERT_PBVH_UPDATE) {
+				float no[3];
+
+				copy_v3_v3(no, vnor[v]);
+				normalize_v3(no);
+				normal_float_to_short_v3(mvert->no, no);
+
+				mvert->flag &= ~ME_VERT_PBVH_UPDATE;
+			}
+		}
+
+		node->flag &= ~PBVH_UpdateNormals;
+	}
+}
+
 static void pbvh_update_normals(PBVH *bvh, PBVHNode **nodes,
                                 int totnode, float (*face_nors)[3])
 {
+	PBVHUpdateData data;
 	float (*vnor)[3];
-	int n;
 
 	if (bvh->type == PBVH_BMESH) {
 		pbvh_bmesh_normals_update(nodes, totnode);
 		return;
 	}
 
-	if (bvh->type != PBVH_FACES)
+	if (bvh->type != PBVH_FACES || totnode == 0)
 		return;
 
 	/* could be per node to save some memory, but also means
@@ -974,101 +1062,52 @@ static void pbvh_update_normals(PBVH *bvh, PBVHNode **nodes,
 	 *   can only update vertices marked with ME_VERT_PBVH_UPDATE.
 	 */
 
-#pragma omp parallel for private(n) schedule(static) if (totnode > PBVH_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHNode *node = nodes[n];
-
-		if ((node->flag & PBVH_UpdateNormals)) {
-			int i, j, totface, *faces;
-
-			faces = node->prim_indices;
-			totface = node->totprim;
-
-			for (i = 0; i < totface; ++i) {
-				MFace *f = bvh->faces + faces[i];
-				float fn[3];
-				unsigned int *fv = &f->v1;
-				int sides = (f->v4) ? 4 : 3;
-
-				if (f->v4)
-					normal_quad_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
-					               bvh->verts[f->v3].co, bvh->verts[f->v4].co);
-				else
-					normal_tri_v3(fn, bvh->verts[f->v1].co, bvh->verts[f->v2].co,
-					              bvh->verts[f->v3].co);
-
-				for (j = 0; j < sides; ++j) {
-					int v = fv[j];
-
-					if (bvh->verts[v].flag & ME_VERT_PBVH_UPDATE) {
-						/* this seems like it could be very slow but profile
-						 * does not show this, so just leave it for now? */
-#pragma omp atomic
-						vnor[v][0] += fn[0];
-#pragma omp atomic
-						vnor[v][1] += fn[1];
-#pragma omp atomic
-						vnor[v][2] += fn[2];
-					}
-				}
-
-				if (face_nors)
-					copy_v3_v3(face_nors[faces[i]], fn);
-			}
-		}
-	}
-
-#pragma omp parallel for private(n) schedule(static) if (totnode > PBVH_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHNode *node = nodes[n];
-
-		if (node->flag & PBVH_UpdateNormals) {
-			int i, *verts, totvert;
+	data.bvh = bvh;
+	data.nodes = nodes;
+	data.face_nors = face_nors;
+	data.vnor = vnor;
 
-			verts = node->vert_indices;
-			totvert = node->uniq_verts;
+	BLI_task_parallel_range_ex(0, totnode, &data, pbvh_update_normals_accum_task_cb,
+	                           PBVH_THREADED_LIMIT, false);
 
-			for (i = 0; i < totvert; ++i) {
-				const int v = verts[i];
-				MVert *mvert = &bvh->verts[v];
+	BLI_task_parallel_range_ex(0, totnode, &data, pbvh_update_normals_store_task_cb,
+	                           PBVH_THREADED_LIMIT, false);
 
-				if (mvert->flag & ME_VERT_PBVH_UPDATE) {
-					float no[3];
+	MEM_freeN(vnor);
+}
 
-					copy_v3_v3(no, vnor[v]);
-					normalize_v3(no);
-					normal_float_to_short_v3(mvert->no, no);
+static void pbvh_update_BB_redraw_task_cb(void *userdata, int n)
+{
+	PBVHUpdateData *data = userdata;
+	PBVH *bvh = data->bvh;
+	PBVHNode *node = data->nodes[n];
+	const int flag = data->flag;
 
-					mvert->flag &= ~ME_VERT_PBVH_UPDATE;
-				}
-			}
+	if ((flag & PBVH_UpdateBB) && (node->flag & PBVH_UpdateBB))
+		/* don't clear flag yet, leave it for flushing later */
+		update_node_vb(bvh, node);
 
-			node->flag &= ~PBVH_UpdateNormals;
-		}
-	}
+	if ((flag & PBVH_UpdateOriginalBB) && (node->flag & PBVH_UpdateOriginalBB))
+		node->orig_vb = node->vb;
 
-	MEM_freeN(vnor);
+	if ((flag & PBVH_UpdateRedraw) && (node->flag & PBVH_UpdateRedraw))
+		node->flag &= ~PBVH_UpdateRedraw;
 }
 
 void pbvh_update_BB_redraw(PBVH *bvh, PBVHNode **nodes, int totnode, int flag)
 {
-	int n;
+	PBVHUpdateData data;
 
-	/* update BB, redraw flag */
-#pragma omp parallel for private(n) schedule(static) if (totnode > PBVH_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHNode *node = nodes[n];
-
-		if ((flag & PBVH_UpdateBB) && (node->flag & PBVH_UpdateBB))
-			/* don't clear flag yet, leave it for flushing later */
-			update_node_vb(bvh, node);
+	if (totnode == 0)
+		return;
 
-		if ((flag & PBVH_UpdateOriginalBB) && (node->flag & PBVH_UpdateOriginalBB))
-			node->orig_vb = node->vb;
+	data.bvh = bvh;
+	data.nodes = nodes;
+	data.flag = flag;
 
-		if ((flag & PBVH_UpdateRedraw) && (node->flag & PBVH_UpdateRedraw))
-			node->flag &= ~PBVH_UpdateRedraw;
-	}
+	/* update BB, redraw flag */
+	BLI_task_parallel_range_ex(0, totnode, &data, pbvh_update_BB_redraw_task_cb,
+	                           PBVH_THREADED_LIMIT, false);
 }
 
 static void pbvh_update_draw_buffers(PBVH *bvh, PBVHNode **nodes, int totnode)
@@ -1880,41 +1919,35 @@ PBVHProxyNode *BKE_pbvh_node_add_proxy(PBVH *bvh, PBVHNode *node)
 {
 	int index, totverts;
 
-#pragma omp critical
-	{
-
-		index = node->proxy_count;
+	/* no locking, nodes are only ever processed by a single thread at once */
+	index = node->proxy_count;
 
-		node->proxy_count++;
+	node->proxy_count++;
 
-		if (node->proxies)
-			node->proxies = MEM_reallocN(node->proxies, node->proxy_count * sizeof(PBVHProxyNode));
-		else
-			node->proxies = MEM_mallocN(sizeof(PBVHProxyNode), "PBVHNodeProxy");
+	if (node->proxies)
+		node->proxies = MEM_reallocN(node->proxies, node->proxy_count * sizeof(PBVHProxyNode));
+	else
+		node->proxies = MEM_mallocN(sizeof(PBVHProxyNode), "PBVHNodeProxy");
 
-		BKE_pbvh_node_num_verts(bvh, node, &totverts, NULL);
-		node->proxies[index].co = MEM_callocN(sizeof(float[3]) * totverts, "PBVHNodeProxy.co");
-	}
+	BKE_pbvh_node_num_verts(bvh, node, &totverts, NULL);
+	node->proxies[index].co = MEM_callocN(sizeof(float[3]) * totverts, "PBVHNodeProxy.co");
 
 	return node->proxies + index;
 }
 
 void BKE_pbvh_node_free_proxies(PBVHNode *node)
 {
-#pragma omp critical
-	{
-		int p;
+	int p;
 
-		for (p = 0; p < node->proxy_count; p++) {
-			MEM_freeN(node->proxies[p].co);
-			node->proxies[p].co = NULL;
-		}
+	for (p = 0; p < node->proxy_count; p++) {
+		MEM_freeN(node->proxies[p].co);
+		node->proxies[p].co = NULL;
+	}
 
-		MEM_freeN(node->proxies);
-		node->proxies = NULL;
+	MEM_freeN(node->proxies);
+	node->proxies = NULL;
 
-		node->proxy_count = 0;
-	}
+	node->proxy_count = 0;
 }
 
 void BKE_pbvh_gather_proxies(PBVH *pbvh, PBVHNode ***r_array,  int *r_tot)
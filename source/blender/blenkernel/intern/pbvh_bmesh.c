@@ -25,10 +25,13 @@
 #include "MEM_guardedalloc.h"
 
 #include "BLI_utildefines.h"
+#include "BLI_bitmap.h"
 #include "BLI_buffer.h"
 #include "BLI_ghash.h"
 #include "BLI_heap.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "BKE_ccg.h"
 #include "BKE_DerivedMesh.h"
@@ -43,6 +46,13 @@
 
 // #define USE_VERIFY
 
+/* Minimum number of nodes to gather queued edges and update node interiors on the task scheduler. */
+#ifdef DEBUG
+#  define PBVH_BMESH_TASK_LIMIT 0
+#else
+#  define PBVH_BMESH_TASK_LIMIT 4
+#endif
+
 #ifdef USE_VERIFY
 static void pbvh_bmesh_verify(PBVH *bvh);
 #endif
@@ -557,8 +567,28 @@ typedef struct {
 	int cd_vert_mask_offset;
 	int cd_vert_node_offset;
 	int cd_face_node_offset;
+
+	/* Only set while the interior of this node is updated in parallel with other nodes,
+	 * see pbvh_bmesh_update_topology_nodes() */
+	struct EdgeQueueNode *node;
+	SpinLock *bm_lock;
 } EdgeQueueContext;
 
+/* Creating and freeing BMesh elements and logging them for undo isn't thread-safe */
+BLI_INLINE void edge_queue_bm_lock(EdgeQueueContext *eq_ctx)
+{
+	if (eq_ctx->bm_lock) {
+		BLI_spin_lock(eq_ctx->bm_lock);
+	}
+}
+
+BLI_INLINE void edge_queue_bm_unlock(EdgeQueueContext *eq_ctx)
+{
+	if (eq_ctx->bm_lock) {
+		BLI_spin_unlock(eq_ctx->bm_lock);
+	}
+}
+
 static bool edge_queue_tri_in_sphere(const EdgeQueue *q, BMFace *f)
 {
 	BMVert *v_tri[3];
@@ -580,26 +610,36 @@ static bool check_mask(EdgeQueueContext *eq_ctx, BMVert *v)
 	return (BM_ELEM_CD_GET_FLOAT(v, eq_ctx->cd_vert_mask_offset) < 1.0f);
 }
 
-static void edge_queue_insert(EdgeQueueContext *eq_ctx, BMEdge *e,
-                              float priority)
+static bool edge_queue_edge_check(EdgeQueueContext *eq_ctx, BMEdge *e)
 {
-	BMVert **pair;
-
 	/* Don't let topology update affect fully masked vertices. This used to
 	 * have a 50% mask cutoff, with the reasoning that you can't do a 50%
 	 * topology update. But this gives an ugly border in the mesh. The mask
 	 * should already make the brush move the vertices only 50%, which means
 	 * that topology updates will also happen less frequent, that should be
 	 * enough. */
-	if (((eq_ctx->cd_vert_mask_offset == -1) ||
-	     (check_mask(eq_ctx, e->v1) || check_mask(eq_ctx, e->v2))) &&
-	    !(BM_elem_flag_test_bool(e->v1, BM_ELEM_HIDDEN) ||
-	      BM_elem_flag_test_bool(e->v2, BM_ELEM_HIDDEN)))
-	{
-		pair = BLI_mempool_alloc(eq_ctx->pool);
-		pair[0] = e->v1;
-		pair[1] = e->v2;
-		BLI_heap_insert(eq_ctx->q->heap, priority, pair);
+	return (((eq_ctx->cd_vert_mask_offset == -1) ||
+	         (check_mask(eq_ctx, e->v1) || check_mask(eq_ctx, e->v2))) &&
+	        !(BM_elem_flag_test_bool(e->v1, BM_ELEM_HIDDEN) ||
+	          BM_elem_flag_test_bool(e->v2, BM_ELEM_HIDDEN)));
+}
+
+static void edge_queue_insert_nocheck(EdgeQueueContext *eq_ctx, BMEdge *e,
+                                      float priority)
+{
+	BMVert **pair;
+
+	pair = BLI_mempool_alloc(eq_ctx->pool);
+	pair[0] = e->v1;
+	pair[1] = e->v2;
+	BLI_heap_insert(eq_ctx->q->heap, priority, pair);
+}
+
+static void edge_queue_insert(EdgeQueueContext *eq_ctx, BMEdge *e,
+                              float priority)
+{
+	if (edge_queue_edge_check(eq_ctx, e)) {
+		edge_queue_insert_nocheck(eq_ctx, e, priority);
 	}
 }
 
@@ -611,14 +651,6 @@ static void long_edge_queue_edge_add(EdgeQueueContext *eq_ctx,
 		edge_queue_insert(eq_ctx, e, -len_sq);
 }
 
-static void short_edge_queue_edge_add(EdgeQueueContext *eq_ctx,
-                                      BMEdge *e)
-{
-	const float len_sq = BM_edge_calc_length_squared(e);
-	if (len_sq < eq_ctx->q->limit_len_squared)
-		edge_queue_insert(eq_ctx, e, len_sq);
-}
-
 static void long_edge_queue_face_add(EdgeQueueContext *eq_ctx,
                                      BMFace *f)
 {
@@ -634,40 +666,138 @@ static void long_edge_queue_face_add(EdgeQueueContext *eq_ctx,
 	}
 }
 
-static void short_edge_queue_face_add(EdgeQueueContext *eq_ctx,
-                                      BMFace *f)
+/* Edges found in a single node, in the order the serial face loop would queue them */
+typedef struct EdgeQueueNodeEdges {
+	BMEdge **edges;
+	float *priority;
+	int count;
+} EdgeQueueNodeEdges;
+
+/* Queue of a single node, its interior is updated on the task scheduler,
+ * see pbvh_bmesh_update_topology_nodes() */
+typedef struct EdgeQueueNode {
+	EdgeQueue q;
+	BLI_mempool *pool;
+	int node_index;
+	/* edges left for the serial queue */
+	Heap *deferred;
+	/* subdividing only, the deferred edges */
+	GSet *deferred_edges;
+	/* collapsing only */
+	GSet *deleted_verts;
+	/* queued nodes sharing vertices with this one, never updated at the same time */
+	BLI_bitmap *conflicts;
+} EdgeQueueNode;
+
+typedef struct EdgeQueueGatherData {
+	EdgeQueueContext *eq_ctx;
+	PBVHNode **nodes;
+	int totnode;
+	EdgeQueueNodeEdges *node_edges;
+	/* when set, the conflicts of each node are found too */
+	EdgeQueueNode *node_queues;
+	/* index in 'nodes' of each PBVH node, -1 when not queued */
+	int *node_queue_index;
+	/* gather edges longer than the limit, otherwise shorter */
+	bool use_long;
+} EdgeQueueGatherData;
+
+/* Every vertex used by more than one node is in the 'other' set of all nodes but its owner,
+ * so checking the faces of those finds all queued nodes sharing a vertex with this one */
+static void edge_queue_node_conflicts_find(EdgeQueueGatherData *data, int n)
+{
+	EdgeQueueContext *eq_ctx = data->eq_ctx;
+	EdgeQueueNode *node_queue = &data->node_queues[n];
+	GSetIterator gs_iter;
+
+	node_queue->conflicts = BLI_BITMAP_NEW(data->totnode, __func__);
+
+	GSET_ITER (gs_iter, data->nodes[n]->bm_other_verts) {
+		BMVert *v = BLI_gsetIterator_getKey(&gs_iter);
+		BMIter bm_iter;
+		BMFace *f;
+
+		BM_ITER_ELEM (f, &bm_iter, v, BM_FACES_OF_VERT) {
+			const int ni = BM_ELEM_CD_GET_INT(f, eq_ctx->cd_face_node_offset);
+
+			if (ni != DYNTOPO_NODE_NONE) {
+				const int qi = data->node_queue_index[ni];
+
+				if (qi != -1 && qi != n) {
+					BLI_BITMAP_ENABLE(node_queue->conflicts, qi);
+				}
+			}
+		}
+	}
+}
+
+/* Only reads the mesh, so nodes can be gathered in parallel */
+static void edge_queue_node_gather_task_cb(void *userdata, int n)
 {
-	if (edge_queue_tri_in_sphere(eq_ctx->q, f)) {
-		BMLoop *l_iter;
-		BMLoop *l_first;
+	EdgeQueueGatherData *data = userdata;
+	EdgeQueueContext *eq_ctx = data->eq_ctx;
+	const float limit_len_squared = eq_ctx->q->limit_len_squared;
+	EdgeQueueNodeEdges *node_edges = &data->node_edges[n];
+	GSet *bm_faces = data->nodes[n]->bm_faces;
+	/* triangles only, an edge is queued for each face using it */
+	const int edges_max = BLI_gset_size(bm_faces) * 3;
+	GSetIterator gs_iter;
 
-		/* Check each edge of the face */
-		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-		do {
-			short_edge_queue_edge_add(eq_ctx, l_iter->e);
-		} while ((l_iter = l_iter->next) != l_first);
+	node_edges->edges = MEM_mallocN(sizeof(*node_edges->edges) * (size_t)edges_max, __func__);
+	node_edges->priority = MEM_mallocN(sizeof(*node_edges->priority) * (size_t)edges_max, __func__);
+	node_edges->count = 0;
+
+	GSET_ITER (gs_iter, bm_faces) {
+		BMFace *f = BLI_gsetIterator_getKey(&gs_iter);
+
+		if (edge_queue_tri_in_sphere(eq_ctx->q, f)) {
+			BMLoop *l_iter;
+			BMLoop *l_first;
+
+			/* Check each edge of the face */
+			l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+			do {
+				BMEdge *e = l_iter->e;
+				const float len_sq = BM_edge_calc_length_squared(e);
+
+				if ((data->use_long ? (len_sq > limit_len_squared) : (len_sq < limit_len_squared)) &&
+				    edge_queue_edge_check(eq_ctx, e))
+				{
+					BLI_assert(node_edges->count < edges_max);
+					node_edges->edges[node_edges->count] = e;
+					node_edges->priority[node_edges->count] = data->use_long ? -len_sq : len_sq;
+					node_edges->count++;
+				}
+			} while ((l_iter = l_iter->next) != l_first);
+		}
+	}
+
+	if (data->node_queues) {
+		edge_queue_node_conflicts_find(data, n);
 	}
 }
 
-/* Create a priority queue containing vertex pairs connected by a long
- * edge as defined by PBVH.bm_max_edge_len.
+/* Fill the queue from the faces of all leaf nodes marked for topology update.
  *
- * Only nodes marked for topology update are checked, and in those
- * nodes only edges used by a face intersecting the (center, radius)
- * sphere are checked.
+ * Testing the faces is done per node on the task scheduler, the results are
+ * then added to the heap in node order, so the queue matches a serial build.
  *
- * The highest priority (lowest number) is given to the longest edge.
- */
-static void long_edge_queue_create(EdgeQueueContext *eq_ctx,
-                                   PBVH *bvh, const float center[3],
-                                   float radius)
+ * When 'r_node_queues' is given and there are enough nodes, each node gets a queue
+ * of its own instead, for pbvh_bmesh_update_topology_nodes() to use. */
+static void edge_queue_create(EdgeQueueContext *eq_ctx, PBVH *bvh, const bool use_long,
+                              EdgeQueueNode **r_node_queues, int *r_totnode_queue)
 {
-	int n;
+	EdgeQueueGatherData data;
+	PBVHNode **nodes;
+	int totnode = 0;
+	int n, i;
+
+	if (r_node_queues) {
+		*r_node_queues = NULL;
+		*r_totnode_queue = 0;
+	}
 
-	eq_ctx->q->heap = BLI_heap_new();
-	eq_ctx->q->center = center;
-	eq_ctx->q->radius_squared = radius * radius;
-	eq_ctx->q->limit_len_squared = bvh->bm_max_edge_len * bvh->bm_max_edge_len;
+	nodes = MEM_mallocN(sizeof(*nodes) * (size_t)bvh->totnode, __func__);
 
 	for (n = 0; n < bvh->totnode; n++) {
 		PBVHNode *node = &bvh->nodes[n];
@@ -677,16 +807,92 @@ static void long_edge_queue_create(EdgeQueueContext *eq_ctx,
 		    (node->flag & PBVH_UpdateTopology) &&
 		    !(node->flag & PBVH_FullyHidden))
 		{
-			GSetIterator gs_iter;
+			nodes[totnode++] = node;
+		}
+	}
 
-			/* Check each face */
-			GSET_ITER (gs_iter, node->bm_faces) {
-				BMFace *f = BLI_gsetIterator_getKey(&gs_iter);
+	if (totnode == 0) {
+		MEM_freeN(nodes);
+		return;
+	}
 
-				long_edge_queue_face_add(eq_ctx, f);
-			}
+	data.eq_ctx = eq_ctx;
+	data.nodes = nodes;
+	data.totnode = totnode;
+	data.node_edges = MEM_mallocN(sizeof(*data.node_edges) * (size_t)totnode, __func__);
+	data.node_queues = NULL;
+	data.node_queue_index = NULL;
+	data.use_long = use_long;
+
+	if (r_node_queues && totnode >= PBVH_BMESH_TASK_LIMIT) {
+		data.node_queues = MEM_callocN(sizeof(*data.node_queues) * (size_t)totnode, __func__);
+		data.node_queue_index = MEM_mallocN(sizeof(*data.node_queue_index) * (size_t)bvh->totnode, __func__);
+
+		for (n = 0; n < bvh->totnode; n++) {
+			data.node_queue_index[n] = -1;
+		}
+		for (n = 0; n < totnode; n++) {
+			data.node_queue_index[nodes[n] - bvh->nodes] = n;
 		}
 	}
+
+	BLI_task_parallel_range_ex(0, totnode, &data, edge_queue_node_gather_task_cb,
+	                           PBVH_BMESH_TASK_LIMIT, false);
+
+	for (n = 0; n < totnode; n++) {
+		EdgeQueueNodeEdges *node_edges = &data.node_edges[n];
+		EdgeQueueContext node_eq_ctx = *eq_ctx;
+
+		if (data.node_queues) {
+			EdgeQueueNode *node_queue = &data.node_queues[n];
+
+			node_queue->q = *eq_ctx->q;
+			node_queue->q.heap = BLI_heap_new();
+			node_queue->pool = BLI_mempool_create(sizeof(BMVert *[2]), 0, 128, BLI_MEMPOOL_NOP);
+			node_queue->node_index = (int)(nodes[n] - bvh->nodes);
+
+			node_eq_ctx.q = &node_queue->q;
+			node_eq_ctx.pool = node_queue->pool;
+		}
+
+		for (i = 0; i < node_edges->count; i++) {
+			edge_queue_insert_nocheck(&node_eq_ctx, node_edges->edges[i], node_edges->priority[i]);
+		}
+
+		MEM_freeN(node_edges->edges);
+		MEM_freeN(node_edges->priority);
+	}
+
+	if (data.node_queues) {
+		*r_node_queues = data.node_queues;
+		*r_totnode_queue = totnode;
+		MEM_freeN(data.node_queue_index);
+	}
+
+	MEM_freeN(data.node_edges);
+	MEM_freeN(nodes);
+}
+
+/* Create a priority queue containing vertex pairs connected by a long
+ * edge as defined by PBVH.bm_max_edge_len.
+ *
+ * Only nodes marked for topology update are checked, and in those
+ * nodes only edges used by a face intersecting the (center, radius)
+ * sphere are checked.
+ *
+ * The highest priority (lowest number) is given to the longest edge.
+ */
+static void long_edge_queue_create(EdgeQueueContext *eq_ctx,
+                                   PBVH *bvh, const float center[3],
+                                   float radius,
+                                   EdgeQueueNode **r_node_queues, int *r_totnode_queue)
+{
+	eq_ctx->q->heap = BLI_heap_new();
+	eq_ctx->q->center = center;
+	eq_ctx->q->radius_squared = radius * radius;
+	eq_ctx->q->limit_len_squared = bvh->bm_max_edge_len * bvh->bm_max_edge_len;
+
+	edge_queue_create(eq_ctx, bvh, true, r_node_queues, r_totnode_queue);
 }
 
 /* Create a priority queue containing vertex pairs connected by a
@@ -700,42 +906,139 @@ static void long_edge_queue_create(EdgeQueueContext *eq_ctx,
  */
 static void short_edge_queue_create(EdgeQueueContext *eq_ctx,
                                     PBVH *bvh, const float center[3],
-                                    float radius)
+                                    float radius,
+                                    EdgeQueueNode **r_node_queues, int *r_totnode_queue)
 {
-	int n;
-
 	eq_ctx->q->heap = BLI_heap_new();
 	eq_ctx->q->center = center;
 	eq_ctx->q->radius_squared = radius * radius;
 	eq_ctx->q->limit_len_squared = bvh->bm_min_edge_len * bvh->bm_min_edge_len;
 
-	for (n = 0; n < bvh->totnode; n++) {
-		PBVHNode *node = &bvh->nodes[n];
+	edge_queue_create(eq_ctx, bvh, false, r_node_queues, r_totnode_queue);
+}
 
-		/* Check leaf nodes marked for topology update */
-		if ((node->flag & PBVH_Leaf) &&
-		    (node->flag & PBVH_UpdateTopology) &&
-		    !(node->flag & PBVH_FullyHidden))
-		{
-			GSetIterator gs_iter;
+/*************************** Topology update **************************/
 
-			/* Check each face */
-			GSET_ITER (gs_iter, node->bm_faces) {
-				BMFace *f = BLI_gsetIterator_getKey(&gs_iter);
+static void bm_edges_from_tri(BMesh *bm, BMVert *v_tri[3], BMEdge *e_tri[3])
+{
+	e_tri[0] = BM_edge_create(bm, v_tri[0], v_tri[1], NULL, BM_CREATE_NO_DOUBLE);
+	e_tri[1] = BM_edge_create(bm, v_tri[1], v_tri[2], NULL, BM_CREATE_NO_DOUBLE);
+	e_tri[2] = BM_edge_create(bm, v_tri[2], v_tri[0], NULL, BM_CREATE_NO_DOUBLE);
+}
+
+/* Return true if only the node being updated uses 'v', so it can be removed with its edges */
+static bool pbvh_bmesh_vert_in_node_only(EdgeQueueContext *eq_ctx, BMVert *v)
+{
+	BMIter bm_iter;
+	BMEdge *e;
+	BMFace *f;
+
+	if (BM_ELEM_CD_GET_INT(v, eq_ctx->cd_vert_node_offset) != eq_ctx->node->node_index)
+		return false;
+
+	/* a wire edge may lead to a vertex used by any node */
+	BM_ITER_ELEM (e, &bm_iter, v, BM_EDGES_OF_VERT) {
+		if (e->l == NULL)
+			return false;
+	}
+
+	BM_ITER_ELEM (f, &bm_iter, v, BM_FACES_OF_VERT) {
+		if (BM_ELEM_CD_GET_INT(f, eq_ctx->cd_face_node_offset) != eq_ctx->node->node_index)
+			return false;
+	}
+
+	return true;
+}
+
+/* Return true if splitting the edge only changes the node being updated.
+ *
+ * Only the faces using the edge are replaced, the new vertex goes to the node owning e->v1.
+ * Other nodes using the edge's vertices are never updated at the same time. */
+static bool pbvh_bmesh_edge_split_in_node(EdgeQueueContext *eq_ctx, BMEdge *e)
+{
+	BMLoop *l_iter;
+	BMLoop *l_first;
+
+	if (BM_ELEM_CD_GET_INT(e->v1, eq_ctx->cd_vert_node_offset) != eq_ctx->node->node_index)
+		return false;
 
-				short_edge_queue_face_add(eq_ctx, f);
+	/* killing a wire edge changes the other vertex too */
+	if (e->l == NULL)
+		return false;
+
+	l_iter = l_first = e->l;
+	do {
+		if (BM_ELEM_CD_GET_INT(l_iter->f, eq_ctx->cd_face_node_offset) != eq_ctx->node->node_index)
+			return false;
+	} while ((l_iter = l_iter->radial_next) != l_first);
+
+	return true;
+}
+
+/* Return true if collapsing the edge only changes the node being updated.
+ *
+ * All faces around both vertices are replaced or removed. Neighboring vertices owned
+ * by the node may lose all of their faces in it, then they are either removed or handed
+ * over to another node, so only those used by this node alone are allowed. */
+static bool pbvh_bmesh_edge_collapse_in_node(EdgeQueueContext *eq_ctx, BMEdge *e)
+{
+	BMVert *v_pair[2] = {e->v1, e->v2};
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		BMIter bm_iter;
+		BMEdge *e_iter;
+
+		if (!pbvh_bmesh_vert_in_node_only(eq_ctx, v_pair[i]))
+			return false;
+
+		BM_ITER_ELEM (e_iter, &bm_iter, v_pair[i], BM_EDGES_OF_VERT) {
+			BMVert *v_other = BM_edge_other_vert(e_iter, v_pair[i]);
+
+			if ((BM_ELEM_CD_GET_INT(v_other, eq_ctx->cd_vert_node_offset) == eq_ctx->node->node_index) &&
+			    !pbvh_bmesh_vert_in_node_only(eq_ctx, v_other))
+			{
+				return false;
 			}
 		}
 	}
+
+	return true;
 }
 
-/*************************** Topology update **************************/
+/* Leave the edge for the serial queue */
+static void edge_queue_defer(EdgeQueueContext *eq_ctx, BMEdge *e, float priority)
+{
+	EdgeQueueNode *node_queue = eq_ctx->node;
+	BMVert **pair;
 
-static void bm_edges_from_tri(BMesh *bm, BMVert *v_tri[3], BMEdge *e_tri[3])
+	pair = BLI_mempool_alloc(eq_ctx->pool);
+	pair[0] = e->v1;
+	pair[1] = e->v2;
+	BLI_heap_insert(node_queue->deferred, priority, pair);
+
+	if (node_queue->deferred_edges) {
+		BLI_gset_add(node_queue->deferred_edges, e);
+	}
+}
+
+/* Faces must be split along their longest edge first, otherwise splitting the others
+ * keeps making thinner faces. So once a long edge is deferred, so are the faces using it. */
+static bool edge_queue_face_has_deferred_edge(EdgeQueueContext *eq_ctx, BMEdge *e)
 {
-	e_tri[0] = BM_edge_create(bm, v_tri[0], v_tri[1], NULL, BM_CREATE_NO_DOUBLE);
-	e_tri[1] = BM_edge_create(bm, v_tri[1], v_tri[2], NULL, BM_CREATE_NO_DOUBLE);
-	e_tri[2] = BM_edge_create(bm, v_tri[2], v_tri[0], NULL, BM_CREATE_NO_DOUBLE);
+	BMLoop *l_iter;
+	BMLoop *l_first;
+
+	l_iter = l_first = e->l;
+	do {
+		if (BLI_gset_haskey(eq_ctx->node->deferred_edges, l_iter->next->e) ||
+		    BLI_gset_haskey(eq_ctx->node->deferred_edges, l_iter->prev->e))
+		{
+			return true;
+		}
+	} while ((l_iter = l_iter->radial_next) != l_first);
+
+	return false;
 }
 
 static void pbvh_bmesh_split_edge(EdgeQueueContext *eq_ctx, PBVH *bvh,
@@ -752,7 +1055,9 @@ static void pbvh_bmesh_split_edge(EdgeQueueContext *eq_ctx, PBVH *bvh,
 	mid_v3_v3v3(mid, e->v1->co, e->v2->co);
 
 	node_index = BM_ELEM_CD_GET_INT(e->v1, eq_ctx->cd_vert_node_offset);
+	edge_queue_bm_lock(eq_ctx);
 	v_new = pbvh_bmesh_vert_create(bvh, node_index, mid, e->v1, eq_ctx->cd_vert_mask_offset);
+	edge_queue_bm_unlock(eq_ctx);
 
 	/* update paint mask */
 	if (eq_ctx->cd_vert_mask_offset != -1) {
@@ -792,22 +1097,28 @@ static void pbvh_bmesh_split_edge(EdgeQueueContext *eq_ctx, PBVH *bvh,
 		v_tri[0] = v1;
 		v_tri[1] = v_new;
 		v_tri[2] = v_opp;
+		edge_queue_bm_lock(eq_ctx);
 		bm_edges_from_tri(bvh->bm, v_tri, e_tri);
 		f_new = pbvh_bmesh_face_create(bvh, ni, v_tri, e_tri, f_adj);
+		edge_queue_bm_unlock(eq_ctx);
 		long_edge_queue_face_add(eq_ctx, f_new);
 
 		v_tri[0] = v_new;
 		v_tri[1] = v2;
 		/* v_tri[2] = v_opp; */ /* unchanged */
+		edge_queue_bm_lock(eq_ctx);
 		e_tri[0] = BM_edge_create(bvh->bm, v_tri[0], v_tri[1], NULL, BM_CREATE_NO_DOUBLE);
 		e_tri[2] = e_tri[1];  /* switched */
 		e_tri[1] = BM_edge_create(bvh->bm, v_tri[1], v_tri[2], NULL, BM_CREATE_NO_DOUBLE);
 		f_new = pbvh_bmesh_face_create(bvh, ni, v_tri, e_tri, f_adj);
+		edge_queue_bm_unlock(eq_ctx);
 		long_edge_queue_face_add(eq_ctx, f_new);
 
 		/* Delete original */
+		edge_queue_bm_lock(eq_ctx);
 		pbvh_bmesh_face_remove(bvh, f_adj);
 		BM_face_kill(bvh->bm, f_adj);
+		edge_queue_bm_unlock(eq_ctx);
 
 		/* Ensure new vertex is in the node */
 		if (!BLI_gset_haskey(bvh->nodes[ni].bm_unique_verts, v_new) &&
@@ -826,7 +1137,9 @@ static void pbvh_bmesh_split_edge(EdgeQueueContext *eq_ctx, PBVH *bvh,
 		}
 	}
 
+	edge_queue_bm_lock(eq_ctx);
 	BM_edge_kill(bvh->bm, e);
+	edge_queue_bm_unlock(eq_ctx);
 }
 
 static bool pbvh_bmesh_subdivide_long_edges(EdgeQueueContext *eq_ctx, PBVH *bvh,
@@ -860,6 +1173,14 @@ static bool pbvh_bmesh_subdivide_long_edges(EdgeQueueContext *eq_ctx, PBVH *bvh,
 			continue;
 		}
 
+		/* Only split edges inside the node when updating nodes in parallel */
+		if (eq_ctx->node &&
+		    (!pbvh_bmesh_edge_split_in_node(eq_ctx, e) || edge_queue_face_has_deferred_edge(eq_ctx, e)))
+		{
+			edge_queue_defer(eq_ctx, e, -len_squared_v3v3(v1->co, v2->co));
+			continue;
+		}
+
 		any_subdivided = true;
 
 		pbvh_bmesh_split_edge(eq_ctx, bvh, e, edge_loops);
@@ -896,6 +1217,7 @@ static void pbvh_bmesh_collapse_edge(
 	pbvh_bmesh_vert_remove(bvh, v_del);
 
 	/* Remove all faces adjacent to the edge */
+	edge_queue_bm_lock(eq_ctx);
 	while ((l_adj = e->l)) {
 		BMFace *f_adj = l_adj->f;
 
@@ -906,6 +1228,7 @@ static void pbvh_bmesh_collapse_edge(
 	/* Kill the edge */
 	BLI_assert(BM_edge_is_wire(e));
 	BM_edge_kill(bvh->bm, e);
+	edge_queue_bm_unlock(eq_ctx);
 
 	/* For all remaining faces of v_del, create a new face that is the
 	 * same except it uses v_conn instead of v_del */
@@ -941,8 +1264,10 @@ static void pbvh_bmesh_collapse_edge(
 			BMEdge *e_tri[3];
 			n = pbvh_bmesh_node_lookup(bvh, f);
 			ni = n - bvh->nodes;
+			edge_queue_bm_lock(eq_ctx);
 			bm_edges_from_tri(bvh->bm, v_tri, e_tri);
 			pbvh_bmesh_face_create(bvh, ni, v_tri, e_tri, f);
+			edge_queue_bm_unlock(eq_ctx);
 
 			/* Ensure that v_conn is in the new face's node */
 			if (!BLI_gset_haskey(n->bm_unique_verts, v_conn) &&
@@ -983,6 +1308,7 @@ static void pbvh_bmesh_collapse_edge(
 		}
 
 		/* Remove the face */
+		edge_queue_bm_lock(eq_ctx);
 		pbvh_bmesh_face_remove(bvh, f_del);
 		BM_face_kill(bvh->bm, f_del);
 
@@ -1000,33 +1326,36 @@ static void pbvh_bmesh_collapse_edge(
 				BM_vert_kill(bvh->bm, v_tri[j]);
 			}
 		}
+		edge_queue_bm_unlock(eq_ctx);
 	}
 
 	/* Move v_conn to the midpoint of v_conn and v_del (if v_conn still exists, it
 	 * may have been deleted above) */
 	if (!BLI_gset_haskey(deleted_verts, v_conn)) {
+		edge_queue_bm_lock(eq_ctx);
 		BM_log_vert_before_modified(bvh->bm_log, v_conn, eq_ctx->cd_vert_mask_offset);
+		edge_queue_bm_unlock(eq_ctx);
 		mid_v3_v3v3(v_conn->co, v_conn->co, v_del->co);
 	}
 
 	/* Delete v_del */
 	BLI_assert(BM_vert_face_count(v_del) == 0);
 	BLI_gset_insert(deleted_verts, v_del);
+	edge_queue_bm_lock(eq_ctx);
 	BM_log_vert_removed(bvh->bm_log, v_del, eq_ctx->cd_vert_mask_offset);
 	BM_vert_kill(bvh->bm, v_del);
+	edge_queue_bm_unlock(eq_ctx);
 }
 
 static bool pbvh_bmesh_collapse_short_edges(
         EdgeQueueContext *eq_ctx,
         PBVH *bvh,
+        GSet *deleted_verts,
         BLI_Buffer *deleted_faces)
 {
 	float min_len_squared = bvh->bm_min_edge_len * bvh->bm_min_edge_len;
-	GSet *deleted_verts;
 	bool any_collapsed = false;
 
-	deleted_verts = BLI_gset_ptr_new("deleted_verts");
-
 	while (!BLI_heap_is_empty(eq_ctx->q->heap)) {
 		BMVert **pair = BLI_heap_popmin(eq_ctx->q->heap);
 		BMVert *v1 = pair[0], *v2 = pair[1];
@@ -1060,6 +1389,12 @@ static bool pbvh_bmesh_collapse_short_edges(
 			continue;
 		}
 
+		/* Only collapse edges inside the node when updating nodes in parallel */
+		if (eq_ctx->node && !pbvh_bmesh_edge_collapse_in_node(eq_ctx, e)) {
+			edge_queue_defer(eq_ctx, e, len_squared_v3v3(v1->co, v2->co));
+			continue;
+		}
+
 		any_collapsed = true;
 
 		pbvh_bmesh_collapse_edge(bvh, e, v1, v2,
@@ -1067,11 +1402,159 @@ static bool pbvh_bmesh_collapse_short_edges(
 		                         deleted_faces, eq_ctx);
 	}
 
-	BLI_gset_free(deleted_verts, NULL);
-
 	return any_collapsed;
 }
 
+typedef struct TopologyUpdateData {
+	EdgeQueueContext *eq_ctx;
+	PBVH *bvh;
+	EdgeQueueNode *node_queues;
+	/* queues of the nodes in the current batch */
+	int *batch_queues;
+	bool use_long;
+} TopologyUpdateData;
+
+static void pbvh_bmesh_node_topology_task_cb(void *userdata, int i)
+{
+	TopologyUpdateData *data = userdata;
+	EdgeQueueNode *node_queue = &data->node_queues[data->batch_queues[i]];
+	EdgeQueueContext eq_ctx = *data->eq_ctx;
+
+	eq_ctx.q = &node_queue->q;
+	eq_ctx.pool = node_queue->pool;
+	eq_ctx.node = node_queue;
+
+	if (data->use_long) {
+		/* 2 is enough for edge faces - manifold edge */
+		BLI_buffer_declare_static(BMLoop *, edge_loops, BLI_BUFFER_NOP, 2);
+		pbvh_bmesh_subdivide_long_edges(&eq_ctx, data->bvh, &edge_loops);
+		BLI_buffer_free(&edge_loops);
+	}
+	else {
+		BLI_buffer_declare_static(BMFace *, deleted_faces, BLI_BUFFER_NOP, 32);
+		pbvh_bmesh_collapse_short_edges(&eq_ctx, data->bvh, node_queue->deleted_verts, &deleted_faces);
+		BLI_buffer_free(&deleted_faces);
+	}
+}
+
+/* Split or collapse the edges inside each node on the task scheduler.
+ *
+ * Edges whose split or collapse only changes the node they are queued in are handled there,
+ * nodes can be updated at the same time as long as they share no vertices.
+ * The nodes are sorted into batches of such nodes, one batch running after the other.
+ *
+ * The remaining edges are moved to the serial queue in 'eq_ctx', which then handles the
+ * node boundaries. Frees 'node_queues', returns true if any edges were queued. */
+static bool pbvh_bmesh_update_topology_nodes(
+        EdgeQueueContext *eq_ctx, PBVH *bvh,
+        EdgeQueueNode *node_queues, int totnode,
+        const bool use_long, GSet *deleted_verts)
+{
+	TopologyUpdateData data;
+	EdgeQueueContext node_eq_ctx = *eq_ctx;
+	SpinLock bm_lock;
+	BLI_bitmap *batch_used;
+	int *node_batch;
+	int totbatch = 0;
+	bool any_queued = false;
+	int n, b;
+
+	/* Give each node the first batch not used by a node it shares vertices with */
+	node_batch = MEM_mallocN(sizeof(*node_batch) * (size_t)totnode, __func__);
+	batch_used = BLI_BITMAP_NEW(totnode, __func__);
+
+	for (n = 0; n < totnode; n++) {
+		EdgeQueueNode *node_queue = &node_queues[n];
+		int m;
+
+		memset(batch_used, 0, BLI_BITMAP_SIZE(totnode));
+		for (m = 0; m < n; m++) {
+			if (BLI_BITMAP_TEST(node_queue->conflicts, m) ||
+			    BLI_BITMAP_TEST(node_queues[m].conflicts, n))
+			{
+				BLI_BITMAP_ENABLE(batch_used, node_batch[m]);
+			}
+		}
+		for (b = 0; BLI_BITMAP_TEST(batch_used, b); b++) {
+			/* pass */
+		}
+		node_batch[n] = b;
+		totbatch = max_ii(totbatch, b + 1);
+
+		node_queue->deferred = BLI_heap_new();
+		node_queue->deferred_edges = use_long ? BLI_gset_ptr_new("deferred_edges") : NULL;
+		node_queue->deleted_verts = use_long ? NULL : BLI_gset_ptr_new("deleted_verts");
+		any_queued |= !BLI_heap_is_empty(node_queue->q.heap);
+	}
+
+	MEM_freeN(batch_used);
+
+	BLI_spin_init(&bm_lock);
+	node_eq_ctx.bm_lock = &bm_lock;
+
+	data.eq_ctx = &node_eq_ctx;
+	data.bvh = bvh;
+	data.node_queues = node_queues;
+	data.batch_queues = MEM_mallocN(sizeof(*data.batch_queues) * (size_t)totnode, __func__);
+	data.use_long = use_long;
+
+	for (b = 0; b < totbatch; b++) {
+		int totbatch_queue = 0;
+
+		for (n = 0; n < totnode; n++) {
+			if (node_batch[n] == b) {
+				data.batch_queues[totbatch_queue++] = n;
+			}
+		}
+
+		BLI_task_parallel_range_ex(0, totbatch_queue, &data, pbvh_bmesh_node_topology_task_cb, 2, true);
+	}
+
+	BLI_spin_end(&bm_lock);
+	MEM_freeN(data.batch_queues);
+	MEM_freeN(node_batch);
+
+	/* Hand the deferred edges over to the serial queue, in node order */
+	for (n = 0; n < totnode; n++) {
+		EdgeQueueNode *node_queue = &node_queues[n];
+
+		BLI_assert(BLI_heap_is_empty(node_queue->q.heap));
+
+		while (!BLI_heap_is_empty(node_queue->deferred)) {
+			const float priority = BLI_heap_node_value(BLI_heap_top(node_queue->deferred));
+			BMVert **pair = BLI_heap_popmin(node_queue->deferred);
+			BMVert **pair_serial = BLI_mempool_alloc(eq_ctx->pool);
+
+			pair_serial[0] = pair[0];
+			pair_serial[1] = pair[1];
+			BLI_heap_insert(eq_ctx->q->heap, priority, pair_serial);
+		}
+
+		/* deferred edges may use vertices removed by later collapses in the node */
+		if (node_queue->deleted_verts) {
+			GSetIterator gs_iter;
+
+			GSET_ITER (gs_iter, node_queue->deleted_verts) {
+				BLI_gset_insert(deleted_verts, BLI_gsetIterator_getKey(&gs_iter));
+			}
+			BLI_gset_free(node_queue->deleted_verts, NULL);
+		}
+
+		if (node_queue->deferred_edges) {
+			BLI_gset_free(node_queue->deferred_edges, NULL);
+		}
+
+		BLI_heap_free(node_queue->q.heap, NULL);
+		BLI_heap_free(node_queue->deferred, NULL);
+		BLI_mempool_destroy(node_queue->pool);
+		MEM_freeN(node_queue->conflicts);
+	}
+
+	MEM_freeN(node_queues);
+
+	return any_queued;
+}
+
 /************************* Called from pbvh.c *************************/
 
 bool pbvh_bmesh_node_raycast(PBVHNode *node, const float ray_start[3],
@@ -1270,11 +1753,19 @@ bool BKE_pbvh_bmesh_update_topology(PBVH *bvh, PBVHTopologyUpdateMode mode,
 		EdgeQueue q;
 		BLI_mempool *queue_pool = BLI_mempool_create(sizeof(BMVert *[2]), 0, 128, BLI_MEMPOOL_NOP);
 		EdgeQueueContext eq_ctx = {&q, queue_pool, bvh->bm, cd_vert_mask_offset, cd_vert_node_offset, cd_face_node_offset};
+		GSet *deleted_verts = BLI_gset_ptr_new("deleted_verts");
+		EdgeQueueNode *node_queues;
+		int totnode_queue;
 
-		short_edge_queue_create(&eq_ctx, bvh, center, radius);
+		short_edge_queue_create(&eq_ctx, bvh, center, radius, &node_queues, &totnode_queue);
 		modified |= !BLI_heap_is_empty(q.heap);
-		pbvh_bmesh_collapse_short_edges(&eq_ctx, bvh,
+		if (node_queues) {
+			modified |= pbvh_bmesh_update_topology_nodes(&eq_ctx, bvh, node_queues, totnode_queue,
+			                                             false, deleted_verts);
+		}
+		pbvh_bmesh_collapse_short_edges(&eq_ctx, bvh, deleted_verts,
 		                                &deleted_faces);
+		BLI_gset_free(deleted_verts, NULL);
 		BLI_heap_free(q.heap, NULL);
 		BLI_mempool_destroy(queue_pool);
 	}
@@ -1283,9 +1774,15 @@ bool BKE_pbvh_bmesh_update_topology(PBVH *bvh, PBVHTopologyUpdateMode mode,
 		EdgeQueue q;
 		BLI_mempool *queue_pool = BLI_mempool_create(sizeof(BMVert *[2]), 0, 128, BLI_MEMPOOL_NOP);
 		EdgeQueueContext eq_ctx = {&q, queue_pool, bvh->bm, cd_vert_mask_offset, cd_vert_node_offset, cd_face_node_offset};
+		EdgeQueueNode *node_queues;
+		int totnode_queue;
 
-		long_edge_queue_create(&eq_ctx, bvh, center, radius);
+		long_edge_queue_create(&eq_ctx, bvh, center, radius, &node_queues, &totnode_queue);
 		modified |= !BLI_heap_is_empty(q.heap);
+		if (node_queues) {
+			modified |= pbvh_bmesh_update_topology_nodes(&eq_ctx, bvh, node_queues, totnode_queue,
+			                                             true, NULL);
+		}
 		pbvh_bmesh_subdivide_long_edges(&eq_ctx, bvh, &edge_loops);
 		BLI_heap_free(q.heap, NULL);
 		BLI_mempool_destroy(queue_pool);
@@ -1795,6 +1795,9 @@ void BKE_scene_update_for_newframe_ex(EvaluationContext *eval_ctx, Main *bmain,
 
 	scene_depsgraph_hack(eval_ctx, sce, sce);
 
+	if (G.debug & G_DEBUG_DEPSGRAPH)
+		BKE_animsys_rna_path_cache_print_stats();
+
 	/* notify editors and python about recalc */
 	BLI_callback_exec(bmain, &sce->id, BLI_CB_EVT_SCENE_UPDATE_POST);
 	BLI_callback_exec(bmain, &sce->id, BLI_CB_EVT_FRAME_CHANGE_POST);
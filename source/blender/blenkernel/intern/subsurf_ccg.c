@@ -142,8 +142,10 @@ static CCGSubSurf *_getSubSurf(CCGSubSurf *prevSS, int subdivLevels,
 
 		ccgSubSurf_getUseAgeCounts(prevSS, &oldUseAging, NULL, NULL, NULL);
 
+		/* arena allocated subsurfs never release elements removed by a sync, so they can't be reused */
 		if ((oldUseAging != useAging) ||
-		    (ccgSubSurf_getSimpleSubdiv(prevSS) != !!(flags & CCG_SIMPLE_SUBDIV)))
+		    (ccgSubSurf_getSimpleSubdiv(prevSS) != !!(flags & CCG_SIMPLE_SUBDIV)) ||
+		    (useArena || ccgSubSurf_getUseCustomAllocator(prevSS)))
 		{
 			ccgSubSurf_free(prevSS);
 		}
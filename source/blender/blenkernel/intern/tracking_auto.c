@@ -30,16 +30,20 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
 
 #include "MEM_guardedalloc.h"
 
 #include "DNA_movieclip_types.h"
 #include "DNA_object_types.h"   /* SELECT */
 
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_utildefines.h"
 #include "BLI_math.h"
 
+#include "PIL_time.h"
+
 #include "BKE_movieclip.h"
 #include "BKE_tracking.h"
 
@@ -61,6 +65,12 @@ typedef struct AutoTrackOptions {
 	 */
 	bool is_failed;
 	int failed_frame;
+
+	bool is_tracked;  /* Marker was tracked in the current step. */
+
+	/* Statistics, time spent tracking this marker. */
+	double track_time;
+	int num_tracked_frames;
 } AutoTrackOptions;
 
 typedef struct AutoTrackContext {
@@ -82,6 +92,16 @@ typedef struct AutoTrackContext {
 	int sync_frame;
 	bool first_sync;
 	SpinLock spin_lock;
+
+	/* Frames are read ahead in their own pool, so tracking steps don't wait
+	 * for them. NULL when there are no threads to overlap the reading with.
+	 */
+	TaskPool *prefetch_pool;
+	bool prefetch_pending;  /* Protected by spin_lock. */
+
+	/* Statistics, time spent in tracking steps. */
+	double step_time;
+	int num_steps;
 } AutoTrackContext;
 
 static void normalized_to_libmv_frame(const float normalized[2],
@@ -306,6 +326,11 @@ AutoTrackContext *BKE_autotrack_context_new(MovieClip *clip,
 
 	BLI_spin_init(&context->spin_lock);
 
+	if (BLI_task_scheduler_num_threads(BLI_task_scheduler_get()) > 1) {
+		context->prefetch_pool = BLI_task_pool_create(BLI_task_scheduler_get(),
+		                                              context);
+	}
+
 	context->image_accessor =
 		tracking_image_accessor_new(context->clips, 1, user->framenr);
 	context->autotrack =
@@ -367,69 +392,154 @@ AutoTrackContext *BKE_autotrack_context_new(MovieClip *clip,
 	return context;
 }
 
+static void autotrack_context_step_cb(TaskPool *pool,
+                                      void *taskdata,
+                                      int UNUSED(threadid))
+{
+	AutoTrackContext *context = BLI_task_pool_userdata(pool);
+	AutoTrackOptions *options = &context->options[GET_INT_FROM_POINTER(taskdata)];
+	const int frame_delta = context->backwards ? -1 : 1;
+	libmv_Marker libmv_current_marker,
+	             libmv_reference_marker,
+	             libmv_tracked_marker;
+	libmv_TrackRegionResult libmv_result;
+	double start_time = PIL_check_seconds_timer();
+	int frame = BKE_movieclip_remap_scene_to_clip_frame(
+		context->clips[options->clip_index],
+		context->user.framenr);
+	bool has_marker;
+
+	/* Markers of other tracks are added concurrently. */
+	BLI_spin_lock(&context->spin_lock);
+	has_marker = libmv_autoTrackGetMarker(context->autotrack,
+	                                      options->clip_index,
+	                                      frame,
+	                                      options->track_index,
+	                                      &libmv_current_marker);
+	BLI_spin_unlock(&context->spin_lock);
+
+	if (!has_marker) {
+		return;
+	}
+
+	if (!tracking_check_marker_margin(&libmv_current_marker,
+	                                  options->track->margin,
+	                                  context->frame_width,
+	                                  context->frame_height))
+	{
+		return;
+	}
+
+	libmv_tracked_marker = libmv_current_marker;
+	libmv_tracked_marker.frame = frame + frame_delta;
+
+	if (options->use_keyframe_match) {
+		libmv_tracked_marker.reference_frame =
+			libmv_current_marker.reference_frame;
+		BLI_spin_lock(&context->spin_lock);
+		libmv_autoTrackGetMarker(context->autotrack,
+		                         options->clip_index,
+		                         libmv_tracked_marker.reference_frame,
+		                         options->track_index,
+		                         &libmv_reference_marker);
+		BLI_spin_unlock(&context->spin_lock);
+	}
+	else {
+		libmv_tracked_marker.reference_frame = frame;
+		libmv_reference_marker = libmv_current_marker;
+	}
+
+	if (libmv_autoTrackMarker(context->autotrack,
+	                          &options->track_region_options,
+	                          &libmv_tracked_marker,
+	                          &libmv_result))
+	{
+		BLI_spin_lock(&context->spin_lock);
+		libmv_autoTrackAddMarker(context->autotrack,
+		                         &libmv_tracked_marker);
+		BLI_spin_unlock(&context->spin_lock);
+	}
+	else {
+		options->is_failed = true;
+		options->failed_frame = frame;
+	}
+	options->is_tracked = true;
+
+	options->track_time += PIL_check_seconds_timer() - start_time;
+	options->num_tracked_frames++;
+}
+
+static void autotrack_context_prefetch_cb(TaskPool *pool,
+                                          void *taskdata,
+                                          int UNUSED(threadid))
+{
+	AutoTrackContext *context = BLI_task_pool_userdata(pool);
+	int clip_index;
+
+	for (clip_index = 0; clip_index < context->num_clips; ++clip_index) {
+		int frame = BKE_movieclip_remap_scene_to_clip_frame(
+			context->clips[clip_index],
+			GET_INT_FROM_POINTER(taskdata));
+		tracking_image_accessor_prefetch(context->image_accessor,
+		                                 clip_index,
+		                                 frame);
+	}
+
+	BLI_spin_lock(&context->spin_lock);
+	context->prefetch_pending = false;
+	BLI_spin_unlock(&context->spin_lock);
+}
+
 bool BKE_autotrack_context_step(AutoTrackContext *context)
 {
 	int frame_delta = context->backwards ? -1 : 1;
+	double start_time = PIL_check_seconds_timer();
+	TaskScheduler *task_scheduler = BLI_task_scheduler_get();
+	TaskPool *task_pool;
 	bool ok = false;
 	int track;
 
-#pragma omp parallel for if(context->num_tracks > 1)
-	for (track = 0; track < context->num_tracks; ++track) {
-		AutoTrackOptions *options = &context->options[track];
-		libmv_Marker libmv_current_marker,
-		             libmv_reference_marker,
-		             libmv_tracked_marker;
-		libmv_TrackRegionResult libmv_result;
-		int frame = BKE_movieclip_remap_scene_to_clip_frame(
-			context->clips[options->clip_index],
-			context->user.framenr);
-
-		if (libmv_autoTrackGetMarker(context->autotrack,
-		                             options->clip_index,
-		                             frame,
-		                             options->track_index,
-		                             &libmv_current_marker))
-		{
-			if (!tracking_check_marker_margin(&libmv_current_marker,
-			                                  options->track->margin,
-			                                  context->frame_width,
-			                                  context->frame_height))
-			{
-				continue;
-			}
+	task_pool = BLI_task_pool_create(task_scheduler, context);
 
-			libmv_tracked_marker = libmv_current_marker;
-			libmv_tracked_marker.frame = frame + frame_delta;
+	/* Read the frame markers will be tracked to in the next step while
+	 * tracking this one, all markers are waiting for it otherwise.
+	 * Reading isn't waited for, a step only pushes a new frame once the
+	 * previous one is read so they don't pile up.
+	 */
+	if (context->prefetch_pool != NULL && context->num_tracks > 0) {
+		bool push;
+
+		BLI_spin_lock(&context->spin_lock);
+		push = !context->prefetch_pending;
+		context->prefetch_pending = true;
+		BLI_spin_unlock(&context->spin_lock);
+
+		if (push) {
+			BLI_task_pool_push(context->prefetch_pool,
+			                   autotrack_context_prefetch_cb,
+			                   SET_INT_IN_POINTER(context->user.framenr + 2 * frame_delta),
+			                   false,
+			                   TASK_PRIORITY_LOW);
+		}
+	}
 
-			if (options->use_keyframe_match) {
-				libmv_tracked_marker.reference_frame =
-					libmv_current_marker.reference_frame;
-				libmv_autoTrackGetMarker(context->autotrack,
-			                             options->clip_index,
-			                             libmv_tracked_marker.reference_frame,
-			                             options->track_index,
-			                             &libmv_reference_marker);
-			}
-			else {
-				libmv_tracked_marker.reference_frame = frame;
-				libmv_reference_marker = libmv_current_marker;
-			}
+	/* Markers are tracked independently from each other. */
+	for (track = 0; track < context->num_tracks; ++track) {
+		context->options[track].is_tracked = false;
+		BLI_task_pool_push(task_pool,
+		                   autotrack_context_step_cb,
+		                   SET_INT_IN_POINTER(track),
+		                   false,
+		                   TASK_PRIORITY_HIGH);
+	}
 
-			if (libmv_autoTrackMarker(context->autotrack,
-			                          &options->track_region_options,
-			                          &libmv_tracked_marker,
-			                          &libmv_result))
-			{
-				BLI_spin_lock(&context->spin_lock);
-				libmv_autoTrackAddMarker(context->autotrack,
-				                         &libmv_tracked_marker);
-				BLI_spin_unlock(&context->spin_lock);
-			}
-			else {
-				options->is_failed = true;
-				options->failed_frame = frame;
-			}
+	BLI_task_pool_work_and_wait(task_pool);
+	BLI_task_pool_free(task_pool);
+
+	for (track = 0; track < context->num_tracks; ++track) {
+		if (context->options[track].is_tracked) {
 			ok = true;
+			break;
 		}
 	}
 
@@ -437,6 +547,9 @@ bool BKE_autotrack_context_step(AutoTrackContext *context)
 	context->user.framenr += frame_delta;
 	BLI_spin_unlock(&context->spin_lock);
 
+	context->step_time += PIL_check_seconds_timer() - start_time;
+	context->num_steps++;
+
 	return ok;
 }
 
@@ -558,8 +671,55 @@ void BKE_autotrack_context_finish(AutoTrackContext *context)
 	}
 }
 
+void BKE_autotrack_context_print_stats(AutoTrackContext *context)
+{
+	AutoTrackOptions *slowest_options = NULL;
+	double slowest_time = 0.0;
+	int track;
+
+	if (context->num_steps == 0 || context->step_time <= 0.0) {
+		return;
+	}
+
+	printf("Tracked %d markers over %d frames in %.3f sec: %.2f frames/sec\n",
+	       context->num_tracks,
+	       context->num_steps,
+	       context->step_time,
+	       (double)context->num_steps / context->step_time);
+
+	for (track = 0; track < context->num_tracks; ++track) {
+		AutoTrackOptions *options = &context->options[track];
+		double time_per_frame;
+
+		if (options->num_tracked_frames == 0) {
+			continue;
+		}
+
+		time_per_frame = options->track_time / options->num_tracked_frames;
+		printf("  %-64s %4d frames, %8.3f ms/frame\n",
+		       options->track->name,
+		       options->num_tracked_frames,
+		       1000.0 * time_per_frame);
+
+		if (slowest_options == NULL || time_per_frame > slowest_time) {
+			slowest_options = options;
+			slowest_time = time_per_frame;
+		}
+	}
+
+	if (slowest_options != NULL) {
+		printf("Slowest marker: %s, %.3f ms/frame\n",
+		       slowest_options->track->name,
+		       1000.0 * slowest_time);
+	}
+}
+
 void BKE_autotrack_context_free(AutoTrackContext *context)
 {
+	if (context->prefetch_pool != NULL) {
+		BLI_task_pool_work_and_wait(context->prefetch_pool);
+		BLI_task_pool_free(context->prefetch_pool);
+	}
 	libmv_autoTrackDestroy(context->autotrack);
 	tracking_image_accessor_destroy(context->image_accessor);
 	MEM_freeN(context->options);
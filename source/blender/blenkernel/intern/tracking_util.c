@@ -583,11 +583,77 @@ static ImBuf *accessor_get_preprocessed_ibuf(TrackingImageAccessor *accessor,
 {
 	MovieClip *clip;
 	MovieClipUser user;
+	TrackingAccessorFrame *slot;
 	ImBuf *ibuf;
-	int scene_frame;
+	int scene_frame, i;
 
 	BLI_assert(clip_index < accessor->num_clips);
 
+	BLI_mutex_lock(&accessor->frames_lock);
+
+	accessor->frames_used++;
+
+	for (;;) {
+		TrackingAccessorFrame *found = NULL;
+
+		slot = NULL;
+		for (i = 0; i < MAX_ACCESSOR_FRAME; ++i) {
+			TrackingAccessorFrame *frame_slot = &accessor->frames[i];
+			if ((frame_slot->ibuf != NULL || frame_slot->is_loading) &&
+			    frame_slot->clip_index == clip_index &&
+			    frame_slot->frame == frame)
+			{
+				found = frame_slot;
+				break;
+			}
+
+			/* Replace least recently used frame if it's not in the cache,
+			 * frames which are being loaded can't be replaced.
+			 */
+			if (!frame_slot->is_loading &&
+			    (slot == NULL || frame_slot->last_used < slot->last_used))
+			{
+				slot = frame_slot;
+			}
+		}
+
+		if (found != NULL && found->is_loading) {
+			/* Another thread is reading this frame from the clip, wait for it
+			 * and look again, reading might have failed.
+			 */
+			BLI_condition_wait(&accessor->frames_cond, &accessor->frames_lock);
+			continue;
+		}
+
+		if (found != NULL) {
+			found->last_used = accessor->frames_used;
+			ibuf = found->ibuf;
+			IMB_refImBuf(ibuf);
+			BLI_mutex_unlock(&accessor->frames_lock);
+			return ibuf;
+		}
+
+		if (slot != NULL) {
+			break;
+		}
+
+		/* All the slots are being loaded. */
+		BLI_condition_wait(&accessor->frames_cond, &accessor->frames_lock);
+	}
+
+	/* Claim the slot, the frame is read from the clip without the lock so
+	 * other frames can be used meanwhile, only requests for this frame wait.
+	 */
+	if (slot->ibuf != NULL) {
+		IMB_freeImBuf(slot->ibuf);
+		slot->ibuf = NULL;
+	}
+	slot->clip_index = clip_index;
+	slot->frame = frame;
+	slot->is_loading = true;
+
+	BLI_mutex_unlock(&accessor->frames_lock);
+
 	clip = accessor->clips[clip_index];
 	scene_frame = BKE_movieclip_remap_clip_to_scene_frame(clip, frame);
 	BKE_movieclip_user_set_frame(&user, scene_frame);
@@ -595,6 +661,18 @@ static ImBuf *accessor_get_preprocessed_ibuf(TrackingImageAccessor *accessor,
 	user.render_flag = 0;
 	ibuf = BKE_movieclip_get_ibuf(clip, &user);
 
+	BLI_mutex_lock(&accessor->frames_lock);
+
+	if (ibuf != NULL) {
+		slot->ibuf = ibuf;
+		IMB_refImBuf(ibuf);
+	}
+	slot->last_used = accessor->frames_used;
+	slot->is_loading = false;
+	BLI_condition_notify_all(&accessor->frames_cond);
+
+	BLI_mutex_unlock(&accessor->frames_lock);
+
 	return ibuf;
 }
 
@@ -886,11 +964,38 @@ TrackingImageAccessor *tracking_image_accessor_new(MovieClip *clips[MAX_ACCESSOR
 		                       accessor_get_image_callback,
 		                       accessor_release_image_callback);
 
+	BLI_mutex_init(&accessor->frames_lock);
+	BLI_condition_init(&accessor->frames_cond);
+
 	return accessor;
 }
 
+/* Fetch the frame from the clip ahead of time, so markers tracked to it
+ * don't have to wait for the frame to be read.
+ */
+void tracking_image_accessor_prefetch(TrackingImageAccessor *accessor,
+                                      int clip_index,
+                                      int frame)
+{
+	ImBuf *ibuf = accessor_get_preprocessed_ibuf(accessor, clip_index, frame);
+
+	if (ibuf != NULL) {
+		IMB_freeImBuf(ibuf);
+	}
+}
+
 void tracking_image_accessor_destroy(TrackingImageAccessor *accessor)
 {
+	int i;
+
+	for (i = 0; i < MAX_ACCESSOR_FRAME; ++i) {
+		if (accessor->frames[i].ibuf != NULL) {
+			IMB_freeImBuf(accessor->frames[i].ibuf);
+		}
+	}
+	BLI_condition_end(&accessor->frames_cond);
+	BLI_mutex_end(&accessor->frames_lock);
+
 	IMB_moviecache_free(accessor->cache);
 	libmv_FrameAccessorDestroy(accessor->libmv_accessor);
 	MEM_freeN(accessor);
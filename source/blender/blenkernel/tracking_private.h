@@ -110,17 +110,41 @@ struct MovieTrackingMarker *tracking_get_keyframed_marker(
 struct libmv_FrameAccessor;
 
 #define MAX_ACCESSOR_CLIP 64
+/* Number of original frames kept by the accessor: current and next frame,
+ * reference frames of keyframe matching and the prefetched frame.
+ */
+#define MAX_ACCESSOR_FRAME 8
+
+typedef struct TrackingAccessorFrame {
+	int clip_index;
+	int frame;
+	unsigned int last_used;
+	struct ImBuf *ibuf;  /* NULL for an unused slot. */
+	bool is_loading;  /* Frame is being read from the clip, ibuf is NULL. */
+} TrackingAccessorFrame;
+
 typedef struct TrackingImageAccessor {
 	struct MovieCache *cache;
 	struct MovieClip *clips[MAX_ACCESSOR_CLIP];
 	int num_clips;
 	int start_frame;
 	struct libmv_FrameAccessor *libmv_accessor;
+
+	/* Original frames shared by all the markers tracked in parallel,
+	 * so every frame is only fetched from the clip once.
+	 */
+	TrackingAccessorFrame frames[MAX_ACCESSOR_FRAME];
+	unsigned int frames_used;
+	ThreadMutex frames_lock;
+	ThreadCondition frames_cond;  /* Signaled when a frame is done loading. */
 } TrackingImageAccessor;
 
 TrackingImageAccessor *tracking_image_accessor_new(MovieClip *clips[MAX_ACCESSOR_CLIP],
                                                    int num_clips,
                                                    int start_frame);
+void tracking_image_accessor_prefetch(TrackingImageAccessor *accessor,
+                                      int clip_index,
+                                      int frame);
 void tracking_image_accessor_destroy(TrackingImageAccessor *accessor);
 
 #endif  /* __TRACKING_PRIVATE_H__ */
@@ -0,0 +1,52 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software  Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_ARRAY_STORE_H__
+#define __BLI_ARRAY_STORE_H__
+
+/** \file BLI_array_store.h
+ *  \ingroup bli
+ *  \brief Efficient in-memory storage of multiple similar arrays.
+ */
+
+#include "BLI_compiler_attrs.h"
+
+typedef struct BArrayStore BArrayStore;
+typedef struct BArrayState BArrayState;
+
+BArrayStore *BLI_array_store_create(
+        unsigned int stride, unsigned int chunk_count) ATTR_WARN_UNUSED_RESULT;
+void BLI_array_store_destroy(BArrayStore *bs) ATTR_NONNULL();
+void BLI_array_store_clear(BArrayStore *bs) ATTR_NONNULL();
+
+size_t BLI_array_store_calc_size_expanded_get(const BArrayStore *bs) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+size_t BLI_array_store_calc_size_compacted_get(const BArrayStore *bs) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+
+BArrayState *BLI_array_store_state_add(
+        BArrayStore *bs, const void *data, const size_t data_len,
+        const BArrayState *state_reference) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL(1);
+void BLI_array_store_state_remove(BArrayStore *bs, BArrayState *state) ATTR_NONNULL();
+
+size_t BLI_array_store_state_size_get(const BArrayState *state) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+void   BLI_array_store_state_data_get(const BArrayState *state, void *data) ATTR_NONNULL();
+void  *BLI_array_store_state_data_get_alloc(
+        const BArrayState *state, size_t *r_data_len) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+
+#endif  /* __BLI_ARRAY_STORE_H__ */
@@ -78,6 +78,10 @@ typedef void (*BVHTree_NearestPointCallback)(void *userdata, int index, const fl
 /* callback must update hit in case it finds a nearest successful hit */
 typedef void (*BVHTree_RayCastCallback)(void *userdata, int index, const BVHTreeRay *ray, BVHTreeRayHit *hit);
 
+/* callback to filter overlapping pairs, return false to skip the pair,
+ * called from multiple threads, thread is the index of the caller's result buffer */
+typedef bool (*BVHTree_OverlapCallback)(void *userdata, int index_a, int index_b, int thread);
+
 /* callback to range search query */
 typedef void (*BVHTree_RangeQuery)(void *userdata, int index, float dist_sq);
 
@@ -94,6 +98,9 @@ void BLI_bvhtree_update_tree(BVHTree *tree);
 
 /* collision/overlap: check two trees if they overlap, alloc's *overlap with length of the int return value */
 BVHTreeOverlap *BLI_bvhtree_overlap(BVHTree *tree1, BVHTree *tree2, unsigned int *r_overlap_tot);
+BVHTreeOverlap *BLI_bvhtree_overlap_ex(BVHTree *tree1, BVHTree *tree2, unsigned int *r_overlap_tot,
+                                       BVHTree_OverlapCallback callback, void *userdata);
+int BLI_bvhtree_overlap_thread_num(const BVHTree *tree1, const BVHTree *tree2);
 
 float BLI_bvhtree_getepsilon(const BVHTree *tree);
 
@@ -105,6 +112,13 @@ int BLI_bvhtree_find_nearest(BVHTree *tree, const float co[3], BVHTreeNearest *n
 int BLI_bvhtree_ray_cast(BVHTree *tree, const float co[3], const float dir[3], float radius, BVHTreeRayHit *hit,
                          BVHTree_RayCastCallback callback, void *userdata);
 
+/* batched queries, threaded, callbacks must be thread-safe */
+void BLI_bvhtree_find_nearest_batch(BVHTree *tree, const float (*co)[3], BVHTreeNearest *nearest, int num,
+                                    BVHTree_NearestPointCallback callback, void *userdata);
+
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree, const BVHTreeRay *rays, BVHTreeRayHit *hits, int num,
+                                BVHTree_RayCastCallback callback, void *userdata);
+
 float BLI_bvhtree_bb_raycast(const float bv[6], const float light_start[3], const float light_end[3], float pos[3]);
 
 /* range query */
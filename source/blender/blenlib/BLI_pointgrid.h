@@ -0,0 +1,45 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software  Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_POINTGRID_H__
+#define __BLI_POINTGRID_H__
+
+/** \file BLI_pointgrid.h
+ *  \ingroup bli
+ *  \brief A uniform grid of points for fixed radius neighbor search.
+ */
+
+#include "BLI_compiler_attrs.h"
+
+typedef struct PointGrid PointGrid;
+
+/* same signature as BVHTree_RangeQuery, so callbacks can be shared */
+typedef void (*PointGrid_RangeQuery)(void *userdata, int index, float dist_sq);
+
+PointGrid *BLI_pointgrid_new(unsigned int maxsize) ATTR_WARN_UNUSED_RESULT;
+void BLI_pointgrid_free(PointGrid *grid);
+void BLI_pointgrid_insert(PointGrid *grid, int index, const float co[3]) ATTR_NONNULL();
+void BLI_pointgrid_balance(PointGrid *grid, float cell_size) ATTR_NONNULL();
+
+int BLI_pointgrid_range_query(
+        const PointGrid *grid, const float co[3], float radius,
+        PointGrid_RangeQuery callback, void *userdata) ATTR_NONNULL(1, 2, 4);
+
+#endif  /* __BLI_POINTGRID_H__ */
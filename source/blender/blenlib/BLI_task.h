@@ -113,6 +113,16 @@ void BLI_task_parallel_range(
         void *userdata,
         TaskParallelRangeFunc func);
 
+/* as above, also passing the id of the thread running the iteration (for per-thread data),
+ * ids range from zero to (but not including) #BLI_task_scheduler_num_threads. */
+typedef void (*TaskParallelRangeFuncThread)(void *userdata, int iter, int thread_id);
+void BLI_task_parallel_range_thread_ex(
+        int start, int stop,
+        void *userdata,
+        TaskParallelRangeFuncThread func,
+        const int range_threshold,
+        const bool use_dynamic_scheduling);
+
 #ifdef __cplusplus
 }
 #endif
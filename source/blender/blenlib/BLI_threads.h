@@ -41,8 +41,9 @@ extern "C" {
 #include <libkern/OSAtomic.h>
 #endif
 
-/* for tables, button in UI, etc */
-#define BLENDER_MAX_THREADS     64
+/* for tables, button in UI, etc, render nodes can have well over 64 cores.
+ * Keep it small, render per thread data is sized for the actual thread count */
+#define BLENDER_MAX_THREADS     256
 
 struct ListBase;
 struct TaskScheduler;
@@ -37,26 +37,23 @@
 #include "BLI_stack.h"
 #include "BLI_kdopbvh.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_strict_flags.h"
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
 /* used for iterative_raycast */
 // #define USE_SKIP_LINKS
 
 #define MAX_TREETYPE 32
 
-/* Setting zero so we can catch bugs in OpenMP/KDOPBVH.
+/* Number of leafs (or queries for the batched functions)
+ * under which everything is done from the calling thread.
+ * Setting zero in debug builds so we can catch threading bugs in KDOPBVH.
  * TODO(sergey): Deduplicate the limits with PBVH from BKE.
  */
-#ifdef _OPENMP
-#  ifdef DEBUG
-#    define KDOPBVH_OMP_LIMIT 0
-#  else
-#    define KDOPBVH_OMP_LIMIT 1024
-#  endif
+#ifdef DEBUG
+#  define KDOPBVH_THREAD_LEAFS_THRESHOLD 0
+#else
+#  define KDOPBVH_THREAD_LEAFS_THRESHOLD 1024
 #endif
 
 typedef unsigned char axis_t;
@@ -96,6 +93,11 @@ typedef struct BVHOverlapData {
 	BVHTree *tree1, *tree2; 
 	struct BLI_Stack *overlap;  /* store BVHTreeOverlap */
 	axis_t start_axis, stop_axis;
+
+	/* optional filter, only pairs it accepts are stored */
+	BVHTree_OverlapCallback callback;
+	void *userdata;
+	int thread;  /* index of this buffer, passed to the callback */
 } BVHOverlapData;
 
 typedef struct BVHNearestData {
@@ -644,7 +646,7 @@ static void build_implicit_tree_helper(BVHTree *tree, BVHBuildHelper *data)
 }
 
 // return the min index of all the leafs archivable with the given branch
-static int implicit_leafs_index(BVHBuildHelper *data, int depth, int child_index)
+static int implicit_leafs_index(const BVHBuildHelper *data, int depth, int child_index)
 {
 	int min_leaf_index = child_index * data->leafs_per_child[depth - 1];
 	if (min_leaf_index <= data->remain_leafs)
@@ -712,6 +714,81 @@ static void split_leafs(BVHNode **leafs_array, int *nth, int partitions, int spl
 	}
 }
 
+typedef struct BVHDivNodesData {
+	BVHTree *tree;
+	BVHNode *branches_array;
+	BVHNode **leafs_array;
+
+	int tree_type;
+	int tree_offset;
+
+	const BVHBuildHelper *data;
+
+	int depth;
+	int i;
+	int first_of_next_level;
+} BVHDivNodesData;
+
+static void non_recursive_bvh_div_nodes_task_cb(void *userdata, int j)
+{
+	const BVHDivNodesData *data = userdata;
+
+	int k;
+	const int parent_level_index = j - data->i;
+	BVHNode *parent = data->branches_array + j;
+	int nth_positions[MAX_TREETYPE + 1];
+	char split_axis;
+
+	int parent_leafs_begin = implicit_leafs_index(data->data, data->depth, parent_level_index);
+	int parent_leafs_end   = implicit_leafs_index(data->data, data->depth, parent_level_index + 1);
+
+	/* This calculates the bounding box of this branch
+	 * and chooses the largest axis as the axis to divide leafs */
+	refit_kdop_hull(data->tree, parent, parent_leafs_begin, parent_leafs_end);
+	split_axis = get_largest_axis(parent->bv);
+
+	/* Save split axis (this can be used on raytracing to speedup the query time) */
+	parent->main_axis = split_axis / 2;
+
+	/* Split the childs along the split_axis, note: its not needed to sort the whole leafs array
+	 * Only to assure that the elements are partitioned on a way that each child takes the elements
+	 * it would take in case the whole array was sorted.
+	 * Split_leafs takes care of that "sort" problem. */
+	nth_positions[0] = parent_leafs_begin;
+	nth_positions[data->tree_type] = parent_leafs_end;
+	for (k = 1; k < data->tree_type; k++) {
+		int child_index = j * data->tree_type + data->tree_offset + k;
+		int child_level_index = child_index - data->first_of_next_level; /* child level index */
+		nth_positions[k] = implicit_leafs_index(data->data, data->depth + 1, child_level_index);
+	}
+
+	split_leafs(data->leafs_array, nth_positions, data->tree_type, split_axis);
+
+	/* Setup children and totnode counters
+	 * Not really needed but currently most of BVH code relies on having an explicit children structure */
+	for (k = 0; k < data->tree_type; k++) {
+		int child_index = j * data->tree_type + data->tree_offset + k;
+		int child_level_index = child_index - data->first_of_next_level; /* child level index */
+
+		int child_leafs_begin = implicit_leafs_index(data->data, data->depth + 1, child_level_index);
+		int child_leafs_end   = implicit_leafs_index(data->data, data->depth + 1, child_level_index + 1);
+
+		if (child_leafs_end - child_leafs_begin > 1) {
+			parent->children[k] = data->branches_array + child_index;
+			parent->children[k]->parent = parent;
+		}
+		else if (child_leafs_end - child_leafs_begin == 1) {
+			parent->children[k] = data->leafs_array[child_leafs_begin];
+			parent->children[k]->parent = parent;
+		}
+		else {
+			break;
+		}
+
+		parent->totnode = (char)(k + 1);
+	}
+}
+
 /**
  * This functions builds an optimal implicit tree from the given leafs.
  * Where optimal stands for:
@@ -737,6 +814,7 @@ static void non_recursive_bvh_div_nodes(BVHTree *tree, BVHNode *branches_array,
 	const int num_branches = implicit_needed_branches(tree_type, num_leafs);
 
 	BVHBuildHelper data;
+	BVHDivNodesData cb_data;
 	int depth;
 	
 	/* set parent from root node to NULL */
@@ -759,71 +837,26 @@ static void non_recursive_bvh_div_nodes(BVHTree *tree, BVHNode *branches_array,
 
 	build_implicit_tree_helper(tree, &data);
 
+	cb_data.tree = tree;
+	cb_data.branches_array = branches_array;
+	cb_data.leafs_array = leafs_array;
+	cb_data.tree_type = tree_type;
+	cb_data.tree_offset = tree_offset;
+	cb_data.data = &data;
+
 	/* Loop tree levels (log N) loops */
 	for (i = 1, depth = 1; i <= num_branches; i = i * tree_type + tree_offset, depth++) {
 		const int first_of_next_level = i * tree_type + tree_offset;
 		const int end_j = min_ii(first_of_next_level, num_branches + 1);  /* index of last branch on this level */
-		int j;
 
 		/* Loop all branches on this level */
+		cb_data.first_of_next_level = first_of_next_level;
+		cb_data.i = i;
+		cb_data.depth = depth;
 
-#pragma omp parallel for private(j) schedule(static) if (num_leafs > KDOPBVH_OMP_LIMIT)
-		for (j = i; j < end_j; j++) {
-			int k;
-			const int parent_level_index = j - i;
-			BVHNode *parent = branches_array + j;
-			int nth_positions[MAX_TREETYPE + 1];
-			char split_axis;
-
-			int parent_leafs_begin = implicit_leafs_index(&data, depth, parent_level_index);
-			int parent_leafs_end   = implicit_leafs_index(&data, depth, parent_level_index + 1);
-
-			/* This calculates the bounding box of this branch
-			 * and chooses the largest axis as the axis to divide leafs */
-			refit_kdop_hull(tree, parent, parent_leafs_begin, parent_leafs_end);
-			split_axis = get_largest_axis(parent->bv);
-
-			/* Save split axis (this can be used on raytracing to speedup the query time) */
-			parent->main_axis = split_axis / 2;
-
-			/* Split the childs along the split_axis, note: its not needed to sort the whole leafs array
-			 * Only to assure that the elements are partitioned on a way that each child takes the elements
-			 * it would take in case the whole array was sorted.
-			 * Split_leafs takes care of that "sort" problem. */
-			nth_positions[0] = parent_leafs_begin;
-			nth_positions[tree_type] = parent_leafs_end;
-			for (k = 1; k < tree_type; k++) {
-				int child_index = j * tree_type + tree_offset + k;
-				int child_level_index = child_index - first_of_next_level; /* child level index */
-				nth_positions[k] = implicit_leafs_index(&data, depth + 1, child_level_index);
-			}
-
-			split_leafs(leafs_array, nth_positions, tree_type, split_axis);
-
-
-			/* Setup children and totnode counters
-			 * Not really needed but currently most of BVH code relies on having an explicit children structure */
-			for (k = 0; k < tree_type; k++) {
-				int child_index = j * tree_type + tree_offset + k;
-				int child_level_index = child_index - first_of_next_level; /* child level index */
-
-				int child_leafs_begin = implicit_leafs_index(&data, depth + 1, child_level_index);
-				int child_leafs_end   = implicit_leafs_index(&data, depth + 1, child_level_index + 1);
-
-				if (child_leafs_end - child_leafs_begin > 1) {
-					parent->children[k] = branches_array + child_index;
-					parent->children[k]->parent = parent;
-				}
-				else if (child_leafs_end - child_leafs_begin == 1) {
-					parent->children[k] = leafs_array[child_leafs_begin];
-					parent->children[k]->parent = parent;
-				}
-				else {
-					break;
-				}
-
-				parent->totnode = (char)(k + 1);
-			}
+		if (end_j > i) {
+			BLI_task_parallel_range_ex(i, end_j, &cb_data, non_recursive_bvh_div_nodes_task_cb,
+			                           num_leafs > KDOPBVH_THREAD_LEAFS_THRESHOLD ? 0 : end_j - i + 1, false);
 		}
 	}
 }
@@ -1064,6 +1097,12 @@ static void traverse(BVHOverlapData *data, BVHNode *node1, BVHNode *node2)
 					return;
 				}
 
+				if (data->callback &&
+				    !data->callback(data->userdata, node1->index, node2->index, data->thread))
+				{
+					return;
+				}
+
 				/* both leafs, insert overlap! */
 				overlap = BLI_stack_push_r(data->overlap);
 				overlap->indexA = node1->index;
@@ -1086,13 +1125,53 @@ static void traverse(BVHOverlapData *data, BVHNode *node1, BVHNode *node2)
 	return;
 }
 
-BVHTreeOverlap *BLI_bvhtree_overlap(BVHTree *tree1, BVHTree *tree2, unsigned int *r_overlap_tot)
+typedef struct BVHOverlapTaskData {
+	BVHOverlapData *data;
+	BVHNode *root1, *root2;
+	int root2_totnode;
+} BVHOverlapTaskData;
+
+/* each task traverses one pair of root children (one from each tree) into its own buffer */
+static void bvhtree_overlap_task_cb(void *userdata, int j)
+{
+	BVHOverlapTaskData *task_data = userdata;
+	BVHNode *node1 = task_data->root1->children[j / task_data->root2_totnode];
+	BVHNode *node2 = task_data->root2->children[j % task_data->root2_totnode];
+
+	traverse(&task_data->data[j], node1, node2);
+}
+
+/**
+ * Number of per-thread buffers #BLI_bvhtree_overlap_ex may use,
+ * the \a thread argument of its callback is always below this value.
+ */
+int BLI_bvhtree_overlap_thread_num(const BVHTree *tree1, const BVHTree *tree2)
+{
+	return tree1->tree_type * tree2->tree_type;
+}
+
+/**
+ * Find all pairs of overlapping leafs.
+ *
+ * The top levels of both trees are split across threads, each thread storing its results
+ * in its own buffer, buffers are merged at the end.
+ *
+ * \param callback Optional, called for every overlapping pair of leafs from the worker threads,
+ * only the pairs it returns true for are stored.
+ * This avoids building the list of all pairs when most of them are rejected anyway.
+ */
+BVHTreeOverlap *BLI_bvhtree_overlap_ex(BVHTree *tree1, BVHTree *tree2, unsigned int *r_overlap_tot,
+                                       BVHTree_OverlapCallback callback, void *userdata)
 {
 	int j;
 	size_t total = 0;
 	BVHTreeOverlap *overlap = NULL, *to = NULL;
-	BVHOverlapData **data;
-	
+	BVHOverlapData *data;
+	BVHOverlapTaskData task_data;
+	BVHNode *root1 = tree1->nodes[tree1->totleaf];
+	BVHNode *root2 = tree2->nodes[tree2->totleaf];
+	int root1_totnode, root2_totnode, data_num;
+
 	/* check for compatibility of both trees (can't compare 14-DOP with 18-DOP) */
 	if (UNLIKELY((tree1->axis != tree2->axis) &&
 	             (tree1->axis == 14 || tree2->axis == 14) &&
@@ -1103,52 +1182,64 @@ BVHTreeOverlap *BLI_bvhtree_overlap(BVHTree *tree1, BVHTree *tree2, unsigned int
 	}
 	
 	/* fast check root nodes for collision before doing big splitting + traversal */
-	if (!tree_overlap(tree1->nodes[tree1->totleaf], tree2->nodes[tree2->totleaf],
+	if (!tree_overlap(root1, root2,
 	                  min_axis(tree1->start_axis, tree2->start_axis),
 	                  min_axis(tree1->stop_axis, tree2->stop_axis)))
 	{
 		return NULL;
 	}
 
-	data = MEM_mallocN(sizeof(BVHOverlapData *) * tree1->tree_type, "BVHOverlapData_star");
+	root1_totnode = MIN2(tree1->tree_type, root1->totnode);
+	root2_totnode = MIN2(tree2->tree_type, root2->totnode);
+	data_num = root1_totnode * root2_totnode;
+
+	data = MEM_mallocN(sizeof(BVHOverlapData) * (size_t)data_num, "BVHOverlapData");
 	
-	for (j = 0; j < tree1->tree_type; j++) {
-		data[j] = MEM_mallocN(sizeof(BVHOverlapData), "BVHOverlapData");
-		
+	for (j = 0; j < data_num; j++) {
 		/* init BVHOverlapData */
-		data[j]->overlap = BLI_stack_new(sizeof(BVHTreeOverlap), __func__);
-		data[j]->tree1 = tree1;
-		data[j]->tree2 = tree2;
-		data[j]->start_axis = min_axis(tree1->start_axis, tree2->start_axis);
-		data[j]->stop_axis  = min_axis(tree1->stop_axis,  tree2->stop_axis);
+		data[j].overlap = BLI_stack_new(sizeof(BVHTreeOverlap), __func__);
+		data[j].tree1 = tree1;
+		data[j].tree2 = tree2;
+		data[j].start_axis = min_axis(tree1->start_axis, tree2->start_axis);
+		data[j].stop_axis  = min_axis(tree1->stop_axis,  tree2->stop_axis);
+		data[j].callback = callback;
+		data[j].userdata = userdata;
+		data[j].thread = j;
 	}
 
-#pragma omp parallel for private(j) schedule(static)  if (tree1->totleaf > KDOPBVH_OMP_LIMIT)
-	for (j = 0; j < MIN2(tree1->tree_type, tree1->nodes[tree1->totleaf]->totnode); j++) {
-		traverse(data[j], tree1->nodes[tree1->totleaf]->children[j], tree2->nodes[tree2->totleaf]);
+	task_data.data = data;
+	task_data.root1 = root1;
+	task_data.root2 = root2;
+	task_data.root2_totnode = root2_totnode;
+
+	if (data_num > 0) {
+		BLI_task_parallel_range_ex(0, data_num, &task_data, bvhtree_overlap_task_cb,
+		                           tree1->totleaf > KDOPBVH_THREAD_LEAFS_THRESHOLD ? 0 : data_num + 1, true);
 	}
 	
-	for (j = 0; j < tree1->tree_type; j++)
-		total += BLI_stack_count(data[j]->overlap);
+	for (j = 0; j < data_num; j++)
+		total += BLI_stack_count(data[j].overlap);
 	
 	to = overlap = MEM_mallocN(sizeof(BVHTreeOverlap) * total, "BVHTreeOverlap");
 	
-	for (j = 0; j < tree1->tree_type; j++) {
-		unsigned int count = (unsigned int)BLI_stack_count(data[j]->overlap);
-		BLI_stack_pop_n(data[j]->overlap, to, count);
-		BLI_stack_free(data[j]->overlap);
+	for (j = 0; j < data_num; j++) {
+		unsigned int count = (unsigned int)BLI_stack_count(data[j].overlap);
+		BLI_stack_pop_n(data[j].overlap, to, count);
+		BLI_stack_free(data[j].overlap);
 		to += count;
 	}
 	
-	for (j = 0; j < tree1->tree_type; j++) {
-		MEM_freeN(data[j]);
-	}
 	MEM_freeN(data);
 	
 	*r_overlap_tot = (unsigned int)total;
 	return overlap;
 }
 
+BVHTreeOverlap *BLI_bvhtree_overlap(BVHTree *tree1, BVHTree *tree2, unsigned int *r_overlap_tot)
+{
+	return BLI_bvhtree_overlap_ex(tree1, tree2, r_overlap_tot, NULL, NULL);
+}
+
 /* Determines the nearest point of the given node BV. Returns the squared distance to that point. */
 static float calc_nearest_point_squared(const float proj[3], BVHNode *node, float nearest[3])
 {
@@ -1548,6 +1639,96 @@ int BLI_bvhtree_ray_cast(BVHTree *tree, const float co[3], const float dir[3], f
 	return data.hit.index;
 }
 
+/**
+ * Batched queries - BLI_bvhtree_find_nearest_batch / BLI_bvhtree_ray_cast_batch
+ *
+ * Run many independent queries against the same tree from worker threads.
+ * Each query reads and writes only its own slot in the result array,
+ * so the given callback must be safe to call from multiple threads at once.
+ */
+
+typedef struct BVHNearestBatchData {
+	BVHTree *tree;
+	const float (*co)[3];
+	BVHTreeNearest *nearest;
+	BVHTree_NearestPointCallback callback;
+	void *userdata;
+} BVHNearestBatchData;
+
+static void bvhtree_find_nearest_batch_cb(void *userdata, int i)
+{
+	BVHNearestBatchData *data = userdata;
+
+	BLI_bvhtree_find_nearest(data->tree, data->co[i], &data->nearest[i], data->callback, data->userdata);
+}
+
+/**
+ * Find the nearest node for each of the \a co coordinates.
+ *
+ * \param nearest Array of \a num elements, each one initialized as for #BLI_bvhtree_find_nearest
+ * (index and dist_sq), results are written back in place.
+ */
+void BLI_bvhtree_find_nearest_batch(BVHTree *tree, const float (*co)[3], BVHTreeNearest *nearest, int num,
+                                    BVHTree_NearestPointCallback callback, void *userdata)
+{
+	BVHNearestBatchData data;
+
+	if (num <= 0) {
+		return;
+	}
+
+	data.tree = tree;
+	data.co = co;
+	data.nearest = nearest;
+	data.callback = callback;
+	data.userdata = userdata;
+
+	BLI_task_parallel_range_ex(0, num, &data, bvhtree_find_nearest_batch_cb,
+	                           KDOPBVH_THREAD_LEAFS_THRESHOLD, true);
+}
+
+typedef struct BVHRayCastBatchData {
+	BVHTree *tree;
+	const BVHTreeRay *rays;
+	BVHTreeRayHit *hits;
+	BVHTree_RayCastCallback callback;
+	void *userdata;
+} BVHRayCastBatchData;
+
+static void bvhtree_ray_cast_batch_cb(void *userdata, int i)
+{
+	BVHRayCastBatchData *data = userdata;
+	const BVHTreeRay *ray = &data->rays[i];
+
+	BLI_bvhtree_ray_cast(data->tree, ray->origin, ray->direction, ray->radius, &data->hits[i],
+	                     data->callback, data->userdata);
+}
+
+/**
+ * Cast each of the \a rays against the tree.
+ *
+ * \param hits Array of \a num elements, each one initialized as for #BLI_bvhtree_ray_cast
+ * (index and dist), results are written back in place.
+ */
+void BLI_bvhtree_ray_cast_batch(BVHTree *tree, const BVHTreeRay *rays, BVHTreeRayHit *hits, int num,
+                                BVHTree_RayCastCallback callback, void *userdata)
+{
+	BVHRayCastBatchData data;
+
+	if (num <= 0) {
+		return;
+	}
+
+	data.tree = tree;
+	data.rays = rays;
+	data.hits = hits;
+	data.callback = callback;
+	data.userdata = userdata;
+
+	BLI_task_parallel_range_ex(0, num, &data, bvhtree_ray_cast_batch_cb,
+	                           KDOPBVH_THREAD_LEAFS_THRESHOLD, true);
+}
+
 float BLI_bvhtree_bb_raycast(const float bv[6], const float light_start[3], const float light_end[3], float pos[3])
 {
 	BVHRayCastData data;
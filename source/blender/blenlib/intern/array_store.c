@@ -0,0 +1,436 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software  Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/array_store.c
+ *  \ingroup bli
+ *
+ * Stores multiple versions of an array, sharing memory between them.
+ *
+ * Each state is a list of chunks (runs of whole elements),
+ * chunks are reference counted and shared between states.
+ *
+ * When adding a state its data is matched against the chunks of a reference state
+ * (typically the previous version of the same array):
+ *
+ * - The chunk following the last match is tried first,
+ *   so unchanged data only costs a memcmp.
+ * - Otherwise the hash of the next few elements is looked up in a table of the reference chunks
+ *   leading elements, this finds chunks again after elements were inserted or removed before them.
+ *
+ * Data which doesn't match is copied into new chunks of (at most) the stores chunk size.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_listbase.h"
+#include "BLI_ghash.h"
+
+#include "BLI_array_store.h"  /* own include */
+
+#include "BLI_strict_flags.h"
+
+/* number of leading elements hashed, to find chunks at a new offset */
+#define BCHUNK_HASH_KEY_ELEMS 4
+
+typedef struct BChunk {
+	size_t data_len;
+	int users;
+	/* data follows */
+} BChunk;
+
+#define BCHUNK_DATA(chunk) ((unsigned char *)((chunk) + 1))
+
+struct BArrayState {
+	struct BArrayState *next, *prev;
+	BChunk **chunks;
+	unsigned int chunks_len;
+	size_t data_len;
+};
+
+struct BArrayStore {
+	size_t stride;
+	size_t chunk_byte_size;
+	ListBase states;
+	/* size of all chunks in use, shared chunks are counted once */
+	size_t size_compacted;
+};
+
+/* chunks of a state being built */
+typedef struct BChunkList {
+	BChunk **chunks;
+	unsigned int len, len_alloc;
+} BChunkList;
+
+/* reference chunks with the same hash key */
+typedef struct BTableRef {
+	struct BTableRef *next;
+	unsigned int index;
+} BTableRef;
+
+
+/* -------------------------------------------------------------------- */
+/* Chunks */
+
+static BChunk *bchunk_new(const unsigned char *data, const size_t data_len)
+{
+	BChunk *chunk = MEM_mallocN(sizeof(*chunk) + data_len, __func__);
+	chunk->data_len = data_len;
+	chunk->users = 0;
+	memcpy(BCHUNK_DATA(chunk), data, data_len);
+	return chunk;
+}
+
+static void bchunk_incref(BArrayStore *bs, BChunk *chunk)
+{
+	if (chunk->users++ == 0) {
+		bs->size_compacted += chunk->data_len;
+	}
+}
+
+static void bchunk_decref(BArrayStore *bs, BChunk *chunk)
+{
+	BLI_assert(chunk->users > 0);
+	if (--chunk->users == 0) {
+		bs->size_compacted -= chunk->data_len;
+		MEM_freeN(chunk);
+	}
+}
+
+static bool bchunk_data_compare(const BChunk *chunk, const unsigned char *data, const size_t data_len, const size_t offset)
+{
+	return ((offset + chunk->data_len <= data_len) &&
+	        (memcmp(BCHUNK_DATA(chunk), data + offset, chunk->data_len) == 0));
+}
+
+static void bchunk_list_append(BArrayStore *bs, BChunkList *clist, BChunk *chunk)
+{
+	if (clist->len == clist->len_alloc) {
+		clist->len_alloc = clist->len_alloc ? clist->len_alloc * 2 : 16;
+		clist->chunks = MEM_reallocN(clist->chunks, sizeof(*clist->chunks) * clist->len_alloc);
+	}
+	bchunk_incref(bs, chunk);
+	clist->chunks[clist->len++] = chunk;
+}
+
+/* copy data into new chunks, no larger than the stores chunk size */
+static void bchunk_list_append_data(BArrayStore *bs, BChunkList *clist, const unsigned char *data, size_t data_len)
+{
+	while (data_len != 0) {
+		const size_t len = MIN2(data_len, bs->chunk_byte_size);
+		bchunk_list_append(bs, clist, bchunk_new(data, len));
+		data += len;
+		data_len -= len;
+	}
+}
+
+
+/* -------------------------------------------------------------------- */
+/* Hashing */
+
+static unsigned int hash_data(const unsigned char *key, size_t n)
+{
+	unsigned int h = 5381;
+
+	while (n--) {
+		h = (h << 5) + h + *key++;
+	}
+
+	return h;
+}
+
+static unsigned int hash_key_from_elems(const unsigned int *elem_hash)
+{
+	unsigned int key = elem_hash[0];
+	int i;
+
+	for (i = 1; i < BCHUNK_HASH_KEY_ELEMS; i++) {
+		key = (key * 31u) + elem_hash[i];
+	}
+
+	return key;
+}
+
+static unsigned int hash_key_from_data(const BArrayStore *bs, const unsigned char *data)
+{
+	unsigned int elem_hash[BCHUNK_HASH_KEY_ELEMS];
+	int i;
+
+	for (i = 0; i < BCHUNK_HASH_KEY_ELEMS; i++) {
+		elem_hash[i] = hash_data(data, bs->stride);
+		data += bs->stride;
+	}
+
+	return hash_key_from_elems(elem_hash);
+}
+
+/* table of reference chunks by the hash of their leading elements */
+static GHash *bchunk_table_create(const BArrayStore *bs, const BArrayState *state_reference, BTableRef **r_table_refs)
+{
+	const size_t key_len = bs->stride * BCHUNK_HASH_KEY_ELEMS;
+	BTableRef *table_refs = MEM_mallocN(sizeof(*table_refs) * state_reference->chunks_len, __func__);
+	GHash *table = BLI_ghash_int_new_ex(__func__, state_reference->chunks_len);
+	unsigned int i;
+
+	for (i = 0; i < state_reference->chunks_len; i++) {
+		const BChunk *chunk = state_reference->chunks[i];
+
+		if (chunk->data_len >= key_len) {
+			const unsigned int key = hash_key_from_data(bs, BCHUNK_DATA(chunk));
+			BTableRef *tref = &table_refs[i];
+			void **val_p = BLI_ghash_lookup_p(table, SET_UINT_IN_POINTER(key));
+
+			tref->index = i;
+			if (val_p) {
+				tref->next = *val_p;
+				*val_p = tref;
+			}
+			else {
+				tref->next = NULL;
+				BLI_ghash_insert(table, SET_UINT_IN_POINTER(key), tref);
+			}
+		}
+	}
+
+	*r_table_refs = table_refs;
+	return table;
+}
+
+static void bchunk_list_fill_from_reference(
+        BArrayStore *bs, BChunkList *clist,
+        const unsigned char *data, const size_t data_len,
+        const BArrayState *state_reference)
+{
+	const size_t stride = bs->stride;
+	const size_t key_len = stride * BCHUNK_HASH_KEY_ELEMS;
+	GHash *table = NULL;
+	BTableRef *table_refs = NULL;
+	unsigned int *elem_hash = NULL;
+	/* reference chunk expected to match next */
+	unsigned int ref_index = 0;
+	/* start of data not yet added to a chunk */
+	size_t i_pending = 0;
+	size_t i = 0;
+
+	while (i < data_len) {
+		BChunk *chunk_match = NULL;
+
+		/* most data is unchanged, try the chunk following the last match first */
+		if (ref_index < state_reference->chunks_len) {
+			BChunk *chunk = state_reference->chunks[ref_index];
+			if (bchunk_data_compare(chunk, data, data_len, i)) {
+				chunk_match = chunk;
+				ref_index++;
+			}
+		}
+
+		if ((chunk_match == NULL) && (data_len - i >= key_len)) {
+			BTableRef *tref;
+			unsigned int key;
+
+			/* only needed once the data diverges from the reference */
+			if (table == NULL) {
+				const size_t elem_len = data_len / stride;
+				size_t j;
+
+				table = bchunk_table_create(bs, state_reference, &table_refs);
+				elem_hash = MEM_mallocN(sizeof(*elem_hash) * elem_len, __func__);
+				for (j = 0; j < elem_len; j++) {
+					elem_hash[j] = hash_data(data + (j * stride), stride);
+				}
+			}
+
+			key = hash_key_from_elems(&elem_hash[i / stride]);
+			for (tref = BLI_ghash_lookup(table, SET_UINT_IN_POINTER(key)); tref; tref = tref->next) {
+				BChunk *chunk = state_reference->chunks[tref->index];
+				if (bchunk_data_compare(chunk, data, data_len, i)) {
+					chunk_match = chunk;
+					ref_index = tref->index + 1;
+					break;
+				}
+			}
+		}
+
+		if (chunk_match) {
+			bchunk_list_append_data(bs, clist, data + i_pending, i - i_pending);
+			bchunk_list_append(bs, clist, chunk_match);
+			i += chunk_match->data_len;
+			i_pending = i;
+		}
+		else {
+			i += stride;
+			if (i - i_pending == bs->chunk_byte_size) {
+				bchunk_list_append_data(bs, clist, data + i_pending, i - i_pending);
+				i_pending = i;
+			}
+		}
+	}
+
+	bchunk_list_append_data(bs, clist, data + i_pending, data_len - i_pending);
+
+	if (table) {
+		BLI_ghash_free(table, NULL, NULL);
+		MEM_freeN(table_refs);
+		MEM_freeN(elem_hash);
+	}
+}
+
+
+/* -------------------------------------------------------------------- */
+/* Public API */
+
+/**
+ * \param stride: Size of each element in bytes, data is only shared in whole elements.
+ * \param chunk_count: Number of elements per chunk, smaller chunks share more data between states,
+ * at the cost of more overhead.
+ */
+BArrayStore *BLI_array_store_create(unsigned int stride, unsigned int chunk_count)
+{
+	BArrayStore *bs = MEM_callocN(sizeof(BArrayStore), __func__);
+
+	BLI_assert(stride > 0 && chunk_count > 0);
+
+	bs->stride = stride;
+	bs->chunk_byte_size = (size_t)stride * (size_t)chunk_count;
+
+	return bs;
+}
+
+void BLI_array_store_destroy(BArrayStore *bs)
+{
+	BLI_array_store_clear(bs);
+	MEM_freeN(bs);
+}
+
+void BLI_array_store_clear(BArrayStore *bs)
+{
+	while (bs->states.first) {
+		BLI_array_store_state_remove(bs, bs->states.first);
+	}
+	BLI_assert(bs->size_compacted == 0);
+}
+
+/**
+ * \return the total size of all states as if they were stored separately.
+ */
+size_t BLI_array_store_calc_size_expanded_get(const BArrayStore *bs)
+{
+	const BArrayState *state;
+	size_t size_total = 0;
+
+	for (state = bs->states.first; state; state = state->next) {
+		size_total += state->data_len;
+	}
+
+	return size_total;
+}
+
+/**
+ * \return the memory used by all states data.
+ */
+size_t BLI_array_store_calc_size_compacted_get(const BArrayStore *bs)
+{
+	return bs->size_compacted;
+}
+
+/**
+ * Add a new state, sharing memory with \a state_reference where the data matches.
+ *
+ * \param data: Data to store, \a data_len must be a multiple of the stores stride.
+ * \param state_reference: State to de-duplicate against, typically the previous version of the same array (may be NULL).
+ */
+BArrayState *BLI_array_store_state_add(
+        BArrayStore *bs, const void *data, const size_t data_len,
+        const BArrayState *state_reference)
+{
+	BArrayState *state = MEM_callocN(sizeof(BArrayState), __func__);
+	BChunkList clist = {NULL};
+
+	BLI_assert(data_len % bs->stride == 0);
+
+	if (data_len != 0) {
+		if (state_reference && state_reference->chunks_len) {
+			bchunk_list_fill_from_reference(bs, &clist, data, data_len, state_reference);
+		}
+		else {
+			bchunk_list_append_data(bs, &clist, data, data_len);
+		}
+	}
+
+	state->chunks = clist.chunks;
+	state->chunks_len = clist.len;
+	state->data_len = data_len;
+
+	BLI_addtail(&bs->states, state);
+
+	return state;
+}
+
+void BLI_array_store_state_remove(BArrayStore *bs, BArrayState *state)
+{
+	unsigned int i;
+
+	for (i = 0; i < state->chunks_len; i++) {
+		bchunk_decref(bs, state->chunks[i]);
+	}
+
+	if (state->chunks) {
+		MEM_freeN(state->chunks);
+	}
+
+	BLI_remlink(&bs->states, state);
+	MEM_freeN(state);
+}
+
+size_t BLI_array_store_state_size_get(const BArrayState *state)
+{
+	return state->data_len;
+}
+
+/**
+ * Fill in existing allocated memory with the contents of \a state.
+ */
+void BLI_array_store_state_data_get(const BArrayState *state, void *data)
+{
+	unsigned char *data_step = data;
+	unsigned int i;
+
+	for (i = 0; i < state->chunks_len; i++) {
+		const BChunk *chunk = state->chunks[i];
+		memcpy(data_step, BCHUNK_DATA(chunk), chunk->data_len);
+		data_step += chunk->data_len;
+	}
+
+	BLI_assert((size_t)(data_step - (unsigned char *)data) == state->data_len);
+}
+
+/**
+ * Allocate an array for \a state and return it.
+ */
+void *BLI_array_store_state_data_get_alloc(const BArrayState *state, size_t *r_data_len)
+{
+	void *data = MEM_mallocN(state->data_len, __func__);
+	BLI_array_store_state_data_get(state, data);
+	*r_data_len = state->data_len;
+	return data;
+}
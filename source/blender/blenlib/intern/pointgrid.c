@@ -0,0 +1,360 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software  Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/pointgrid.c
+ *  \ingroup bli
+ *
+ * Uniform grid (cell list) for fixed radius neighbor search.
+ *
+ * Points are sorted into cells spanning their bounds with a counting sort,
+ * so each cell is a contiguous run of points. A range query only visits the cells overlapping the
+ * query sphere, when the cell size is close to the query radius this is a constant number of cells
+ * and building the grid is linear in the number of points (unlike a BVH).
+ *
+ * The counting sort runs on the task scheduler for large point counts,
+ * points within a cell are sorted by index afterwards so the result doesn't depend on threading.
+ */
+
+#include <stdlib.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_math.h"
+#include "BLI_task.h"
+#include "BLI_utildefines.h"
+#include "BLI_pointgrid.h"
+
+#include "atomic_ops.h"
+
+#include "BLI_strict_flags.h"
+
+/* limit the number of cells relative to the number of points,
+ * sparse points spread over a large area use bigger cells instead */
+#define POINTGRID_CELLS_PER_POINT 2
+/* points (or cells) handled by one task */
+#define POINTGRID_TASK_BLOCK 1024
+/* use threads only when there are at least this many blocks */
+#define POINTGRID_TASK_BLOCKS_MIN 8
+
+typedef struct PointGridNode {
+	float co[3];
+	int index;
+} PointGridNode;
+
+struct PointGrid {
+	PointGridNode *nodes;
+	unsigned int totnode, maxsize;
+
+	/* offset of the first node of each cell, with one extra item for the end of the last cell */
+	unsigned int *cells;
+	unsigned int cells_num;
+	int dims[3];
+	float min[3];
+	float cell_size_inv;
+#ifdef DEBUG
+	bool is_balanced;  /* ensure we call balance first */
+#endif
+};
+
+PointGrid *BLI_pointgrid_new(unsigned int maxsize)
+{
+	PointGrid *grid = MEM_callocN(sizeof(PointGrid), "PointGrid");
+
+	grid->nodes = MEM_mallocN(sizeof(PointGridNode) * MAX2(maxsize, 1u), "PointGridNode");
+	grid->maxsize = maxsize;
+
+	return grid;
+}
+
+void BLI_pointgrid_free(PointGrid *grid)
+{
+	if (grid) {
+		MEM_freeN(grid->nodes);
+		MEM_SAFE_FREE(grid->cells);
+		MEM_freeN(grid);
+	}
+}
+
+void BLI_pointgrid_insert(PointGrid *grid, int index, const float co[3])
+{
+	PointGridNode *node;
+
+	BLI_assert(grid->totnode < grid->maxsize);
+
+	node = &grid->nodes[grid->totnode++];
+	copy_v3_v3(node->co, co);
+	node->index = index;
+
+#ifdef DEBUG
+	grid->is_balanced = false;
+#endif
+}
+
+/* -------------------------------------------------------------------- */
+/* Balance */
+
+/* cell coordinate along one axis, clamped to the grid */
+BLI_INLINE int pointgrid_cell_axis(const PointGrid *grid, const float co, const int axis)
+{
+	const float f = (co - grid->min[axis]) * grid->cell_size_inv;
+
+	/* clamp before casting, far away points would overflow */
+	if (f <= 0.0f) {
+		return 0;
+	}
+	else if (f >= (float)(grid->dims[axis] - 1)) {
+		return grid->dims[axis] - 1;
+	}
+	else {
+		return (int)f;
+	}
+}
+
+BLI_INLINE unsigned int pointgrid_cell_index(const PointGrid *grid, const int x, const int y, const int z)
+{
+	return (unsigned int)(x + grid->dims[0] * (y + grid->dims[1] * z));
+}
+
+static void pointgrid_dims_init(PointGrid *grid, const float min[3], const float max[3], float cell_size)
+{
+	const double cells_max = (double)MAX2(grid->totnode * POINTGRID_CELLS_PER_POINT, 1u);
+	float extent[3];
+	double cells_num;
+	int i;
+
+	sub_v3_v3v3(extent, max, min);
+
+	if (!(cell_size > 0.0f)) {
+		cell_size = max_ff(max_fff(extent[0], extent[1], extent[2]), FLT_EPSILON);
+	}
+
+	/* grow the cells until their number is within limits */
+	while (true) {
+		cells_num = 1.0;
+		for (i = 0; i < 3; i++) {
+			cells_num *= floor((double)(extent[i] / cell_size)) + 1.0;
+		}
+		if (cells_num <= cells_max) {
+			break;
+		}
+		cell_size *= max_ff(cbrtf((float)(cells_num / cells_max)), 1.01f);
+	}
+
+	copy_v3_v3(grid->min, min);
+	grid->cell_size_inv = 1.0f / cell_size;
+	for (i = 0; i < 3; i++) {
+		grid->dims[i] = (int)(extent[i] * grid->cell_size_inv) + 1;
+	}
+	grid->cells_num = (unsigned int)(grid->dims[0] * grid->dims[1] * grid->dims[2]);
+}
+
+typedef struct PointGridBalanceData {
+	PointGrid *grid;
+	PointGridNode *nodes_sorted;
+	unsigned int *node_cells;
+	unsigned int *cells_fill;
+} PointGridBalanceData;
+
+static void pointgrid_count_task_cb(void *userdata, int block)
+{
+	PointGridBalanceData *data = userdata;
+	PointGrid *grid = data->grid;
+	const unsigned int start = (unsigned int)block * POINTGRID_TASK_BLOCK;
+	const unsigned int end = MIN2(start + POINTGRID_TASK_BLOCK, grid->totnode);
+	unsigned int i;
+
+	for (i = start; i < end; i++) {
+		const float *co = grid->nodes[i].co;
+		const unsigned int cell = pointgrid_cell_index(
+		        grid,
+		        pointgrid_cell_axis(grid, co[0], 0),
+		        pointgrid_cell_axis(grid, co[1], 1),
+		        pointgrid_cell_axis(grid, co[2], 2));
+
+		data->node_cells[i] = cell;
+		atomic_add_uint32(&grid->cells[cell], 1);
+	}
+}
+
+static void pointgrid_scatter_task_cb(void *userdata, int block)
+{
+	PointGridBalanceData *data = userdata;
+	PointGrid *grid = data->grid;
+	const unsigned int start = (unsigned int)block * POINTGRID_TASK_BLOCK;
+	const unsigned int end = MIN2(start + POINTGRID_TASK_BLOCK, grid->totnode);
+	unsigned int i;
+
+	for (i = start; i < end; i++) {
+		const unsigned int slot = atomic_add_uint32(&data->cells_fill[data->node_cells[i]], 1) - 1;
+		data->nodes_sorted[slot] = grid->nodes[i];
+	}
+}
+
+static int pointgrid_node_cmp_index(const void *a, const void *b)
+{
+	const PointGridNode *node_a = a, *node_b = b;
+
+	if      (node_a->index < node_b->index) return -1;
+	else if (node_a->index > node_b->index) return  1;
+	else                                    return  0;
+}
+
+static void pointgrid_cell_sort_task_cb(void *userdata, int block)
+{
+	PointGridBalanceData *data = userdata;
+	PointGrid *grid = data->grid;
+	const unsigned int start = (unsigned int)block * POINTGRID_TASK_BLOCK;
+	const unsigned int end = MIN2(start + POINTGRID_TASK_BLOCK, grid->cells_num);
+	unsigned int i;
+
+	for (i = start; i < end; i++) {
+		const unsigned int cell_totnode = grid->cells[i + 1] - grid->cells[i];
+
+		if (cell_totnode > 1) {
+			qsort(&grid->nodes[grid->cells[i]], cell_totnode, sizeof(PointGridNode), pointgrid_node_cmp_index);
+		}
+	}
+}
+
+static void pointgrid_parallel_blocks(
+        PointGridBalanceData *data, unsigned int items_num, TaskParallelRangeFunc func)
+{
+	const int blocks_num = (int)((items_num + POINTGRID_TASK_BLOCK - 1) / POINTGRID_TASK_BLOCK);
+
+	if (blocks_num > 0) {
+		BLI_task_parallel_range_ex(0, blocks_num, data, func, POINTGRID_TASK_BLOCKS_MIN, false);
+	}
+}
+
+/**
+ * Sort the inserted points into cells of (at least) \a cell_size,
+ * typically the radius used for range queries.
+ */
+void BLI_pointgrid_balance(PointGrid *grid, float cell_size)
+{
+	PointGridBalanceData data;
+	float min[3], max[3];
+	unsigned int i, offset;
+
+	INIT_MINMAX(min, max);
+	for (i = 0; i < grid->totnode; i++) {
+		minmax_v3v3_v3(min, max, grid->nodes[i].co);
+	}
+	if (grid->totnode == 0) {
+		zero_v3(min);
+		zero_v3(max);
+	}
+
+	pointgrid_dims_init(grid, min, max, cell_size);
+
+	MEM_SAFE_FREE(grid->cells);
+	grid->cells = MEM_callocN(sizeof(*grid->cells) * (grid->cells_num + 1), __func__);
+
+	data.grid = grid;
+	data.nodes_sorted = MEM_mallocN(sizeof(PointGridNode) * MAX2(grid->maxsize, 1u), __func__);
+	data.node_cells = MEM_mallocN(sizeof(*data.node_cells) * MAX2(grid->totnode, 1u), __func__);
+	data.cells_fill = MEM_mallocN(sizeof(*data.cells_fill) * grid->cells_num, __func__);
+
+	/* count the points of each cell */
+	pointgrid_parallel_blocks(&data, grid->totnode, pointgrid_count_task_cb);
+
+	/* turn counts into offsets */
+	for (i = 0, offset = 0; i < grid->cells_num; i++) {
+		const unsigned int count = grid->cells[i];
+		grid->cells[i] = offset;
+		data.cells_fill[i] = offset;
+		offset += count;
+	}
+	grid->cells[grid->cells_num] = offset;
+
+	/* move the points to their cells */
+	pointgrid_parallel_blocks(&data, grid->totnode, pointgrid_scatter_task_cb);
+
+	MEM_freeN(grid->nodes);
+	grid->nodes = data.nodes_sorted;
+
+	/* order within the cells depends on threading, make it deterministic */
+	pointgrid_parallel_blocks(&data, grid->cells_num, pointgrid_cell_sort_task_cb);
+
+	MEM_freeN(data.node_cells);
+	MEM_freeN(data.cells_fill);
+
+#ifdef DEBUG
+	grid->is_balanced = true;
+#endif
+}
+
+/* -------------------------------------------------------------------- */
+/* Range Query */
+
+/**
+ * Calls \a callback for all points closer than \a radius to \a co,
+ * returns the number of points found.
+ */
+int BLI_pointgrid_range_query(
+        const PointGrid *grid, const float co[3], float radius,
+        PointGrid_RangeQuery callback, void *userdata)
+{
+	const float radius_sq = radius * radius;
+	int cell_min[3], cell_max[3];
+	int y, z, i;
+	int hits = 0;
+
+#ifdef DEBUG
+	BLI_assert(grid->is_balanced == true);
+#endif
+
+	if (grid->totnode == 0) {
+		return 0;
+	}
+
+	for (i = 0; i < 3; i++) {
+		/* query doesn't overlap the grid */
+		if (co[i] + radius < grid->min[i] ||
+		    co[i] - radius > grid->min[i] + (float)grid->dims[i] / grid->cell_size_inv)
+		{
+			return 0;
+		}
+		cell_min[i] = pointgrid_cell_axis(grid, co[i] - radius, i);
+		cell_max[i] = pointgrid_cell_axis(grid, co[i] + radius, i);
+	}
+
+	for (z = cell_min[2]; z <= cell_max[2]; z++) {
+		for (y = cell_min[1]; y <= cell_max[1]; y++) {
+			const unsigned int row = pointgrid_cell_index(grid, 0, y, z);
+			/* cells of a row are contiguous */
+			const unsigned int start = grid->cells[row + (unsigned int)cell_min[0]];
+			const unsigned int end = grid->cells[row + (unsigned int)cell_max[0] + 1];
+			unsigned int j;
+
+			for (j = start; j < end; j++) {
+				const PointGridNode *node = &grid->nodes[j];
+				const float dist_sq = len_squared_v3v3(co, node->co);
+
+				if (dist_sq < radius_sq) {
+					callback(userdata, node->index, dist_sq);
+					hits++;
+				}
+			}
+		}
+	}
+
+	return hits;
+}
@@ -451,6 +451,7 @@ typedef struct ParallelRangeState {
 	int start, stop;
 	void *userdata;
 	TaskParallelRangeFunc func;
+	TaskParallelRangeFuncThread func_thread;
 
 	int iter;
 	int chunk_size;
@@ -478,22 +479,30 @@ BLI_INLINE bool parallel_range_next_iter_get(
 static void parallel_range_func(
         TaskPool * __restrict pool,
         void *UNUSED(taskdata),
-        int UNUSED(threadid))
+        int threadid)
 {
 	ParallelRangeState * __restrict state = BLI_task_pool_userdata(pool);
 	int iter, count;
 	while (parallel_range_next_iter_get(state, &iter, &count)) {
 		int i;
-		for (i = 0; i < count; ++i) {
-			state->func(state->userdata, iter + i);
+		if (state->func_thread) {
+			for (i = 0; i < count; ++i) {
+				state->func_thread(state->userdata, iter + i, threadid);
+			}
+		}
+		else {
+			for (i = 0; i < count; ++i) {
+				state->func(state->userdata, iter + i);
+			}
 		}
 	}
 }
 
-void BLI_task_parallel_range_ex(
+static void task_parallel_range_ex(
         int start, int stop,
         void *userdata,
         TaskParallelRangeFunc func,
+        TaskParallelRangeFuncThread func_thread,
         const int range_threshold,
         const bool use_dynamic_scheduling)
 {
@@ -508,8 +517,15 @@ void BLI_task_parallel_range_ex(
 	 * do everything from the main thread.
 	 */
 	if (stop - start < range_threshold) {
-		for (i = start; i < stop; ++i) {
-			func(userdata, i);
+		if (func_thread) {
+			for (i = start; i < stop; ++i) {
+				func_thread(userdata, i, 0);
+			}
+		}
+		else {
+			for (i = start; i < stop; ++i) {
+				func(userdata, i);
+			}
 		}
 		return;
 	}
@@ -529,12 +545,13 @@ void BLI_task_parallel_range_ex(
 	state.stop = stop;
 	state.userdata = userdata;
 	state.func = func;
+	state.func_thread = func_thread;
 	state.iter = start;
 	if (use_dynamic_scheduling) {
 		state.chunk_size = 32;
 	}
 	else {
-		state.chunk_size = (stop - start) / (num_tasks);
+		state.chunk_size = max_ii(1, (stop - start) / (num_tasks));
 	}
 
 	for (i = 0; i < num_tasks; i++) {
@@ -550,6 +567,26 @@ void BLI_task_parallel_range_ex(
 	BLI_spin_end(&state.lock);
 }
 
+void BLI_task_parallel_range_ex(
+        int start, int stop,
+        void *userdata,
+        TaskParallelRangeFunc func,
+        const int range_threshold,
+        const bool use_dynamic_scheduling)
+{
+	task_parallel_range_ex(start, stop, userdata, func, NULL, range_threshold, use_dynamic_scheduling);
+}
+
+void BLI_task_parallel_range_thread_ex(
+        int start, int stop,
+        void *userdata,
+        TaskParallelRangeFuncThread func,
+        const int range_threshold,
+        const bool use_dynamic_scheduling)
+{
+	task_parallel_range_ex(start, stop, userdata, NULL, func, range_threshold, use_dynamic_scheduling);
+}
+
 void BLI_task_parallel_range(
         int start, int stop,
         void *userdata,
@@ -2112,6 +2112,9 @@ static void direct_link_fcurves(FileData *fd, ListBase *list)
 		/* group */
 		fcu->grp = newdataadr(fd, fcu->grp);
 		
+		/* baked samples are rebuilt on playback */
+		fcu->sample_table = NULL;
+		
 		/* clear disabled flag - allows disabled drivers to be tried again ([#32155]),
 		 * but also means that another method for "reviving disabled F-Curves" exists
 		 */
@@ -2125,6 +2128,7 @@ static void direct_link_fcurves(FileData *fd, ListBase *list)
 			
 			/* compiled expression data will need to be regenerated (old pointer may still be set here) */
 			driver->expr_comp = NULL;
+			driver->rna_cache = NULL;
 			
 			/* give the driver a fresh chance - the operating environment may be different now 
 			 * (addons, etc. may be different) so the driver namespace may be sane now [#32155]
@@ -2331,6 +2335,9 @@ static void direct_link_animdata(FileData *fd, AnimData *adt)
 	if (adt == NULL)
 		return;
 	
+	/* runtime */
+	adt->rna_cache = NULL;
+	
 	/* link drivers */
 	link_list(fd, &adt->drivers);
 	direct_link_fcurves(fd, &adt->drivers);
@@ -4587,6 +4594,7 @@ static void direct_link_pose(FileData *fd, bPose *pose)
 		CLAMP(pchan->rotmode, ROT_MODE_MIN, ROT_MODE_MAX);
 	}
 	pose->ikdata = NULL;
+	pose->eval_graph = NULL;
 	if (pose->ikparam != NULL) {
 		pose->ikparam = newdataadr(fd, pose->ikparam);
 	}
@@ -34,6 +34,7 @@
 #include "BLI_linklist_stack.h"
 #include "BLI_listbase.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BKE_cdderivedmesh.h"
@@ -274,91 +275,137 @@ void BM_mesh_free(BMesh *bm)
 
 /**
  * Helpers for #BM_mesh_normals_update and #BM_verts_calc_normal_vcos
+ *
+ * Each phase runs over the element tables on the task scheduler,
+ * vertex normals gather the weighted normals of their faces so no two threads write the same vertex.
  */
+typedef struct BMVertsCalcNormalsData {
+	BMesh *bm;
+	float (*edgevec)[3];
+	const float (*fnos)[3];
+	const float (*vcos)[3];
+	float (*vnos)[3];
+} BMVertsCalcNormalsData;
+
+static void bm_mesh_edges_calc_vectors_task_cb(void *userdata, int index)
+{
+	BMVertsCalcNormalsData *data = userdata;
+	BMEdge *e = data->bm->etable[index];
+
+	BM_elem_index_set(e, index); /* set_inline */
+
+	if (e->l) {
+		const float *v1_co = data->vcos ? data->vcos[BM_elem_index_get(e->v1)] : e->v1->co;
+		const float *v2_co = data->vcos ? data->vcos[BM_elem_index_get(e->v2)] : e->v2->co;
+		sub_v3_v3v3(data->edgevec[index], v2_co, v1_co);
+		normalize_v3(data->edgevec[index]);
+	}
+	else {
+		/* the edge vector will not be needed when the edge has no radial */
+	}
+}
+
 static void bm_mesh_edges_calc_vectors(BMesh *bm, float (*edgevec)[3], const float (*vcos)[3])
 {
-	BMIter eiter;
-	BMEdge *e;
-	int index;
+	BMVertsCalcNormalsData data = {NULL};
 
 	if (vcos) {
 		BM_mesh_elem_index_ensure(bm, BM_VERT);
 	}
 
-	BM_ITER_MESH_INDEX (e, &eiter, bm, BM_EDGES_OF_MESH, index) {
-		BM_elem_index_set(e, index); /* set_inline */
+	data.bm = bm;
+	data.edgevec = edgevec;
+	data.vcos = vcos;
 
-		if (e->l) {
-			const float *v1_co = vcos ? vcos[BM_elem_index_get(e->v1)] : e->v1->co;
-			const float *v2_co = vcos ? vcos[BM_elem_index_get(e->v2)] : e->v2->co;
-			sub_v3_v3v3(edgevec[index], v2_co, v1_co);
-			normalize_v3(edgevec[index]);
-		}
-		else {
-			/* the edge vector will not be needed when the edge has no radial */
-		}
+	if (bm->totedge) {
+		BLI_task_parallel_range_ex(0, bm->totedge, &data, bm_mesh_edges_calc_vectors_task_cb, BM_OMP_LIMIT, false);
 	}
 	bm->elem_index_dirty &= ~BM_EDGE;
 }
 
+static void bm_mesh_verts_calc_normals_task_cb(void *userdata, int index)
+{
+	BMVertsCalcNormalsData *data = userdata;
+	BMVert *v = data->bm->vtable[index];
+	float *v_no = data->vnos ? data->vnos[index] : v->no;
+
+	BM_elem_index_set(v, index); /* set_inline */
+	zero_v3(v_no);
+
+	/* add weighted face normals of all loops using this vertex */
+	if (v->e) {
+		BMEdge *e_first, *e_iter;
+
+		e_iter = e_first = v->e;
+		do {
+			if (e_iter->l) {
+				BMLoop *l_first, *l_iter;
+
+				l_iter = l_first = e_iter->l;
+				do {
+					/* each loop of the vertex uses exactly one of its edges as 'l->e' */
+					if (l_iter->v == v) {
+						const float *f_no = data->fnos ? data->fnos[BM_elem_index_get(l_iter->f)] : l_iter->f->no;
+						const float *e1diff, *e2diff;
+						float dotprod;
+						float fac;
+
+						/* calculate the dot product of the two edges that
+						 * meet at the loop's vertex */
+						e1diff = data->edgevec[BM_elem_index_get(l_iter->prev->e)];
+						e2diff = data->edgevec[BM_elem_index_get(l_iter->e)];
+						dotprod = dot_v3v3(e1diff, e2diff);
+
+						/* edge vectors are calculated from e->v1 to e->v2, so
+						 * adjust the dot product if one but not both loops
+						 * actually runs from from e->v2 to e->v1 */
+						if ((l_iter->prev->e->v1 == l_iter->prev->v) ^ (l_iter->e->v1 == l_iter->v)) {
+							dotprod = -dotprod;
+						}
+
+						fac = saacos(-dotprod);
+
+						/* accumulate weighted face normal into the vertex's normal */
+						madd_v3_v3fl(v_no, f_no, fac);
+					}
+				} while ((l_iter = l_iter->radial_next) != l_first);
+			}
+		} while ((e_iter = BM_DISK_EDGE_NEXT(e_iter, v)) != e_first);
+	}
+
+	/* normalize the accumulated vertex normal */
+	if (UNLIKELY(normalize_v3(v_no) == 0.0f)) {
+		const float *v_co = data->vcos ? data->vcos[index] : v->co;
+		normalize_v3_v3(v_no, v_co);
+	}
+}
+
 static void bm_mesh_verts_calc_normals(BMesh *bm, const float (*edgevec)[3], const float (*fnos)[3],
                                        const float (*vcos)[3], float (*vnos)[3])
 {
-	BM_mesh_elem_index_ensure(bm, (vnos) ? (BM_EDGE | BM_VERT) : BM_EDGE);
+	BMVertsCalcNormalsData data = {NULL};
 
-	/* add weighted face normals to vertices */
-	{
-		BMIter fiter;
-		BMFace *f;
-		int i;
-
-		BM_ITER_MESH_INDEX (f, &fiter, bm, BM_FACES_OF_MESH, i) {
-			BMLoop *l_first, *l_iter;
-			const float *f_no = fnos ? fnos[i] : f->no;
-
-			l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-			do {
-				const float *e1diff, *e2diff;
-				float dotprod;
-				float fac;
-				float *v_no = vnos ? vnos[BM_elem_index_get(l_iter->v)] : l_iter->v->no;
-
-				/* calculate the dot product of the two edges that
-				 * meet at the loop's vertex */
-				e1diff = edgevec[BM_elem_index_get(l_iter->prev->e)];
-				e2diff = edgevec[BM_elem_index_get(l_iter->e)];
-				dotprod = dot_v3v3(e1diff, e2diff);
-
-				/* edge vectors are calculated from e->v1 to e->v2, so
-				 * adjust the dot product if one but not both loops
-				 * actually runs from from e->v2 to e->v1 */
-				if ((l_iter->prev->e->v1 == l_iter->prev->v) ^ (l_iter->e->v1 == l_iter->v)) {
-					dotprod = -dotprod;
-				}
+	BM_mesh_elem_index_ensure(bm, (fnos) ? (BM_EDGE | BM_FACE) : BM_EDGE);
 
-				fac = saacos(-dotprod);
+	data.bm = bm;
+	data.edgevec = (float (*)[3])edgevec;
+	data.fnos = fnos;
+	data.vcos = vcos;
+	data.vnos = vnos;
 
-				/* accumulate weighted face normal into the vertex's normal */
-				madd_v3_v3fl(v_no, f_no, fac);
-			} while ((l_iter = l_iter->next) != l_first);
-		}
+	if (bm->totvert) {
+		BLI_task_parallel_range_ex(0, bm->totvert, &data, bm_mesh_verts_calc_normals_task_cb, BM_OMP_LIMIT, false);
 	}
+	bm->elem_index_dirty &= ~BM_VERT;
+}
 
+static void bm_mesh_faces_calc_normals_task_cb(void *userdata, int index)
+{
+	BMVertsCalcNormalsData *data = userdata;
+	BMFace *f = data->bm->ftable[index];
 
-	/* normalize the accumulated vertex normals */
-	{
-		BMIter viter;
-		BMVert *v;
-		int i;
-
-		BM_ITER_MESH_INDEX (v, &viter, bm, BM_VERTS_OF_MESH, i) {
-			float *v_no = vnos ? vnos[i] : v->no;
-			if (UNLIKELY(normalize_v3(v_no) == 0.0f)) {
-				const float *v_co = vcos ? vcos[i] : v->co;
-				normalize_v3_v3(v_no, v_co);
-			}
-		}
-	}
+	BM_elem_index_set(f, index); /* set_inline */
+	BM_face_normal_update(f);
 }
 
 /**
@@ -369,44 +416,22 @@ static void bm_mesh_verts_calc_normals(BMesh *bm, const float (*edgevec)[3], con
 void BM_mesh_normals_update(BMesh *bm)
 {
 	float (*edgevec)[3] = MEM_mallocN(sizeof(*edgevec) * bm->totedge, __func__);
+	BMVertsCalcNormalsData data = {NULL};
 
-#pragma omp parallel sections if (bm->totvert + bm->totedge + bm->totface >= BM_OMP_LIMIT)
-	{
-#pragma omp section
-		{
-			/* calculate all face normals */
-			BMIter fiter;
-			BMFace *f;
-			int i;
-
-			BM_ITER_MESH_INDEX (f, &fiter, bm, BM_FACES_OF_MESH, i) {
-				BM_elem_index_set(f, i); /* set_inline */
-				BM_face_normal_update(f);
-			}
-			bm->elem_index_dirty &= ~BM_FACE;
-		}
-#pragma omp section
-		{
-			/* Zero out vertex normals */
-			BMIter viter;
-			BMVert *v;
-			int i;
-
-			BM_ITER_MESH_INDEX (v, &viter, bm, BM_VERTS_OF_MESH, i) {
-				BM_elem_index_set(v, i); /* set_inline */
-				zero_v3(v->no);
-			}
-			bm->elem_index_dirty &= ~BM_VERT;
-		}
-#pragma omp section
-		{
-			/* Compute normalized direction vectors for each edge.
-			 * Directions will be used for calculating the weights of the face normals on the vertex normals.
-			 */
-			bm_mesh_edges_calc_vectors(bm, edgevec, NULL);
-		}
+	BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
+
+	data.bm = bm;
+
+	/* calculate all face normals */
+	if (bm->totface) {
+		BLI_task_parallel_range_ex(0, bm->totface, &data, bm_mesh_faces_calc_normals_task_cb, BM_OMP_LIMIT, false);
 	}
-	/* end omp */
+	bm->elem_index_dirty &= ~BM_FACE;
+
+	/* Compute normalized direction vectors for each edge.
+	 * Directions will be used for calculating the weights of the face normals on the vertex normals.
+	 */
+	bm_mesh_edges_calc_vectors(bm, edgevec, NULL);
 
 	/* Add weighted face normals to vertices, and normalize vert normals. */
 	bm_mesh_verts_calc_normals(bm, (const float(*)[3])edgevec, NULL, NULL, NULL);
@@ -422,6 +447,8 @@ void BM_verts_calc_normal_vcos(BMesh *bm, const float (*fnos)[3], const float (*
 {
 	float (*edgevec)[3] = MEM_mallocN(sizeof(*edgevec) * bm->totedge, __func__);
 
+	BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE);
+
 	/* Compute normalized direction vectors for each edge.
 	 * Directions will be used for calculating the weights of the face normals on the vertex normals.
 	 */
@@ -434,18 +461,78 @@ void BM_verts_calc_normal_vcos(BMesh *bm, const float (*fnos)[3], const float (*
 
 /**
  * Helpers for #BM_mesh_loop_normals_update and #BM_loops_calc_normals_vnos
+ *
+ * Edges only write their own tag and the normals of their own loops,
+ * faces only write the loop normals of the fans starting in them, so both run in parallel.
  */
+typedef struct BMLoopsCalcNormalsData {
+	BMesh *bm;
+	const float (*vcos)[3];
+	const float (*vnos)[3];
+	const float (*fnos)[3];
+	float split_angle;
+	bool check_angle;
+	float (*r_lnos)[3];
+} BMLoopsCalcNormalsData;
+
+static void bm_mesh_edges_sharp_tag_task_cb(void *userdata, int i)
+{
+	BMLoopsCalcNormalsData *data = userdata;
+	BMEdge *e = data->bm->etable[i];
+	const float (*vnos)[3] = data->vnos;
+	const float (*fnos)[3] = data->fnos;
+	BMLoop *l_a, *l_b;
+
+	BM_elem_index_set(e, i); /* set_inline */
+	BM_elem_flag_disable(e, BM_ELEM_TAG); /* Clear tag (means edge is sharp). */
+
+	/* An edge with only two loops, might be smooth... */
+	if (BM_edge_loop_pair(e, &l_a, &l_b)) {
+		bool is_angle_smooth = true;
+		if (data->check_angle) {
+			const float *no_a = fnos ? fnos[BM_elem_index_get(l_a->f)] : l_a->f->no;
+			const float *no_b = fnos ? fnos[BM_elem_index_get(l_b->f)] : l_b->f->no;
+			is_angle_smooth = (dot_v3v3(no_a, no_b) >= data->split_angle);
+		}
+
+		/* We only tag edges that are *really* smooth:
+		 * If the angle between both its polys' normals is below split_angle value,
+		 * and it is tagged as such,
+		 * and both its faces are smooth,
+		 * and both its faces have compatible (non-flipped) normals, i.e. both loops on the same edge do not share
+		 *     the same vertex.
+		 */
+		if (is_angle_smooth &&
+		    BM_elem_flag_test_bool(e, BM_ELEM_SMOOTH) &&
+		    BM_elem_flag_test_bool(l_a->f, BM_ELEM_SMOOTH) &&
+		    BM_elem_flag_test_bool(l_b->f, BM_ELEM_SMOOTH) &&
+		    l_a->v != l_b->v)
+		{
+			const float *no;
+			BM_elem_flag_enable(e, BM_ELEM_TAG);
+
+			/* linked vertices might be fully smooth, copy their normals to loop ones. */
+			no = vnos ? vnos[BM_elem_index_get(l_a->v)] : l_a->v->no;
+			copy_v3_v3(data->r_lnos[BM_elem_index_get(l_a)], no);
+			no = vnos ? vnos[BM_elem_index_get(l_b->v)] : l_b->v->no;
+			copy_v3_v3(data->r_lnos[BM_elem_index_get(l_b)], no);
+		}
+	}
+}
+
 static void bm_mesh_edges_sharp_tag(BMesh *bm, const float (*vnos)[3], const float (*fnos)[3], float split_angle,
                                     float (*r_lnos)[3])
 {
-	BMIter eiter;
-	BMEdge *e;
-	int i;
+	BMLoopsCalcNormalsData data = {NULL};
 
-	const bool check_angle = (split_angle < (float)M_PI);
+	data.bm = bm;
+	data.vnos = vnos;
+	data.fnos = fnos;
+	data.r_lnos = r_lnos;
+	data.check_angle = (split_angle < (float)M_PI);
 
-	if (check_angle) {
-		split_angle = cosf(split_angle);
+	if (data.check_angle) {
+		data.split_angle = cosf(split_angle);
 	}
 
 	{
@@ -459,194 +546,176 @@ static void bm_mesh_edges_sharp_tag(BMesh *bm, const float (*vnos)[3], const flo
 		BM_mesh_elem_index_ensure(bm, htype);
 	}
 
+	BM_mesh_elem_table_ensure(bm, BM_EDGE);
+
 	/* This first loop checks which edges are actually smooth, and pre-populate lnos with vnos (as if they were
 	 * all smooth).
 	 */
-	BM_ITER_MESH_INDEX (e, &eiter, bm, BM_EDGES_OF_MESH, i) {
-		BMLoop *l_a, *l_b;
-
-		BM_elem_index_set(e, i); /* set_inline */
-		BM_elem_flag_disable(e, BM_ELEM_TAG); /* Clear tag (means edge is sharp). */
-
-		/* An edge with only two loops, might be smooth... */
-		if (BM_edge_loop_pair(e, &l_a, &l_b)) {
-			bool is_angle_smooth = true;
-			if (check_angle) {
-				const float *no_a = fnos ? fnos[BM_elem_index_get(l_a->f)] : l_a->f->no;
-				const float *no_b = fnos ? fnos[BM_elem_index_get(l_b->f)] : l_b->f->no;
-				is_angle_smooth = (dot_v3v3(no_a, no_b) >= split_angle);
-			}
-
-			/* We only tag edges that are *really* smooth:
-			 * If the angle between both its polys' normals is below split_angle value,
-			 * and it is tagged as such,
-			 * and both its faces are smooth,
-			 * and both its faces have compatible (non-flipped) normals, i.e. both loops on the same edge do not share
-			 *     the same vertex.
-			 */
-			if (is_angle_smooth &&
-			    BM_elem_flag_test_bool(e, BM_ELEM_SMOOTH) &&
-			    BM_elem_flag_test_bool(l_a->f, BM_ELEM_SMOOTH) &&
-			    BM_elem_flag_test_bool(l_b->f, BM_ELEM_SMOOTH) &&
-			    l_a->v != l_b->v)
-			{
-				const float *no;
-				BM_elem_flag_enable(e, BM_ELEM_TAG);
-
-				/* linked vertices might be fully smooth, copy their normals to loop ones. */
-				no = vnos ? vnos[BM_elem_index_get(l_a->v)] : l_a->v->no;
-				copy_v3_v3(r_lnos[BM_elem_index_get(l_a)], no);
-				no = vnos ? vnos[BM_elem_index_get(l_b->v)] : l_b->v->no;
-				copy_v3_v3(r_lnos[BM_elem_index_get(l_b)], no);
-			}
-		}
+	if (bm->totedge) {
+		BLI_task_parallel_range_ex(0, bm->totedge, &data, bm_mesh_edges_sharp_tag_task_cb, BM_OMP_LIMIT, false);
 	}
 
 	bm->elem_index_dirty &= ~BM_EDGE;
 }
 
-/* BMesh version of BKE_mesh_normals_loop_split() in mesh_evaluate.c */
-static void bm_mesh_loops_calc_normals(BMesh *bm, const float (*vcos)[3], const float (*fnos)[3], float (*r_lnos)[3])
+static void bm_mesh_loops_calc_normals_task_cb(void *userdata, int index)
 {
-	BMIter fiter;
-	BMFace *f_curr;
+	BMLoopsCalcNormalsData *data = userdata;
+	BMFace *f_curr = data->bm->ftable[index];
+	const float (*vcos)[3] = data->vcos;
+	const float (*fnos)[3] = data->fnos;
+	float (*r_lnos)[3] = data->r_lnos;
+	BMLoop *l_curr, *l_first;
 
 	/* Temp normal stack. */
 	BLI_SMALLSTACK_DECLARE(normal, float *);
 
-	{
-		char htype = BM_LOOP;
-		if (vcos) {
-			htype |= BM_VERT;
+	l_curr = l_first = BM_FACE_FIRST_LOOP(f_curr);
+	do {
+		if (BM_elem_flag_test_bool(l_curr->e, BM_ELEM_TAG)) {
+			/* A smooth edge.
+			 * We skip it because it is either:
+			 * - in the middle of a 'smooth fan' already computed (or that will be as soon as we hit
+			 *   one of its ends, i.e. one of its two sharp edges), or...
+			 * - the related vertex is a "full smooth" one, in which case pre-populated normals from vertex
+			 *   are just fine!
+			 */
 		}
-		if (fnos) {
-			htype |= BM_FACE;
+		else if (!BM_elem_flag_test_bool(l_curr->prev->e, BM_ELEM_TAG)) {
+			/* Simple case (both edges around that vertex are sharp in related polygon),
+			 * this vertex just takes its poly normal.
+			 */
+			const float *no = fnos ? fnos[BM_elem_index_get(f_curr)] : f_curr->no;
+			copy_v3_v3(r_lnos[BM_elem_index_get(l_curr)], no);
 		}
-		BM_mesh_elem_index_ensure(bm, htype);
-	}
+		/* We *do not need* to check/tag loops as already computed!
+		 * Due to the fact a loop only links to one of its two edges, a same fan *will never be walked more than
+		 * once!*
+		 * Since we consider edges having neighbor faces with inverted (flipped) normals as sharp, we are sure that
+		 * no fan will be skipped, even only considering the case (sharp curr_edge, smooth prev_edge), and not the
+		 * alternative (smooth curr_edge, sharp prev_edge).
+		 * All this due/thanks to link between normals and loop ordering.
+		 */
+		else {
+			/* We have to fan around current vertex, until we find the other non-smooth edge,
+			 * and accumulate face normals into the vertex!
+			 * Note in case this vertex has only one sharp edge, this is a waste because the normal is the same as
+			 * the vertex normal, but I do not see any easy way to detect that (would need to count number
+			 * of sharp edges per vertex, I doubt the additional memory usage would be worth it, especially as
+			 * it should not be a common case in real-life meshes anyway).
+			 */
+			BMVert *v_pivot = l_curr->v;
+			BMEdge *e_next;
+			BMLoop *lfan_pivot, *lfan_pivot_next;
+			float lnor[3] = {0.0f, 0.0f, 0.0f};
+			float vec_curr[3], vec_next[3];
 
-	/* We now know edges that can be smoothed (they are tagged), and edges that will be hard (they aren't).
-	 * Now, time to generate the normals.
-	 */
-	BM_ITER_MESH (f_curr, &fiter, bm, BM_FACES_OF_MESH) {
-		BMLoop *l_curr, *l_first;
+			const float *co_pivot = vcos ? vcos[BM_elem_index_get(v_pivot)] : v_pivot->co;
 
-		l_curr = l_first = BM_FACE_FIRST_LOOP(f_curr);
-		do {
-			if (BM_elem_flag_test_bool(l_curr->e, BM_ELEM_TAG)) {
-				/* A smooth edge.
-				 * We skip it because it is either:
-				 * - in the middle of a 'smooth fan' already computed (or that will be as soon as we hit
-				 *   one of its ends, i.e. one of its two sharp edges), or...
-				 * - the related vertex is a "full smooth" one, in which case pre-populated normals from vertex
-				 *   are just fine!
-				 */
-			}
-			else if (!BM_elem_flag_test_bool(l_curr->prev->e, BM_ELEM_TAG)) {
-				/* Simple case (both edges around that vertex are sharp in related polygon),
-				 * this vertex just takes its poly normal.
-				 */
-				const float *no = fnos ? fnos[BM_elem_index_get(f_curr)] : f_curr->no;
-				copy_v3_v3(r_lnos[BM_elem_index_get(l_curr)], no);
-			}
-			/* We *do not need* to check/tag loops as already computed!
-			 * Due to the fact a loop only links to one of its two edges, a same fan *will never be walked more than
-			 * once!*
-			 * Since we consider edges having neighbor faces with inverted (flipped) normals as sharp, we are sure that
-			 * no fan will be skipped, even only considering the case (sharp curr_edge, smooth prev_edge), and not the
-			 * alternative (smooth curr_edge, sharp prev_edge).
-			 * All this due/thanks to link between normals and loop ordering.
-			 */
-			else {
-				/* We have to fan around current vertex, until we find the other non-smooth edge,
-				 * and accumulate face normals into the vertex!
-				 * Note in case this vertex has only one sharp edge, this is a waste because the normal is the same as
-				 * the vertex normal, but I do not see any easy way to detect that (would need to count number
-				 * of sharp edges per vertex, I doubt the additional memory usage would be worth it, especially as
-				 * it should not be a common case in real-life meshes anyway).
-				 */
-				BMVert *v_pivot = l_curr->v;
-				BMEdge *e_next;
-				BMLoop *lfan_pivot, *lfan_pivot_next;
-				float lnor[3] = {0.0f, 0.0f, 0.0f};
-				float vec_curr[3], vec_next[3];
+			lfan_pivot = l_curr;
+			e_next = lfan_pivot->e;  /* Current edge here, actually! */
+
+			/* Only need to compute previous edge's vector once, then we can just reuse old current one! */
+			{
+				const BMVert *v_2 = BM_edge_other_vert(e_next, v_pivot);
+				const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
 
-				const float *co_pivot = vcos ? vcos[BM_elem_index_get(v_pivot)] : v_pivot->co;
+				sub_v3_v3v3(vec_curr, co_2, co_pivot);
+				normalize_v3(vec_curr);
+			}
 
-				lfan_pivot = l_curr;
-				e_next = lfan_pivot->e;  /* Current edge here, actually! */
+			while (true) {
+				/* Much simpler than in sibling code with basic Mesh data! */
+				lfan_pivot_next = BM_vert_step_fan_loop(lfan_pivot, &e_next);
+				if (lfan_pivot_next) {
+					BLI_assert(lfan_pivot_next->v == v_pivot);
+				}
+				else {
+					/* next edge is non-manifold, we have to find it ourselves! */
+					e_next = (lfan_pivot->e == e_next) ? lfan_pivot->prev->e : lfan_pivot->e;
+				}
 
-				/* Only need to compute previous edge's vector once, then we can just reuse old current one! */
+				/* Compute edge vector.
+				 * NOTE: We could pre-compute those into an array, in the first iteration, instead of computing them
+				 *       twice (or more) here. However, time gained is not worth memory and time lost,
+				 *       given the fact that this code should not be called that much in real-life meshes...
+				 */
 				{
 					const BMVert *v_2 = BM_edge_other_vert(e_next, v_pivot);
 					const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
 
-					sub_v3_v3v3(vec_curr, co_2, co_pivot);
-					normalize_v3(vec_curr);
+					sub_v3_v3v3(vec_next, co_2, co_pivot);
+					normalize_v3(vec_next);
 				}
 
-				while (true) {
-					/* Much simpler than in sibling code with basic Mesh data! */
-					lfan_pivot_next = BM_vert_step_fan_loop(lfan_pivot, &e_next);
-					if (lfan_pivot_next) {
-						BLI_assert(lfan_pivot_next->v == v_pivot);
-					}
-					else {
-						/* next edge is non-manifold, we have to find it ourselves! */
-						e_next = (lfan_pivot->e == e_next) ? lfan_pivot->prev->e : lfan_pivot->e;
-					}
-
-					/* Compute edge vector.
-					 * NOTE: We could pre-compute those into an array, in the first iteration, instead of computing them
-					 *       twice (or more) here. However, time gained is not worth memory and time lost,
-					 *       given the fact that this code should not be called that much in real-life meshes...
-					 */
-					{
-						const BMVert *v_2 = BM_edge_other_vert(e_next, v_pivot);
-						const float *co_2 = vcos ? vcos[BM_elem_index_get(v_2)] : v_2->co;
-
-						sub_v3_v3v3(vec_next, co_2, co_pivot);
-						normalize_v3(vec_next);
-					}
-
-					{
-						/* Code similar to accumulate_vertex_normals_poly. */
-						/* Calculate angle between the two poly edges incident on this vertex. */
-						const BMFace *f = lfan_pivot->f;
-						const float fac = saacos(dot_v3v3(vec_next, vec_curr));
-						const float *no = fnos ? fnos[BM_elem_index_get(f)] : f->no;
-						/* Accumulate */
-						madd_v3_v3fl(lnor, no, fac);
-					}
-
-					/* We store here a pointer to all loop-normals processed. */
-					BLI_SMALLSTACK_PUSH(normal, (float *)r_lnos[BM_elem_index_get(lfan_pivot)]);
+				{
+					/* Code similar to accumulate_vertex_normals_poly. */
+					/* Calculate angle between the two poly edges incident on this vertex. */
+					const BMFace *f = lfan_pivot->f;
+					const float fac = saacos(dot_v3v3(vec_next, vec_curr));
+					const float *no = fnos ? fnos[BM_elem_index_get(f)] : f->no;
+					/* Accumulate */
+					madd_v3_v3fl(lnor, no, fac);
+				}
 
-					if (!BM_elem_flag_test_bool(e_next, BM_ELEM_TAG)) {
-						/* Next edge is sharp, we have finished with this fan of faces around this vert! */
-						break;
-					}
+				/* We store here a pointer to all loop-normals processed. */
+				BLI_SMALLSTACK_PUSH(normal, (float *)r_lnos[BM_elem_index_get(lfan_pivot)]);
 
-					/* Copy next edge vector to current one. */
-					copy_v3_v3(vec_curr, vec_next);
-					/* Next pivot loop to current one. */
-					lfan_pivot = lfan_pivot_next;
+				if (!BM_elem_flag_test_bool(e_next, BM_ELEM_TAG)) {
+					/* Next edge is sharp, we have finished with this fan of faces around this vert! */
+					break;
 				}
 
-				/* In case we get a zero normal here, just use vertex normal already set! */
-				if (LIKELY(normalize_v3(lnor) != 0.0f)) {
-					/* Copy back the final computed normal into all related loop-normals. */
-					float *nor;
-					while ((nor = BLI_SMALLSTACK_POP(normal))) {
-						copy_v3_v3(nor, lnor);
-					}
-				}
-				else {
-					/* We still have to clear the stack! */
-					while (BLI_SMALLSTACK_POP(normal));
+				/* Copy next edge vector to current one. */
+				copy_v3_v3(vec_curr, vec_next);
+				/* Next pivot loop to current one. */
+				lfan_pivot = lfan_pivot_next;
+			}
+
+			/* In case we get a zero normal here, just use vertex normal already set! */
+			if (LIKELY(normalize_v3(lnor) != 0.0f)) {
+				/* Copy back the final computed normal into all related loop-normals. */
+				float *nor;
+				while ((nor = BLI_SMALLSTACK_POP(normal))) {
+					copy_v3_v3(nor, lnor);
 				}
 			}
-		} while ((l_curr = l_curr->next) != l_first);
+			else {
+				/* We still have to clear the stack! */
+				while (BLI_SMALLSTACK_POP(normal));
+			}
+		}
+	} while ((l_curr = l_curr->next) != l_first);
+}
+
+/* BMesh version of BKE_mesh_normals_loop_split() in mesh_evaluate.c */
+static void bm_mesh_loops_calc_normals(BMesh *bm, const float (*vcos)[3], const float (*fnos)[3], float (*r_lnos)[3])
+{
+	BMLoopsCalcNormalsData data = {NULL};
+
+	{
+		char htype = BM_LOOP;
+		if (vcos) {
+			htype |= BM_VERT;
+		}
+		if (fnos) {
+			htype |= BM_FACE;
+		}
+		BM_mesh_elem_index_ensure(bm, htype);
+	}
+
+	BM_mesh_elem_table_ensure(bm, BM_FACE);
+
+	data.bm = bm;
+	data.vcos = vcos;
+	data.fnos = fnos;
+	data.r_lnos = r_lnos;
+
+	/* We now know edges that can be smoothed (they are tagged), and edges that will be hard (they aren't).
+	 * Now, time to generate the normals.
+	 */
+	if (bm->totface) {
+		BLI_task_parallel_range_ex(0, bm->totface, &data, bm_mesh_loops_calc_normals_task_cb, BM_OMP_LIMIT, false);
 	}
 }
 
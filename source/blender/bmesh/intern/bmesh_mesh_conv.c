@@ -86,6 +86,7 @@
 #include "BLI_listbase.h"
 #include "BLI_alloca.h"
 #include "BLI_math_vector.h"
+#include "BLI_task.h"
 
 #include "BKE_mesh.h"
 #include "BKE_customdata.h"
@@ -216,9 +217,104 @@ static BMFace *bm_face_create_from_mpoly(MPoly *mp, MLoop *ml,
 }
 
 
+typedef struct BMFromMeData {
+	BMesh *bm;
+	Mesh *me;
+	BMVert **vtable;
+	BMEdge **etable;
+	BMFace **ftable;
+
+	/* shape key layers, in key-block order */
+	float **shape_co;
+	int *cd_shape_offsets;
+	int totshape;
+
+	int cd_vert_bweight_offset;
+	int cd_edge_bweight_offset;
+	int cd_edge_crease_offset;
+	int cd_shape_keyindex_offset;
+
+	bool calc_face_normal;
+} BMFromMeData;
+
+static void bm_from_me_vert_task_cb(void *userdata, int i)
+{
+	BMFromMeData *data = userdata;
+	MVert *mvert = &data->me->mvert[i];
+	BMVert *v = data->vtable[i];
+	int j;
+
+	normal_short_to_float_v3(v->no, mvert->no);
+
+	/* Copy Custom Data */
+	CustomData_to_bmesh_block(&data->me->vdata, &data->bm->vdata, i, &v->head.data, true);
+
+	if (data->cd_vert_bweight_offset != -1) {
+		BM_ELEM_CD_SET_FLOAT(v, data->cd_vert_bweight_offset, (float)mvert->bweight / 255.0f);
+	}
+
+	/* set shape key original index */
+	if (data->cd_shape_keyindex_offset != -1) {
+		BM_ELEM_CD_SET_INT(v, data->cd_shape_keyindex_offset, i);
+	}
+
+	/* set shapekey data */
+	for (j = 0; j < data->totshape; j++) {
+		if (data->cd_shape_offsets[j] != -1) {
+			copy_v3_v3(BM_ELEM_CD_GET_VOID_P(v, data->cd_shape_offsets[j]), data->shape_co[j] + 3 * i);
+		}
+	}
+}
+
+static void bm_from_me_edge_task_cb(void *userdata, int i)
+{
+	BMFromMeData *data = userdata;
+	MEdge *medge = &data->me->medge[i];
+	BMEdge *e = data->etable[i];
+
+	/* Copy Custom Data */
+	CustomData_to_bmesh_block(&data->me->edata, &data->bm->edata, i, &e->head.data, true);
+
+	if (data->cd_edge_bweight_offset != -1) {
+		BM_ELEM_CD_SET_FLOAT(e, data->cd_edge_bweight_offset, (float)medge->bweight / 255.0f);
+	}
+	if (data->cd_edge_crease_offset != -1) {
+		BM_ELEM_CD_SET_FLOAT(e, data->cd_edge_crease_offset, (float)medge->crease / 255.0f);
+	}
+}
+
+static void bm_from_me_face_task_cb(void *userdata, int i)
+{
+	BMFromMeData *data = userdata;
+	BMFace *f = data->ftable[i];
+	BMLoop *l_iter, *l_first;
+	int j;
+
+	/* bad face, skipped on creation */
+	if (f == NULL) {
+		return;
+	}
+
+	j = data->me->mpoly[i].loopstart;
+	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+	do {
+		CustomData_to_bmesh_block(&data->me->ldata, &data->bm->ldata, j++, &l_iter->head.data, true);
+	} while ((l_iter = l_iter->next) != l_first);
+
+	/* Copy Custom Data */
+	CustomData_to_bmesh_block(&data->me->pdata, &data->bm->pdata, i, &f->head.data, true);
+
+	if (data->calc_face_normal) {
+		BM_face_normal_update(f);
+	}
+}
+
 /**
  * \brief Mesh -> BMesh
  *
+ * Elements are created in order on the calling thread (mempools and selection counts aren't thread safe),
+ * custom-data, shape keys and face normals are then filled in on the task scheduler.
+ *
  * \warning This function doesn't calculate face normals.
  */
 void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
@@ -231,14 +327,10 @@ void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
 	KeyBlock *actkey, *block;
 	BMVert *v, **vtable = NULL;
 	BMEdge *e, **etable = NULL;
-	BMFace *f;
+	BMFace *f, **ftable = NULL;
 	float (*keyco)[3] = NULL;
 	int totuv, totloops, i, j;
-
-	int cd_vert_bweight_offset;
-	int cd_edge_bweight_offset;
-	int cd_edge_crease_offset;
-	int cd_shape_keyindex_offset;
+	BMFromMeData data = {NULL};
 
 	/* free custom data */
 	/* this isnt needed in most cases but do just incase */
@@ -322,10 +414,25 @@ void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
 
 	BM_mesh_cd_flag_apply(bm, me->cd_flag);
 
-	cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
-	cd_edge_bweight_offset = CustomData_get_offset(&bm->edata, CD_BWEIGHT);
-	cd_edge_crease_offset  = CustomData_get_offset(&bm->edata, CD_CREASE);
-	cd_shape_keyindex_offset = me->key ? CustomData_get_offset(&bm->vdata, CD_SHAPE_KEYINDEX) : -1;
+	data.bm = bm;
+	data.me = me;
+	data.vtable = vtable;
+	data.calc_face_normal = calc_face_normal;
+	data.cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
+	data.cd_edge_bweight_offset = CustomData_get_offset(&bm->edata, CD_BWEIGHT);
+	data.cd_edge_crease_offset  = CustomData_get_offset(&bm->edata, CD_CREASE);
+	data.cd_shape_keyindex_offset = me->key ? CustomData_get_offset(&bm->vdata, CD_SHAPE_KEYINDEX) : -1;
+
+	if (me->key) {
+		data.totshape = BLI_listbase_count(&me->key->block);
+		data.shape_co = BLI_array_alloca(data.shape_co, data.totshape);
+		data.cd_shape_offsets = BLI_array_alloca(data.cd_shape_offsets, data.totshape);
+
+		for (block = me->key->block.first, j = 0; block; block = block->next, j++) {
+			data.shape_co[j] = block->data;
+			data.cd_shape_offsets[j] = CustomData_get_n_offset(&bm->vdata, CD_SHAPEKEY, j);
+		}
+	}
 
 	for (i = 0, mvert = me->mvert; i < me->totvert; i++, mvert++) {
 		v = vtable[i] = BM_vert_create(bm, keyco && set_key ? keyco[i] : mvert->co, NULL, BM_CREATE_SKIP_CD);
@@ -339,28 +446,12 @@ void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
 			BM_vert_select_set(bm, v, true);
 		}
 
-		normal_short_to_float_v3(v->no, mvert->no);
-
-		/* Copy Custom Data */
-		CustomData_to_bmesh_block(&me->vdata, &bm->vdata, i, &v->head.data, true);
-
-		if (cd_vert_bweight_offset != -1) BM_ELEM_CD_SET_FLOAT(v, cd_vert_bweight_offset, (float)mvert->bweight / 255.0f);
-
-		/* set shapekey data */
-		if (me->key) {
-			/* set shape key original index */
-			if (cd_shape_keyindex_offset != -1) BM_ELEM_CD_SET_INT(v, cd_shape_keyindex_offset, i);
-
-			for (block = me->key->block.first, j = 0; block; block = block->next, j++) {
-				float *co = CustomData_bmesh_get_n(&bm->vdata, v->head.data, CD_SHAPEKEY, j);
-
-				if (co) {
-					copy_v3_v3(co, ((float *)block->data) + 3 * i);
-				}
-			}
-		}
+		/* filled in by bm_from_me_vert_task_cb */
+		CustomData_bmesh_alloc_block(&bm->vdata, &v->head.data);
 	}
 
+	BLI_task_parallel_range_ex(0, me->totvert, &data, bm_from_me_vert_task_cb, BM_OMP_LIMIT, false);
+
 	bm->elem_index_dirty &= ~BM_VERT; /* added in order, clear dirty flag */
 
 	if (!me->totedge) {
@@ -369,6 +460,7 @@ void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
 	}
 
 	etable = MEM_mallocN(sizeof(void **) * me->totedge, "mesh to bmesh etable");
+	data.etable = etable;
 
 	medge = me->medge;
 	for (i = 0; i < me->totedge; i++, medge++) {
@@ -383,24 +475,27 @@ void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
 			BM_edge_select_set(bm, e, true);
 		}
 
-		/* Copy Custom Data */
-		CustomData_to_bmesh_block(&me->edata, &bm->edata, i, &e->head.data, true);
-
-		if (cd_edge_bweight_offset != -1) BM_ELEM_CD_SET_FLOAT(e, cd_edge_bweight_offset, (float)medge->bweight / 255.0f);
-		if (cd_edge_crease_offset  != -1) BM_ELEM_CD_SET_FLOAT(e, cd_edge_crease_offset,  (float)medge->crease  / 255.0f);
-
+		/* filled in by bm_from_me_edge_task_cb */
+		CustomData_bmesh_alloc_block(&bm->edata, &e->head.data);
 	}
 
+	BLI_task_parallel_range_ex(0, me->totedge, &data, bm_from_me_edge_task_cb, BM_OMP_LIMIT, false);
+
 	bm->elem_index_dirty &= ~BM_EDGE; /* added in order, clear dirty flag */
 
+	if (me->totpoly) {
+		ftable = MEM_mallocN(sizeof(void **) * me->totpoly, "mesh to bmesh ftable");
+		data.ftable = ftable;
+	}
+
 	mloop = me->mloop;
 	mp = me->mpoly;
 	for (i = 0, totloops = 0; i < me->totpoly; i++, mp++) {
 		BMLoop *l_iter;
 		BMLoop *l_first;
 
-		f = bm_face_create_from_mpoly(mp, mloop + mp->loopstart,
-		                              bm, vtable, etable);
+		f = ftable[i] = bm_face_create_from_mpoly(mp, mloop + mp->loopstart,
+		                                          bm, vtable, etable);
 
 		if (UNLIKELY(f == NULL)) {
 			printf("%s: Warning! Bad face in mesh"
@@ -423,22 +518,20 @@ void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
 		f->mat_nr = mp->mat_nr;
 		if (i == me->act_face) bm->act_face = f;
 
-		j = mp->loopstart;
 		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
 		do {
 			/* don't use 'j' since we may have skipped some faces, hence some loops. */
 			BM_elem_index_set(l_iter, totloops++); /* set_ok */
 
-			/* Save index of correspsonding MLoop */
-			CustomData_to_bmesh_block(&me->ldata, &bm->ldata, j++, &l_iter->head.data, true);
+			/* filled in by bm_from_me_face_task_cb */
+			CustomData_bmesh_alloc_block(&bm->ldata, &l_iter->head.data);
 		} while ((l_iter = l_iter->next) != l_first);
 
-		/* Copy Custom Data */
-		CustomData_to_bmesh_block(&me->pdata, &bm->pdata, i, &f->head.data, true);
+		CustomData_bmesh_alloc_block(&bm->pdata, &f->head.data);
+	}
 
-		if (calc_face_normal) {
-			BM_face_normal_update(f);
-		}
+	if (me->totpoly) {
+		BLI_task_parallel_range_ex(0, me->totpoly, &data, bm_from_me_face_task_cb, BM_OMP_LIMIT, false);
 	}
 
 	bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP); /* added in order, clear dirty flag */
@@ -488,6 +581,9 @@ void BM_mesh_bm_from_me(BMesh *bm, Mesh *me,
 
 	MEM_freeN(vtable);
 	MEM_freeN(etable);
+	if (ftable) {
+		MEM_freeN(ftable);
+	}
 }
 
 
@@ -566,24 +662,185 @@ BLI_INLINE void bmesh_quick_edgedraw_flag(MEdge *med, BMEdge *e)
 	}
 }
 
+typedef struct BMToMeData {
+	BMesh *bm;
+	Mesh *me;
+
+	int cd_vert_bweight_offset;
+	int cd_edge_bweight_offset;
+	int cd_edge_crease_offset;
+	int cd_shape_keyindex_offset;
+
+	/* shape key being written, see bm_to_me_shape_task_cb */
+	KeyBlock *currkey;
+	KeyBlock *actkey;
+	MVert *oldverts;
+	float (*oldkey)[3];
+	float (*newkey)[3];
+	float (*ofs)[3];
+	int cd_shape_offset;
+	bool apply_offset;
+} BMToMeData;
+
+static void bm_to_me_vert_task_cb(void *userdata, int i)
+{
+	BMToMeData *data = userdata;
+	BMVert *v = data->bm->vtable[i];
+	MVert *mvert = &data->me->mvert[i];
+
+	copy_v3_v3(mvert->co, v->co);
+	normal_float_to_short_v3(mvert->no, v->no);
+
+	mvert->flag = BM_vert_flag_to_mflag(v);
+
+	BM_elem_index_set(v, i); /* set_inline */
+
+	/* copy over customdat */
+	CustomData_from_bmesh_block(&data->bm->vdata, &data->me->vdata, v->head.data, i);
+
+	if (data->cd_vert_bweight_offset != -1) mvert->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(v, data->cd_vert_bweight_offset);
+
+	BM_CHECK_ELEMENT(v);
+}
+
+static void bm_to_me_edge_task_cb(void *userdata, int i)
+{
+	BMToMeData *data = userdata;
+	BMEdge *e = data->bm->etable[i];
+	MEdge *med = &data->me->medge[i];
+
+	/* vertex indices are set by bm_to_me_vert_task_cb */
+	med->v1 = BM_elem_index_get(e->v1);
+	med->v2 = BM_elem_index_get(e->v2);
+
+	med->flag = BM_edge_flag_to_mflag(e);
+
+	BM_elem_index_set(e, i); /* set_inline */
+
+	/* copy over customdata */
+	CustomData_from_bmesh_block(&data->bm->edata, &data->me->edata, e->head.data, i);
+
+	bmesh_quick_edgedraw_flag(med, e);
+
+	if (data->cd_edge_crease_offset  != -1) med->crease  = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, data->cd_edge_crease_offset);
+	if (data->cd_edge_bweight_offset != -1) med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, data->cd_edge_bweight_offset);
+
+	BM_CHECK_ELEMENT(e);
+}
+
+static void bm_to_me_face_task_cb(void *userdata, int i)
+{
+	BMToMeData *data = userdata;
+	BMFace *f = data->bm->ftable[i];
+	MPoly *mpoly = &data->me->mpoly[i];
+	MLoop *mloop;
+	BMLoop *l_iter, *l_first;
+	int j;
+
+	/* loopstart and totloop are set on the calling thread */
+	mpoly->mat_nr = f->mat_nr;
+	mpoly->flag = BM_face_flag_to_mflag(f);
+
+	j = mpoly->loopstart;
+	mloop = &data->me->mloop[j];
+	l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+	do {
+		mloop->e = BM_elem_index_get(l_iter->e);
+		mloop->v = BM_elem_index_get(l_iter->v);
+
+		/* copy over customdata */
+		CustomData_from_bmesh_block(&data->bm->ldata, &data->me->ldata, l_iter->head.data, j);
+
+		j++;
+		mloop++;
+		BM_CHECK_ELEMENT(l_iter);
+		BM_CHECK_ELEMENT(l_iter->e);
+		BM_CHECK_ELEMENT(l_iter->v);
+	} while ((l_iter = l_iter->next) != l_first);
+
+	/* copy over customdata */
+	CustomData_from_bmesh_block(&data->bm->pdata, &data->me->pdata, f->head.data, i);
+
+	BM_CHECK_ELEMENT(f);
+}
+
+static void bm_to_me_shape_task_cb(void *userdata, int i)
+{
+	BMToMeData *data = userdata;
+	BMVert *eve = data->bm->vtable[i];
+	MVert *mvert = &data->me->mvert[i];
+	KeyBlock *currkey = data->currkey;
+	float *fp = data->newkey[i];
+	int keyi;
+
+	if (currkey == data->actkey) {
+		copy_v3_v3(fp, eve->co);
+
+		if (data->actkey != data->me->key->refkey) { /* important see bug [#30771] */
+			if (data->cd_shape_keyindex_offset != -1) {
+				if (data->oldverts) {
+					keyi = BM_ELEM_CD_GET_INT(eve, data->cd_shape_keyindex_offset);
+					if (keyi != ORIGINDEX_NONE && keyi < currkey->totelem) { /* valid old vertex */
+						copy_v3_v3(mvert->co, data->oldverts[keyi].co);
+					}
+				}
+			}
+		}
+	}
+	else if (data->cd_shape_offset != -1) {
+		/* in most cases this runs */
+		copy_v3_v3(fp, BM_ELEM_CD_GET_VOID_P(eve, data->cd_shape_offset));
+	}
+	else if ((data->oldkey != NULL) &&
+	         (data->cd_shape_keyindex_offset != -1) &&
+	         ((keyi = BM_ELEM_CD_GET_INT(eve, data->cd_shape_keyindex_offset)) != ORIGINDEX_NONE) &&
+	         (keyi < currkey->totelem))
+	{
+		/* old method of reconstructing keys via vertice's original key indices,
+		 * currently used if the new method above fails (which is theoretically
+		 * possible in certain cases of undo) */
+		copy_v3_v3(fp, data->oldkey[keyi]);
+	}
+	else {
+		/* fail! fill in with dummy value */
+		copy_v3_v3(fp, mvert->co);
+	}
+
+	/* propagate edited basis offsets to other shapes */
+	if (data->apply_offset) {
+		add_v3_v3(fp, data->ofs[i]);
+	}
+}
+
+/**
+ * \brief BMesh -> Mesh
+ *
+ * Element tables are ensured so vertices, edges, faces and shape keys
+ * can be written out on the task scheduler, in the order of the BMesh mempools.
+ */
 void BM_mesh_bm_to_me(BMesh *bm, Mesh *me, bool do_tessface)
 {
 	MLoop *mloop;
 	MPoly *mpoly;
 	MVert *mvert, *oldverts;
-	MEdge *med, *medge;
-	BMVert *v, *eve;
-	BMEdge *e;
+	MEdge *medge;
+	BMVert *eve;
 	BMFace *f;
 	BMIter iter;
 	int i, j, ototvert;
+	BMToMeData data = {NULL};
 
-	const int cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
-	const int cd_edge_bweight_offset = CustomData_get_offset(&bm->edata, CD_BWEIGHT);
-	const int cd_edge_crease_offset  = CustomData_get_offset(&bm->edata, CD_CREASE);
+	data.bm = bm;
+	data.me = me;
+	data.cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
+	data.cd_edge_bweight_offset = CustomData_get_offset(&bm->edata, CD_BWEIGHT);
+	data.cd_edge_crease_offset  = CustomData_get_offset(&bm->edata, CD_CREASE);
+	data.cd_shape_keyindex_offset = CustomData_get_offset(&bm->vdata, CD_SHAPE_KEYINDEX);
 
 	ototvert = me->totvert;
 
+	BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
+
 	/* new vertex block */
 	if (bm->totvert == 0) mvert = NULL;
 	else mvert = MEM_callocN(bm->totvert * sizeof(MVert), "loadeditbMesh vert");
@@ -642,83 +899,28 @@ void BM_mesh_bm_to_me(BMesh *bm, Mesh *me, bool do_tessface)
 	/* this is called again, 'dotess' arg is used there */
 	BKE_mesh_update_customdata_pointers(me, 0);
 
-	i = 0;
-	BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
-		copy_v3_v3(mvert->co, v->co);
-		normal_float_to_short_v3(mvert->no, v->no);
-
-		mvert->flag = BM_vert_flag_to_mflag(v);
-
-		BM_elem_index_set(v, i); /* set_inline */
-
-		/* copy over customdat */
-		CustomData_from_bmesh_block(&bm->vdata, &me->vdata, v->head.data, i);
-
-		if (cd_vert_bweight_offset != -1) mvert->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(v, cd_vert_bweight_offset);
-
-		i++;
-		mvert++;
-
-		BM_CHECK_ELEMENT(v);
+	if (bm->totvert) {
+		BLI_task_parallel_range_ex(0, bm->totvert, &data, bm_to_me_vert_task_cb, BM_OMP_LIMIT, false);
 	}
 	bm->elem_index_dirty &= ~BM_VERT;
 
-	med = medge;
-	i = 0;
-	BM_ITER_MESH (e, &iter, bm, BM_EDGES_OF_MESH) {
-		med->v1 = BM_elem_index_get(e->v1);
-		med->v2 = BM_elem_index_get(e->v2);
-
-		med->flag = BM_edge_flag_to_mflag(e);
-
-		BM_elem_index_set(e, i); /* set_inline */
-
-		/* copy over customdata */
-		CustomData_from_bmesh_block(&bm->edata, &me->edata, e->head.data, i);
-
-		bmesh_quick_edgedraw_flag(med, e);
-
-		if (cd_edge_crease_offset  != -1) med->crease  = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_crease_offset);
-		if (cd_edge_bweight_offset != -1) med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_bweight_offset);
-
-		i++;
-		med++;
-		BM_CHECK_ELEMENT(e);
+	if (bm->totedge) {
+		BLI_task_parallel_range_ex(0, bm->totedge, &data, bm_to_me_edge_task_cb, BM_OMP_LIMIT, false);
 	}
 	bm->elem_index_dirty &= ~BM_EDGE;
 
-	i = 0;
-	j = 0;
-	BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
-		BMLoop *l_iter, *l_first;
-		mpoly->loopstart = j;
-		mpoly->totloop = f->len;
-		mpoly->mat_nr = f->mat_nr;
-		mpoly->flag = BM_face_flag_to_mflag(f);
-
-		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-		do {
-			mloop->e = BM_elem_index_get(l_iter->e);
-			mloop->v = BM_elem_index_get(l_iter->v);
-
-			/* copy over customdata */
-			CustomData_from_bmesh_block(&bm->ldata, &me->ldata, l_iter->head.data, j);
-
-			j++;
-			mloop++;
-			BM_CHECK_ELEMENT(l_iter);
-			BM_CHECK_ELEMENT(l_iter->e);
-			BM_CHECK_ELEMENT(l_iter->v);
-		} while ((l_iter = l_iter->next) != l_first);
+	/* loop offsets depend on all previous faces */
+	for (i = 0, j = 0; i < bm->totface; i++) {
+		f = bm->ftable[i];
+		mpoly[i].loopstart = j;
+		mpoly[i].totloop = f->len;
+		j += f->len;
 
 		if (f == bm->act_face) me->act_face = i;
+	}
 
-		/* copy over customdata */
-		CustomData_from_bmesh_block(&bm->pdata, &me->pdata, f->head.data, i);
-
-		i++;
-		mpoly++;
-		BM_CHECK_ELEMENT(f);
+	if (bm->totface) {
+		BLI_task_parallel_range_ex(0, bm->totface, &data, bm_to_me_face_task_cb, BM_OMP_LIMIT, false);
 	}
 
 	/* patch hook indices and vertex parents */
@@ -878,70 +1080,28 @@ void BM_mesh_bm_to_me(BMesh *bm, Mesh *me, bool do_tessface)
 			}
 		}
 
-		for (currkey = me->key->block.first; currkey; currkey = currkey->next) {
-			const bool apply_offset = (ofs && (currkey != actkey) && (bm->shapenr - 1 == currkey->relative));
-			int cd_shape_offset;
-			int keyi;
-			float (*ofs_pt)[3] = ofs;
-			float *newkey, (*oldkey)[3], *fp;
+		data.actkey = actkey;
+		data.oldverts = oldverts;
+		data.ofs = ofs;
 
+		for (currkey = me->key->block.first; currkey; currkey = currkey->next) {
 			j = bm_to_mesh_shape_layer_index_from_kb(bm, currkey);
-			cd_shape_offset = CustomData_get_n_offset(&bm->vdata, CD_SHAPEKEY, j);
-
-
-			fp = newkey = MEM_callocN(me->key->elemsize * bm->totvert,  "currkey->data");
-			oldkey = currkey->data;
-
-			mvert = me->mvert;
-			BM_ITER_MESH (eve, &iter, bm, BM_VERTS_OF_MESH) {
-
-				if (currkey == actkey) {
-					copy_v3_v3(fp, eve->co);
 
-					if (actkey != me->key->refkey) { /* important see bug [#30771] */
-						if (cd_shape_keyindex_offset != -1) {
-							if (oldverts) {
-								keyi = BM_ELEM_CD_GET_INT(eve, cd_shape_keyindex_offset);
-								if (keyi != ORIGINDEX_NONE && keyi < currkey->totelem) { /* valid old vertex */
-									copy_v3_v3(mvert->co, oldverts[keyi].co);
-								}
-							}
-						}
-					}
-				}
-				else if (j != -1) {
-					/* in most cases this runs */
-					copy_v3_v3(fp, BM_ELEM_CD_GET_VOID_P(eve, cd_shape_offset));
-				}
-				else if ((oldkey != NULL) &&
-				         (cd_shape_keyindex_offset != -1) &&
-				         ((keyi = BM_ELEM_CD_GET_INT(eve, cd_shape_keyindex_offset)) != ORIGINDEX_NONE) &&
-				         (keyi < currkey->totelem))
-				{
-					/* old method of reconstructing keys via vertice's original key indices,
-					 * currently used if the new method above fails (which is theoretically
-					 * possible in certain cases of undo) */
-					copy_v3_v3(fp, oldkey[keyi]);
-				}
-				else {
-					/* fail! fill in with dummy value */
-					copy_v3_v3(fp, mvert->co);
-				}
-
-				/* propagate edited basis offsets to other shapes */
-				if (apply_offset) {
-					add_v3_v3(fp, *ofs_pt++);
-				}
+			data.currkey = currkey;
+			data.apply_offset = (ofs && (currkey != actkey) && (bm->shapenr - 1 == currkey->relative));
+			data.cd_shape_offset = (j != -1) ? CustomData_get_n_offset(&bm->vdata, CD_SHAPEKEY, j) : -1;
+			data.oldkey = currkey->data;
+			data.newkey = MEM_callocN(me->key->elemsize * bm->totvert,  "currkey->data");
 
-				fp += 3;
-				mvert++;
+			if (bm->totvert) {
+				BLI_task_parallel_range_ex(0, bm->totvert, &data, bm_to_me_shape_task_cb, BM_OMP_LIMIT, false);
 			}
 
 			currkey->totelem = bm->totvert;
 			if (currkey->data) {
 				MEM_freeN(currkey->data);
 			}
-			currkey->data = newkey;
+			currkey->data = data.newkey;
 		}
 
 		if (ofs) MEM_freeN(ofs);
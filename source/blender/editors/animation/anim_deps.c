@@ -78,6 +78,12 @@ void ANIM_list_elem_update(Scene *scene, bAnimListElem *ale)
 
 	/* update data */
 	fcu = (ale->datatype == ALE_FCURVE) ? ale->key_data : NULL;
+	
+	/* keys may have been moved in place (e.g. by transform), so samples baked from them are outdated */
+	if (fcu)
+		fcurve_free_sample_table(fcu);
+	else
+		BKE_animdata_free_sample_tables(id);
 		
 	if (fcu && fcu->rna_path) {
 		/* if we have an fcurve, call the update for the property we
@@ -42,6 +42,7 @@
 #include "BLI_math.h"
 
 #include "BKE_action.h"
+#include "BKE_animsys.h"
 #include "BKE_armature.h"
 #include "BKE_constraint.h"
 #include "BKE_context.h"
@@ -1213,6 +1214,10 @@ static int armature_delete_selected_exec(bContext *C, wmOperator *UNUSED(op))
 	/*  First erase any associated pose channel */
 	if (obedit->pose) {
 		bPoseChannel *pchan, *pchan_next;
+
+		/* animation paths may be resolved to the removed channels */
+		BKE_animsys_rna_path_cache_tag_invalid();
+
 		for (pchan = obedit->pose->chanbase.first; pchan; pchan = pchan_next) {
 			pchan_next = pchan->next;
 			curBone = ED_armature_bone_find_name(arm->edbo, pchan->name);
@@ -827,6 +827,7 @@ static int pose_clear_user_transforms_exec(bContext *C, wmOperator *op)
 		BKE_pose_copy_data(&dummyPose, ob->pose, 0);
 		
 		BLI_strncpy(workob.id.name, "OB<ClearTfmWorkOb>", sizeof(workob.id.name));
+		workob.id.flag |= LIB_ANIM_NO_RECALC;
 		workob.type = OB_ARMATURE;
 		workob.data = ob->data;
 		workob.adt = ob->adt;
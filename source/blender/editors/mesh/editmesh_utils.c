@@ -37,9 +37,11 @@
 
 #include "BLI_math.h"
 #include "BLI_alloca.h"
+#include "BLI_array_store.h"
 #include "BLI_listbase.h"
 
 #include "BKE_DerivedMesh.h"
+#include "BKE_customdata.h"
 #include "BKE_context.h"
 #include "BKE_global.h"
 #include "BKE_depsgraph.h"
@@ -497,6 +499,7 @@ static void *getEditMesh(bContext *C)
 }
 
 typedef struct UndoMesh {
+	struct UndoMesh *next, *prev;
 	Mesh me;
 	int selectmode;
 
@@ -509,9 +512,278 @@ typedef struct UndoMesh {
 	 * There are a few ways this could be made to work but for now its a known limitation with mixing
 	 * object and editmode operations - Campbell */
 	int shapenr;
+
+	/* custom-data layers and shape keys, stored in the array stores (NULL for layers kept in 'me') */
+	struct {
+		BArrayState **vdata, **edata, **ldata, **pdata;
+		BArrayState **keyblocks;
+	} store;
 } UndoMesh;
 
-/* undo simply makes copies of a bmesh */
+/* Undo steps store their arrays de-duplicated against the previous step,
+ * so unchanged data (most of it for typical edits) is shared between steps. */
+
+/* number of elements per chunk */
+#define ARRAY_CHUNK_SIZE 256
+
+static struct {
+	/* one store per element size (index is the stride - 1) */
+	BArrayStore **stride_table;
+	int stride_table_len;
+
+	/* all undo steps, the last is the reference for the next step */
+	ListBase undo_meshes;
+} um_arraystore = {NULL};
+
+static BArrayStore *um_arraystore_at_stride_ensure(const int stride)
+{
+	BArrayStore **bs_p;
+
+	if (um_arraystore.stride_table_len < stride) {
+		um_arraystore.stride_table_len = stride;
+		um_arraystore.stride_table = MEM_recallocN(
+		        um_arraystore.stride_table, sizeof(*um_arraystore.stride_table) * (size_t)stride);
+	}
+
+	bs_p = &um_arraystore.stride_table[stride - 1];
+	if (*bs_p == NULL) {
+		*bs_p = BLI_array_store_create((unsigned int)stride, ARRAY_CHUNK_SIZE);
+	}
+	return *bs_p;
+}
+
+static void um_arraystore_clear_if_unused(void)
+{
+	int i;
+
+	if (um_arraystore.undo_meshes.first) {
+		return;
+	}
+
+	for (i = 0; i < um_arraystore.stride_table_len; i++) {
+		if (um_arraystore.stride_table[i]) {
+			BLI_array_store_destroy(um_arraystore.stride_table[i]);
+		}
+	}
+	MEM_SAFE_FREE(um_arraystore.stride_table);
+	um_arraystore.stride_table_len = 0;
+}
+
+/* move plain custom-data layers into the array stores, layers owning memory are kept as-is */
+static void um_arraystore_cd_compact(
+        CustomData *cdata, const int totelem,
+        const CustomData *cdata_reference, BArrayState **store_reference,
+        BArrayState ***r_store)
+{
+	BArrayState **store = NULL;
+	int i;
+
+	if (cdata->totlayer == 0) {
+		*r_store = NULL;
+		return;
+	}
+
+	store = MEM_callocN(sizeof(*store) * (size_t)cdata->totlayer, __func__);
+
+	for (i = 0; i < cdata->totlayer; i++) {
+		CustomDataLayer *layer = &cdata->layers[i];
+		const BArrayState *state_reference = NULL;
+		int stride;
+
+		if ((layer->data == NULL) ||
+		    (layer->flag & CD_FLAG_NOFREE) ||
+		    CustomData_layertype_is_dynamic(layer->type))
+		{
+			continue;
+		}
+
+		if (store_reference && (i < cdata_reference->totlayer) && (cdata_reference->layers[i].type == layer->type)) {
+			state_reference = store_reference[i];
+		}
+
+		stride = CustomData_sizeof(layer->type);
+		store[i] = BLI_array_store_state_add(
+		        um_arraystore_at_stride_ensure(stride),
+		        layer->data, (size_t)stride * (size_t)totelem, state_reference);
+
+		MEM_freeN(layer->data);
+		layer->data = NULL;
+	}
+
+	*r_store = store;
+}
+
+static void um_arraystore_cd_expand(BArrayState **store, CustomData *cdata)
+{
+	int i;
+
+	if (store == NULL) {
+		return;
+	}
+
+	for (i = 0; i < cdata->totlayer; i++) {
+		if (store[i]) {
+			size_t data_len;
+			cdata->layers[i].data = BLI_array_store_state_data_get_alloc(store[i], &data_len);
+		}
+	}
+}
+
+static void um_arraystore_cd_expand_free(BArrayState **store, CustomData *cdata)
+{
+	int i;
+
+	if (store == NULL) {
+		return;
+	}
+
+	for (i = 0; i < cdata->totlayer; i++) {
+		if (store[i]) {
+			MEM_freeN(cdata->layers[i].data);
+			cdata->layers[i].data = NULL;
+		}
+	}
+}
+
+static void um_arraystore_cd_free(BArrayState **store, CustomData *cdata)
+{
+	int i;
+
+	if (store == NULL) {
+		return;
+	}
+
+	for (i = 0; i < cdata->totlayer; i++) {
+		if (store[i]) {
+			const int stride = CustomData_sizeof(cdata->layers[i].type);
+			BLI_array_store_state_remove(um_arraystore_at_stride_ensure(stride), store[i]);
+		}
+	}
+	MEM_freeN(store);
+}
+
+static void um_arraystore_compact(UndoMesh *um, const UndoMesh *um_ref)
+{
+	Mesh *me = &um->me;
+	const Mesh *me_ref = um_ref ? &um_ref->me : NULL;
+
+	um_arraystore_cd_compact(&me->vdata, me->totvert, me_ref ? &me_ref->vdata : NULL,
+	                         um_ref ? um_ref->store.vdata : NULL, &um->store.vdata);
+	um_arraystore_cd_compact(&me->edata, me->totedge, me_ref ? &me_ref->edata : NULL,
+	                         um_ref ? um_ref->store.edata : NULL, &um->store.edata);
+	um_arraystore_cd_compact(&me->ldata, me->totloop, me_ref ? &me_ref->ldata : NULL,
+	                         um_ref ? um_ref->store.ldata : NULL, &um->store.ldata);
+	um_arraystore_cd_compact(&me->pdata, me->totpoly, me_ref ? &me_ref->pdata : NULL,
+	                         um_ref ? um_ref->store.pdata : NULL, &um->store.pdata);
+
+	if (me->key && me->key->totkey) {
+		const Key *key_ref = me_ref ? me_ref->key : NULL;
+		const KeyBlock *kb_ref = key_ref ? key_ref->block.first : NULL;
+		KeyBlock *kb;
+		int i;
+
+		um->store.keyblocks = MEM_callocN(sizeof(*um->store.keyblocks) * (size_t)me->key->totkey, __func__);
+
+		for (kb = me->key->block.first, i = 0; kb; kb = kb->next, i++) {
+			if (kb->data) {
+				const BArrayState *state_reference = NULL;
+
+				/* keys can't be added or removed in edit-mode, so matching by index is enough */
+				if (kb_ref && (key_ref->elemsize == me->key->elemsize) && um_ref->store.keyblocks) {
+					state_reference = um_ref->store.keyblocks[i];
+				}
+
+				um->store.keyblocks[i] = BLI_array_store_state_add(
+				        um_arraystore_at_stride_ensure(me->key->elemsize),
+				        kb->data, (size_t)me->key->elemsize * (size_t)kb->totelem, state_reference);
+
+				MEM_freeN(kb->data);
+				kb->data = NULL;
+			}
+
+			if (kb_ref) {
+				kb_ref = kb_ref->next;
+			}
+		}
+	}
+
+	BKE_mesh_update_customdata_pointers(me, false);
+}
+
+static void um_arraystore_expand(UndoMesh *um)
+{
+	Mesh *me = &um->me;
+
+	um_arraystore_cd_expand(um->store.vdata, &me->vdata);
+	um_arraystore_cd_expand(um->store.edata, &me->edata);
+	um_arraystore_cd_expand(um->store.ldata, &me->ldata);
+	um_arraystore_cd_expand(um->store.pdata, &me->pdata);
+
+	if (um->store.keyblocks) {
+		KeyBlock *kb;
+		int i;
+
+		for (kb = me->key->block.first, i = 0; kb; kb = kb->next, i++) {
+			if (um->store.keyblocks[i]) {
+				size_t data_len;
+				kb->data = BLI_array_store_state_data_get_alloc(um->store.keyblocks[i], &data_len);
+			}
+		}
+	}
+
+	BKE_mesh_update_customdata_pointers(me, false);
+}
+
+static void um_arraystore_expand_free(UndoMesh *um)
+{
+	Mesh *me = &um->me;
+
+	um_arraystore_cd_expand_free(um->store.vdata, &me->vdata);
+	um_arraystore_cd_expand_free(um->store.edata, &me->edata);
+	um_arraystore_cd_expand_free(um->store.ldata, &me->ldata);
+	um_arraystore_cd_expand_free(um->store.pdata, &me->pdata);
+
+	if (um->store.keyblocks) {
+		KeyBlock *kb;
+		int i;
+
+		for (kb = me->key->block.first, i = 0; kb; kb = kb->next, i++) {
+			if (um->store.keyblocks[i]) {
+				MEM_freeN(kb->data);
+				kb->data = NULL;
+			}
+		}
+	}
+
+	BKE_mesh_update_customdata_pointers(me, false);
+}
+
+static void um_arraystore_free(UndoMesh *um)
+{
+	Mesh *me = &um->me;
+
+	um_arraystore_cd_free(um->store.vdata, &me->vdata);
+	um_arraystore_cd_free(um->store.edata, &me->edata);
+	um_arraystore_cd_free(um->store.ldata, &me->ldata);
+	um_arraystore_cd_free(um->store.pdata, &me->pdata);
+
+	if (um->store.keyblocks) {
+		BArrayStore *bs = um_arraystore_at_stride_ensure(me->key->elemsize);
+		int i;
+
+		for (i = 0; i < me->key->totkey; i++) {
+			if (um->store.keyblocks[i]) {
+				BLI_array_store_state_remove(bs, um->store.keyblocks[i]);
+			}
+		}
+		MEM_freeN(um->store.keyblocks);
+	}
+
+	BLI_remlink(&um_arraystore.undo_meshes, um);
+	um_arraystore_clear_if_unused();
+}
+
+/* undo simply makes copies of a bmesh, with arrays shared with the previous step where unchanged */
 static void *editbtMesh_to_undoMesh(void *emv, void *obdata)
 {
 	BMEditMesh *em = emv;
@@ -529,6 +801,9 @@ static void *editbtMesh_to_undoMesh(void *emv, void *obdata)
 	um->selectmode = em->selectmode;
 	um->shapenr = em->bm->shapenr;
 
+	um_arraystore_compact(um, um_arraystore.undo_meshes.last);
+	BLI_addtail(&um_arraystore.undo_meshes, um);
+
 	return um;
 }
 
@@ -546,6 +821,8 @@ static void undoMesh_to_editbtMesh(void *umv, void *em_v, void *obdata)
 
 	EDBM_mesh_free(em);
 
+	um_arraystore_expand(um);
+
 	bm = BM_mesh_create(&allocsize);
 
 	BM_mesh_bm_from_me(bm, &um->me, true, false, um->shapenr);
@@ -582,19 +859,25 @@ static void undoMesh_to_editbtMesh(void *umv, void *em_v, void *obdata)
 
 	ob->shapenr = um->shapenr;
 
+	um_arraystore_expand_free(um);
+
 	MEM_freeN(em_tmp);
 }
 
-static void free_undo(void *me_v)
+static void free_undo(void *um_v)
 {
-	Mesh *me = me_v;
+	UndoMesh *um = um_v;
+	Mesh *me = &um->me;
+
+	um_arraystore_free(um);
+
 	if (me->key) {
 		BKE_key_free(me->key);
 		MEM_freeN(me->key);
 	}
 
 	BKE_mesh_free(me, false);
-	MEM_freeN(me);
+	MEM_freeN(um);
 }
 
 /* and this is all the undo system needs to know */
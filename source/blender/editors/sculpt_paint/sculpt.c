@@ -40,6 +40,7 @@
 #include "BLI_dial.h"
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 
 #include "BLF_translation.h"
@@ -95,27 +96,11 @@
 #include "bmesh.h"
 #include "bmesh_tools.h"
 
+#include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
-#ifdef _OPENMP
-#include <omp.h>
-#endif
-
-#if defined(__APPLE__) && defined _OPENMP
-#include <sys/sysctl.h>
-
-/* Query how many cores not counting HT aka physical cores we've got. */
-static int system_physical_thread_count(void)
-{
-	int pcount;
-	size_t pcount_len = sizeof(pcount);
-	sysctlbyname("hw.physicalcpu", &pcount, &pcount_len, NULL, 0);
-	return pcount;
-}
-#endif  /* __APPLE__ */
-
 void ED_sculpt_stroke_get_average(Object *ob, float stroke[3])
 {
 	if (ob->sculpt->last_stroke_valid && ob->sculpt->average_stroke_counter > 0) {
@@ -181,8 +166,8 @@ typedef struct StrokeCache {
 	float clip_tolerance[3];
 	float initial_mouse[2];
 
-	/* Pre-allocated temporary storage used during smoothing */
-	int num_threads, init_num_threads;
+	/* Pre-allocated temporary storage used during smoothing, per thread of the task scheduler */
+	int num_threads;
 	float (**tmpgrid_co)[3], (**tmprow_co)[3];
 	float **tmpgrid_mask, **tmprow_mask;
 
@@ -338,6 +323,50 @@ static void sculpt_orig_vert_data_update(SculptOrigVertData *orig_data,
 
 /**********************************************************************/
 
+/* Per node sums gathered for the area normal and flatten center,
+ * added up in node order afterwards so the result doesn't depend on threading. */
+typedef struct SculptAreaNodeData {
+	float an[3], an_flip[3];
+	float fc[3], fc_flip[3];
+	int count, count_flip;
+} SculptAreaNodeData;
+
+/* Data for the threaded loops over PBVH nodes, only the members used by a loop are set. */
+typedef struct SculptThreadedTaskData {
+	Sculpt *sd;
+	Object *ob;
+	Brush *brush;
+	PBVHNode **nodes;
+
+	float bstrength;
+	float flippedbstrength;
+	float angle;
+	float lim;
+	bool flip;
+	bool original;
+	bool use_orco;
+	bool smooth_mask;
+	SculptUndoType undo_type;
+
+	const float *offset;
+	const float *grab_delta;
+	const float *cono;
+	const float *area_no;
+	const float *area_co;
+	float (*mat)[4];
+	float (*vertCos)[3];
+
+	SculptAreaNodeData *area_nodes;
+} SculptThreadedTaskData;
+
+/* Threshold for the task scheduler, loops run serially when threading is disabled in the sculpt settings */
+static int sculpt_threaded_limit(const Sculpt *sd)
+{
+	return (sd->flags & SCULPT_USE_OPENMP) ? SCULPT_THREADED_LIMIT + 1 : INT_MAX;
+}
+
+/**********************************************************************/
+
 /* Returns true if the stroke will use dynamic topology, false
  * otherwise.
  *
@@ -373,62 +402,72 @@ static int sculpt_stroke_dynamic_topology(const SculptSession *ss,
 
 /*** paint mesh ***/
 
+static void paint_mesh_restore_co_task_cb(void *userdata, int n, int UNUSED(thread_id))
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	SculptUndoNode *unode;
+	SculptUndoType type = (data->brush->sculpt_tool == SCULPT_TOOL_MASK ?
+	                       SCULPT_UNDO_MASK : SCULPT_UNDO_COORDS);
+
+	if (ss->bm) {
+		unode = sculpt_undo_push_node(data->ob, data->nodes[n], type);
+	}
+	else {
+		unode = sculpt_undo_get_node(data->nodes[n]);
+	}
+	if (unode) {
+		PBVHVertexIter vd;
+		SculptOrigVertData orig_data;
+
+		sculpt_orig_vert_data_unode_init(&orig_data, data->ob, unode);
+
+		BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+		{
+			sculpt_orig_vert_data_update(&orig_data, &vd);
+
+			if (orig_data.unode->type == SCULPT_UNDO_COORDS) {
+				copy_v3_v3(vd.co, orig_data.co);
+				if (vd.no) copy_v3_v3_short(vd.no, orig_data.no);
+				else normal_short_to_float_v3(vd.fno, orig_data.no);
+			}
+			else if (orig_data.unode->type == SCULPT_UNDO_MASK) {
+				*vd.mask = orig_data.mask;
+			}
+			if (vd.mvert) vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
+		}
+		BKE_pbvh_vertex_iter_end;
+
+		BKE_pbvh_node_mark_update(data->nodes[n]);
+	}
+}
+
 static void paint_mesh_restore_co(Sculpt *sd, Object *ob)
 {
 	SculptSession *ss = ob->sculpt;
 	StrokeCache *cache = ss->cache;
-	const Brush *brush = BKE_paint_brush(&sd->paint);
+	Brush *brush = BKE_paint_brush(&sd->paint);
 	int i;
 
 	PBVHNode **nodes;
-	int n, totnode;
-
-#ifndef _OPENMP
-	(void)sd; /* quied unused warning */
-#endif
+	int totnode;
 
 	BKE_pbvh_search_gather(ss->pbvh, NULL, NULL, &nodes, &totnode);
 
-	/* Disable OpenMP when dynamic-topology is enabled. Otherwise, new
+	/* Run serially when dynamic-topology is enabled. Otherwise, new
 	 * entries might be inserted by sculpt_undo_push_node() into the
 	 * GHash used internally by BM_log_original_vert_co() by a
 	 * different thread. [#33787] */
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && !ss->bm && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		SculptUndoNode *unode;
-		SculptUndoType type = (brush->sculpt_tool == SCULPT_TOOL_MASK ?
-		                       SCULPT_UNDO_MASK : SCULPT_UNDO_COORDS);
-
-		if (ss->bm) {
-			unode = sculpt_undo_push_node(ob, nodes[n], type);
-		}
-		else {
-			unode = sculpt_undo_get_node(nodes[n]);
-		}
-		if (unode) {
-			PBVHVertexIter vd;
-			SculptOrigVertData orig_data;
-
-			sculpt_orig_vert_data_unode_init(&orig_data, ob, unode);
-		
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				sculpt_orig_vert_data_update(&orig_data, &vd);
-
-				if (orig_data.unode->type == SCULPT_UNDO_COORDS) {
-					copy_v3_v3(vd.co, orig_data.co);
-					if (vd.no) copy_v3_v3_short(vd.no, orig_data.no);
-					else normal_short_to_float_v3(vd.fno, orig_data.no);
-				}
-				else if (orig_data.unode->type == SCULPT_UNDO_MASK) {
-					*vd.mask = orig_data.mask;
-				}
-				if (vd.mvert) vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
-			BKE_pbvh_vertex_iter_end;
+	if (totnode) {
+		SculptThreadedTaskData data = {NULL};
+		data.sd = sd;
+		data.ob = ob;
+		data.brush = brush;
+		data.nodes = nodes;
 
-			BKE_pbvh_node_mark_update(nodes[n]);
-		}
+		BLI_task_parallel_range_thread_ex(
+		        0, totnode, &data, paint_mesh_restore_co_task_cb,
+		        ss->bm ? INT_MAX : sculpt_threaded_limit(sd), false);
 	}
 
 	if (ss->face_normals) {
@@ -828,14 +867,14 @@ static float tex_strength(SculptSession *ss, Brush *br,
                           const float len,
                           const short vno[3],
                           const float fno[3],
-                          const float mask)
+                          const float mask,
+                          const int thread_id)
 {
 	StrokeCache *cache = ss->cache;
 	const Scene *scene = cache->vc->scene;
 	MTex *mtex = &br->mtex;
 	float avg = 1;
 	float rgba[4];
-	int thread_num;
 
 	if (!mtex->tex) {
 		avg = 1;
@@ -878,12 +917,7 @@ static float tex_strength(SculptSession *ss, Brush *br,
 			x += br->mtex.ofs[0];
 			y += br->mtex.ofs[1];
 
-#ifdef _OPENMP
-			thread_num = omp_get_thread_num();
-#else
-			thread_num = 0;
-#endif
-			avg = paint_get_tex_pixel(&br->mtex, x, y, ss->tex_pool, thread_num);
+			avg = paint_get_tex_pixel(&br->mtex, x, y, ss->tex_pool, thread_id);
 
 			avg += br->texture_sample_bias;
 		}
@@ -964,13 +998,72 @@ static void add_norm_if(float view_vec[3], float out[3], float out_flip[3], floa
 	}
 }
 
-static void calc_area_normal(Sculpt *sd, Object *ob, float an[3], PBVHNode **nodes, int totnode)
+/* Add up the per node results of the area normal and flatten center tasks in node order */
+static void sculpt_area_nodes_sum(const SculptAreaNodeData *area_nodes, int totnode, SculptAreaNodeData *r_sum)
+{
+	int n;
+
+	memset(r_sum, 0, sizeof(*r_sum));
+
+	for (n = 0; n < totnode; n++) {
+		add_v3_v3(r_sum->an, area_nodes[n].an);
+		add_v3_v3(r_sum->an_flip, area_nodes[n].an_flip);
+		add_v3_v3(r_sum->fc, area_nodes[n].fc);
+		add_v3_v3(r_sum->fc_flip, area_nodes[n].fc_flip);
+		r_sum->count += area_nodes[n].count;
+		r_sum->count_flip += area_nodes[n].count_flip;
+	}
+}
+
+static void calc_area_normal_task_cb(void *userdata, int n, int UNUSED(thread_id))
 {
-	float out_flip[3] = {0.0f, 0.0f, 0.0f};
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	SculptAreaNodeData *area = &data->area_nodes[n];
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	SculptUndoNode *unode;
+
+	unode = sculpt_undo_push_node(data->ob, data->nodes[n], SCULPT_UNDO_COORDS);
+	sculpt_brush_test_init(ss, &test);
+
+	if (data->original) {
+		BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+		{
+			if (sculpt_brush_test_fast(&test, unode->co[vd.i])) {
+				float fno[3];
+
+				normal_short_to_float_v3(fno, unode->no[vd.i]);
+				add_norm_if(ss->cache->view_normal, area->an, area->an_flip, fno);
+			}
+		}
+		BKE_pbvh_vertex_iter_end;
+	}
+	else {
+		BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+		{
+			if (sculpt_brush_test_fast(&test, vd.co)) {
+				if (vd.no) {
+					float fno[3];
+
+					normal_short_to_float_v3(fno, vd.no);
+					add_norm_if(ss->cache->view_normal, area->an, area->an_flip, fno);
+				}
+				else {
+					add_norm_if(ss->cache->view_normal, area->an, area->an_flip, vd.fno);
+				}
+			}
+		}
+		BKE_pbvh_vertex_iter_end;
+	}
+}
 
+static void calc_area_normal(Sculpt *sd, Object *ob, float an[3], PBVHNode **nodes, int totnode)
+{
 	SculptSession *ss = ob->sculpt;
 	const Brush *brush = BKE_paint_brush(&sd->paint);
-	int n;
+	SculptThreadedTaskData data = {NULL};
+	SculptAreaNodeData sum;
 	bool original;
 
 	/* Grab brush requires to test on original data (see r33888 and
@@ -989,60 +1082,22 @@ static void calc_area_normal(Sculpt *sd, Object *ob, float an[3], PBVHNode **nod
 	if (ss->bm || brush->sculpt_tool == SCULPT_TOOL_MASK)
 		original = false;
 
-	(void)sd; /* unused w/o openmp */
-	
-	zero_v3(an);
-
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		SculptUndoNode *unode;
-		float private_an[3] = {0.0f, 0.0f, 0.0f};
-		float private_out_flip[3] = {0.0f, 0.0f, 0.0f};
-
-		unode = sculpt_undo_push_node(ob, nodes[n], SCULPT_UNDO_COORDS);
-		sculpt_brush_test_init(ss, &test);
-
-		if (original) {
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				if (sculpt_brush_test_fast(&test, unode->co[vd.i])) {
-					float fno[3];
-
-					normal_short_to_float_v3(fno, unode->no[vd.i]);
-					add_norm_if(ss->cache->view_normal, private_an, private_out_flip, fno);
-				}
-			}
-			BKE_pbvh_vertex_iter_end;
-		}
-		else {
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				if (sculpt_brush_test_fast(&test, vd.co)) {
-					if (vd.no) {
-						float fno[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.nodes = nodes;
+	data.original = original;
+	data.area_nodes = MEM_callocN(sizeof(*data.area_nodes) * totnode, __func__);
 
-						normal_short_to_float_v3(fno, vd.no);
-						add_norm_if(ss->cache->view_normal, private_an, private_out_flip, fno);
-					}
-					else {
-						add_norm_if(ss->cache->view_normal, private_an, private_out_flip, vd.fno);
-					}
-				}
-			}
-			BKE_pbvh_vertex_iter_end;
-		}
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, calc_area_normal_task_cb, sculpt_threaded_limit(sd), false);
 
-#pragma omp critical
-		{
-			add_v3_v3(an, private_an);
-			add_v3_v3(out_flip, private_out_flip);
-		}
-	}
+	sculpt_area_nodes_sum(data.area_nodes, totnode, &sum);
+	MEM_freeN(data.area_nodes);
 
-	if (is_zero_v3(an))
-		copy_v3_v3(an, out_flip);
+	if (is_zero_v3(sum.an))
+		copy_v3_v3(an, sum.an_flip);
+	else
+		copy_v3_v3(an, sum.an);
 
 	normalize_v3(an);
 }
@@ -1337,7 +1392,8 @@ static float bmesh_neighbor_average_mask(BMesh *bm, BMVert *v)
 	}
 }
 
-static void do_mesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node, float bstrength, int smooth_mask)
+static void do_mesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node,
+                                 float bstrength, int smooth_mask, const int thread_id)
 {
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	PBVHVertexIter vd;
@@ -1352,7 +1408,7 @@ static void do_mesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node,
 		if (sculpt_brush_test(&test, vd.co)) {
 			const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
 			                                            vd.no, vd.fno,
-			                                            smooth_mask ? 0 : (vd.mask ? *vd.mask : 0.0f));
+			                                            smooth_mask ? 0 : (vd.mask ? *vd.mask : 0.0f), thread_id);
 			if (smooth_mask) {
 				float val = neighbor_average_mask(ss, vd.vert_indices[vd.i]) - *vd.mask;
 				val *= fade * bstrength;
@@ -1378,7 +1434,8 @@ static void do_mesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node,
 	BKE_pbvh_vertex_iter_end;
 }
 
-static void do_bmesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node, float bstrength, int smooth_mask)
+static void do_bmesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node,
+                                  float bstrength, int smooth_mask, const int thread_id)
 {
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	PBVHVertexIter vd;
@@ -1393,7 +1450,7 @@ static void do_bmesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node,
 		if (sculpt_brush_test(&test, vd.co)) {
 			const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
 			                                            vd.no, vd.fno,
-			                                            smooth_mask ? 0 : *vd.mask);
+			                                            smooth_mask ? 0 : *vd.mask, thread_id);
 			if (smooth_mask) {
 				float val = bmesh_neighbor_average_mask(ss->bm, vd.bm_vert) - *vd.mask;
 				val *= fade * bstrength;
@@ -1420,7 +1477,7 @@ static void do_bmesh_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node,
 }
 
 static void do_multires_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *node,
-                                     float bstrength, int smooth_mask)
+                                     float bstrength, int smooth_mask, const int thread_id)
 {
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	SculptBrushTest test;
@@ -1430,7 +1487,6 @@ static void do_multires_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *no
 	float (*tmpgrid_co)[3], (*tmprow_co)[3];
 	float *tmpgrid_mask, *tmprow_mask;
 	int v1, v2, v3, v4;
-	int thread_num;
 	BLI_bitmap **grid_hidden;
 	int *grid_indices, totgrid, gridsize, i, x, y;
 
@@ -1444,15 +1500,10 @@ static void do_multires_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *no
 
 	grid_hidden = BKE_pbvh_grid_hidden(ss->pbvh);
 
-#ifdef _OPENMP
-	thread_num = omp_get_thread_num();
-#else
-	thread_num = 0;
-#endif
-	tmpgrid_co = ss->cache->tmpgrid_co[thread_num];
-	tmprow_co = ss->cache->tmprow_co[thread_num];
-	tmpgrid_mask = ss->cache->tmpgrid_mask[thread_num];
-	tmprow_mask = ss->cache->tmprow_mask[thread_num];
+	tmpgrid_co = ss->cache->tmpgrid_co[thread_id];
+	tmprow_co = ss->cache->tmprow_co[thread_id];
+	tmpgrid_mask = ss->cache->tmpgrid_mask[thread_id];
+	tmprow_mask = ss->cache->tmprow_mask[thread_id];
 
 	for (i = 0; i < totgrid; ++i) {
 		int gi = grid_indices[i];
@@ -1544,7 +1595,7 @@ static void do_multires_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *no
 				if (sculpt_brush_test(&test, co)) {
 					const float strength_mask = (smooth_mask ? 0 : *mask);
 					const float fade = bstrength * tex_strength(ss, brush, co, test.dist,
-					                                            NULL, fno, strength_mask);
+					                                            NULL, fno, strength_mask, thread_id);
 					float n = 1.0f / 16.0f;
 					
 					if (x == 0 || x == gridsize - 1)
@@ -1576,6 +1627,27 @@ static void do_multires_smooth_brush(Sculpt *sd, SculptSession *ss, PBVHNode *no
 	}
 }
 
+static void smooth_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+
+	switch (BKE_pbvh_type(ss->pbvh)) {
+		case PBVH_GRIDS:
+			do_multires_smooth_brush(data->sd, ss, data->nodes[n], data->bstrength,
+			                         data->smooth_mask, thread_id);
+			break;
+		case PBVH_FACES:
+			do_mesh_smooth_brush(data->sd, ss, data->nodes[n], data->bstrength,
+			                     data->smooth_mask, thread_id);
+			break;
+		case PBVH_BMESH:
+			do_bmesh_smooth_brush(data->sd, ss, data->nodes[n], data->bstrength,
+			                      data->smooth_mask, thread_id);
+			break;
+	}
+}
+
 static void smooth(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode,
                    float bstrength, int smooth_mask)
 {
@@ -1583,7 +1655,7 @@ static void smooth(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode,
 	const int max_iterations = 4;
 	const float fract = 1.0f / max_iterations;
 	PBVHType type = BKE_pbvh_type(ss->pbvh);
-	int iteration, n, count;
+	int iteration, count;
 	float last;
 
 	CLAMP(bstrength, 0, 1);
@@ -1597,24 +1669,14 @@ static void smooth(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode,
 	}
 
 	for (iteration = 0; iteration <= count; ++iteration) {
-		float strength = (iteration != count) ? 1.0f : last;
+		SculptThreadedTaskData data = {NULL};
+		data.sd = sd;
+		data.ob = ob;
+		data.nodes = nodes;
+		data.bstrength = (iteration != count) ? 1.0f : last;
+		data.smooth_mask = smooth_mask;
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-		for (n = 0; n < totnode; n++) {
-			switch (type) {
-				case PBVH_GRIDS:
-					do_multires_smooth_brush(sd, ss, nodes[n], strength,
-					                         smooth_mask);
-					break;
-				case PBVH_FACES:
-					do_mesh_smooth_brush(sd, ss, nodes[n], strength,
-					                     smooth_mask);
-					break;
-				case PBVH_BMESH:
-					do_bmesh_smooth_brush(sd, ss, nodes[n], strength, smooth_mask);
-					break;
-			}
-		}
+		BLI_task_parallel_range_thread_ex(0, totnode, &data, smooth_task_cb, sculpt_threaded_limit(sd), false);
 
 		if (ss->multires)
 			multires_stitch_grids(ob);
@@ -1627,38 +1689,51 @@ static void do_smooth_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnod
 	smooth(sd, ob, nodes, totnode, ss->cache->bstrength, false);
 }
 
-static void do_mask_brush_draw(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
+static void do_mask_brush_draw_task_cb(void *userdata, int n, int thread_id)
 {
-	SculptSession *ss = ob->sculpt;
-	Brush *brush = BKE_paint_brush(&sd->paint);
-	float bstrength = ss->cache->bstrength;
-	int n;
-
-	/* threaded loop over nodes */
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
 
-		sculpt_brush_test_init(ss, &test);
+	sculpt_brush_test_init(ss, &test);
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test(&test, vd.co)) {
-				float fade = tex_strength(ss, brush, vd.co, test.dist,
-				                          vd.no, vd.fno, 0);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test(&test, vd.co)) {
+			float fade = tex_strength(ss, brush, vd.co, test.dist,
+			                          vd.no, vd.fno, 0, thread_id);
 
-				(*vd.mask) += fade * bstrength;
-				CLAMP(*vd.mask, 0, 1);
+			(*vd.mask) += fade * bstrength;
+			CLAMP(*vd.mask, 0, 1);
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
-			BKE_pbvh_vertex_iter_end;
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
+		BKE_pbvh_vertex_iter_end;
 	}
 }
 
+static void do_mask_brush_draw(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
+{
+	SculptSession *ss = ob->sculpt;
+	Brush *brush = BKE_paint_brush(&sd->paint);
+	float bstrength = ss->cache->bstrength;
+	SculptThreadedTaskData data = {NULL};
+
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+
+	/* threaded loop over nodes */
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_mask_brush_draw_task_cb, sculpt_threaded_limit(sd), false);
+}
+
 static void do_mask_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
 	SculptSession *ss = ob->sculpt;
@@ -1674,45 +1749,98 @@ static void do_mask_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 	}
 }
 
+static void do_draw_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float *offset = data->offset;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
+
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
+
+	sculpt_brush_test_init(ss, &test);
+
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test(&test, vd.co)) {
+			/* offset vertex */
+			float fade = tex_strength(ss, brush, vd.co, test.dist, vd.no,
+			                          vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
+
+			mul_v3_v3fl(proxy[vd.i], offset, fade);
+
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
+		}
+	}
+	BKE_pbvh_vertex_iter_end;
+}
+
 static void do_draw_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	float offset[3];
 	float bstrength = ss->cache->bstrength;
-	int n;
+	SculptThreadedTaskData data = {NULL};
 
 	/* offset with as much as possible factored in already */
 	mul_v3_v3fl(offset, ss->cache->sculpt_normal_symm, ss->cache->radius);
 	mul_v3_v3(offset, ss->cache->scale);
 	mul_v3_fl(offset, bstrength);
 
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.offset = offset;
+
 	/* threaded loop over nodes */
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_draw_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+static void do_crease_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float flippedbstrength = data->flippedbstrength;
+	const float *offset = data->offset;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		sculpt_brush_test_init(ss, &test);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test(&test, vd.co)) {
-				/* offset vertex */
-				float fade = tex_strength(ss, brush, vd.co, test.dist, vd.no,
-				                          vd.fno, vd.mask ? *vd.mask : 0.0f);
+	sculpt_brush_test_init(ss, &test);
 
-				mul_v3_v3fl(proxy[vd.i], offset, fade);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test(&test, vd.co)) {
+			/* offset vertex */
+			const float fade = tex_strength(ss, brush, vd.co, test.dist,
+			                                vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
+			float val1[3];
+			float val2[3];
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
+			/* first we pinch */
+			sub_v3_v3v3(val1, test.location, vd.co);
+			mul_v3_fl(val1, fade * flippedbstrength);
+
+			/* then we draw */
+			mul_v3_v3fl(val2, offset, fade);
+
+			add_v3_v3v3(proxy[vd.i], val1, val2);
+
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_crease_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -1724,7 +1852,7 @@ static void do_crease_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnod
 	float bstrength = ss->cache->bstrength;
 	float flippedbstrength, crease_correction;
 	float brush_alpha;
-	int n;
+	SculptThreadedTaskData data = {NULL};
 
 	/* offset with as much as possible factored in already */
 	mul_v3_v3fl(offset, ss->cache->sculpt_normal_symm, ss->cache->radius);
@@ -1742,41 +1870,47 @@ static void do_crease_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnod
 
 	if (brush->sculpt_tool == SCULPT_TOOL_BLOB) flippedbstrength *= -1.0f;
 
-	/* threaded loop over nodes */
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.flippedbstrength = flippedbstrength;
+	data.offset = offset;
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	/* threaded loop over nodes */
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_crease_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		sculpt_brush_test_init(ss, &test);
+static void do_pinch_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test(&test, vd.co)) {
-				/* offset vertex */
-				const float fade = tex_strength(ss, brush, vd.co, test.dist,
-				                                vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
-				float val1[3];
-				float val2[3];
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-				/* first we pinch */
-				sub_v3_v3v3(val1, test.location, vd.co);
-				mul_v3_fl(val1, fade * flippedbstrength);
+	sculpt_brush_test_init(ss, &test);
 
-				/* then we draw */
-				mul_v3_v3fl(val2, offset, fade);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test(&test, vd.co)) {
+			float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist, vd.no,
+			                                      vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
+			float val[3];
 
-				add_v3_v3v3(proxy[vd.i], val1, val2);
+			sub_v3_v3v3(val, test.location, vd.co);
+			mul_v3_v3fl(proxy[vd.i], val, fade);
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_pinch_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -1784,35 +1918,55 @@ static void do_pinch_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	float bstrength = ss->cache->bstrength;
-	int n;
+	SculptThreadedTaskData data = {NULL};
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_pinch_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		sculpt_brush_test_init(ss, &test);
+static void do_grab_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *grab_delta = data->grab_delta;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	SculptOrigVertData orig_data;
+	float (*proxy)[3];
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test(&test, vd.co)) {
-				float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist, vd.no,
-				                                      vd.fno, vd.mask ? *vd.mask : 0.0f);
-				float val[3];
+	sculpt_orig_vert_data_init(&orig_data, data->ob, data->nodes[n]);
 
-				sub_v3_v3v3(val, test.location, vd.co);
-				mul_v3_v3fl(proxy[vd.i], val, fade);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
-		}
-		BKE_pbvh_vertex_iter_end;
-	}
-}
+	sculpt_brush_test_init(ss, &test);
+
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		sculpt_orig_vert_data_update(&orig_data, &vd);
+
+		if (sculpt_brush_test(&test, orig_data.co)) {
+			const float fade = bstrength * tex_strength(ss, brush,
+			                                            orig_data.co,
+			                                            test.dist,
+			                                            orig_data.no,
+			                                            NULL, vd.mask ? *vd.mask : 0.0f, thread_id);
+
+			mul_v3_v3fl(proxy[vd.i], grab_delta, fade);
+
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
+		}
+	}
+	BKE_pbvh_vertex_iter_end;
+}
 
 static void do_grab_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
@@ -1820,8 +1974,8 @@ static void do_grab_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	float bstrength = ss->cache->bstrength;
 	float grab_delta[3];
-	int n;
 	float len;
+	SculptThreadedTaskData data = {NULL};
 
 	copy_v3_v3(grab_delta, ss->cache->grab_delta_symmetry);
 
@@ -1833,38 +1987,45 @@ static void do_grab_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 		add_v3_v3(grab_delta, ss->cache->sculpt_normal_symm);
 	}
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		SculptOrigVertData orig_data;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.grab_delta = grab_delta;
 
-		sculpt_orig_vert_data_init(&orig_data, ob, nodes[n]);
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_grab_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+static void do_nudge_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *cono = data->cono;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		sculpt_brush_test_init(ss, &test);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			sculpt_orig_vert_data_update(&orig_data, &vd);
+	sculpt_brush_test_init(ss, &test);
 
-			if (sculpt_brush_test(&test, orig_data.co)) {
-				const float fade = bstrength * tex_strength(ss, brush,
-				                                            orig_data.co,
-				                                            test.dist,
-				                                            orig_data.no,
-				                                            NULL, vd.mask ? *vd.mask : 0.0f);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test(&test, vd.co)) {
+			const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
+			                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
 
-				mul_v3_v3fl(proxy[vd.i], grab_delta, fade);
+			mul_v3_v3fl(proxy[vd.i], cono, fade);
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_nudge_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -1874,37 +2035,52 @@ static void do_nudge_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
 	float bstrength = ss->cache->bstrength;
 	float grab_delta[3];
 	float tmp[3], cono[3];
-	int n;
+	SculptThreadedTaskData data = {NULL};
 
 	copy_v3_v3(grab_delta, ss->cache->grab_delta_symmetry);
 
 	cross_v3_v3v3(tmp, ss->cache->sculpt_normal_symm, grab_delta);
 	cross_v3_v3v3(cono, tmp, ss->cache->sculpt_normal_symm);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.cono = cono;
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_nudge_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		sculpt_brush_test_init(ss, &test);
+static void do_snake_hook_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *grab_delta = data->grab_delta;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test(&test, vd.co)) {
-				const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
-				                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-				mul_v3_v3fl(proxy[vd.i], cono, fade);
+	sculpt_brush_test_init(ss, &test);
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test(&test, vd.co)) {
+			const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
+			                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
+
+			mul_v3_v3fl(proxy[vd.i], grab_delta, fade);
+
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_snake_hook_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -1913,8 +2089,8 @@ static void do_snake_hook_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int to
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	float bstrength = ss->cache->bstrength;
 	float grab_delta[3];
-	int n;
 	float len;
+	SculptThreadedTaskData data = {NULL};
 
 	copy_v3_v3(grab_delta, ss->cache->grab_delta_symmetry);
 
@@ -1929,30 +2105,53 @@ static void do_snake_hook_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int to
 		add_v3_v3(grab_delta, ss->cache->sculpt_normal_symm);
 	}
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.grab_delta = grab_delta;
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_snake_hook_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		sculpt_brush_test_init(ss, &test);
+static void do_thumb_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *cono = data->cono;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	SculptOrigVertData orig_data;
+	float (*proxy)[3];
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test(&test, vd.co)) {
-				const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
-				                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
+	sculpt_orig_vert_data_init(&orig_data, data->ob, data->nodes[n]);
 
-				mul_v3_v3fl(proxy[vd.i], grab_delta, fade);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
+	sculpt_brush_test_init(ss, &test);
+
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		sculpt_orig_vert_data_update(&orig_data, &vd);
+
+		if (sculpt_brush_test(&test, orig_data.co)) {
+			const float fade = bstrength * tex_strength(ss, brush,
+			                                            orig_data.co,
+			                                            test.dist,
+			                                            orig_data.no,
+			                                            NULL, vd.mask ? *vd.mask : 0.0f, thread_id);
+
+			mul_v3_v3fl(proxy[vd.i], cono, fade);
+
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_thumb_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -1962,45 +2161,65 @@ static void do_thumb_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
 	float bstrength = ss->cache->bstrength;
 	float grab_delta[3];
 	float tmp[3], cono[3];
-	int n;
+	SculptThreadedTaskData data = {NULL};
 
 	copy_v3_v3(grab_delta, ss->cache->grab_delta_symmetry);
 
 	cross_v3_v3v3(tmp, ss->cache->sculpt_normal_symm, grab_delta);
 	cross_v3_v3v3(cono, tmp, ss->cache->sculpt_normal_symm);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		SculptOrigVertData orig_data;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.cono = cono;
 
-		sculpt_orig_vert_data_init(&orig_data, ob, nodes[n]);
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_thumb_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+static void do_rotate_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float angle = data->angle;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	SculptOrigVertData orig_data;
+	float (*proxy)[3];
 
-		sculpt_brush_test_init(ss, &test);
+	sculpt_orig_vert_data_init(&orig_data, data->ob, data->nodes[n]);
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			sculpt_orig_vert_data_update(&orig_data, &vd);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-			if (sculpt_brush_test(&test, orig_data.co)) {
-				const float fade = bstrength * tex_strength(ss, brush,
-				                                            orig_data.co,
-				                                            test.dist,
-				                                            orig_data.no,
-				                                            NULL, vd.mask ? *vd.mask : 0.0f);
+	sculpt_brush_test_init(ss, &test);
 
-				mul_v3_v3fl(proxy[vd.i], cono, fade);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		sculpt_orig_vert_data_update(&orig_data, &vd);
+
+		if (sculpt_brush_test(&test, orig_data.co)) {
+			float vec[3], rot[3][3];
+			const float fade = bstrength * tex_strength(ss, brush,
+			                                            orig_data.co,
+			                                            test.dist,
+			                                            orig_data.no,
+			                                            NULL, vd.mask ? *vd.mask : 0.0f, thread_id);
+
+			sub_v3_v3v3(vec, orig_data.co, ss->cache->location);
+			axis_angle_normalized_to_mat3(rot, ss->cache->sculpt_normal_symm, angle * fade);
+			mul_v3_m3v3(proxy[vd.i], rot, vec);
+			add_v3_v3(proxy[vd.i], ss->cache->location);
+			sub_v3_v3(proxy[vd.i], orig_data.co);
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_rotate_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -2008,47 +2227,78 @@ static void do_rotate_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnod
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	float bstrength = ss->cache->bstrength;
-	int n;
 	static const int flip[8] = { 1, -1, -1, 1, -1, 1, 1, -1 };
 	float angle = ss->cache->vertex_rotation * flip[ss->cache->mirror_symmetry_pass];
+	SculptThreadedTaskData data = {NULL};
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		SculptOrigVertData orig_data;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.angle = angle;
+
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_rotate_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		sculpt_orig_vert_data_init(&orig_data, ob, nodes[n]);
+static void do_layer_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *offset = data->offset;
+	const float lim = data->lim;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	SculptOrigVertData orig_data;
+	float *layer_disp;
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	/* XXX: layer brush needs conversion to proxy but its more complicated */
+	/* proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co; */
+	
+	sculpt_orig_vert_data_init(&orig_data, data->ob, data->nodes[n]);
 
-		sculpt_brush_test_init(ss, &test);
+	layer_disp = BKE_pbvh_node_layer_disp_get(ss->pbvh, data->nodes[n]);
+	
+	sculpt_brush_test_init(ss, &test);
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			sculpt_orig_vert_data_update(&orig_data, &vd);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		sculpt_orig_vert_data_update(&orig_data, &vd);
 
-			if (sculpt_brush_test(&test, orig_data.co)) {
-				float vec[3], rot[3][3];
-				const float fade = bstrength * tex_strength(ss, brush,
-				                                            orig_data.co,
-				                                            test.dist,
-				                                            orig_data.no,
-				                                            NULL, vd.mask ? *vd.mask : 0.0f);
+		if (sculpt_brush_test(&test, orig_data.co)) {
+			const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
+			                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
+			float *disp = &layer_disp[vd.i];
+			float val[3];
 
-				sub_v3_v3v3(vec, orig_data.co, ss->cache->location);
-				axis_angle_normalized_to_mat3(rot, ss->cache->sculpt_normal_symm, angle * fade);
-				mul_v3_m3v3(proxy[vd.i], rot, vec);
-				add_v3_v3(proxy[vd.i], ss->cache->location);
-				sub_v3_v3(proxy[vd.i], orig_data.co);
+			*disp += fade;
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
+			/* Don't let the displacement go past the limit */
+			if ((lim < 0 && *disp < lim) || (lim >= 0 && *disp > lim))
+				*disp = lim;
+
+			mul_v3_v3fl(val, offset, *disp);
+
+			if (!ss->multires && !ss->bm && ss->layer_co && (brush->flag & BRUSH_PERSISTENT)) {
+				int index = vd.vert_indices[vd.i];
+
+				/* persistent base */
+				add_v3_v3(val, ss->layer_co[index]);
 			}
+			else {
+				add_v3_v3(val, orig_data.co);
+			}
+
+			sculpt_clip(data->sd, ss, vd.co, val);
+
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_layer_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -2058,67 +2308,57 @@ static void do_layer_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
 	float bstrength = ss->cache->bstrength;
 	float offset[3];
 	float lim = brush->height;
-	int n;
+	SculptThreadedTaskData data = {NULL};
 
 	if (bstrength < 0)
 		lim = -lim;
 
 	mul_v3_v3v3(offset, ss->cache->scale, ss->cache->sculpt_normal_symm);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		SculptOrigVertData orig_data;
-		float *layer_disp;
-		/* XXX: layer brush needs conversion to proxy but its more complicated */
-		/* proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co; */
-		
-		sculpt_orig_vert_data_init(&orig_data, ob, nodes[n]);
-
-#pragma omp critical
-		{
-			layer_disp = BKE_pbvh_node_layer_disp_get(ss->pbvh, nodes[n]);
-		}
-		
-		sculpt_brush_test_init(ss, &test);
-
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			sculpt_orig_vert_data_update(&orig_data, &vd);
-
-			if (sculpt_brush_test(&test, orig_data.co)) {
-				const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
-				                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
-				float *disp = &layer_disp[vd.i];
-				float val[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.offset = offset;
+	data.lim = lim;
 
-				*disp += fade;
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_layer_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-				/* Don't let the displacement go past the limit */
-				if ((lim < 0 && *disp < lim) || (lim >= 0 && *disp > lim))
-					*disp = lim;
+static void do_inflate_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-				mul_v3_v3fl(val, offset, *disp);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-				if (!ss->multires && !ss->bm && ss->layer_co && (brush->flag & BRUSH_PERSISTENT)) {
-					int index = vd.vert_indices[vd.i];
+	sculpt_brush_test_init(ss, &test);
 
-					/* persistent base */
-					add_v3_v3(val, ss->layer_co[index]);
-				}
-				else {
-					add_v3_v3(val, orig_data.co);
-				}
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test(&test, vd.co)) {
+			const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
+			                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
+			float val[3];
 
-				sculpt_clip(sd, ss, vd.co, val);
+			if (vd.fno) copy_v3_v3(val, vd.fno);
+			else normal_short_to_float_v3(val, vd.no);
+			
+			mul_v3_fl(val, fade * ss->cache->radius);
+			mul_v3_v3v3(proxy[vd.i], val, ss->cache->scale);
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_inflate_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -2126,261 +2366,215 @@ static void do_inflate_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totno
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
 	float bstrength = ss->cache->bstrength;
-	int n;
+	SculptThreadedTaskData data = {NULL};
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_inflate_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		sculpt_brush_test_init(ss, &test);
+static void calc_flatten_center_task_cb(void *userdata, int n, int UNUSED(thread_id))
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	SculptAreaNodeData *area = &data->area_nodes[n];
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	SculptUndoNode *unode;
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test(&test, vd.co)) {
-				const float fade = bstrength * tex_strength(ss, brush, vd.co, test.dist,
-				                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
-				float val[3];
+	unode = sculpt_undo_push_node(data->ob, data->nodes[n], SCULPT_UNDO_COORDS);
+	sculpt_brush_test_init(ss, &test);
 
-				if (vd.fno) copy_v3_v3(val, vd.fno);
-				else normal_short_to_float_v3(val, vd.no);
-				
-				mul_v3_fl(val, fade * ss->cache->radius);
-				mul_v3_v3v3(proxy[vd.i], val, ss->cache->scale);
+	if (ss->cache->original && unode->co) {
+		BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+		{
+			if (sculpt_brush_test_fast(&test, unode->co[vd.i])) {
+				float fno[3];
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
+				normal_short_to_float_v3(fno, unode->no[vd.i]);
+				if (dot_v3v3(ss->cache->view_normal, fno) > 0) {
+					add_v3_v3(area->fc, unode->co[vd.i]);
+					area->count++;
+				}
+				else {
+					add_v3_v3(area->fc_flip, unode->co[vd.i]);
+					area->count_flip++;
+				}
 			}
 		}
 		BKE_pbvh_vertex_iter_end;
 	}
-}
-
-static void calc_flatten_center(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode, float fc[3])
-{
-	SculptSession *ss = ob->sculpt;
-	int n;
-
-	int count = 0;
-	int count_flip = 0;
-
-	float fc_flip[3] = {0.0, 0.0, 0.0};
-
-	(void)sd; /* unused w/o openmp */
-
-	zero_v3(fc);
-
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		SculptUndoNode *unode;
-		float private_fc[3] = {0.0f, 0.0f, 0.0f};
-		float private_fc_flip[3] = {0.0f, 0.0f, 0.0f};
-		int private_count = 0;
-		int private_count_flip = 0;
-
-		unode = sculpt_undo_push_node(ob, nodes[n], SCULPT_UNDO_COORDS);
-		sculpt_brush_test_init(ss, &test);
-
-		if (ss->cache->original && unode->co) {
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				if (sculpt_brush_test_fast(&test, unode->co[vd.i])) {
+	else {
+		BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+		{
+			if (sculpt_brush_test_fast(&test, vd.co)) {
+				/* for area normal */
+				if (vd.no) {
 					float fno[3];
 
-					normal_short_to_float_v3(fno, unode->no[vd.i]);
+					normal_short_to_float_v3(fno, vd.no);
+
 					if (dot_v3v3(ss->cache->view_normal, fno) > 0) {
-						add_v3_v3(private_fc, unode->co[vd.i]);
-						private_count++;
+						add_v3_v3(area->fc, vd.co);
+						area->count++;
 					}
 					else {
-						add_v3_v3(private_fc_flip, unode->co[vd.i]);
-						private_count_flip++;
+						add_v3_v3(area->fc_flip, vd.co);
+						area->count_flip++;
 					}
 				}
-			}
-			BKE_pbvh_vertex_iter_end;
-		}
-		else {
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				if (sculpt_brush_test_fast(&test, vd.co)) {
-					/* for area normal */
-					if (vd.no) {
-						float fno[3];
-
-						normal_short_to_float_v3(fno, vd.no);
-
-						if (dot_v3v3(ss->cache->view_normal, fno) > 0) {
-							add_v3_v3(private_fc, vd.co);
-							private_count++;
-						}
-						else {
-							add_v3_v3(private_fc_flip, vd.co);
-							private_count_flip++;
-						}
+				else {
+					if (dot_v3v3(ss->cache->view_normal, vd.fno) > 0) {
+						add_v3_v3(area->fc, vd.co);
+						area->count++;
 					}
 					else {
-						if (dot_v3v3(ss->cache->view_normal, vd.fno) > 0) {
-							add_v3_v3(private_fc, vd.co);
-							private_count++;
-						}
-						else {
-							add_v3_v3(private_fc_flip, vd.co);
-							private_count_flip++;
-						}
+						add_v3_v3(area->fc_flip, vd.co);
+						area->count_flip++;
 					}
 				}
 			}
-			BKE_pbvh_vertex_iter_end;
-		}
-
-#pragma omp critical
-		{
-			add_v3_v3(fc, private_fc);
-			add_v3_v3(fc_flip, private_fc_flip);
-			count += private_count;
-			count_flip += private_count_flip;
 		}
+		BKE_pbvh_vertex_iter_end;
 	}
-	if (count != 0)
-		mul_v3_fl(fc, 1.0f / count);
-	else if (count_flip != 0)
-		mul_v3_v3fl(fc, fc_flip, 1.0f / count_flip);
+}
+
+static void calc_flatten_center(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode, float fc[3])
+{
+	SculptThreadedTaskData data = {NULL};
+	SculptAreaNodeData sum;
+
+	data.sd = sd;
+	data.ob = ob;
+	data.nodes = nodes;
+	data.area_nodes = MEM_callocN(sizeof(*data.area_nodes) * totnode, __func__);
+
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, calc_flatten_center_task_cb, sculpt_threaded_limit(sd), false);
+
+	sculpt_area_nodes_sum(data.area_nodes, totnode, &sum);
+	MEM_freeN(data.area_nodes);
+
+	if (sum.count != 0)
+		mul_v3_v3fl(fc, sum.fc, 1.0f / sum.count);
+	else if (sum.count_flip != 0)
+		mul_v3_v3fl(fc, sum.fc_flip, 1.0f / sum.count_flip);
 	else
 		zero_v3(fc);
 }
 
-/* this calculates flatten center and area normal together, 
- * amortizing the memory bandwidth and loop overhead to calculate both at the same time */
-static void calc_area_normal_and_flatten_center(Sculpt *sd, Object *ob,
-                                                PBVHNode **nodes, int totnode,
-                                                float an[3], float fc[3])
+static void calc_area_normal_and_flatten_center_task_cb(void *userdata, int n, int UNUSED(thread_id))
 {
-	SculptSession *ss = ob->sculpt;
-	int n;
-
-	/* for area normal */
-	float out_flip[3] = {0.0f, 0.0f, 0.0f};
-	float fc_flip[3] = {0.0f, 0.0f, 0.0f};
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	SculptAreaNodeData *area = &data->area_nodes[n];
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	SculptUndoNode *unode;
 
-	/* for flatten center */
-	int count = 0;
-	int count_flipped = 0;
+	unode = sculpt_undo_push_node(data->ob, data->nodes[n], SCULPT_UNDO_COORDS);
+	sculpt_brush_test_init(ss, &test);
 
-	(void)sd; /* unused w/o openmp */
-	
-	/* for area normal */
-	zero_v3(an);
+	if (ss->cache->original && unode->co) {
+		BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+		{
+			if (sculpt_brush_test_fast(&test, unode->co[vd.i])) {
+				/* for area normal */
+				float fno[3];
 
-	/* for flatten center */
-	zero_v3(fc);
+				normal_short_to_float_v3(fno, unode->no[vd.i]);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		SculptUndoNode *unode;
-		float private_an[3] = {0.0f, 0.0f, 0.0f};
-		float private_out_flip[3] = {0.0f, 0.0f, 0.0f};
-		float private_fc[3] = {0.0f, 0.0f, 0.0f};
-		float private_fc_flip[3] = {0.0f, 0.0f, 0.0f};
-		int private_count = 0;
-		int private_count_flip = 0;
-
-		unode = sculpt_undo_push_node(ob, nodes[n], SCULPT_UNDO_COORDS);
-		sculpt_brush_test_init(ss, &test);
-
-		if (ss->cache->original && unode->co) {
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				if (sculpt_brush_test_fast(&test, unode->co[vd.i])) {
-					/* for area normal */
+				if (dot_v3v3(ss->cache->view_normal, fno) > 0) {
+					add_v3_v3(area->an, fno);
+					add_v3_v3(area->fc, unode->co[vd.i]);
+					area->count++;
+				}
+				else {
+					add_v3_v3(area->an_flip, fno);
+					add_v3_v3(area->fc_flip, unode->co[vd.i]);
+					area->count_flip++;
+				}
+			}
+		}
+		BKE_pbvh_vertex_iter_end;
+	}
+	else {
+		BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+		{
+			if (sculpt_brush_test_fast(&test, vd.co)) {
+				/* for area normal */
+				if (vd.no) {
 					float fno[3];
 
-					normal_short_to_float_v3(fno, unode->no[vd.i]);
+					normal_short_to_float_v3(fno, vd.no);
 
 					if (dot_v3v3(ss->cache->view_normal, fno) > 0) {
-						add_v3_v3(private_an, fno);
-						add_v3_v3(private_fc, unode->co[vd.i]);
-						private_count++;
+						add_v3_v3(area->an, fno);
+						add_v3_v3(area->fc, vd.co);
+						area->count++;
 					}
 					else {
-						add_v3_v3(private_out_flip, fno);
-						add_v3_v3(private_fc_flip, unode->co[vd.i]);
-						private_count_flip++;
+						add_v3_v3(area->an_flip, fno);
+						add_v3_v3(area->fc_flip, vd.co);
+						area->count_flip++;
 					}
 				}
-			}
-			BKE_pbvh_vertex_iter_end;
-		}
-		else {
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				if (sculpt_brush_test_fast(&test, vd.co)) {
-					/* for area normal */
-					if (vd.no) {
-						float fno[3];
-
-						normal_short_to_float_v3(fno, vd.no);
-
-						if (dot_v3v3(ss->cache->view_normal, fno) > 0) {
-							add_v3_v3(private_an, fno);
-							add_v3_v3(private_fc, vd.co);
-							private_count++;
-						}
-						else {
-							add_v3_v3(private_out_flip, fno);
-							add_v3_v3(private_fc_flip, vd.co);
-							private_count_flip++;
-						}
+				else {
+					if (dot_v3v3(ss->cache->view_normal, vd.fno) > 0) {
+						add_v3_v3(area->an, vd.fno);
+						add_v3_v3(area->fc, vd.co);
+						area->count++;
 					}
 					else {
-						if (dot_v3v3(ss->cache->view_normal, vd.fno) > 0) {
-							add_v3_v3(private_an, vd.fno);
-							add_v3_v3(private_fc, vd.co);
-							private_count++;
-						}
-						else {
-							add_v3_v3(private_out_flip, vd.fno);
-							add_v3_v3(private_fc_flip, vd.co);
-							private_count_flip++;
-						}
+						add_v3_v3(area->an_flip, vd.fno);
+						add_v3_v3(area->fc_flip, vd.co);
+						area->count_flip++;
 					}
 				}
 			}
-			BKE_pbvh_vertex_iter_end;
-		}
-
-#pragma omp critical
-		{
-			/* for area normal */
-			add_v3_v3(an, private_an);
-			add_v3_v3(out_flip, private_out_flip);
-
-			/* for flatten center */
-			add_v3_v3(fc, private_fc);
-			add_v3_v3(fc_flip, private_fc_flip);
-			count += private_count;
-			count_flipped += private_count_flip;
 		}
+		BKE_pbvh_vertex_iter_end;
 	}
+}
+
+/* this calculates flatten center and area normal together, 
+ * amortizing the memory bandwidth and loop overhead to calculate both at the same time */
+static void calc_area_normal_and_flatten_center(Sculpt *sd, Object *ob,
+                                                PBVHNode **nodes, int totnode,
+                                                float an[3], float fc[3])
+{
+	SculptThreadedTaskData data = {NULL};
+	SculptAreaNodeData sum;
+
+	data.sd = sd;
+	data.ob = ob;
+	data.nodes = nodes;
+	data.area_nodes = MEM_callocN(sizeof(*data.area_nodes) * totnode, __func__);
+
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, calc_area_normal_and_flatten_center_task_cb, sculpt_threaded_limit(sd), false);
+
+	sculpt_area_nodes_sum(data.area_nodes, totnode, &sum);
+	MEM_freeN(data.area_nodes);
 
 	/* for area normal */
-	if (is_zero_v3(an))
-		copy_v3_v3(an, out_flip);
+	if (is_zero_v3(sum.an))
+		copy_v3_v3(an, sum.an_flip);
+	else
+		copy_v3_v3(an, sum.an);
 
 	normalize_v3(an);
 
 	/* for flatten center */
-	if (count != 0)
-		mul_v3_fl(fc, 1.0f / count);
-	else if (count_flipped != 0)
-		mul_v3_v3fl(fc, fc_flip, 1.0f / count_flipped);
+	if (sum.count != 0)
+		mul_v3_v3fl(fc, sum.fc, 1.0f / sum.count);
+	else if (sum.count_flip != 0)
+		mul_v3_v3fl(fc, sum.fc_flip, 1.0f / sum.count_flip);
 	else
 		zero_v3(fc);
 }
@@ -2458,7 +2652,8 @@ static void calc_sculpt_plane(Sculpt *sd, Object *ob, PBVHNode **nodes, int totn
 }
 
 /* Projects a point onto a plane along the plane's normal */
-static void point_plane_project(float intr[3], float co[3], float plane_normal[3], float plane_center[3])
+static void point_plane_project(float intr[3], const float co[3],
+                                const float plane_normal[3], const float plane_center[3])
 {
 	sub_v3_v3v3(intr, co, plane_center);
 	mul_v3_v3fl(intr, plane_normal, dot_v3v3(plane_normal, intr));
@@ -2471,7 +2666,8 @@ static int plane_trim(StrokeCache *cache, Brush *brush, float val[3])
 	        ((dot_v3v3(val, val) <= cache->radius_squared * cache->plane_trim_squared)));
 }
 
-static int plane_point_side_flip(float co[3], float plane_normal[3], float plane_center[3], int flip)
+static int plane_point_side_flip(const float co[3], const float plane_normal[3],
+                                  const float plane_center[3], int flip)
 {
 	float delta[3];
 	float d;
@@ -2484,7 +2680,7 @@ static int plane_point_side_flip(float co[3], float plane_normal[3], float plane
 	return d <= 0.0f;
 }
 
-static int plane_point_side(float co[3], float plane_normal[3], float plane_center[3])
+static int plane_point_side(const float co[3], const float plane_normal[3], const float plane_center[3])
 {
 	float delta[3];
 
@@ -2505,10 +2701,51 @@ static float get_offset(Sculpt *sd, SculptSession *ss)
 	return rv;
 }
 
+static void do_flatten_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *area_co = data->area_co;
+	const float *area_no = data->area_no;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
+
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
+
+	sculpt_brush_test_init(ss, &test);
+
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test_sq(&test, vd.co)) {
+			float intr[3];
+			float val[3];
+
+			point_plane_project(intr, vd.co, area_no, area_co);
+
+			sub_v3_v3v3(val, intr, vd.co);
+
+			if (plane_trim(ss->cache, brush, val)) {
+				const float fade = bstrength * tex_strength(ss, brush, vd.co, sqrtf(test.dist),
+				                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
+
+				mul_v3_v3fl(proxy[vd.i], val, fade);
+
+				if (vd.mvert)
+					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
+			}
+		}
+	}
+	BKE_pbvh_vertex_iter_end;
+}
+
 static void do_flatten_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
+	SculptThreadedTaskData data = {NULL};
 
 	float bstrength = ss->cache->bstrength;
 	const float radius = ss->cache->radius;
@@ -2520,7 +2757,6 @@ static void do_flatten_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totno
 
 	float displace;
 
-	int n;
 
 	float temp[3];
 
@@ -2532,29 +2768,49 @@ static void do_flatten_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totno
 	mul_v3_fl(temp, displace);
 	add_v3_v3(fc, temp);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.area_co = fc;
+	data.area_no = an;
+
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_flatten_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
+
+static void do_clay_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const bool flip = data->flip;
+	const float *area_co = data->area_co;
+	const float *area_no = data->area_no;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-		sculpt_brush_test_init(ss, &test);
+	sculpt_brush_test_init(ss, &test);
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test_sq(&test, vd.co)) {
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test_sq(&test, vd.co)) {
+			if (plane_point_side_flip(vd.co, area_no, area_co, flip)) {
 				float intr[3];
 				float val[3];
 
-				point_plane_project(intr, vd.co, an, fc);
+				point_plane_project(intr, vd.co, area_no, area_co);
 
 				sub_v3_v3v3(val, intr, vd.co);
 
 				if (plane_trim(ss->cache, brush, val)) {
 					const float fade = bstrength * tex_strength(ss, brush, vd.co, sqrtf(test.dist),
-					                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
+					                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
 
 					mul_v3_v3fl(proxy[vd.i], val, fade);
 
@@ -2563,14 +2819,15 @@ static void do_flatten_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totno
 				}
 			}
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_clay_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
+	SculptThreadedTaskData data = {NULL};
 
 	float bstrength = ss->cache->bstrength;
 	float radius    = ss->cache->radius;
@@ -2581,7 +2838,6 @@ static void do_clay_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 	float an[3];
 	float fc[3];
 
-	int n;
 
 	float temp[3];
 
@@ -2604,47 +2860,69 @@ static void do_clay_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 
 	/* add_v3_v3v3(p, ss->cache->location, an); */
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.flip = flip;
+	data.area_co = fc;
+	data.area_no = an;
+
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_clay_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
+
+static void do_clay_strips_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const bool flip = data->flip;
+	float (*mat)[4] = data->mat;
+	const float *area_co = data->area_co;
+	const float *area_no = data->area_no;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-		sculpt_brush_test_init(ss, &test);
+	sculpt_brush_test_init(ss, &test);
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test_sq(&test, vd.co)) {
-				if (plane_point_side_flip(vd.co, an, fc, flip)) {
-					float intr[3];
-					float val[3];
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test_cube(&test, vd.co, mat)) {
+			if (plane_point_side_flip(vd.co, area_no, area_co, flip)) {
+				float intr[3];
+				float val[3];
 
-					point_plane_project(intr, vd.co, an, fc);
+				point_plane_project(intr, vd.co, area_no, area_co);
 
-					sub_v3_v3v3(val, intr, vd.co);
+				sub_v3_v3v3(val, intr, vd.co);
 
-					if (plane_trim(ss->cache, brush, val)) {
-						const float fade = bstrength * tex_strength(ss, brush, vd.co, sqrtf(test.dist),
-						                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
+				if (plane_trim(ss->cache, brush, val)) {
+					const float fade = bstrength * tex_strength(ss, brush, vd.co,
+					                                            ss->cache->radius * test.dist,
+					                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
 
-						mul_v3_v3fl(proxy[vd.i], val, fade);
+					mul_v3_v3fl(proxy[vd.i], val, fade);
 
-						if (vd.mvert)
-							vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-					}
+					if (vd.mvert)
+						vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 				}
 			}
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_clay_strips_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
+	SculptThreadedTaskData data = {NULL};
 
 	float bstrength = ss->cache->bstrength;
 	float radius    = ss->cache->radius;
@@ -2656,7 +2934,6 @@ static void do_clay_strips_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int t
 	float an[3];
 	float fc[3];
 
-	int n;
 
 	float temp[3];
 	float mat[4][4];
@@ -2705,48 +2982,68 @@ static void do_clay_strips_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int t
 	mul_m4_m4m4(tmat, mat, scale);
 	invert_m4_m4(mat, tmat);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.flip = flip;
+	data.mat = mat;
+	data.area_co = fc;
+	data.area_no = sn;
+
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_clay_strips_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
+
+static void do_fill_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *area_co = data->area_co;
+	const float *area_no = data->area_no;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-		sculpt_brush_test_init(ss, &test);
+	sculpt_brush_test_init(ss, &test);
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test_cube(&test, vd.co, mat)) {
-				if (plane_point_side_flip(vd.co, sn, fc, flip)) {
-					float intr[3];
-					float val[3];
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test_sq(&test, vd.co)) {
+			if (plane_point_side(vd.co, area_no, area_co)) {
+				float intr[3];
+				float val[3];
 
-					point_plane_project(intr, vd.co, sn, fc);
+				point_plane_project(intr, vd.co, area_no, area_co);
 
-					sub_v3_v3v3(val, intr, vd.co);
+				sub_v3_v3v3(val, intr, vd.co);
 
-					if (plane_trim(ss->cache, brush, val)) {
-						const float fade = bstrength * tex_strength(ss, brush, vd.co,
-						                                            ss->cache->radius * test.dist,
-						                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
+				if (plane_trim(ss->cache, brush, val)) {
+					const float fade = bstrength * tex_strength(ss, brush, vd.co,
+					                                            sqrtf(test.dist),
+					                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
 
-						mul_v3_v3fl(proxy[vd.i], val, fade);
+					mul_v3_v3fl(proxy[vd.i], val, fade);
 
-						if (vd.mvert)
-							vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-					}
+					if (vd.mvert)
+						vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 				}
 			}
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_fill_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
+	SculptThreadedTaskData data = {NULL};
 
 	float bstrength = ss->cache->bstrength;
 	const float radius = ss->cache->radius;
@@ -2757,7 +3054,6 @@ static void do_fill_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 
 	float displace;
 
-	int n;
 
 	float temp[3];
 
@@ -2769,48 +3065,66 @@ static void do_fill_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 	mul_v3_fl(temp, displace);
 	add_v3_v3(fc, temp);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.area_co = fc;
+	data.area_no = an;
+
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_fill_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+static void do_scrape_brush_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float bstrength = data->bstrength;
+	const float *area_co = data->area_co;
+	const float *area_no = data->area_no;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-		sculpt_brush_test_init(ss, &test);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test_sq(&test, vd.co)) {
-				if (plane_point_side(vd.co, an, fc)) {
-					float intr[3];
-					float val[3];
+	sculpt_brush_test_init(ss, &test);
 
-					point_plane_project(intr, vd.co, an, fc);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		if (sculpt_brush_test_sq(&test, vd.co)) {
+			if (!plane_point_side(vd.co, area_no, area_co)) {
+				float intr[3];
+				float val[3];
 
-					sub_v3_v3v3(val, intr, vd.co);
+				point_plane_project(intr, vd.co, area_no, area_co);
 
-					if (plane_trim(ss->cache, brush, val)) {
-						const float fade = bstrength * tex_strength(ss, brush, vd.co,
-						                                            sqrtf(test.dist),
-						                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
+				sub_v3_v3v3(val, intr, vd.co);
 
-						mul_v3_v3fl(proxy[vd.i], val, fade);
+				if (plane_trim(ss->cache, brush, val)) {
+					const float fade = bstrength * tex_strength(ss, brush, vd.co,
+					                                            sqrtf(test.dist),
+					                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
 
-						if (vd.mvert)
-							vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-					}
+					mul_v3_v3fl(proxy[vd.i], val, fade);
+
+					if (vd.mvert)
+						vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 				}
 			}
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_scrape_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 {
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
+	SculptThreadedTaskData data = {NULL};
 
 	float bstrength = ss->cache->bstrength;
 	const float radius = ss->cache->radius;
@@ -2821,7 +3135,6 @@ static void do_scrape_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnod
 
 	float displace;
 
-	int n;
 
 	float temp[3];
 
@@ -2833,51 +3146,53 @@ static void do_scrape_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnod
 	mul_v3_fl(temp, displace);
 	add_v3_v3(fc, temp);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
-
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.bstrength = bstrength;
+	data.area_co = fc;
+	data.area_no = an;
 
-		sculpt_brush_test_init(ss, &test);
+	BLI_task_parallel_range_thread_ex(
+	        0, totnode, &data, do_scrape_brush_task_cb, sculpt_threaded_limit(sd), false);
+}
 
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-		{
-			if (sculpt_brush_test_sq(&test, vd.co)) {
-				if (!plane_point_side(vd.co, an, fc)) {
-					float intr[3];
-					float val[3];
+static void do_gravity_task_cb(void *userdata, int n, int thread_id)
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	Brush *brush = data->brush;
+	const float *offset = data->offset;
+	PBVHVertexIter vd;
+	SculptBrushTest test;
+	float (*proxy)[3];
 
-					point_plane_project(intr, vd.co, an, fc);
+	proxy = BKE_pbvh_node_add_proxy(ss->pbvh, data->nodes[n])->co;
 
-					sub_v3_v3v3(val, intr, vd.co);
+	sculpt_brush_test_init(ss, &test);
 
-					if (plane_trim(ss->cache, brush, val)) {
-						const float fade = bstrength * tex_strength(ss, brush, vd.co,
-						                                            sqrtf(test.dist),
-						                                            vd.no, vd.fno, vd.mask ? *vd.mask : 0.0f);
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
+		if (sculpt_brush_test_sq(&test, vd.co)) {
+			const float fade = tex_strength(ss, brush, vd.co, sqrtf(test.dist), vd.no,
+			                                vd.fno, vd.mask ? *vd.mask : 0.0f, thread_id);
 
-						mul_v3_v3fl(proxy[vd.i], val, fade);
+			mul_v3_v3fl(proxy[vd.i], offset, fade);
 
-						if (vd.mvert)
-							vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-					}
-				}
-			}
+			if (vd.mvert)
+				vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
 		}
-		BKE_pbvh_vertex_iter_end;
 	}
+	BKE_pbvh_vertex_iter_end;
 }
 
 static void do_gravity(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode, float bstrength)
 {
 	SculptSession *ss = ob->sculpt;
 	Brush *brush = BKE_paint_brush(&sd->paint);
+	SculptThreadedTaskData data = {NULL};
 
 	float offset[3]/*, an[3]*/;
-	int n;
 	float gravity_vector[3];
 
 	mul_v3_v3fl(gravity_vector, ss->cache->gravity_direction, -ss->cache->radius_squared);
@@ -2886,30 +3201,14 @@ static void do_gravity(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode, fl
 	mul_v3_v3v3(offset, gravity_vector, ss->cache->scale);
 	mul_v3_fl(offset, bstrength);
 
-	/* threaded loop over nodes */
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-	for (n = 0; n < totnode; n++) {
-		PBVHVertexIter vd;
-		SculptBrushTest test;
-		float (*proxy)[3];
-
-		proxy = BKE_pbvh_node_add_proxy(ss->pbvh, nodes[n])->co;
-
-		sculpt_brush_test_init(ss, &test);
-
-		BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE) {
-			if (sculpt_brush_test_sq(&test, vd.co)) {
-				const float fade = tex_strength(ss, brush, vd.co, sqrtf(test.dist), vd.no,
-				                                vd.fno, vd.mask ? *vd.mask : 0.0f);
-
-				mul_v3_v3fl(proxy[vd.i], offset, fade);
+	data.sd = sd;
+	data.ob = ob;
+	data.brush = brush;
+	data.nodes = nodes;
+	data.offset = offset;
 
-				if (vd.mvert)
-					vd.mvert->flag |= ME_VERT_PBVH_UPDATE;
-			}
-		}
-		BKE_pbvh_vertex_iter_end;
-	}
+	/* threaded loop over nodes */
+	BLI_task_parallel_range_thread_ex(0, totnode, &data, do_gravity_task_cb, sculpt_threaded_limit(sd), false);
 }
 
 
@@ -3024,12 +3323,20 @@ static void sculpt_topology_update(Sculpt *sd, Object *ob, Brush *brush)
 	}
 }
 
+static void do_brush_action_undo_push_task_cb(void *userdata, int n, int UNUSED(thread_id))
+{
+	SculptThreadedTaskData *data = userdata;
+
+	sculpt_undo_push_node(data->ob, data->nodes[n], data->undo_type);
+	BKE_pbvh_node_mark_update(data->nodes[n]);
+}
+
 static void do_brush_action(Sculpt *sd, Object *ob, Brush *brush)
 {
 	SculptSession *ss = ob->sculpt;
 	SculptSearchSphereData data;
 	PBVHNode **nodes = NULL;
-	int n, totnode;
+	int totnode;
 
 	/* Build a list of all nodes that are potentially within the brush's area of influence */
 	data.ss = ss;
@@ -3044,15 +3351,16 @@ static void do_brush_action(Sculpt *sd, Object *ob, Brush *brush)
 
 	/* Only act if some verts are inside the brush area */
 	if (totnode) {
+		SculptThreadedTaskData task_data = {NULL};
 		float location[3];
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-		for (n = 0; n < totnode; n++) {
-			sculpt_undo_push_node(ob, nodes[n],
-			                      brush->sculpt_tool == SCULPT_TOOL_MASK ?
-			                      SCULPT_UNDO_MASK : SCULPT_UNDO_COORDS);
-			BKE_pbvh_node_mark_update(nodes[n]);
-		}
+		task_data.sd = sd;
+		task_data.ob = ob;
+		task_data.nodes = nodes;
+		task_data.undo_type = (brush->sculpt_tool == SCULPT_TOOL_MASK) ? SCULPT_UNDO_MASK : SCULPT_UNDO_COORDS;
+
+		BLI_task_parallel_range_thread_ex(
+		        0, totnode, &task_data, do_brush_action_undo_push_task_cb, sculpt_threaded_limit(sd), false);
 
 		if (brush_needs_sculpt_normal(brush))
 			update_sculpt_normal(sd, ob, nodes, totnode);
@@ -3162,64 +3470,76 @@ static void sculpt_flush_pbvhvert_deform(Object *ob, PBVHVertexIter *vd)
 		copy_v3_v3(me->mvert[index].co, newco);
 }
 
-static void sculpt_combine_proxies(Sculpt *sd, Object *ob)
+static void sculpt_combine_proxies_task_cb(void *userdata, int n, int UNUSED(thread_id))
 {
-	SculptSession *ss = ob->sculpt;
-	Brush *brush = BKE_paint_brush(&sd->paint);
-	PBVHNode **nodes;
-	int totnode, n;
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	const bool use_orco = data->use_orco;
+	PBVHVertexIter vd;
+	PBVHProxyNode *proxies;
+	int proxy_count;
+	float (*orco)[3] = NULL;
 
-	BKE_pbvh_gather_proxies(ss->pbvh, &nodes, &totnode);
+	if (use_orco && !ss->bm)
+		orco = sculpt_undo_push_node(data->ob, data->nodes[n], SCULPT_UNDO_COORDS)->co;
 
-	/* first line is tools that don't support proxies */
-	if (!ELEM(brush->sculpt_tool, SCULPT_TOOL_SMOOTH, SCULPT_TOOL_LAYER) ||
-	    ss->cache->supports_gravity)
+	BKE_pbvh_node_get_proxies(data->nodes[n], &proxies, &proxy_count);
+
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
 	{
-		/* these brushes start from original coordinates */
-		const bool use_orco = ELEM(brush->sculpt_tool, SCULPT_TOOL_GRAB,
-		                           SCULPT_TOOL_ROTATE, SCULPT_TOOL_THUMB);
+		float val[3];
+		int p;
+
+		if (use_orco) {
+			if (ss->bm) {
+				copy_v3_v3(val,
+				           BM_log_original_vert_co(ss->bm_log,
+				           vd.bm_vert));
+			}
+			else
+				copy_v3_v3(val, orco[vd.i]);
+		}
+		else
+			copy_v3_v3(val, vd.co);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-		for (n = 0; n < totnode; n++) {
-			PBVHVertexIter vd;
-			PBVHProxyNode *proxies;
-			int proxy_count;
-			float (*orco)[3] = NULL;
+		for (p = 0; p < proxy_count; p++)
+			add_v3_v3(val, proxies[p].co[vd.i]);
 
-			if (use_orco && !ss->bm)
-				orco = sculpt_undo_push_node(ob, nodes[n], SCULPT_UNDO_COORDS)->co;
+		sculpt_clip(data->sd, ss, vd.co, val);
 
-			BKE_pbvh_node_get_proxies(nodes[n], &proxies, &proxy_count);
+		if (ss->modifiers_active)
+			sculpt_flush_pbvhvert_deform(data->ob, &vd);
+	}
+	BKE_pbvh_vertex_iter_end;
 
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				float val[3];
-				int p;
+	BKE_pbvh_node_free_proxies(data->nodes[n]);
+}
 
-				if (use_orco) {
-					if (ss->bm) {
-						copy_v3_v3(val,
-						           BM_log_original_vert_co(ss->bm_log,
-						           vd.bm_vert));
-					}
-					else
-						copy_v3_v3(val, orco[vd.i]);
-				}
-				else
-					copy_v3_v3(val, vd.co);
+static void sculpt_combine_proxies(Sculpt *sd, Object *ob)
+{
+	SculptSession *ss = ob->sculpt;
+	Brush *brush = BKE_paint_brush(&sd->paint);
+	PBVHNode **nodes;
+	int totnode;
 
-				for (p = 0; p < proxy_count; p++)
-					add_v3_v3(val, proxies[p].co[vd.i]);
+	BKE_pbvh_gather_proxies(ss->pbvh, &nodes, &totnode);
 
-				sculpt_clip(sd, ss, vd.co, val);
+	/* first line is tools that don't support proxies */
+	if (totnode &&
+	    (!ELEM(brush->sculpt_tool, SCULPT_TOOL_SMOOTH, SCULPT_TOOL_LAYER) ||
+	     ss->cache->supports_gravity))
+	{
+		SculptThreadedTaskData data = {NULL};
 
-				if (ss->modifiers_active)
-					sculpt_flush_pbvhvert_deform(ob, &vd);
-			}
-			BKE_pbvh_vertex_iter_end;
+		data.sd = sd;
+		data.ob = ob;
+		data.nodes = nodes;
+		/* these brushes start from original coordinates */
+		data.use_orco = ELEM(brush->sculpt_tool, SCULPT_TOOL_GRAB,
+		                     SCULPT_TOOL_ROTATE, SCULPT_TOOL_THUMB);
 
-			BKE_pbvh_node_free_proxies(nodes[n]);
-		}
+		BLI_task_parallel_range_thread_ex(
+		        0, totnode, &data, sculpt_combine_proxies_task_cb, sculpt_threaded_limit(sd), false);
 	}
 
 	if (nodes)
@@ -3246,6 +3566,25 @@ static void sculpt_update_keyblock(Object *ob)
 }
 
 /* flush displacement from deformed PBVH to original layer */
+static void sculpt_flush_stroke_deform_task_cb(void *userdata, int n, int UNUSED(thread_id))
+{
+	SculptThreadedTaskData *data = userdata;
+	SculptSession *ss = data->ob->sculpt;
+	float (*vertCos)[3] = data->vertCos;
+	PBVHVertexIter vd;
+
+	BKE_pbvh_vertex_iter_begin(ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE)
+	{
+		sculpt_flush_pbvhvert_deform(data->ob, &vd);
+
+		if (vertCos) {
+			int index = vd.vert_indices[vd.i];
+			copy_v3_v3(vertCos[index], ss->orig_cos[index]);
+		}
+	}
+	BKE_pbvh_vertex_iter_end;
+}
+
 static void sculpt_flush_stroke_deform(Sculpt *sd, Object *ob)
 {
 	SculptSession *ss = ob->sculpt;
@@ -3255,7 +3594,8 @@ static void sculpt_flush_stroke_deform(Sculpt *sd, Object *ob)
 		/* this brushes aren't using proxies, so sculpt_combine_proxies() wouldn't
 		 * propagate needed deformation to original base */
 
-		int n, totnode;
+		SculptThreadedTaskData data = {NULL};
+		int totnode;
 		Mesh *me = (Mesh *)ob->data;
 		PBVHNode **nodes;
 		float (*vertCos)[3] = NULL;
@@ -3272,20 +3612,14 @@ static void sculpt_flush_stroke_deform(Sculpt *sd, Object *ob)
 
 		BKE_pbvh_search_gather(ss->pbvh, NULL, NULL, &nodes, &totnode);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
-		for (n = 0; n < totnode; n++) {
-			PBVHVertexIter vd;
-
-			BKE_pbvh_vertex_iter_begin(ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE)
-			{
-				sculpt_flush_pbvhvert_deform(ob, &vd);
+		data.sd = sd;
+		data.ob = ob;
+		data.nodes = nodes;
+		data.vertCos = vertCos;
 
-				if (vertCos) {
-					int index = vd.vert_indices[vd.i];
-					copy_v3_v3(vertCos[index], ss->orig_cos[index]);
-				}
-			}
-			BKE_pbvh_vertex_iter_end;
+		if (totnode) {
+			BLI_task_parallel_range_thread_ex(
+			        0, totnode, &data, sculpt_flush_stroke_deform_task_cb, sculpt_threaded_limit(sd), false);
 		}
 
 		if (vertCos) {
@@ -3552,36 +3886,14 @@ static void sculpt_init_mirror_clipping(Object *ob, SculptSession *ss)
 	}
 }
 
-static void sculpt_omp_start(Sculpt *sd, SculptSession *ss)
+static void sculpt_threaded_start(SculptSession *ss)
 {
 	StrokeCache *cache = ss->cache;
 
-#ifdef _OPENMP
+	/* Threaded loops index the per thread storage by the task scheduler thread id,
+	 * allocate for all of them even when threading is disabled so the setting can change during the stroke. */
+	cache->num_threads = BLI_task_scheduler_num_threads(BLI_task_scheduler_get());
 
-#if defined(__APPLE__)
-	cache->init_num_threads = BLI_system_thread_count();
-#else
-	cache->init_num_threads = omp_get_max_threads();
-#endif
-	/* If using OpenMP then create a number of threads two times the
-	 * number of processor cores.
-	 * Justification: Empirically I've found that two threads per
-	 * processor gives higher throughput. */
-	if (sd->flags & SCULPT_USE_OPENMP) {
-#if defined(__APPLE__)
-		cache->num_threads = system_physical_thread_count();
-#else
-		cache->num_threads = 2 * omp_get_num_procs();
-#endif
-	}
-	else {
-		cache->num_threads = 1;
-	}
-	omp_set_num_threads(cache->num_threads);
-#else
-	(void)sd;
-	cache->num_threads = 1;
-#endif
 	if (ss->multires) {
 		int i, gridsize, array_mem_size;
 		BKE_pbvh_node_get_grids(ss->pbvh, NULL, NULL, NULL, NULL,
@@ -3606,12 +3918,8 @@ static void sculpt_omp_start(Sculpt *sd, SculptSession *ss)
 	}
 }
 
-static void sculpt_omp_done(SculptSession *ss)
+static void sculpt_threaded_done(SculptSession *ss)
 {
-#ifdef _OPENMP
-	omp_set_num_threads(ss->cache->init_num_threads);
-#endif
-
 	if (ss->multires) {
 		int i;
 
@@ -3801,7 +4109,7 @@ static void sculpt_update_cache_invariants(bContext *C, Sculpt *sd, SculptSessio
 		
 #undef PIXEL_INPUT_THRESHHOLD
 	
-	sculpt_omp_start(sd, ss);
+	sculpt_threaded_start(ss);
 }
 
 static void sculpt_update_brush_delta(UnifiedPaintSettings *ups, Object *ob, Brush *brush)
@@ -4340,7 +4648,7 @@ static void sculpt_stroke_done(const bContext *C, struct PaintStroke *UNUSED(str
 	SculptSession *ss = ob->sculpt;
 	Sculpt *sd = CTX_data_tool_settings(C)->sculpt;
 
-	sculpt_omp_done(ss);
+	sculpt_threaded_done(ss);
 
 	/* Finished */
 	if (ss->cache) {
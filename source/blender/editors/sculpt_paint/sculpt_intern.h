@@ -130,11 +130,11 @@ void sculpt_vertcos_to_key(Object *ob, KeyBlock *kb, float (*vertCos)[3]);
 
 void sculpt_update_object_bounding_box(struct Object *ob);
 
-/* Setting zero so we can catch bugs in OpenMP/sculpt. */
+/* Setting zero so we can catch bugs in threaded sculpt loops. */
 #ifdef DEBUG
-#  define SCULPT_OMP_LIMIT 0
+#  define SCULPT_THREADED_LIMIT 0
 #else
-#  define SCULPT_OMP_LIMIT 4
+#  define SCULPT_THREADED_LIMIT 4
 #endif
 
 #endif
@@ -283,15 +283,11 @@ static void sculpt_undo_bmesh_restore_generic(bContext *C,
 		int i, totnode;
 		PBVHNode **nodes;
 
-#ifdef _OPENMP
-		Sculpt *sd = CTX_data_tool_settings(C)->sculpt;
-#else
 		(void)C;
-#endif
 
 		BKE_pbvh_search_gather(ss->pbvh, NULL, NULL, &nodes, &totnode);
 
-#pragma omp parallel for schedule(guided) if ((sd->flags & SCULPT_USE_OPENMP) && totnode > SCULPT_OMP_LIMIT)
+		/* only sets a flag per node, not worth threading */
 		for (i = 0; i < totnode; i++) {
 			BKE_pbvh_node_mark_redraw(nodes[i]);
 		}
@@ -1253,7 +1253,6 @@ static void track_markers_startjob(void *tmv, short *stop, short *do_update, flo
 {
 	TrackMarkersJob *tmj = (TrackMarkersJob *)tmv;
 	int framenr = tmj->sfra;
-	// double t = PIL_check_seconds_timer();
 
 	while (framenr != tmj->efra) {
 		if (tmj->delay > 0) {
@@ -1288,8 +1287,6 @@ static void track_markers_startjob(void *tmv, short *stop, short *do_update, flo
 		if (*stop || track_markers_testbreak())
 			break;
 	}
-
-	// printf("Tracking time: %lf\n", PIL_check_seconds_timer()-t);
 }
 
 static void track_markers_updatejob(void *tmv)
@@ -1313,6 +1310,10 @@ static void track_markers_endjob(void *tmv)
 	BKE_autotrack_context_sync(tmj->context);
 	BKE_autotrack_context_finish(tmj->context);
 
+	if (G.debug & G_DEBUG) {
+		BKE_autotrack_context_print_stats(tmj->context);
+	}
+
 	WM_main_add_notifier(NC_SCENE | ND_FRAME, tmj->scene);
 }
 
@@ -1403,6 +1404,11 @@ static int track_markers_exec(bContext *C, wmOperator *op)
 
 	BKE_autotrack_context_sync(context);
 	BKE_autotrack_context_finish(context);
+
+	if (G.debug & G_DEBUG) {
+		BKE_autotrack_context_print_stats(context);
+	}
+
 	BKE_autotrack_context_free(context);
 
 	/* update scene current frame to the lastes tracked frame */
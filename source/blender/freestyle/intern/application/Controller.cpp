@@ -48,6 +48,7 @@ extern "C" {
 #include "../stroke/StrokeTesselator.h"
 #include "../stroke/StyleModule.h"
 
+#include "../system/MemoryPool.h"
 #include "../system/StringUtils.h"
 #include "../system/PythonInterpreter.h"
 
@@ -156,11 +157,14 @@ Controller::~Controller()
 		delete _winged_edge;
 		_winged_edge = NULL;
 	}
+	_shapeCache.clear();
+	WingedEdge::releaseMemoryPools();
 
 	if (0 != _ViewMap) {
 		delete _ViewMap;
 		_ViewMap = 0;
 	}
+	ViewMap::releaseMemoryPools();
 
 	if (0 != _Canvas) {
 		delete _Canvas;
@@ -227,6 +231,14 @@ bool Controller::hitViewMapCache()
 	return false;
 }
 
+// Memory used by the pooled winged-edge and view map elements, and its peak since the last phase started
+static void printPoolMemory()
+{
+	printf("Pooled memory    : %.2fM (peak %.2fM)\n",
+	       MemoryPoolBase::getMemoryInUse() / (1024.0 * 1024.0),
+	       MemoryPoolBase::getPeakMemory() / (1024.0 * 1024.0));
+}
+
 int Controller::LoadMesh(Render *re, SceneRenderLayer *srl)
 {
 	BlenderFileLoader loader(re, srl);
@@ -292,19 +304,29 @@ int Controller::LoadMesh(Render *re, SceneRenderLayer *srl)
 		else {
 			delete _ViewMap;
 			_ViewMap = NULL;
+			ViewMap::releaseMemoryPools();
 		}
 	}
 
+	MemoryPoolBase::resetPeakMemory();
 	_Chrono.start();
 
 	WXEdgeBuilder wx_builder;
 	wx_builder.setRenderMonitor(_pRenderMonitor);
+	if (_EnableViewMapCache) {
+		wx_builder.setShapeCache(&_shapeCache);
+	}
 	blenderScene->accept(wx_builder);
 	_winged_edge = wx_builder.getWingedEdge();
 
 	duration = _Chrono.stop();
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		printf("WEdge building   : %lf\n", duration);
+		printPoolMemory();
+		if (_EnableViewMapCache) {
+			printf("WEdge shapes     : %u reused of %u\n", wx_builder.getNumReusedShapes(),
+			       (unsigned)_winged_edge->getWShapes().size());
+		}
 	}
 
 #if 0
@@ -378,9 +400,17 @@ void Controller::ClearRootNode()
 void Controller::DeleteWingedEdge()
 {
 	if (_winged_edge) {
+		if (_EnableViewMapCache) {
+			// keep the shapes for the next render layer or frame
+			_shapeCache.store(*_winged_edge);
+		}
 		delete _winged_edge;
 		_winged_edge = NULL;
 	}
+	if (!_EnableViewMapCache) {
+		_shapeCache.clear();
+	}
+	WingedEdge::releaseMemoryPools();
 
 	// clears the grid
 	_Grid.clear();
@@ -429,6 +459,7 @@ void Controller::DeleteViewMap(bool freeCache)
 			delete _ViewMap;
 			_ViewMap = NULL;
 			prevSceneHash = -1.0;
+			ViewMap::releaseMemoryPools();
 		}
 		else {
 			_ViewMap->Clean();
@@ -436,6 +467,18 @@ void Controller::DeleteViewMap(bool freeCache)
 	}
 }
 
+void Controller::PurgeWingedEdgeCache(bool freeAll)
+{
+	if (freeAll) {
+		_shapeCache.clear();
+	}
+	else {
+		// free the shapes of the objects that changed or disappeared since the previous render
+		_shapeCache.purge();
+	}
+	WingedEdge::releaseMemoryPools();
+}
+
 void Controller::ComputeViewMap()
 {
 	if (!_ListOfModels.size())
@@ -513,6 +556,7 @@ void Controller::ComputeViewMap()
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		cout << "\n===  Detecting silhouette edges  ===" << endl;
 	}
+	MemoryPoolBase::resetPeakMemory();
 	_Chrono.start();
 
 	edgeDetector.setViewpoint(Vec3r(vp));
@@ -530,6 +574,7 @@ void Controller::ComputeViewMap()
 	real duration = _Chrono.stop();
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		printf("Feature lines    : %lf\n", duration);
+		printPoolMemory();
 	}
 
 	if (_pRenderMonitor->testBreak())
@@ -557,6 +602,7 @@ void Controller::ComputeViewMap()
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		cout << "\n===  Building the view map  ===" << endl;
 	}
+	MemoryPoolBase::resetPeakMemory();
 	_Chrono.start();
 	// Build View Map
 	_ViewMap = vmBuilder.BuildViewMap(*_winged_edge, _VisibilityAlgo, _EPSILON, _Scene3dBBox, _SceneNumFaces);
@@ -579,6 +625,7 @@ void Controller::ComputeViewMap()
 	duration = _Chrono.stop();
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		printf("ViewMap building : %lf\n", duration);
+		printPoolMemory();
 	}
 
 	_pView->AddSilhouette(_SilhouetteNode);
@@ -846,12 +893,14 @@ void Controller::DrawStrokes()
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		cout << "\n===  Stroke drawing  ===" << endl;
 	}
+	MemoryPoolBase::resetPeakMemory();
 	_Chrono.start();
 	_Canvas->Draw();
 	real d = _Chrono.stop();
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		cout << "Strokes generation  : " << d << endl;
 		cout << "Stroke count  : " << _Canvas->stroke_count << endl;
+		printPoolMemory();
 	}
 	resetModified();
 	DeleteViewMap();
@@ -40,6 +40,7 @@
 #include "../system/TimeUtils.h"
 #include "../view_map/FEdgeXDetector.h"
 #include "../view_map/ViewMapBuilder.h"
+#include "../winged_edge/WXShapeCache.h"
 
 extern "C" {
 #include "render_types.h"
@@ -98,6 +99,7 @@ public:
 	void ClearRootNode();
 	void DeleteWingedEdge();
 	void DeleteViewMap(bool freeCache = false);
+	void PurgeWingedEdgeCache(bool freeAll = false);
 	void toggleLayer(unsigned index, bool iDisplay);
 	void setModified(unsigned index, bool iMod);
 	void resetModified(bool iMod=false);
@@ -253,6 +255,9 @@ private:
 	SceneHash sceneHashFunc;
 	real prevSceneHash;
 
+	// winged-edge shapes of the previous loads, reused for unchanged objects
+	WXShapeCache _shapeCache;
+
 #ifdef WITH_CXX_GUARDEDALLOC
 	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:Controller")
 #endif
@@ -579,6 +579,7 @@ void FRS_init_stroke_rendering(Render *re)
 	init_camera(re);
 
 	controller->ResetRenderCount();
+	controller->PurgeWingedEdgeCache();
 }
 
 Render *FRS_do_stroke_rendering(Render *re, SceneRenderLayer *srl, int render)
@@ -655,6 +656,7 @@ void FRS_free_view_map_cache(void)
 {
 	// free cache
 	controller->DeleteViewMap(true);
+	controller->PurgeWingedEdgeCache(true);
 #if 0
 	if (G.debug & G_DEBUG_FREESTYLE) {
 		printf("View map cache freed\n");
@@ -24,6 +24,10 @@
 
 #include "SceneHash.h"
 
+extern "C" {
+#include "BLI_hash_mm2a.h"
+}
+
 namespace Freestyle {
 
 void SceneHash::visitIndexedFaceSet(IndexedFaceSet& ifs)
@@ -36,4 +40,34 @@ void SceneHash::visitIndexedFaceSet(IndexedFaceSet& ifs)
 	}
 }
 
+static void hash_add_array(BLI_HashMurmur2A *mm2, const void *data, size_t len)
+{
+	BLI_hash_mm2a_add_int(mm2, (int)len);
+	if (data && len) {
+		BLI_hash_mm2a_add(mm2, (const unsigned char *)data, len);
+	}
+}
+
+unsigned int SceneHash::hashIndexedFaceSet(const IndexedFaceSet& ifs)
+{
+	BLI_HashMurmur2A mm2;
+
+	BLI_hash_mm2a_init(&mm2, 0);
+
+	hash_add_array(&mm2, ifs.vertices(), ifs.vsize() * sizeof(real));
+	hash_add_array(&mm2, ifs.normals(), ifs.nsize() * sizeof(real));
+	hash_add_array(&mm2, ifs.texCoords(), ifs.tsize() * sizeof(real));
+
+	hash_add_array(&mm2, ifs.numVertexPerFaces(), ifs.numFaces() * sizeof(unsigned));
+	hash_add_array(&mm2, ifs.trianglesStyle(), ifs.numFaces() * sizeof(IndexedFaceSet::TRIANGLES_STYLE));
+	hash_add_array(&mm2, ifs.faceEdgeMarks(), ifs.numFaces() * sizeof(IndexedFaceSet::FaceEdgeMark));
+
+	hash_add_array(&mm2, ifs.vindices(), ifs.visize() * sizeof(unsigned));
+	hash_add_array(&mm2, ifs.nindices(), ifs.nisize() * sizeof(unsigned));
+	hash_add_array(&mm2, ifs.mindices(), ifs.misize() * sizeof(unsigned));
+	hash_add_array(&mm2, ifs.tindices(), ifs.tisize() * sizeof(unsigned));
+
+	return BLI_hash_mm2a_end(&mm2);
+}
+
 } /* namespace Freestyle */
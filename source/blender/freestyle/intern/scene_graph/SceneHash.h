@@ -54,6 +54,11 @@ public:
 		_hashcode = 0.0;
 	}
 
+	/*! Returns a hash of a single face set: its vertices, normals, texture coordinates, faces and edge marks.
+	 *  Used to find out whether the winged-edge shape built from it on a previous load can be reused.
+	 */
+	static unsigned int hashIndexedFaceSet(const IndexedFaceSet& ifs);
+
 private:
 	real _hashcode;
 
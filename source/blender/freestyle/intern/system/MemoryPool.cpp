@@ -0,0 +1,68 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/freestyle/intern/system/MemoryPool.cpp
+ *  \ingroup freestyle
+ *  \brief Pooled allocation of the many small elements of the winged-edge and view map structures
+ */
+
+#include "MemoryPool.h"
+
+#include "atomic_ops.h"
+
+namespace Freestyle {
+
+size_t MemoryPoolBase::_memInUse = 0;
+size_t MemoryPoolBase::_memPeak = 0;
+
+size_t MemoryPoolBase::getMemoryInUse()
+{
+	return _memInUse;
+}
+
+size_t MemoryPoolBase::getPeakMemory()
+{
+	return _memPeak;
+}
+
+void MemoryPoolBase::resetPeakMemory()
+{
+	_memPeak = _memInUse;
+}
+
+void MemoryPoolBase::addMemoryInUse(size_t num_bytes)
+{
+	size_t memInUse = atomic_add_z(&_memInUse, num_bytes);
+	size_t memPeak = _memPeak;
+
+	while (memInUse > memPeak) {
+		size_t prevPeak = atomic_cas_z(&_memPeak, memPeak, memInUse);
+		if (prevPeak == memPeak)
+			break;
+		memPeak = prevPeak;
+	}
+}
+
+void MemoryPoolBase::subMemoryInUse(size_t num_bytes)
+{
+	atomic_sub_z(&_memInUse, num_bytes);
+}
+
+} /* namespace Freestyle */
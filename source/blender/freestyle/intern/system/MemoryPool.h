@@ -0,0 +1,139 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __FREESTYLE_MEMORY_POOL_H__
+#define __FREESTYLE_MEMORY_POOL_H__
+
+/** \file blender/freestyle/intern/system/MemoryPool.h
+ *  \ingroup freestyle
+ *  \brief Pooled allocation of the many small elements of the winged-edge and view map structures
+ */
+
+#include <stddef.h>
+
+#include "BLI_mempool.h"
+#include "BLI_threads.h"
+
+#include "MEM_guardedalloc.h"
+
+namespace Freestyle {
+
+/*! Statistics shared by all the pools */
+class MemoryPoolBase
+{
+public:
+	/*! Memory used by the elements of all pools, in bytes */
+	static size_t getMemoryInUse();
+
+	/*! Highest memory used by the elements of all pools since the last call to resetPeakMemory(), in bytes */
+	static size_t getPeakMemory();
+
+	static void resetPeakMemory();
+
+protected:
+	static void addMemoryInUse(size_t num_bytes);
+	static void subMemoryInUse(size_t num_bytes);
+
+	static size_t _memInUse;
+	static size_t _memPeak;
+};
+
+/*! Allocates the elements of type T from a BLI_mempool instead of one by one, which keeps them close in memory
+ *  and saves the allocation header of each element.
+ *  The pool is created for the first element. Freed elements go back to the pool, and its memory is given back
+ *  in bulk by release() at the end of a render layer, once the view map and winged-edge are freed.
+ *  Derived classes that don't have a pool of their own are allocated with MEM_mallocN.
+ */
+template <class T>
+class MemoryPool : public MemoryPoolBase
+{
+public:
+	static void *alloc(size_t num_bytes, const char *str)
+	{
+		void *mem;
+
+		if (num_bytes != sizeof(T)) {
+			return MEM_mallocN(num_bytes, str);
+		}
+
+		BLI_mutex_lock(&_mutex);
+		if (_pool == NULL) {
+			_pool = BLI_mempool_create(sizeof(T), 0, 512, BLI_MEMPOOL_NOP);
+		}
+		mem = BLI_mempool_alloc(_pool);
+		BLI_mutex_unlock(&_mutex);
+
+		addMemoryInUse(sizeof(T));
+
+		return mem;
+	}
+
+	static void free(void *mem, size_t num_bytes)
+	{
+		if (num_bytes != sizeof(T)) {
+			MEM_freeN(mem);
+			return;
+		}
+
+		BLI_mutex_lock(&_mutex);
+		BLI_mempool_free(_pool, mem);
+		BLI_mutex_unlock(&_mutex);
+
+		subMemoryInUse(sizeof(T));
+	}
+
+	/*! Destroys the pool once all its elements have been deleted. Elements still in use, like the shapes kept
+	 *  by the WXShapeCache for the next render layer, keep the pool alive for their own reuse. */
+	static void release()
+	{
+		BLI_mutex_lock(&_mutex);
+		if (_pool && BLI_mempool_count(_pool) == 0) {
+			BLI_mempool_destroy(_pool);
+			_pool = NULL;
+		}
+		BLI_mutex_unlock(&_mutex);
+	}
+
+private:
+	static BLI_mempool *_pool;
+	static ThreadMutex _mutex;
+};
+
+template <class T>
+BLI_mempool *MemoryPool<T>::_pool = NULL;
+
+template <class T>
+ThreadMutex MemoryPool<T>::_mutex = BLI_MUTEX_INITIALIZER;
+
+/* Like MEM_CXX_CLASS_ALLOC_FUNCS, for classes allocated from a MemoryPool. The sized operator delete gets the
+ * size of the actual (derived) class being freed, from the virtual destructor. */
+#define FRS_POOL_CLASS_ALLOC_FUNCS(_type, _id)                                \
+public:                                                                       \
+	void *operator new(size_t num_bytes) {                                    \
+		return MemoryPool<_type>::alloc(num_bytes, _id);                      \
+	}                                                                         \
+	void operator delete(void *mem, size_t num_bytes) {                       \
+		if (mem)                                                              \
+			MemoryPool<_type>::free(mem, num_bytes);                          \
+	}                                                                         \
+
+} /* namespace Freestyle */
+
+#endif // __FREESTYLE_MEMORY_POOL_H__
@@ -45,6 +45,7 @@
 
 #include "../system/Exception.h"
 #include "../system/FreestyleConfig.h"
+#include "../system/MemoryPool.h"
 
 #include "../winged_edge/Curvature.h"
 
@@ -453,9 +454,7 @@ public:
 	inline real curvature2d_as_angle() const;
 #endif
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:SVertex")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(SVertex, "Freestyle:SVertex")
 };
 
 /**********************************/
@@ -962,9 +961,7 @@ public:
 	 */
 	virtual inline Interface0DIterator pointsEnd(float t = 0.0f);
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:FEdge")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(FEdge, "Freestyle:FEdge")
 };
 
 //
@@ -1276,9 +1273,7 @@ public:
 		_bFaceMark = iFaceMark;
 	}
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:FEdgeSharp")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(FEdgeSharp, "Freestyle:FEdgeSharp")
 };
 
 /*! Class defining a smooth edge. This kind of edge typically runs across a face of the input mesh. It can be
@@ -1392,9 +1387,7 @@ public:
 		_FrsMaterialIndex = i;
 	}
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:FEdgeSmooth")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(FEdgeSmooth, "Freestyle:FEdgeSmooth")
 };
 
 
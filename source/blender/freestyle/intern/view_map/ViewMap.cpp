@@ -63,6 +63,17 @@ ViewMap::~ViewMap()
 	_VEdges.clear();
 }
 
+void ViewMap::releaseMemoryPools()
+{
+	MemoryPool<SVertex>::release();
+	MemoryPool<FEdge>::release();
+	MemoryPool<FEdgeSharp>::release();
+	MemoryPool<FEdgeSmooth>::release();
+	MemoryPool<ViewVertex>::release();
+	MemoryPool<TVertex>::release();
+	MemoryPool<NonTVertex>::release();
+}
+
 void ViewMap::Clean()
 {
 	vector<FEdge*> tmpEdges;
@@ -89,8 +100,9 @@ void ViewMap::Clean()
 
 ViewShape *ViewMap::viewShape(unsigned id)
 {
-	int index = _shapeIdToIndex[id];
-	return _VShapes[ index ];
+	// Not operator[], which may insert: this is called from several threads while computing visibility
+	id_to_index_map::const_iterator it = _shapeIdToIndex.find(id);
+	return _VShapes[it->second];
 }
 
 void ViewMap::AddViewShape(ViewShape *iVShape)
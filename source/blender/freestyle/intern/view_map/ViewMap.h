@@ -38,6 +38,7 @@
 
 #include "../system/BaseIterator.h"
 #include "../system/FreestyleConfig.h"
+#include "../system/MemoryPool.h"
 
 #ifdef WITH_CXX_GUARDEDALLOC
 #include "MEM_guardedalloc.h"
@@ -239,6 +240,9 @@ public:
 	/* Clean temporary FEdges created by chaining */
 	virtual void Clean();
 
+	/*! Gives the memory of the pooled view map elements back, once the view map has been deleted */
+	static void releaseMemoryPools();
+
 #ifdef WITH_CXX_GUARDEDALLOC
 	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:ViewMap")
 #endif
@@ -369,9 +373,7 @@ public:
 	/*! Returns an orientedViewEdgeIterator pointing to the ViewEdge given as argument. */
 	virtual ViewVertexInternal::orientedViewEdgeIterator edgesIterator(ViewEdge *iEdge) = 0;
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:ViewVertex")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(ViewVertex, "Freestyle:ViewVertex")
 };
 
 /**********************************/
@@ -641,9 +643,7 @@ public:
 	/*! Returns an orientedViewEdgeIterator pointing to the ViewEdge given as argument. */
 	virtual ViewVertexInternal::orientedViewEdgeIterator edgesIterator(ViewEdge *iEdge);
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:TVertex")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(TVertex, "Freestyle:TVertex")
 };
 
 
@@ -857,9 +857,7 @@ public:
 	/*! Returns an orientedViewEdgeIterator pointing to the ViewEdge given as argument. */
 	virtual ViewVertexInternal::orientedViewEdgeIterator edgesIterator(ViewEdge *iEdge);
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:NonTVertex")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(NonTVertex, "Freestyle:NonTVertex")
 };
 
 /**********************************/
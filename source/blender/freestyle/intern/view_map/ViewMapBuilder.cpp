@@ -46,6 +46,10 @@
 
 #include "BKE_global.h"
 
+#include "BLI_task.h"
+
+#include "PIL_time.h"
+
 namespace Freestyle {
 
 // XXX Grmll... G is used as template's typename parameter :/
@@ -396,6 +400,60 @@ static int computeVisibility(ViewMap *viewMap, FEdge *fe, G& grid, real epsilon,
 	return qi;
 }
 
+// Visibility of the view edges is computed from the task scheduler.
+//
+// Each view edge only writes to itself and its own FEdges, and the grids are read-only once built (their iterators
+// keep all the state of a query), so the edges can be processed in any order and the result is the same as with a
+// single thread.
+// The edges are handed to the scheduler in blocks, cancellation and progress are checked from the calling thread
+// in between.
+
+#ifdef DEBUG
+// Catch threading issues on small scenes too.
+#  define VISIBILITY_THREAD_THRESHOLD 0
+#else
+#  define VISIBILITY_THREAD_THRESHOLD 256
+#endif
+#define VISIBILITY_BLOCK_MIN 1024
+
+template <typename G>
+struct VisibilityTaskData {
+	ViewMap *viewMap;
+	vector<ViewEdge*> *vedges;
+	G *grid;
+	real epsilon;
+};
+
+static void computeViewEdgesVisibility(vector<ViewEdge*>& vedges, void *userdata, TaskParallelRangeFunc func,
+                                       RenderMonitor *iRenderMonitor)
+{
+	const int vedgesSize = (int)vedges.size();
+	const int blockSize = max(VISIBILITY_BLOCK_MIN, (int)ceil(0.01f * vedgesSize));
+	const bool useThreads = (vedgesSize > VISIBILITY_THREAD_THRESHOLD);
+	int start = 0;
+
+	while (start < vedgesSize) {
+		const int stop = min(start + blockSize, vedgesSize);
+
+		if (iRenderMonitor) {
+			if (iRenderMonitor->testBreak())
+				return;
+			stringstream ss;
+			ss << "Freestyle: Visibility computations " << (100 * start / vedgesSize) << "%";
+			iRenderMonitor->setInfo(ss.str());
+			iRenderMonitor->progress((float)start / vedgesSize);
+		}
+
+		BLI_task_parallel_range_ex(start, stop, userdata, func, useThreads ? 0 : stop - start + 1, true);
+		start = stop;
+	}
+
+	if (iRenderMonitor && vedgesSize) {
+		iRenderMonitor->setInfo("Freestyle: Visibility computations 100%");
+		iRenderMonitor->progress(1.0f);
+	}
+}
+
 // computeCumulativeVisibility returns the lowest x such that the majority of FEdges have QI <= x
 //
 // This was probably the original intention of the "normal" algorithm on which computeDetailedVisibility is based.
@@ -405,209 +463,197 @@ static int computeVisibility(ViewMap *viewMap, FEdge *fe, G& grid, real epsilon,
 // 6 occluders have QI <= 22.
 
 template <typename G, typename I>
-static void computeCumulativeVisibility(ViewMap *ioViewMap, G& grid, real epsilon, RenderMonitor *iRenderMonitor)
+static void computeCumulativeViewEdgeVisibility(ViewMap *ioViewMap, ViewEdge *ve, G& grid, real epsilon)
 {
-	vector<ViewEdge*>& vedges = ioViewMap->ViewEdges();
-
 	FEdge *fe, *festart;
 	int nSamples = 0;
 	vector<WFace*> wFaces;
 	WFace *wFace = NULL;
-	unsigned cnt = 0;
-	unsigned cntStep = (unsigned)ceil(0.01f * vedges.size());
 	unsigned tmpQI = 0;
 	unsigned qiClasses[256];
 	unsigned maxIndex, maxCard;
 	unsigned qiMajority;
-	for (vector<ViewEdge*>::iterator ve = vedges.begin(), veend = vedges.end(); ve != veend; ve++) {
-		if (iRenderMonitor) {
-			if (iRenderMonitor->testBreak())
-				break;
-			if (cnt % cntStep == 0) {
-				stringstream ss;
-				ss << "Freestyle: Visibility computations " << (100 * cnt / vedges.size()) << "%";
-				iRenderMonitor->setInfo(ss.str());
-				iRenderMonitor->progress((float)cnt / vedges.size());
-			}
-			cnt++;
-		}
+#if LOGGING
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "Processing ViewEdge " << ve->getId() << endl;
+	}
+#endif
+	// Find an edge to test
+	if (!ve->isInImage()) {
+		// This view edge has been proscenium culled
+		ve->setQI(255);
+		ve->setaShape(0);
 #if LOGGING
 		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "Processing ViewEdge " << (*ve)->getId() << endl;
+			cout << "\tCulled." << endl;
 		}
 #endif
-		// Find an edge to test
-		if (!(*ve)->isInImage()) {
-			// This view edge has been proscenium culled
-			(*ve)->setQI(255);
-			(*ve)->setaShape(0);
+		return;
+	}
+
+	// Test edge
+	festart = ve->fedgeA();
+	fe = ve->fedgeA();
+	qiMajority = 0;
+	do {
+		if (fe != NULL && fe->isInImage()) {
+			qiMajority++;
+		}
+		fe = fe->nextEdge();
+	} while (fe && fe != festart);
+
+	if (qiMajority == 0) {
+		// There are no occludable FEdges on this ViewEdge
+		// This should be impossible.
+		if (_global.debug & G_DEBUG_FREESTYLE) {
+			cout << "View Edge in viewport without occludable FEdges: " << ve->getId() << endl;
+		}
+		// We can recover from this error:
+		// Treat this edge as fully visible with no occludee
+		ve->setQI(0);
+		ve->setaShape(0);
+		return;
+	}
+	else {
+		++qiMajority;
+		qiMajority >>= 1;
+	}
 #if LOGGING
-			if (_global.debug & G_DEBUG_FREESTYLE) {
-				cout << "\tCulled." << endl;
-			}
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "\tqiMajority: " << qiMajority << endl;
+	}
 #endif
-			continue;
-		}
 
-		// Test edge
-		festart = (*ve)->fedgeA();
-		fe = (*ve)->fedgeA();
-		qiMajority = 0;
-		do {
-			if (fe != NULL && fe->isInImage()) {
-				qiMajority++;
-			}
-			fe = fe->nextEdge();
-		} while (fe && fe != festart);
+	tmpQI = 0;
+	maxIndex = 0;
+	maxCard = 0;
+	nSamples = 0;
+	memset(qiClasses, 0, 256 * sizeof(*qiClasses));
+	set<ViewShape*> foundOccluders;
 
-		if (qiMajority == 0) {
-			// There are no occludable FEdges on this ViewEdge
-			// This should be impossible.
-			if (_global.debug & G_DEBUG_FREESTYLE) {
-				cout << "View Edge in viewport without occludable FEdges: " << (*ve)->getId() << endl;
-			}
-			// We can recover from this error:
-			// Treat this edge as fully visible with no occludee
-			(*ve)->setQI(0);
-			(*ve)->setaShape(0);
+	fe = ve->fedgeA();
+	do {
+		if (!fe || !fe->isInImage()) {
+			fe = fe->nextEdge();
 			continue;
 		}
-		else {
-			++qiMajority;
-			qiMajority >>= 1;
-		}
+		if ((maxCard < qiMajority)) {
+			//ARB: change &wFace to wFace and use reference in called function
+			tmpQI = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, ve, &wFace, &foundOccluders);
 #if LOGGING
-		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "\tqiMajority: " << qiMajority << endl;
-		}
+			if (_global.debug & G_DEBUG_FREESTYLE) {
+				cout << "\tFEdge: visibility " << tmpQI << endl;
+			}
 #endif
 
-		tmpQI = 0;
-		maxIndex = 0;
-		maxCard = 0;
-		nSamples = 0;
-		memset(qiClasses, 0, 256 * sizeof(*qiClasses));
-		set<ViewShape*> foundOccluders;
+			//ARB: This is an error condition, not an alert condition.
+			// Some sort of recovery or abort is necessary.
+			if (tmpQI >= 256) {
+				cerr << "Warning: too many occluding levels" << endl;
+				//ARB: Wild guess: instead of aborting or corrupting memory, treat as tmpQI == 255
+				tmpQI = 255;
+			}
 
-		fe = (*ve)->fedgeA();
-		do {
-			if (!fe || !fe->isInImage()) {
-				fe = fe->nextEdge();
-				continue;
+			if (++qiClasses[tmpQI] > maxCard) {
+				maxCard = qiClasses[tmpQI];
+				maxIndex = tmpQI;
 			}
-			if ((maxCard < qiMajority)) {
-				//ARB: change &wFace to wFace and use reference in called function
-				tmpQI = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, *ve, &wFace, &foundOccluders);
+		}
+		else {
+			//ARB: FindOccludee is redundant if ComputeRayCastingVisibility has been called
+			//ARB: change &wFace to wFace and use reference in called function
+			findOccludee<G, I>(fe, grid, epsilon, ve, &wFace);
 #if LOGGING
-				if (_global.debug & G_DEBUG_FREESTYLE) {
-					cout << "\tFEdge: visibility " << tmpQI << endl;
-				}
+			if (_global.debug & G_DEBUG_FREESTYLE) {
+				cout << "\tFEdge: occludee only (" << (wFace != NULL ? "found" : "not found") << ")" << endl;
+			}
 #endif
+		}
 
-				//ARB: This is an error condition, not an alert condition.
-				// Some sort of recovery or abort is necessary.
-				if (tmpQI >= 256) {
-					cerr << "Warning: too many occluding levels" << endl;
-					//ARB: Wild guess: instead of aborting or corrupting memory, treat as tmpQI == 255
-					tmpQI = 255;
-				}
-
-				if (++qiClasses[tmpQI] > maxCard) {
-					maxCard = qiClasses[tmpQI];
-					maxIndex = tmpQI;
-				}
+		// Store test results
+		if (wFace) {
+			vector<Vec3r> vertices;
+			for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
+				vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
 			}
-			else {
-				//ARB: FindOccludee is redundant if ComputeRayCastingVisibility has been called
-				//ARB: change &wFace to wFace and use reference in called function
-				findOccludee<G, I>(fe, grid, epsilon, *ve, &wFace);
+			Polygon3r poly(vertices, wFace->GetNormal());
+			poly.userdata = (void *)wFace;
+			fe->setaFace(poly);
+			wFaces.push_back(wFace);
+			fe->setOccludeeEmpty(false);
 #if LOGGING
-				if (_global.debug & G_DEBUG_FREESTYLE) {
-					cout << "\tFEdge: occludee only (" << (wFace != NULL ? "found" : "not found") << ")" << endl;
-				}
-#endif
+			if (_global.debug & G_DEBUG_FREESTYLE) {
+				cout << "\tFound occludee" << endl;
 			}
-
-			// Store test results
-			if (wFace) {
-				vector<Vec3r> vertices;
-				for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
-					vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
-				}
-				Polygon3r poly(vertices, wFace->GetNormal());
-				poly.userdata = (void *)wFace;
-				fe->setaFace(poly);
-				wFaces.push_back(wFace);
-				fe->setOccludeeEmpty(false);
-#if LOGGING
-				if (_global.debug & G_DEBUG_FREESTYLE) {
-					cout << "\tFound occludee" << endl;
-				}
 #endif
-			}
-			else {
-				fe->setOccludeeEmpty(true);
-			}
+		}
+		else {
+			fe->setOccludeeEmpty(true);
+		}
 
-			++nSamples;
-			fe = fe->nextEdge();
-		} while ((maxCard < qiMajority) && (fe) && (fe != festart));
+		++nSamples;
+		fe = fe->nextEdge();
+	} while ((maxCard < qiMajority) && (fe) && (fe != festart));
 
 #if LOGGING
-		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "\tFinished with " << nSamples << " samples, maxCard = " << maxCard << endl;
-		}
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "\tFinished with " << nSamples << " samples, maxCard = " << maxCard << endl;
+	}
 #endif
 
-		// ViewEdge
-		// qi --
-		// Find the minimum value that is >= the majority of the QI
-		for (unsigned count = 0, i = 0; i < 256; ++i) {
-			count += qiClasses[i];
-			if (count >= qiMajority) {
-				(*ve)->setQI(i);
-				break;
-			}
-		}
-		// occluders --
-		// I would rather not have to go through the effort of creating this set and then copying out its contents.
-		// Is there a reason why ViewEdge::_Occluders cannot be converted to a set<>?
-		for (set<ViewShape*>::iterator o = foundOccluders.begin(), oend = foundOccluders.end(); o != oend; ++o) {
-			(*ve)->AddOccluder((*o));
+	// ViewEdge
+	// qi --
+	// Find the minimum value that is >= the majority of the QI
+	for (unsigned count = 0, i = 0; i < 256; ++i) {
+		count += qiClasses[i];
+		if (count >= qiMajority) {
+			ve->setQI(i);
+			break;
 		}
+	}
+	// occluders --
+	// I would rather not have to go through the effort of creating this set and then copying out its contents.
+	// Is there a reason why ViewEdge::_Occluders cannot be converted to a set<>?
+	for (set<ViewShape*>::iterator o = foundOccluders.begin(), oend = foundOccluders.end(); o != oend; ++o) {
+		ve->AddOccluder((*o));
+	}
 #if LOGGING
-		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "\tConclusion: QI = " << maxIndex << ", " << (*ve)->occluders_size() << " occluders." << endl;
-		}
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "\tConclusion: QI = " << maxIndex << ", " << ve->occluders_size() << " occluders." << endl;
+	}
 #else
-		(void)maxIndex;
+	(void)maxIndex;
 #endif
-		// occludee --
-		if (!wFaces.empty()) {
-			if (wFaces.size() <= (float)nSamples / 2.0f) {
-				(*ve)->setaShape(0);
-			}
-			else {
-				ViewShape *vshape = ioViewMap->viewShape((*wFaces.begin())->GetVertex(0)->shape()->GetId());
-				(*ve)->setaShape(vshape);
-			}
+	// occludee --
+	if (!wFaces.empty()) {
+		if (wFaces.size() <= (float)nSamples / 2.0f) {
+			ve->setaShape(0);
+		}
+		else {
+			ViewShape *vshape = ioViewMap->viewShape((*wFaces.begin())->GetVertex(0)->shape()->GetId());
+			ve->setaShape(vshape);
 		}
-
-		wFaces.clear();
-	}
-	if (iRenderMonitor && vedges.size()) {
-		stringstream ss;
-		ss << "Freestyle: Visibility computations " << (100 * cnt / vedges.size()) << "%";
-		iRenderMonitor->setInfo(ss.str());
-		iRenderMonitor->progress((float)cnt / vedges.size());
 	}
 }
 
 template <typename G, typename I>
-static void computeDetailedVisibility(ViewMap *ioViewMap, G& grid, real epsilon, RenderMonitor *iRenderMonitor)
+static void computeCumulativeVisibility_task_cb(void *userdata, int i)
 {
-	vector<ViewEdge*>& vedges = ioViewMap->ViewEdges();
+	VisibilityTaskData<G> *data = (VisibilityTaskData<G> *)userdata;
+	computeCumulativeViewEdgeVisibility<G, I>(data->viewMap, (*data->vedges)[i], *data->grid, data->epsilon);
+}
+
+template <typename G, typename I>
+static void computeCumulativeVisibility(ViewMap *ioViewMap, G& grid, real epsilon, RenderMonitor *iRenderMonitor)
+{
+	VisibilityTaskData<G> data = {ioViewMap, &ioViewMap->ViewEdges(), &grid, epsilon};
+	computeViewEdgesVisibility(ioViewMap->ViewEdges(), &data, computeCumulativeVisibility_task_cb<G, I>,
+	                           iRenderMonitor);
+}
 
+template <typename G, typename I>
+static void computeDetailedViewEdgeVisibility(ViewMap *ioViewMap, ViewEdge *ve, G& grid, real epsilon)
+{
 	FEdge *fe, *festart;
 	int nSamples = 0;
 	vector<WFace*> wFaces;
@@ -616,171 +662,178 @@ static void computeDetailedVisibility(ViewMap *ioViewMap, G& grid, real epsilon,
 	unsigned qiClasses[256];
 	unsigned maxIndex, maxCard;
 	unsigned qiMajority;
-	for (vector<ViewEdge*>::iterator ve = vedges.begin(), veend = vedges.end(); ve != veend; ve++) {
-		if (iRenderMonitor && iRenderMonitor->testBreak())
-			break;
 #if LOGGING
-		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "Processing ViewEdge " << (*ve)->getId() << endl;
-		}
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "Processing ViewEdge " << ve->getId() << endl;
+	}
 #endif
-		// Find an edge to test
-		if (!(*ve)->isInImage()) {
-			// This view edge has been proscenium culled
-			(*ve)->setQI(255);
-			(*ve)->setaShape(0);
-#if LOGGING
-			if (_global.debug & G_DEBUG_FREESTYLE) {
-				cout << "\tCulled." << endl;
-			}
-#endif
-			continue;
-		}
-
-		// Test edge
-		festart = (*ve)->fedgeA();
-		fe = (*ve)->fedgeA();
-		qiMajority = 0;
-		do {
-			if (fe != NULL && fe->isInImage()) {
-				qiMajority++;
-			}
-			fe = fe->nextEdge();
-		} while (fe && fe != festart);
-
-		if (qiMajority == 0) {
-			// There are no occludable FEdges on this ViewEdge
-			// This should be impossible.
-			if (_global.debug & G_DEBUG_FREESTYLE) {
-				cout << "View Edge in viewport without occludable FEdges: " << (*ve)->getId() << endl;
-			}
-			// We can recover from this error:
-			// Treat this edge as fully visible with no occludee
-			(*ve)->setQI(0);
-			(*ve)->setaShape(0);
-			continue;
-		}
-		else {
-			++qiMajority;
-			qiMajority >>= 1;
-		}
+	// Find an edge to test
+	if (!ve->isInImage()) {
+		// This view edge has been proscenium culled
+		ve->setQI(255);
+		ve->setaShape(0);
 #if LOGGING
 		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "\tqiMajority: " << qiMajority << endl;
+			cout << "\tCulled." << endl;
 		}
 #endif
+		return;
+	}
 
-		tmpQI = 0;
-		maxIndex = 0;
-		maxCard = 0;
-		nSamples = 0;
-		memset(qiClasses, 0, 256 * sizeof(*qiClasses));
-		set<ViewShape*> foundOccluders;
+	// Test edge
+	festart = ve->fedgeA();
+	fe = ve->fedgeA();
+	qiMajority = 0;
+	do {
+		if (fe != NULL && fe->isInImage()) {
+			qiMajority++;
+		}
+		fe = fe->nextEdge();
+	} while (fe && fe != festart);
 
-		fe = (*ve)->fedgeA();
-		do {
-			if (fe == NULL || ! fe->isInImage()) {
-				fe = fe->nextEdge();
-				continue;
-			}
-			if ((maxCard < qiMajority)) {
-				//ARB: change &wFace to wFace and use reference in called function
-				tmpQI = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, *ve, &wFace, &foundOccluders);
+	if (qiMajority == 0) {
+		// There are no occludable FEdges on this ViewEdge
+		// This should be impossible.
+		if (_global.debug & G_DEBUG_FREESTYLE) {
+			cout << "View Edge in viewport without occludable FEdges: " << ve->getId() << endl;
+		}
+		// We can recover from this error:
+		// Treat this edge as fully visible with no occludee
+		ve->setQI(0);
+		ve->setaShape(0);
+		return;
+	}
+	else {
+		++qiMajority;
+		qiMajority >>= 1;
+	}
 #if LOGGING
-				if (_global.debug & G_DEBUG_FREESTYLE) {
-					cout << "\tFEdge: visibility " << tmpQI << endl;
-				}
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "\tqiMajority: " << qiMajority << endl;
+	}
 #endif
 
-				//ARB: This is an error condition, not an alert condition.
-				// Some sort of recovery or abort is necessary.
-				if (tmpQI >= 256) {
-					cerr << "Warning: too many occluding levels" << endl;
-					//ARB: Wild guess: instead of aborting or corrupting memory, treat as tmpQI == 255
-					tmpQI = 255;
-				}
+	tmpQI = 0;
+	maxIndex = 0;
+	maxCard = 0;
+	nSamples = 0;
+	memset(qiClasses, 0, 256 * sizeof(*qiClasses));
+	set<ViewShape*> foundOccluders;
 
-				if (++qiClasses[tmpQI] > maxCard) {
-					maxCard = qiClasses[tmpQI];
-					maxIndex = tmpQI;
-				}
-			}
-			else {
-				//ARB: FindOccludee is redundant if ComputeRayCastingVisibility has been called
-				//ARB: change &wFace to wFace and use reference in called function
-				findOccludee<G, I>(fe, grid, epsilon, *ve, &wFace);
+	fe = ve->fedgeA();
+	do {
+		if (fe == NULL || ! fe->isInImage()) {
+			fe = fe->nextEdge();
+			continue;
+		}
+		if ((maxCard < qiMajority)) {
+			//ARB: change &wFace to wFace and use reference in called function
+			tmpQI = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, ve, &wFace, &foundOccluders);
 #if LOGGING
-				if (_global.debug & G_DEBUG_FREESTYLE) {
-					cout << "\tFEdge: occludee only (" << (wFace != NULL ? "found" : "not found") << ")" << endl;
-				}
+			if (_global.debug & G_DEBUG_FREESTYLE) {
+				cout << "\tFEdge: visibility " << tmpQI << endl;
+			}
 #endif
+
+			//ARB: This is an error condition, not an alert condition.
+			// Some sort of recovery or abort is necessary.
+			if (tmpQI >= 256) {
+				cerr << "Warning: too many occluding levels" << endl;
+				//ARB: Wild guess: instead of aborting or corrupting memory, treat as tmpQI == 255
+				tmpQI = 255;
 			}
 
-			// Store test results
-			if (wFace) {
-				vector<Vec3r> vertices;
-				for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
-					vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
-				}
-				Polygon3r poly(vertices, wFace->GetNormal());
-				poly.userdata = (void *)wFace;
-				fe->setaFace(poly);
-				wFaces.push_back(wFace);
-				fe->setOccludeeEmpty(false);
+			if (++qiClasses[tmpQI] > maxCard) {
+				maxCard = qiClasses[tmpQI];
+				maxIndex = tmpQI;
+			}
+		}
+		else {
+			//ARB: FindOccludee is redundant if ComputeRayCastingVisibility has been called
+			//ARB: change &wFace to wFace and use reference in called function
+			findOccludee<G, I>(fe, grid, epsilon, ve, &wFace);
 #if LOGGING
-				if (_global.debug & G_DEBUG_FREESTYLE) {
-					cout << "\tFound occludee" << endl;
-				}
+			if (_global.debug & G_DEBUG_FREESTYLE) {
+				cout << "\tFEdge: occludee only (" << (wFace != NULL ? "found" : "not found") << ")" << endl;
+			}
 #endif
+		}
+
+		// Store test results
+		if (wFace) {
+			vector<Vec3r> vertices;
+			for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
+				vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
 			}
-			else {
-				fe->setOccludeeEmpty(true);
+			Polygon3r poly(vertices, wFace->GetNormal());
+			poly.userdata = (void *)wFace;
+			fe->setaFace(poly);
+			wFaces.push_back(wFace);
+			fe->setOccludeeEmpty(false);
+#if LOGGING
+			if (_global.debug & G_DEBUG_FREESTYLE) {
+				cout << "\tFound occludee" << endl;
 			}
+#endif
+		}
+		else {
+			fe->setOccludeeEmpty(true);
+		}
 
-			++nSamples;
-			fe = fe->nextEdge();
-		} while ((maxCard < qiMajority) && (fe) && (fe != festart));
+		++nSamples;
+		fe = fe->nextEdge();
+	} while ((maxCard < qiMajority) && (fe) && (fe != festart));
 
 #if LOGGING
-		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "\tFinished with " << nSamples << " samples, maxCard = " << maxCard << endl;
-		}
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "\tFinished with " << nSamples << " samples, maxCard = " << maxCard << endl;
+	}
 #endif
 
-		// ViewEdge
-		// qi --
-		(*ve)->setQI(maxIndex);
-		// occluders --
-		// I would rather not have to go through the effort of creating this this set and then copying out its contents.
-		// Is there a reason why ViewEdge::_Occluders cannot be converted to a set<>?
-		for (set<ViewShape*>::iterator o = foundOccluders.begin(), oend = foundOccluders.end(); o != oend; ++o) {
-			(*ve)->AddOccluder((*o));
-		}
+	// ViewEdge
+	// qi --
+	ve->setQI(maxIndex);
+	// occluders --
+	// I would rather not have to go through the effort of creating this this set and then copying out its contents.
+	// Is there a reason why ViewEdge::_Occluders cannot be converted to a set<>?
+	for (set<ViewShape*>::iterator o = foundOccluders.begin(), oend = foundOccluders.end(); o != oend; ++o) {
+		ve->AddOccluder((*o));
+	}
 #if LOGGING
-		if (_global.debug & G_DEBUG_FREESTYLE) {
-			cout << "\tConclusion: QI = " << maxIndex << ", " << (*ve)->occluders_size() << " occluders." << endl;
-		}
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		cout << "\tConclusion: QI = " << maxIndex << ", " << ve->occluders_size() << " occluders." << endl;
+	}
 #endif
-		// occludee --
-		if (!wFaces.empty()) {
-			if (wFaces.size() <= (float)nSamples / 2.0f) {
-				(*ve)->setaShape(0);
-			}
-			else {
-				ViewShape *vshape = ioViewMap->viewShape((*wFaces.begin())->GetVertex(0)->shape()->GetId());
-				(*ve)->setaShape(vshape);
-			}
+	// occludee --
+	if (!wFaces.empty()) {
+		if (wFaces.size() <= (float)nSamples / 2.0f) {
+			ve->setaShape(0);
+		}
+		else {
+			ViewShape *vshape = ioViewMap->viewShape((*wFaces.begin())->GetVertex(0)->shape()->GetId());
+			ve->setaShape(vshape);
 		}
-
-		wFaces.clear();
 	}
 }
 
 template <typename G, typename I>
-static void computeFastVisibility(ViewMap *ioViewMap, G& grid, real epsilon)
+static void computeDetailedVisibility_task_cb(void *userdata, int i)
 {
-	vector<ViewEdge*>& vedges = ioViewMap->ViewEdges();
+	VisibilityTaskData<G> *data = (VisibilityTaskData<G> *)userdata;
+	computeDetailedViewEdgeVisibility<G, I>(data->viewMap, (*data->vedges)[i], *data->grid, data->epsilon);
+}
+
+template <typename G, typename I>
+static void computeDetailedVisibility(ViewMap *ioViewMap, G& grid, real epsilon, RenderMonitor *iRenderMonitor)
+{
+	VisibilityTaskData<G> data = {ioViewMap, &ioViewMap->ViewEdges(), &grid, epsilon};
+	computeViewEdgesVisibility(ioViewMap->ViewEdges(), &data, computeDetailedVisibility_task_cb<G, I>,
+	                           iRenderMonitor);
+}
 
+template <typename G, typename I>
+static void computeFastViewEdgeVisibility(ViewMap *ioViewMap, ViewEdge *ve, G& grid, real epsilon)
+{
 	FEdge *fe, *festart;
 	unsigned nSamples = 0;
 	vector<WFace*> wFaces;
@@ -790,180 +843,201 @@ static void computeFastVisibility(ViewMap *ioViewMap, G& grid, real epsilon)
 	unsigned maxIndex, maxCard;
 	unsigned qiMajority;
 	bool even_test;
-	for (vector<ViewEdge*>::iterator ve = vedges.begin(), veend = vedges.end(); ve != veend; ve++) {
-		// Find an edge to test
-		if (!(*ve)->isInImage()) {
-			// This view edge has been proscenium culled
-			(*ve)->setQI(255);
-			(*ve)->setaShape(0);
-			continue;
-		}
 
-		// Test edge
-		festart = (*ve)->fedgeA();
-		fe = (*ve)->fedgeA();
+	// Find an edge to test
+	if (!ve->isInImage()) {
+		// This view edge has been proscenium culled
+		ve->setQI(255);
+		ve->setaShape(0);
+		return;
+	}
 
-		even_test = true;
-		qiMajority = 0;
-		do {
-			if (even_test && fe && fe->isInImage()) {
-				qiMajority++;
-				even_test = !even_test;
-			}
-			fe = fe->nextEdge();
-		} while (fe && fe != festart);
+	// Test edge
+	festart = ve->fedgeA();
+	fe = ve->fedgeA();
 
-		if (qiMajority == 0 ) {
-			// There are no occludable FEdges on this ViewEdge
-			// This should be impossible.
-			if (_global.debug & G_DEBUG_FREESTYLE) {
-				cout << "View Edge in viewport without occludable FEdges: " << (*ve)->getId() << endl;
-			}
-			// We can recover from this error:
-			// Treat this edge as fully visible with no occludee
-			(*ve)->setQI(0);
-			(*ve)->setaShape(0);
-			continue;
-		}
-		else {
-			++qiMajority;
-			qiMajority >>= 1;
+	even_test = true;
+	qiMajority = 0;
+	do {
+		if (even_test && fe && fe->isInImage()) {
+			qiMajority++;
+			even_test = !even_test;
 		}
+		fe = fe->nextEdge();
+	} while (fe && fe != festart);
 
-		even_test = true;
-		maxIndex = 0;
-		maxCard = 0;
-		nSamples = 0;
-		memset(qiClasses, 0, 256 * sizeof(*qiClasses));
-		set<ViewShape*> foundOccluders;
+	if (qiMajority == 0 ) {
+		// There are no occludable FEdges on this ViewEdge
+		// This should be impossible.
+		if (_global.debug & G_DEBUG_FREESTYLE) {
+			cout << "View Edge in viewport without occludable FEdges: " << ve->getId() << endl;
+		}
+		// We can recover from this error:
+		// Treat this edge as fully visible with no occludee
+		ve->setQI(0);
+		ve->setaShape(0);
+		return;
+	}
+	else {
+		++qiMajority;
+		qiMajority >>= 1;
+	}
 
-		fe = (*ve)->fedgeA();
-		do {
-			if (!fe || !fe->isInImage()) {
-				fe = fe->nextEdge();
-				continue;
-			}
-			if (even_test) {
-				if ((maxCard < qiMajority)) {
-					//ARB: change &wFace to wFace and use reference in called function
-					tmpQI = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, *ve, &wFace, &foundOccluders);
+	even_test = true;
+	maxIndex = 0;
+	maxCard = 0;
+	nSamples = 0;
+	memset(qiClasses, 0, 256 * sizeof(*qiClasses));
+	set<ViewShape*> foundOccluders;
 
-					//ARB: This is an error condition, not an alert condition.
-					// Some sort of recovery or abort is necessary.
-					if (tmpQI >= 256) {
-						cerr << "Warning: too many occluding levels" << endl;
-						//ARB: Wild guess: instead of aborting or corrupting memory, treat as tmpQI == 255
-						tmpQI = 255;
-					}
+	fe = ve->fedgeA();
+	do {
+		if (!fe || !fe->isInImage()) {
+			fe = fe->nextEdge();
+			continue;
+		}
+		if (even_test) {
+			if ((maxCard < qiMajority)) {
+				//ARB: change &wFace to wFace and use reference in called function
+				tmpQI = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, ve, &wFace, &foundOccluders);
 
-					if (++qiClasses[tmpQI] > maxCard) {
-						maxCard = qiClasses[tmpQI];
-						maxIndex = tmpQI;
-					}
+				//ARB: This is an error condition, not an alert condition.
+				// Some sort of recovery or abort is necessary.
+				if (tmpQI >= 256) {
+					cerr << "Warning: too many occluding levels" << endl;
+					//ARB: Wild guess: instead of aborting or corrupting memory, treat as tmpQI == 255
+					tmpQI = 255;
 				}
-				else {
-					//ARB: FindOccludee is redundant if ComputeRayCastingVisibility has been called
-					//ARB: change &wFace to wFace and use reference in called function
-					findOccludee<G, I>(fe, grid, epsilon, *ve, &wFace);
+
+				if (++qiClasses[tmpQI] > maxCard) {
+					maxCard = qiClasses[tmpQI];
+					maxIndex = tmpQI;
 				}
+			}
+			else {
+				//ARB: FindOccludee is redundant if ComputeRayCastingVisibility has been called
+				//ARB: change &wFace to wFace and use reference in called function
+				findOccludee<G, I>(fe, grid, epsilon, ve, &wFace);
+			}
 
-				if (wFace) {
-					vector<Vec3r> vertices;
-					for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
-						vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
-					}
-					Polygon3r poly(vertices, wFace->GetNormal());
-					poly.userdata = (void *)wFace;
-					fe->setaFace(poly);
-					wFaces.push_back(wFace);
+			if (wFace) {
+				vector<Vec3r> vertices;
+				for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
+					vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
 				}
-				++nSamples;
+				Polygon3r poly(vertices, wFace->GetNormal());
+				poly.userdata = (void *)wFace;
+				fe->setaFace(poly);
+				wFaces.push_back(wFace);
 			}
+			++nSamples;
+		}
 
-			even_test = ! even_test;
-			fe = fe->nextEdge();
-		} while ((maxCard < qiMajority) && (fe) && (fe != festart));
+		even_test = ! even_test;
+		fe = fe->nextEdge();
+	} while ((maxCard < qiMajority) && (fe) && (fe != festart));
 
-		// qi --
-		(*ve)->setQI(maxIndex);
+	// qi --
+	ve->setQI(maxIndex);
 
-		// occluders --
-		for (set<ViewShape*>::iterator o = foundOccluders.begin(), oend = foundOccluders.end(); o != oend; ++o) {
-			(*ve)->AddOccluder((*o));
-		}
+	// occluders --
+	for (set<ViewShape*>::iterator o = foundOccluders.begin(), oend = foundOccluders.end(); o != oend; ++o) {
+		ve->AddOccluder((*o));
+	}
 
-		// occludee --
-		if (!wFaces.empty()) {
-			if (wFaces.size() < nSamples / 2) {
-				(*ve)->setaShape(0);
-			}
-			else {
-				ViewShape *vshape = ioViewMap->viewShape((*wFaces.begin())->GetVertex(0)->shape()->GetId());
-				(*ve)->setaShape(vshape);
-			}
+	// occludee --
+	if (!wFaces.empty()) {
+		if (wFaces.size() < nSamples / 2) {
+			ve->setaShape(0);
+		}
+		else {
+			ViewShape *vshape = ioViewMap->viewShape((*wFaces.begin())->GetVertex(0)->shape()->GetId());
+			ve->setaShape(vshape);
 		}
-
-		wFaces.clear();
 	}
 }
 
 template <typename G, typename I>
-static void computeVeryFastVisibility(ViewMap *ioViewMap, G& grid, real epsilon)
+static void computeFastVisibility_task_cb(void *userdata, int i)
 {
-	vector<ViewEdge*>& vedges = ioViewMap->ViewEdges();
+	VisibilityTaskData<G> *data = (VisibilityTaskData<G> *)userdata;
+	computeFastViewEdgeVisibility<G, I>(data->viewMap, (*data->vedges)[i], *data->grid, data->epsilon);
+}
+
+template <typename G, typename I>
+static void computeFastVisibility(ViewMap *ioViewMap, G& grid, real epsilon)
+{
+	VisibilityTaskData<G> data = {ioViewMap, &ioViewMap->ViewEdges(), &grid, epsilon};
+	computeViewEdgesVisibility(ioViewMap->ViewEdges(), &data, computeFastVisibility_task_cb<G, I>, NULL);
+}
 
+template <typename G, typename I>
+static void computeVeryFastViewEdgeVisibility(ViewMap *ioViewMap, ViewEdge *ve, G& grid, real epsilon)
+{
 	FEdge *fe;
 	unsigned qi = 0;
 	WFace *wFace = 0;
 
-	for (vector<ViewEdge*>::iterator ve = vedges.begin(), veend = vedges.end(); ve != veend; ve++) {
-		// Find an edge to test
-		if (!(*ve)->isInImage()) {
-			// This view edge has been proscenium culled
-			(*ve)->setQI(255);
-			(*ve)->setaShape(0);
-			continue;
-		}
-		fe = (*ve)->fedgeA();
-		// Find a FEdge inside the occluder proscenium to test for visibility
-		FEdge *festart = fe;
-		while (fe && !fe->isInImage() && fe != festart) {
-			fe = fe->nextEdge();
-		}
+	// Find an edge to test
+	if (!ve->isInImage()) {
+		// This view edge has been proscenium culled
+		ve->setQI(255);
+		ve->setaShape(0);
+		return;
+	}
+	fe = ve->fedgeA();
+	// Find a FEdge inside the occluder proscenium to test for visibility
+	FEdge *festart = fe;
+	while (fe && !fe->isInImage() && fe != festart) {
+		fe = fe->nextEdge();
+	}
 
-		// Test edge
-		if (!fe || !fe->isInImage()) {
-			// There are no occludable FEdges on this ViewEdge
-			// This should be impossible.
-			if (_global.debug & G_DEBUG_FREESTYLE) {
-				cout << "View Edge in viewport without occludable FEdges: " << (*ve)->getId() << endl;
-			}
-			// We can recover from this error:
-			// Treat this edge as fully visible with no occludee
-			qi = 0;
-			wFace = NULL;
-		}
-		else {
-			qi = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, *ve, &wFace, NULL);
+	// Test edge
+	if (!fe || !fe->isInImage()) {
+		// There are no occludable FEdges on this ViewEdge
+		// This should be impossible.
+		if (_global.debug & G_DEBUG_FREESTYLE) {
+			cout << "View Edge in viewport without occludable FEdges: " << ve->getId() << endl;
 		}
+		// We can recover from this error:
+		// Treat this edge as fully visible with no occludee
+		qi = 0;
+		wFace = NULL;
+	}
+	else {
+		qi = computeVisibility<G, I>(ioViewMap, fe, grid, epsilon, ve, &wFace, NULL);
+	}
 
-		// Store test results
-		if (wFace) {
-			vector<Vec3r> vertices;
-			for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
-				vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
-			}
-			Polygon3r poly(vertices, wFace->GetNormal());
-			poly.userdata = (void *)wFace;
-			fe->setaFace(poly);  // This works because setaFace *copies* the polygon
-			ViewShape *vshape = ioViewMap->viewShape(wFace->GetVertex(0)->shape()->GetId());
-			(*ve)->setaShape(vshape);
-		}
-		else {
-			(*ve)->setaShape(0);
+	// Store test results
+	if (wFace) {
+		vector<Vec3r> vertices;
+		for (int i = 0, numEdges = wFace->numberOfEdges(); i < numEdges; ++i) {
+			vertices.push_back(Vec3r(wFace->GetVertex(i)->GetVertex()));
 		}
-		(*ve)->setQI(qi);
+		Polygon3r poly(vertices, wFace->GetNormal());
+		poly.userdata = (void *)wFace;
+		fe->setaFace(poly);  // This works because setaFace *copies* the polygon
+		ViewShape *vshape = ioViewMap->viewShape(wFace->GetVertex(0)->shape()->GetId());
+		ve->setaShape(vshape);
+	}
+	else {
+		ve->setaShape(0);
 	}
+	ve->setQI(qi);
+}
+
+template <typename G, typename I>
+static void computeVeryFastVisibility_task_cb(void *userdata, int i)
+{
+	VisibilityTaskData<G> *data = (VisibilityTaskData<G> *)userdata;
+	computeVeryFastViewEdgeVisibility<G, I>(data->viewMap, (*data->vedges)[i], *data->grid, data->epsilon);
+}
+
+template <typename G, typename I>
+static void computeVeryFastVisibility(ViewMap *ioViewMap, G& grid, real epsilon)
+{
+	VisibilityTaskData<G> data = {ioViewMap, &ioViewMap->ViewEdges(), &grid, epsilon};
+	computeViewEdgesVisibility(ioViewMap->ViewEdges(), &data, computeVeryFastVisibility_task_cb<G, I>, NULL);
 }
 
 void ViewMapBuilder::BuildGrid(WingedEdge& we, const BBox<Vec3r>& bbox, unsigned int sceneNumFaces)
@@ -998,18 +1072,38 @@ ViewMap *ViewMapBuilder::BuildViewMap(WingedEdge& we, visibility_algo iAlgo, rea
 	_currentFId = 0;
 	_currentSVertexId = 0;
 
+	// Wall clock time of each phase, the visibility and intersections phases run on several threads
+	double time_start = PIL_check_seconds_timer(), time_phase;
+
 	// Builds initial view edges
 	computeInitialViewEdges(we);
 
 	// Detects cusps
 	computeCusps(_ViewMap); 
 
+	time_phase = PIL_check_seconds_timer();
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		printf("  Initial edges  : %lf\n", time_phase - time_start);
+	}
+	time_start = time_phase;
+
 	// Compute intersections
 	ComputeIntersections(_ViewMap, sweep_line, epsilon);
 
+	time_phase = PIL_check_seconds_timer();
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		printf("  Intersections  : %lf\n", time_phase - time_start);
+	}
+	time_start = time_phase;
+
 	// Compute visibility
 	ComputeEdgesVisibility(_ViewMap, we, bbox, sceneNumFaces, iAlgo, epsilon);
 
+	time_phase = PIL_check_seconds_timer();
+	if (_global.debug & G_DEBUG_FREESTYLE) {
+		printf("  Visibility     : %lf\n", time_phase - time_start);
+	}
+
 	return _ViewMap;
 }
 
@@ -2196,6 +2290,34 @@ struct silhouette_binary_rule : public binary_rule<segment, segment>
 	}
 };
 
+#ifdef DEBUG
+#  define INTERSECTION_THREAD_THRESHOLD 0
+#else
+#  define INTERSECTION_THREAD_THRESHOLD 1024
+#endif
+
+struct IntersectionTaskData {
+	vector<intersection*> *intersections;
+	vector<real> *worldParameters;
+};
+
+static void imageToWorldParameters_task_cb(void *userdata, int i)
+{
+	IntersectionTaskData *data = (IntersectionTaskData *)userdata;
+	intersection *inter = (*data->intersections)[i];
+
+	(*data->worldParameters)[2 * i] = SilhouetteGeomEngine::ImageToWorldParameter(inter->EdgeA->edge(), inter->tA);
+	(*data->worldParameters)[2 * i + 1] = SilhouetteGeomEngine::ImageToWorldParameter(inter->EdgeB->edge(), inter->tB);
+}
+
+static void sortEdgeIntersections_task_cb(void *userdata, int i)
+{
+	segment *s = (*(vector<segment*> *)userdata)[i];
+	vector<intersection*>& eIntersections = s->intersections();
+
+	sort(eIntersections.begin(), eIntersections.end(), less_Intersection(s));
+}
+
 void ViewMapBuilder::ComputeSweepLineIntersections(ViewMap *ioViewMap, real epsilon)
 {
 	vector<SVertex *>& svertices = ioViewMap->SVertices();
@@ -2288,6 +2410,15 @@ void ViewMapBuilder::ComputeSweepLineIntersections(ViewMap *ioViewMap, real epsi
 	// retrieve the intersections:
 	vector<intersection*>& intersections = SL.intersections();
 
+	// the 3D parameters of the intersections are computed from the task scheduler,
+	// view vertices are then created in order so the ids don't depend on the threads
+	vector<real> worldParameters(2 * intersections.size());
+	if (!intersections.empty()) {
+		IntersectionTaskData data = {&intersections, &worldParameters};
+		BLI_task_parallel_range_ex(0, (int)intersections.size(), &data, imageToWorldParameters_task_cb,
+		                           INTERSECTION_THREAD_THRESHOLD, false);
+	}
+
 	int id = 0;
 	// create a view vertex for each intersection and linked this one with the intersection object
 	vector<intersection*>::iterator i, iend;
@@ -2316,8 +2447,8 @@ void ViewMapBuilder::ComputeSweepLineIntersections(ViewMap *ioViewMap, real epsi
 			cerr << "Warning: 2D intersection out of range for edge " << fB->vertexA()->getId() << " - " <<
 			        fB->vertexB()->getId() << endl;
 
-		real Ta = SilhouetteGeomEngine::ImageToWorldParameter(fA, ta);
-		real Tb = SilhouetteGeomEngine::ImageToWorldParameter(fB, tb);
+		real Ta = worldParameters[2 * id];
+		real Tb = worldParameters[2 * id + 1];
 
 		if ((Ta < -epsilon) || (Ta > 1 + epsilon))
 			cerr << "Warning: 3D intersection out of range for edge " << fA->vertexA()->getId() << " - " <<
@@ -2367,6 +2498,13 @@ void ViewMapBuilder::ComputeSweepLineIntersections(ViewMap *ioViewMap, real epsi
 
 	counter = progressBarStep;
 
+	// we first need to sort the intersections of each edge from farther to closer to A,
+	// every edge owns its list so they are sorted from the task scheduler
+	if (!iedges.empty()) {
+		BLI_task_parallel_range_ex(0, (int)iedges.size(), &iedges, sortEdgeIntersections_task_cb,
+		                           INTERSECTION_THREAD_THRESHOLD, false);
+	}
+
 	vector<TVertex*> edgeVVertices;
 	vector<ViewEdge*> newVEdges;
 	vector<segment*>::iterator s, send;
@@ -2380,8 +2518,6 @@ void ViewMapBuilder::ComputeSweepLineIntersections(ViewMap *ioViewMap, real epsi
 		ViewShape *shape = vEdge->viewShape();
 
 		vector<intersection*>& eIntersections = (*s)->intersections();
-		// we first need to sort these intersections from farther to closer to A
-		sort(eIntersections.begin(), eIntersections.end(), less_Intersection(*s));
 		for (i = eIntersections.begin(), iend = eIntersections.end(); i != iend; i++)
 			edgeVVertices.push_back((TVertex *)(*i)->userdata);
 
@@ -36,6 +36,7 @@
 #include "../scene_graph/FrsMaterial.h"
 
 #include "../system/FreestyleConfig.h"
+#include "../system/MemoryPool.h"
 
 #include "BLI_math.h"
 
@@ -349,9 +350,7 @@ public:
 		return face_iterator(incoming_edges_end());
 	}
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:WVertex")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(WVertex, "Freestyle:WVertex")
 };
 
 
@@ -533,9 +532,7 @@ public:
 		userdata = NULL;
 	}
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:WOEdge")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(WOEdge, "Freestyle:WOEdge")
 };
 
 
@@ -720,9 +717,7 @@ public:
 		userdata = NULL;
 	}
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:WEdge")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(WEdge, "Freestyle:WEdge")
 };
 
 
@@ -1323,11 +1318,22 @@ public:
 		return _wshapes;
 	}
 
+	/*! Hands the shapes over to the caller, which has to free them, the winged-edge is left empty */
+	void releaseWShapes(vector<WShape *>& oWShapes)
+	{
+		oWShapes.swap(_wshapes);
+		_wshapes.clear();
+		_numFaces = 0;
+	}
+
 	unsigned getNumFaces()
 	{
 		return _numFaces;
 	}
 
+	/*! Gives the memory of the pooled winged-edge elements back, once all shapes have been freed */
+	static void releaseMemoryPools();
+
 private:
 	vector<WShape *> _wshapes;
 	unsigned _numFaces;
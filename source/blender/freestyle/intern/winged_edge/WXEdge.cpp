@@ -295,4 +295,22 @@ WFace *WXShape::MakeFace(vector<WVertex *>& iVertexList, vector<Vec3r>& iNormals
 	return face;
 }
 
+/**********************************
+ *                                *
+ *                                *
+ *          WingedEdge            *
+ *                                *
+ *                                *
+ **********************************/
+
+// defined here, as the WX elements have pools of their own
+void WingedEdge::releaseMemoryPools()
+{
+	MemoryPool<WVertex>::release();
+	MemoryPool<WOEdge>::release();
+	MemoryPool<WEdge>::release();
+	MemoryPool<WXVertex>::release();
+	MemoryPool<WXEdge>::release();
+}
+
 } /* namespace Freestyle */
@@ -84,6 +84,15 @@ public:
 			_curvatures->Kr = 0.0;
 	}
 
+	/*! Clears everything */
+	inline void Clear()
+	{
+		if (_curvatures) {
+			delete _curvatures;
+			_curvatures = NULL;
+		}
+	}
+
 	inline void setCurvatures(CurvatureInfo *ci)
 	{
 		_curvatures = ci;
@@ -96,9 +105,7 @@ public:
 		return _curvatures;
 	}
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:WXVertex")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(WXVertex, "Freestyle:WXVertex")
 
 };
 
@@ -166,6 +173,14 @@ public:
 		_nature  = _nature & ~Nature::SUGGESTIVE_CONTOUR;
 	}
 
+	/*! Clears everything */
+	inline void Clear()
+	{
+		_nature = Nature::NO_FEATURE;
+		_front = false;
+		_order = 0;
+	}
+
 	/*! accessors */
 	inline WXNature nature()
 	{
@@ -203,9 +218,7 @@ public:
 		_order = i;
 	}
 
-#ifdef WITH_CXX_GUARDEDALLOC
-	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:WXEdge")
-#endif
+	FRS_POOL_CLASS_ALLOC_FUNCS(WXEdge, "Freestyle:WXEdge")
 
 };
 
@@ -796,6 +809,31 @@ public:
 			((WXFace *)(*wf))->Reset();
 		}
 	}
+
+	/*! Clears all edges, faces and vertices of the features computed on previous passes, view independent ones
+	 *  included, so that the shape is processed as if it was just built (used when the shape is reused from the
+	 *  WXShapeCache).
+	 */
+	virtual void Clear()
+	{
+		vector<WEdge *>& wedges = getEdgeList();
+		for (vector<WEdge *>::iterator we = wedges.begin(), weend = wedges.end(); we != weend; ++we) {
+			((WXEdge *)(*we))->Clear();
+		}
+
+		vector<WFace *>& wfaces = GetFaceList();
+		for (vector<WFace *>::iterator wf = wfaces.begin(), wfend = wfaces.end(); wf != wfend; ++wf) {
+			((WXFace *)(*wf))->Clear();
+		}
+
+		vector<WVertex *>& wvertices = getVertexList();
+		for (vector<WVertex *>::iterator wv = wvertices.begin(), wvend = wvertices.end(); wv != wvend; ++wv) {
+			((WXVertex *)(*wv))->Clear();
+		}
+
+		ResetUserData();
+		_computeViewIndependent = true;
+	}
 	/*! accessors */
 
 #ifdef WITH_CXX_GUARDEDALLOC
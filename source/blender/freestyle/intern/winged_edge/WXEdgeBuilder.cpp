@@ -29,16 +29,49 @@
 #include "WXEdge.h"
 #include "WXEdgeBuilder.h"
 
+#include "../scene_graph/SceneHash.h"
+
 namespace Freestyle {
 
 void WXEdgeBuilder::visitIndexedFaceSet(IndexedFaceSet& ifs)
 {
 	if (_pRenderMonitor && _pRenderMonitor->testBreak())
 		return;
-	WXShape *shape = new WXShape;
-	if (!buildWShape(*shape, ifs)) {
-		delete shape;
-		return;
+
+	// transformed face sets are not cached, the hash only covers the face set itself
+	const bool useCache = (_shapeCache && !getCurrentMatrix());
+	unsigned int hash = 0;
+	WXShape *shape = NULL;
+
+	if (useCache) {
+		hash = SceneHash::hashIndexedFaceSet(ifs);
+		shape = _shapeCache->take(ifs.getName(), hash);
+	}
+
+	if (shape) {
+		// materials are not part of the hash, they are only stored on the shape
+		if (ifs.msize()) {
+			vector<FrsMaterial> frs_materials;
+			const FrsMaterial *const *mats = ifs.frs_materials();
+			for (unsigned i = 0; i < ifs.msize(); ++i)
+				frs_materials.push_back(*(mats[i]));
+			shape->setFrsMaterials(frs_materials);
+		}
+		else if (getCurrentFrsMaterial()) {
+			// same fallback as a newly built shape, WShape only takes a list of materials
+			shape->setFrsMaterials(vector<FrsMaterial>(1, *getCurrentFrsMaterial()));
+		}
+		getWingedEdge()->addWShape(shape);
+		_numReusedShapes++;
+	}
+	else {
+		shape = new WXShape;
+		if (!buildWShape(*shape, ifs)) {
+			delete shape;
+			return;
+		}
+		if (useCache)
+			_shapeCache->add(shape, hash);
 	}
 	shape->setId(ifs.getId().getFirst());
 	shape->setName(ifs.getName());
@@ -30,6 +30,7 @@
  */
 
 #include "WingedEdgeBuilder.h"
+#include "WXShapeCache.h"
 
 #include "../scene_graph/IndexedFaceSet.h"
 
@@ -38,13 +39,34 @@ namespace Freestyle {
 class WXEdgeBuilder : public WingedEdgeBuilder
 {
 public:
-	WXEdgeBuilder() : WingedEdgeBuilder() {}
+	WXEdgeBuilder() : WingedEdgeBuilder()
+	{
+		_shapeCache = NULL;
+		_numReusedShapes = 0;
+	}
+
 	virtual ~WXEdgeBuilder() {}
 	VISIT_DECL(IndexedFaceSet)
 
+	/*! Reuse the shapes of unchanged face sets from the cache instead of building them, the shapes built are
+	 *  registered in the cache (see WXShapeCache::store).
+	 */
+	inline void setShapeCache(WXShapeCache *iShapeCache)
+	{
+		_shapeCache = iShapeCache;
+	}
+
+	inline unsigned getNumReusedShapes() const
+	{
+		return _numReusedShapes;
+	}
+
 protected:
 	virtual void buildWVertices(WShape& shape, const real *vertices, unsigned vsize);
 
+	WXShapeCache *_shapeCache;
+	unsigned _numReusedShapes;
+
 #ifdef WITH_CXX_GUARDEDALLOC
 	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:WXEdgeBuilder")
 #endif
@@ -0,0 +1,94 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/freestyle/intern/winged_edge/WXShapeCache.cpp
+ *  \ingroup freestyle
+ *  \brief Keeps the WX shapes of unchanged objects from one load of the scene to the next
+ */
+
+#include "WXShapeCache.h"
+
+namespace Freestyle {
+
+WXShape *WXShapeCache::take(const string& name, unsigned int hash)
+{
+	pair<shapes_map::iterator, shapes_map::iterator> range = _shapes.equal_range(hash);
+
+	for (shapes_map::iterator it = range.first; it != range.second; ++it) {
+		WXShape *shape = it->second.shape;
+		if (shape->getName() == name) {
+			_shapes.erase(it);
+			_taken[shape] = hash;
+			shape->Clear();
+			return shape;
+		}
+	}
+	return NULL;
+}
+
+void WXShapeCache::add(WXShape *shape, unsigned int hash)
+{
+	_taken[shape] = hash;
+}
+
+void WXShapeCache::store(WingedEdge& we)
+{
+	vector<WShape *> wshapes;
+	we.releaseWShapes(wshapes);
+
+	for (vector<WShape *>::iterator it = wshapes.begin(); it != wshapes.end(); ++it) {
+		map<WShape *, unsigned int>::iterator taken = _taken.find(*it);
+		if (taken == _taken.end()) {
+			delete *it;
+			continue;
+		}
+		Entry entry = {(WXShape *)(*it), true};
+		_shapes.insert(make_pair(taken->second, entry));
+		_taken.erase(taken);
+	}
+	// anything left belonged to a winged-edge that was freed without being stored
+	_taken.clear();
+}
+
+void WXShapeCache::purge()
+{
+	shapes_map::iterator it = _shapes.begin();
+	while (it != _shapes.end()) {
+		if (it->second.used) {
+			it->second.used = false;
+			++it;
+		}
+		else {
+			delete it->second.shape;
+			_shapes.erase(it++);
+		}
+	}
+}
+
+void WXShapeCache::clear()
+{
+	for (shapes_map::iterator it = _shapes.begin(); it != _shapes.end(); ++it) {
+		delete it->second.shape;
+	}
+	_shapes.clear();
+	_taken.clear();
+}
+
+} /* namespace Freestyle */
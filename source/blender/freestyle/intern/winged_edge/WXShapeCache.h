@@ -0,0 +1,103 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __FREESTYLE_WX_SHAPE_CACHE_H__
+#define __FREESTYLE_WX_SHAPE_CACHE_H__
+
+/** \file blender/freestyle/intern/winged_edge/WXShapeCache.h
+ *  \ingroup freestyle
+ *  \brief Keeps the WX shapes of unchanged objects from one load of the scene to the next
+ */
+
+#include <map>
+#include <string>
+
+#include "WXEdge.h"
+
+#ifdef WITH_CXX_GUARDEDALLOC
+#include "MEM_guardedalloc.h"
+#endif
+
+namespace Freestyle {
+
+/*! Building the winged-edge structure is one of the most expensive steps of the view map creation, while from one
+ *  render layer or one frame to the next most objects often did not change (their coordinates are in the camera
+ *  system, so they stay the same as long as neither the camera nor the object move).
+ *  The cache keeps the shapes of the last winged-edge, keyed by the name and the hash of the face set they were
+ *  built from (see SceneHash::hashIndexedFaceSet), so that the WXEdgeBuilder only has to build the changed ones.
+ *  Feature lines and visibility are computed again for all shapes.
+ */
+class WXShapeCache
+{
+public:
+	WXShapeCache() {}
+
+	~WXShapeCache()
+	{
+		clear();
+	}
+
+	/*! Returns a shape built from a face set with the same name and hash, cleared from the features computed
+	 *  on the previous pass, or NULL when there is none. The shape is owned by the caller until it is stored
+	 *  again.
+	 */
+	WXShape *take(const string& name, unsigned int hash);
+
+	/*! Registers a shape just built, so that it is kept when the winged-edge is stored. */
+	void add(WXShape *shape, unsigned int hash);
+
+	/*! Moves the shapes taken from or added to the cache back into it, the other shapes of the winged-edge are
+	 *  freed. The winged-edge is left empty.
+	 */
+	void store(WingedEdge& we);
+
+	/*! Frees the shapes that were neither taken nor stored since the last call, i.e. objects that changed or
+	 *  disappeared.
+	 */
+	void purge();
+
+	/*! Frees all the shapes */
+	void clear();
+
+	inline unsigned int size() const
+	{
+		return _shapes.size();
+	}
+
+private:
+	struct Entry {
+		WXShape *shape;
+		bool used;
+	};
+
+	typedef multimap<unsigned int, Entry> shapes_map;
+
+	shapes_map _shapes;
+	// shapes currently owned by a winged-edge
+	map<WShape *, unsigned int> _taken;
+
+#ifdef WITH_CXX_GUARDEDALLOC
+	MEM_CXX_CLASS_ALLOC_FUNCS("Freestyle:WXShapeCache")
+#endif
+};
+
+} /* namespace Freestyle */
+
+#endif // __FREESTYLE_WX_SHAPE_CACHE_H__
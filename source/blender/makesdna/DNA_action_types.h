@@ -350,6 +350,7 @@ typedef struct bPose {
 	int iksolver;               /* ik solver to use, see ePose_IKSolverType */
 	void *ikdata;               /* temporary IK data, depends on the IK solver. Not saved in file */
 	void *ikparam;              /* IK solver parameters, structure depends on iksolver */
+	struct PoseEvalGraph *eval_graph;  /* channel dependencies for threaded evaluation. Not saved in file */
 	
 	bAnimVizSettings avs;       /* settings for visualization of bone animation */
 	char proxy_act_bone[64];    /* proxy active bone name, MAXBONENAME */
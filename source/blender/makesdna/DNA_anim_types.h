@@ -383,6 +383,8 @@ typedef struct ChannelDriver {
 		/* general settings */
 	int type;			/* type of driver */
 	int flag;			/* settings of driver */
+	
+	struct AnimRNAPathCache *rna_cache;	/* resolved paths of the targets, don't save this */
 } ChannelDriver;
 
 /* driver type */
@@ -460,6 +462,8 @@ typedef struct FCurve {
 	float color[3];			/* the last-color this curve took */
 
 	float prev_norm_factor, pad;
+
+	struct FCurveSampleTable *sample_table;	/* baked keyframe values for playback, don't save this */
 } FCurve;
 
 
@@ -866,6 +870,8 @@ typedef struct AnimData {
 	short act_blendmode;    /* accumulation mode for active action */
 	short act_extendmode;   /* extrapolation mode for active action */
 	float act_influence;    /* influence for active action */
+
+	struct AnimRNAPathCache *rna_cache;  /* resolved paths of the F-Curves, don't save this */
 } AnimData;
 
 /* Animation Data settings (mostly for NLA) */
@@ -145,6 +145,7 @@ typedef struct SPHFluidSettings {
 #define SPH_FAC_RADIUS				16
 #define SPH_FAC_VISCOSITY			32
 #define SPH_FAC_REST_LENGTH			64
+#define SPH_GRID_SEARCH				128
 
 /* fluid->solver (numerical ID field, not bitfield) */
 #define SPH_SOLVER_DDR					0
@@ -535,6 +535,8 @@ typedef struct UserDef {
 	int compute_device_id;
 	
 	float fcu_inactive_alpha;	/* opacity of inactive F-Curves in F-Curve Editor */
+	float fcu_sample_tolerance;	/* max error of F-Curves evaluated from baked samples on playback, 0 disables */
+	int pad2;
 	float pixelsize;			/* private, set by GHOST, to multiply DPI with */
 	int virtual_pixel;			/* virtual pixelsize mode */
 
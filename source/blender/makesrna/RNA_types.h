@@ -373,6 +373,7 @@ typedef enum FunctionFlag {
 	FUNC_USE_REPORTS       = (1 << 4),
 	FUNC_USE_SELF_ID       = (1 << 11),
 	FUNC_ALLOW_WRITE       = (1 << 12),
+	FUNC_NO_DATA_REALLOC   = (1 << 13), /* doesn't add, remove or reallocate data, resolved RNA paths stay valid */
 
 	/* registering */
 	FUNC_REGISTER          = (1 << 5),
@@ -1666,6 +1666,9 @@ static void rna_property_update(bContext *C, Main *bmain, Scene *scene, PointerR
 	const bool is_rna = (prop->magic == RNA_MAGIC);
 	prop = rna_ensure_property(prop);
 
+	/* names and pointers used to resolve animation paths may have changed */
+	BKE_animsys_rna_path_cache_tag_invalid();
+
 	if (is_rna) {
 		if (prop->update) {
 			/* ideally no context would be needed for update, but there's some
@@ -5948,6 +5951,10 @@ int RNA_function_call(bContext *C, ReportList *reports, PointerRNA *ptr, Functio
 	if (func->call) {
 		func->call(C, reports, ptr, parms);
 
+		/* functions can add or remove data (modifiers.remove() etc) */
+		if (!(func->flag & FUNC_NO_DATA_REALLOC))
+			BKE_animsys_rna_path_cache_tag_invalid();
+
 		return 0;
 	}
 
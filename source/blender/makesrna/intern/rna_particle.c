@@ -1509,6 +1509,13 @@ static void rna_def_fluid_settings(BlenderRNA *brna)
 	RNA_def_property_ui_text(prop, "SPH Solver", "The code used to calculate internal forces on particles");
 	RNA_def_property_update(prop, 0, "rna_Particle_reset");
 
+	prop = RNA_def_property(srna, "use_grid_search", PROP_BOOLEAN, PROP_NONE);
+	RNA_def_property_boolean_sdna(prop, NULL, "flag", SPH_GRID_SEARCH);
+	RNA_def_property_ui_text(prop, "Grid Search",
+	                         "Find neighboring particles in a uniform grid instead of a BVH tree "
+	                         "(faster for dense fluids)");
+	RNA_def_property_update(prop, 0, "rna_Particle_reset");
+
 	prop = RNA_def_property(srna, "spring_force", PROP_FLOAT, PROP_NONE);
 	RNA_def_property_float_sdna(prop, NULL, "spring_k");
 	RNA_def_property_range(prop, 0.0f, 100.0f);
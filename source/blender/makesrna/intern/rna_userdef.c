@@ -83,6 +83,7 @@ EnumPropertyItem navigation_mode_items[] = {
 #include "DNA_object_types.h"
 #include "DNA_screen_types.h"
 
+#include "BKE_animsys.h"
 #include "BKE_blender.h"
 #include "BKE_DerivedMesh.h"
 #include "BKE_depsgraph.h"
@@ -141,6 +142,12 @@ static void rna_userdef_language_update(Main *UNUSED(bmain), Scene *UNUSED(scene
 	UI_reinit_font();
 }
 
+static void rna_userdef_fcurve_sample_update(Main *bmain, Scene *UNUSED(scene), PointerRNA *UNUSED(ptr))
+{
+	/* F-Curves are baked again for the new tolerance on playback */
+	BKE_animdata_free_sample_tables_main(bmain);
+}
+
 static void rna_userdef_show_manipulator_update(Main *bmain, Scene *scene, PointerRNA *ptr)
 {
 	UserDef *userdef = (UserDef *)ptr->data;
@@ -3550,6 +3557,16 @@ static void rna_def_userdef_edit(BlenderRNA *brna)
 	RNA_def_property_ui_text(prop, "Allow Negative Frames",
 	                         "Current frame number can be manually set to a negative value");
 
+	prop = RNA_def_property(srna, "fcurve_sample_tolerance", PROP_FLOAT, PROP_NONE);
+	RNA_def_property_float_sdna(prop, NULL, "fcu_sample_tolerance");
+	RNA_def_property_range(prop, 0.0f, 1.0f);
+	RNA_def_property_ui_range(prop, 0.0f, 0.1f, 0.1, 4);
+	RNA_def_property_ui_text(prop, "F-Curve Sampling Tolerance",
+	                         "Largest error allowed for evaluating keyframes from baked samples on playback, "
+	                         "faster for many F-Curves (zero always evaluates the keyframes exactly, "
+	                         "renders are never affected)");
+	RNA_def_property_update(prop, 0, "rna_userdef_fcurve_sample_update");
+
 	/* fcurve opacity */
 	prop = RNA_def_property(srna, "fcurve_unselected_alpha", PROP_FLOAT, PROP_FACTOR);
 	RNA_def_property_float_sdna(prop, NULL, "fcu_inactive_alpha");
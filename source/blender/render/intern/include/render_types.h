@@ -66,6 +66,7 @@ struct RenderEngine;
 struct ReportList;
 struct Main;
 struct ImagePool;
+struct Tex;
 
 #define TABLEINITSIZE 1024
 
@@ -82,7 +83,7 @@ typedef struct QMCSampler {
 	int tot;
 	int used;
 	double *samp2d;
-	double offs[BLENDER_MAX_THREADS][2];
+	double offs[2];  /* samplers are per thread, see get_thread_qmcsampler() */
 } QMCSampler;
 
 // #define SAMP_TYPE_JITTERED		0  // UNUSED
@@ -183,8 +184,13 @@ struct Render
 	float mblur_jit[32][2];
 	ListBase *qmcsamplers;
 	
-	/* shadow counter, detect shadow-reuse for shaders */
-	int shadowsamplenr[BLENDER_MAX_THREADS];
+	/* shadow counter, detect shadow-reuse for shaders, per thread */
+	int *shadowsamplenr;
+
+	/* per thread, pixel the AO table in wrld.aotables was made for */
+	int (*aotable_xy)[2];
+	/* per thread, image texture for render_realtime_texture() */
+	struct Tex *realtime_tex;
 	
 	/* main, scene, and its full copy of renderdata and world */
 	struct Main *main;
@@ -228,6 +234,7 @@ struct Render
 	struct Image *bakebuf;
 	
 	struct GHash *orco_hash;
+	struct GHash *derivedmesh_hash;
 
 	struct GHash *sss_hash;
 	ListBase *sss_points;
@@ -307,7 +314,7 @@ typedef struct ShadBuf {
 	ListBase buffers;
 	
 	/* irregular shadowbufer, result stored per thread */
-	struct ISBData *isb_result[BLENDER_MAX_THREADS];
+	struct ISBData **isb_result;
 } ShadBuf;
 
 /* ------------------------------------------------------------------------- */
@@ -582,7 +589,7 @@ typedef struct LampRen {
 	float compressthresh;
 	
 	short ray_samp, ray_sampy, ray_sampz, ray_samp_method, ray_samp_type, area_shape, ray_totsamp;
-	short xold[BLENDER_MAX_THREADS], yold[BLENDER_MAX_THREADS];	/* last jitter table for area lights */
+	short *xold, *yold;	/* last jitter table for area lights, per thread */
 	float area_size, area_sizey, area_sizez;
 	float adapt_thresh;
 
@@ -604,8 +611,8 @@ typedef struct LampRen {
 	/* passes & node shader support: all shadow info for a pixel */
 	LampShadowSample *shadsamp;
 	
-	/* ray optim */
-	struct RayObject *last_hit[BLENDER_MAX_THREADS];
+	/* ray optim, per thread */
+	struct RayObject **last_hit;
 	
 	struct MTex *mtex[MAX_MTEX];
 
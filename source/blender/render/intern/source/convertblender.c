@@ -40,6 +40,7 @@
 #include "BLI_utildefines.h"
 #include "BLI_rand.h"
 #include "BLI_memarena.h"
+#include "BLI_task.h"
 #ifdef WITH_FREESTYLE
 #  include "BLI_edgehash.h"
 #endif
@@ -3084,61 +3085,41 @@ static bool has_freestyle_edge_mark(EdgeHash *edge_hash, int v1, int v2)
 }
 #endif
 
-static void init_render_mesh(Render *re, ObjectRen *obr, int timeoffset)
+typedef struct RenderMeshNeeds {
+	bool need_orco, need_stress, need_nmap_tangent, need_tangent, need_origindex;
+	bool do_autosmooth, do_displace;
+} RenderMeshNeeds;
+
+/* what init_render_mesh needs from the derived mesh, returns its data mask,
+ * timeoffset is cleared when the object can't have speed vectors */
+static CustomDataMask init_render_mesh_needs(Render *re, Object *ob, int *timeoffset, RenderMeshNeeds *needs)
 {
-	Object *ob= obr->ob;
-	Mesh *me;
-	MVert *mvert = NULL;
-	MFace *mface;
-	VlakRen *vlr; //, *vlr1;
-	VertRen *ver;
+	Mesh *me = ob->data;
 	Material *ma;
-	DerivedMesh *dm;
 	CustomDataMask mask;
-	float xn, yn, zn,  imat[3][3], mat[4][4];  //nor[3],
-	float *orco = NULL;
-	short (*loop_nors)[4][3] = NULL;
-	bool need_orco = false, need_stress = false, need_nmap_tangent = false, need_tangent = false, need_origindex = false;
-	int a, a1, ok, vertofs;
-	int end, totvert = 0;
-	bool do_autosmooth = false, do_displace = false;
-	bool use_original_normals = false;
-	int recalc_normals = 0;	/* false by default */
-	int negative_scale;
-#ifdef WITH_FREESTYLE
-	FreestyleFace *ffa;
-#endif
-
-	me= ob->data;
+	int a;
 
-	mul_m4_m4m4(mat, re->viewmat, ob->obmat);
-	invert_m4_m4(ob->imat, mat);
-	copy_m3_m4(imat, ob->imat);
-	negative_scale= is_negative_m4(mat);
+	memset(needs, 0, sizeof(*needs));
 
-	if (me->totvert==0)
-		return;
-	
-	need_orco= 0;
 	for (a=1; a<=ob->totcol; a++) {
 		ma= give_render_material(re, ob, a);
 		if (ma) {
 			if (ma->texco & (TEXCO_ORCO|TEXCO_STRESS))
-				need_orco= 1;
+				needs->need_orco= 1;
 			if (ma->texco & TEXCO_STRESS)
-				need_stress= 1;
+				needs->need_stress= 1;
 			/* normalmaps, test if tangents needed, separated from shading */
 			if (ma->mode_l & MA_TANGENT_V) {
-				need_tangent= 1;
+				needs->need_tangent= 1;
 				if (me->mtpoly==NULL)
-					need_orco= 1;
+					needs->need_orco= 1;
 			}
 			if (ma->mode_l & MA_NORMAP_TANG) {
 				if (me->mtpoly==NULL) {
-					need_orco= 1;
-					need_tangent= 1;
+					needs->need_orco= 1;
+					needs->need_tangent= 1;
 				}
-				need_nmap_tangent= 1;
+				needs->need_nmap_tangent= 1;
 			}
 		}
 	}
@@ -3146,37 +3127,135 @@ static void init_render_mesh(Render *re, ObjectRen *obr, int timeoffset)
 	if (re->flag & R_NEED_TANGENT) {
 		/* exception for tangent space baking */
 		if (me->mtpoly==NULL) {
-			need_orco= 1;
-			need_tangent= 1;
+			needs->need_orco= 1;
+			needs->need_tangent= 1;
 		}
-		need_nmap_tangent= 1;
+		needs->need_nmap_tangent= 1;
 	}
 
 	/* check autosmooth and displacement, we then have to skip only-verts optimize
 	 * Note: not sure what we want to give higher priority, currently do_displace
 	 *       takes precedence over do_autosmooth.
 	 */
-	do_displace = test_for_displace(re, ob);
-	do_autosmooth = ((me->flag & ME_AUTOSMOOTH) != 0) && !do_displace;
-	if (do_autosmooth || do_displace)
-		timeoffset = 0;
+	needs->do_displace = test_for_displace(re, ob);
+	needs->do_autosmooth = ((me->flag & ME_AUTOSMOOTH) != 0) && !needs->do_displace;
+	if (needs->do_autosmooth || needs->do_displace)
+		*timeoffset = 0;
 
 	/* origindex currently used when using autosmooth, or baking to vertex colors. */
-	need_origindex = (do_autosmooth || ((re->flag & R_BAKING) && (re->r.bake_flag & R_BAKE_VCOL)));
+	needs->need_origindex = (needs->do_autosmooth || ((re->flag & R_BAKING) && (re->r.bake_flag & R_BAKE_VCOL)));
 
 	mask= CD_MASK_BAREMESH|CD_MASK_MTFACE|CD_MASK_MCOL;
-	if (!timeoffset)
-		if (need_orco)
+	if (!*timeoffset)
+		if (needs->need_orco)
 			mask |= CD_MASK_ORCO;
 
 #ifdef WITH_FREESTYLE
 	mask |= CD_MASK_ORIGINDEX | CD_MASK_FREESTYLE_EDGE | CD_MASK_FREESTYLE_FACE;
 #endif
 
+	return mask;
+}
+
+/* derived mesh evaluated in advance by database_init_derived_meshes */
+typedef struct RenderDerivedMesh {
+	Object *ob;
+	DerivedMesh *dm;
+	CustomDataMask mask;
+	float obmat[4][4];
+} RenderDerivedMesh;
+
+static void free_render_derived_mesh(void *rdm_v)
+{
+	RenderDerivedMesh *rdm = rdm_v;
+
+	if (rdm->dm)
+		rdm->dm->release(rdm->dm);
+	MEM_freeN(rdm);
+}
+
+static void free_derived_mesh_hash(Render *re)
+{
+	if (re->derivedmesh_hash) {
+		BLI_ghash_free(re->derivedmesh_hash, NULL, free_render_derived_mesh);
+		re->derivedmesh_hash = NULL;
+	}
+}
+
+static DerivedMesh *render_mesh_derived(Render *re, ObjectRen *obr, CustomDataMask mask)
+{
+	Object *ob = obr->ob;
+
 	if (re->r.scemode & R_VIEWPORT_PREVIEW)
-		dm= mesh_create_derived_view(re->scene, ob, mask);
-	else
-		dm= mesh_create_derived_render(re->scene, ob, mask);
+		return mesh_create_derived_view(re->scene, ob, mask);
+
+	/* dupli group members get their matrix changed during conversion, the
+	 * cached mesh is only valid for the object as it was evaluated */
+	if (re->derivedmesh_hash && obr->par == NULL) {
+		RenderDerivedMesh *rdm = BLI_ghash_popkey(re->derivedmesh_hash, ob, NULL);
+
+		if (rdm) {
+			DerivedMesh *dm = NULL;
+
+			if (rdm->mask == mask && memcmp(rdm->obmat, ob->obmat, sizeof(rdm->obmat)) == 0) {
+				dm = rdm->dm;
+				rdm->dm = NULL;
+			}
+			free_render_derived_mesh(rdm);
+
+			if (dm)
+				return dm;
+		}
+	}
+
+	return mesh_create_derived_render(re->scene, ob, mask);
+}
+
+static void init_render_mesh(Render *re, ObjectRen *obr, int timeoffset)
+{
+	Object *ob= obr->ob;
+	Mesh *me;
+	MVert *mvert = NULL;
+	MFace *mface;
+	VlakRen *vlr; //, *vlr1;
+	VertRen *ver;
+	Material *ma;
+	DerivedMesh *dm;
+	CustomDataMask mask;
+	float xn, yn, zn,  imat[3][3], mat[4][4];  //nor[3],
+	float *orco = NULL;
+	short (*loop_nors)[4][3] = NULL;
+	bool need_stress = false, need_nmap_tangent = false, need_tangent = false, need_origindex = false;
+	int a, a1, ok, vertofs;
+	int end, totvert = 0;
+	bool do_autosmooth = false, do_displace = false;
+	bool use_original_normals = false;
+	int recalc_normals = 0;	/* false by default */
+	int negative_scale;
+	RenderMeshNeeds needs;
+#ifdef WITH_FREESTYLE
+	FreestyleFace *ffa;
+#endif
+
+	me= ob->data;
+
+	mul_m4_m4m4(mat, re->viewmat, ob->obmat);
+	invert_m4_m4(ob->imat, mat);
+	copy_m3_m4(imat, ob->imat);
+	negative_scale= is_negative_m4(mat);
+
+	if (me->totvert==0)
+		return;
+	
+	mask = init_render_mesh_needs(re, ob, &timeoffset, &needs);
+	need_stress = needs.need_stress;
+	need_nmap_tangent = needs.need_nmap_tangent;
+	need_tangent = needs.need_tangent;
+	need_origindex = needs.need_origindex;
+	do_autosmooth = needs.do_autosmooth;
+	do_displace = needs.do_displace;
+
+	dm = render_mesh_derived(re, obr, mask);
 	if (dm==NULL) return;	/* in case duplicated object fails? */
 
 	if (mask & CD_MASK_ORCO) {
@@ -3542,6 +3621,8 @@ static void initshadowbuf(Render *re, LampRen *lar, float mat[4][4])
 	lar->shb= shb;
 	
 	if (shb==NULL) return;
+
+	shb->isb_result= MEM_callocN(sizeof(*shb->isb_result)*re->r.threads, "isb results");
 	
 	VECCOPY(shb->co, lar->co); /* int copy */
 	
@@ -3641,6 +3722,11 @@ static GroupObject *add_render_lamp(Render *re, Object *ob)
 	BLI_addtail(&re->lampren, lar);
 	go->lampren= lar;
 
+	/* per thread */
+	lar->xold= MEM_callocN(sizeof(*lar->xold)*re->r.threads, "lamp jitter xold");
+	lar->yold= MEM_callocN(sizeof(*lar->yold)*re->r.threads, "lamp jitter yold");
+	lar->last_hit= MEM_callocN(sizeof(*lar->last_hit)*re->r.threads, "lamp last hit");
+
 	mul_m4_m4m4(mat, re->viewmat, ob->obmat);
 	invert_m4_m4(ob->imat, mat);
 
@@ -3737,7 +3823,7 @@ static GroupObject *add_render_lamp(Render *re, Object *ob)
 		}
 
 		area_lamp_vectors(lar);
-		init_jitter_plane(lar);	 /* subsamples */
+		init_jitter_plane(re, lar);	 /* subsamples */
 	}
 	else if (lar->type==LA_SUN) {
 		lar->ray_totsamp= lar->ray_samp*lar->ray_samp;
@@ -3856,7 +3942,7 @@ static GroupObject *add_render_lamp(Render *re, Object *ob)
 		if (re->r.mode & R_SHADOW) {
 			
 			if (la->type==LA_AREA && (lar->mode & LA_SHAD_RAY) && (lar->ray_samp_method == LA_SAMP_CONSTANT)) {
-				init_jitter_plane(lar);
+				init_jitter_plane(re, lar);
 			}
 			else if (la->type==LA_SPOT && (lar->mode & LA_SHAD_BUF) ) {
 				/* Per lamp, one shadow buffer is made. */
@@ -3872,7 +3958,7 @@ static GroupObject *add_render_lamp(Render *re, Object *ob)
 				LampShadowSubSample *lss;
 				int a, b;
 
-				memset(re->shadowsamplenr, 0, sizeof(re->shadowsamplenr));
+				memset(re->shadowsamplenr, 0, sizeof(*re->shadowsamplenr)*re->r.threads);
 				
 				lar->shadsamp= MEM_mallocN(re->r.threads*sizeof(LampShadowSample), "lamp shadow sample");
 				ls= lar->shadsamp;
@@ -4729,6 +4815,9 @@ void RE_Database_Free(Render *re)
 	for (lar= re->lampren.first; lar; lar= lar->next) {
 		freeshadowbuf(lar);
 		if (lar->jitter) MEM_freeN(lar->jitter);
+		MEM_freeN(lar->xold);
+		MEM_freeN(lar->yold);
+		MEM_freeN(lar->last_hit);
 		if (lar->shadsamp) MEM_freeN(lar->shadsamp);
 		if (lar->sunsky) MEM_freeN(lar->sunsky);
 		curvemapping_free(lar->curfalloff);
@@ -4764,6 +4853,14 @@ void RE_Database_Free(Render *re)
 		if (re->scene && re->scene->world)
 			re->scene->world->aotables= NULL;
 	}
+	if (re->aotable_xy) {
+		MEM_freeN(re->aotable_xy);
+		re->aotable_xy= NULL;
+	}
+	if (re->shadowsamplenr) {
+		MEM_freeN(re->shadowsamplenr);
+		re->shadowsamplenr= NULL;
+	}
 	if (re->r.mode & R_RAYTRACE)
 		free_render_qmcsampler(re);
 	
@@ -4924,6 +5021,119 @@ static void add_group_render_dupli_obs(Render *re, Group *group, int nolamps, in
 	}
 }
 
+static void derived_mesh_check_id_link(void *userData, Object *UNUSED(ob), ID **idpoin)
+{
+	bool *has_links = userData;
+	ID *id = *idpoin;
+
+	/* other objects may be evaluated concurrently, node textures share exec data */
+	if (id) {
+		if (GS(id->name) == ID_OB)
+			*has_links = true;
+		else if (GS(id->name) == ID_TE && ((Tex *)id)->use_nodes && ((Tex *)id)->nodetree)
+			*has_links = true;
+	}
+}
+
+/* only plain mesh objects whose modifier stack depends on nothing but its own data */
+static bool allow_parallel_derived_mesh(Object *ob)
+{
+	VirtualModifierData virtualModifierData;
+	ModifierData *md;
+	Mesh *me = ob->data;
+	bool has_links = false;
+
+	if (ob->type != OB_MESH || me->totvert == 0)
+		return false;
+	if ((ob->transflag & OB_DUPLI) || ob->particlesystem.first)
+		return false;
+
+	for (md = modifiers_getVirtualModifierList(ob, &virtualModifierData); md; md = md->next) {
+		ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+
+		if (mti->flags & eModifierTypeFlag_UsesPointCache)
+			return false;
+	}
+
+	modifiers_foreachIDLink(ob, derived_mesh_check_id_link, &has_links);
+
+	return !has_links;
+}
+
+static void derived_mesh_task(TaskPool *pool, void *taskdata, int UNUSED(threadid))
+{
+	Render *re = BLI_task_pool_userdata(pool);
+	RenderDerivedMesh *rdm = taskdata;
+
+	if (!re->test_break(re->tbh))
+		rdm->dm = mesh_create_derived_render(re->scene, rdm->ob, rdm->mask);
+}
+
+/* evaluate the modifier stacks of independent mesh objects in parallel ahead
+ * of conversion, init_render_mesh picks the results up from derivedmesh_hash */
+static void database_init_derived_meshes(Render *re, unsigned int renderlay, int nolamps, int onlyselected, Object *actob, int timeoffset)
+{
+	Base *base;
+	Object *ob;
+	Scene *sce_iter;
+	GHash *mesh_hash;
+	GHashIterator gh_iter;
+	TaskPool *task_pool;
+	int lay;
+
+	if (re->r.scemode & R_VIEWPORT_PREVIEW)
+		return;
+
+	lay = (timeoffset)? renderlay & get_vector_renderlayers(re->scene): renderlay;
+
+	re->derivedmesh_hash = BLI_ghash_ptr_new("database_init_derived_meshes gh");
+	/* objects sharing a mesh also share shape keys and tessellation */
+	mesh_hash = BLI_ghash_ptr_new("database_init_derived_meshes mesh gh");
+
+	for (SETLOOPER(re->scene, sce_iter, base)) {
+		RenderDerivedMesh *rdm;
+		RenderMeshNeeds needs;
+		int ob_timeoffset = timeoffset;
+
+		ob = base->object;
+
+		if (!(base->lay & lay))
+			continue;
+		if (is_object_restricted(re, ob) || !allow_render_object(re, ob, nolamps, onlyselected, actob))
+			continue;
+		if (!allow_parallel_derived_mesh(ob))
+			continue;
+		if (BLI_ghash_haskey(re->derivedmesh_hash, ob) || BLI_ghash_haskey(mesh_hash, ob->data))
+			continue;
+
+		rdm = MEM_callocN(sizeof(RenderDerivedMesh), "RenderDerivedMesh");
+		rdm->ob = ob;
+		/* materials get flagged for rendering here, so not done in the tasks */
+		rdm->mask = init_render_mesh_needs(re, ob, &ob_timeoffset, &needs);
+		copy_m4_m4(rdm->obmat, ob->obmat);
+
+		BLI_ghash_insert(re->derivedmesh_hash, ob, rdm);
+		BLI_ghash_insert(mesh_hash, ob->data, ob);
+	}
+
+	BLI_ghash_free(mesh_hash, NULL, NULL);
+
+	/* nothing to gain over evaluating during conversion */
+	if (BLI_ghash_size(re->derivedmesh_hash) < 2) {
+		free_derived_mesh_hash(re);
+		return;
+	}
+
+	task_pool = BLI_task_pool_create(BLI_task_scheduler_get(), re);
+
+	GHASH_ITER (gh_iter, re->derivedmesh_hash) {
+		BLI_task_pool_push(task_pool, derived_mesh_task, BLI_ghashIterator_getValue(&gh_iter), false, TASK_PRIORITY_LOW);
+	}
+
+	BLI_task_pool_work_and_wait(task_pool);
+	BLI_task_pool_free(task_pool);
+}
+
 static void database_init_objects(Render *re, unsigned int renderlay, int nolamps, int onlyselected, Object *actob, int timeoffset)
 {
 	Base *base;
@@ -4956,6 +5166,8 @@ static void database_init_objects(Render *re, unsigned int renderlay, int nolamp
 		ob->transflag &= ~OB_RENDER_DUPLI;
 	}
 
+	database_init_derived_meshes(re, renderlay, nolamps, onlyselected, actob, timeoffset);
+
 	for (SETLOOPER(re->scene, sce_iter, base)) {
 		ob= base->object;
 
@@ -5105,6 +5317,9 @@ static void database_init_objects(Render *re, unsigned int renderlay, int nolamp
 	for (group= re->main->group.first; group; group=group->id.next)
 		add_group_render_dupli_obs(re, group, nolamps, onlyselected, actob, timeoffset, 0);
 
+	/* meshes not picked up, on test_break or when conversion took another path */
+	free_derived_mesh_hash(re);
+
 	if (!re->test_break(re->tbh))
 		RE_makeRenderInstances(re);
 }
@@ -5171,12 +5386,13 @@ void RE_Database_FromScene(Render *re, Main *bmain, Scene *scene, unsigned int l
 	copy_m4_m4(re->viewmat_orig, re->viewmat);
 	
 	init_render_world(re);	/* do first, because of ambient. also requires re->osa set correct */
+	re->shadowsamplenr= MEM_callocN(sizeof(*re->shadowsamplenr)*re->r.threads, "shadow sample nr");
 	if (re->r.mode & R_RAYTRACE) {
 		init_render_qmcsampler(re);
 
 		if (re->wrld.mode & (WO_AMB_OCC|WO_ENV_LIGHT|WO_INDIRECT_LIGHT))
 			if (re->wrld.ao_samp_method == WO_AOSAMP_CONSTANT)
-				init_ao_sphere(&re->wrld);
+				init_ao_sphere(re, &re->wrld);
 	}
 	
 	/* still bad... doing all */
@@ -5902,12 +6118,13 @@ void RE_Database_Baking(Render *re, Main *bmain, Scene *scene, unsigned int lay,
 	/* done setting dummy values */
 
 	init_render_world(re);	/* do first, because of ambient. also requires re->osa set correct */
+	re->shadowsamplenr= MEM_callocN(sizeof(*re->shadowsamplenr)*re->r.threads, "shadow sample nr");
 	if (re->r.mode & R_RAYTRACE) {
 		init_render_qmcsampler(re);
 		
 		if (re->wrld.mode & (WO_AMB_OCC|WO_ENV_LIGHT|WO_INDIRECT_LIGHT))
 			if (re->wrld.ao_samp_method == WO_AOSAMP_CONSTANT)
-				init_ao_sphere(&re->wrld);
+				init_ao_sphere(re, &re->wrld);
 	}
 	
 	/* still bad... doing all */
@@ -185,6 +185,9 @@ static Render *envmap_render_copy(Render *re, EnvMap *env)
 	envre->instancetable = re->instancetable;
 	envre->objectinstance = re->objectinstance;
 	envre->qmcsamplers = re->qmcsamplers;
+	envre->shadowsamplenr = re->shadowsamplenr;
+	envre->aotable_xy = re->aotable_xy;
+	envre->realtime_tex = re->realtime_tex;
 	
 	return envre;
 }
@@ -206,6 +209,9 @@ static void envmap_free_render_copy(Render *envre)
 	BLI_listbase_clear(&envre->instancetable);
 	envre->objectinstance = NULL;
 	envre->qmcsamplers = NULL;
+	envre->shadowsamplenr = NULL;
+	envre->aotable_xy = NULL;
+	envre->realtime_tex = NULL;
 	
 	RE_FreeRender(envre);
 }
@@ -104,7 +104,8 @@ typedef struct OcclusionTree {
 	
 	OccNode *root;
 
-	OccNode **stack[BLENDER_MAX_THREADS];
+	OccNode ***stack;   /* per thread */
+	int totstack;
 	int maxdepth;
 
 	int totface;
@@ -534,7 +535,7 @@ static void *exec_occ_build(void *data)
 static void occ_build_recursive(OcclusionTree *tree, OccNode *node, int begin, int end, int depth)
 {
 	ListBase threads;
-	OcclusionBuildThread othreads[BLENDER_MAX_THREADS];
+	OcclusionBuildThread othreads[TOTCHILD];  /* one thread per child at most */
 	OccNode *child, tmpnode;
 	/* OccFace *face; */
 	int a, b, totthread = 0, offset[TOTCHILD], count[TOTCHILD];
@@ -683,7 +684,7 @@ static OcclusionTree *occ_tree_build(Render *re)
 	BLI_memarena_use_calloc(tree->arena);
 
 	if (re->wrld.aomode & WO_AOCACHE)
-		tree->cache = MEM_callocN(sizeof(OcclusionCache) * BLENDER_MAX_THREADS, "OcclusionCache");
+		tree->cache = MEM_callocN(sizeof(OcclusionCache) * re->r.threads, "OcclusionCache");
 
 	tree->face = MEM_callocN(sizeof(OccFace) * totface, "OcclusionFace");
 	tree->co = MEM_callocN(sizeof(float) * 3 * totface, "OcclusionCo");
@@ -734,7 +735,9 @@ static OcclusionTree *occ_tree_build(Render *re)
 	if (!(re->test_break(re->tbh)))
 		occ_build_sh_normalize(tree->root);
 
-	for (a = 0; a < BLENDER_MAX_THREADS; a++)
+	tree->totstack = re->r.threads;
+	tree->stack = MEM_callocN(sizeof(*tree->stack) * tree->totstack, "OccStacks");
+	for (a = 0; a < tree->totstack; a++)
 		tree->stack[a] = MEM_callocN(sizeof(OccNode) * TOTCHILD * (tree->maxdepth + 1), "OccStack");
 
 	return tree;
@@ -746,9 +749,11 @@ static void occ_free_tree(OcclusionTree *tree)
 
 	if (tree) {
 		if (tree->arena) BLI_memarena_free(tree->arena);
-		for (a = 0; a < BLENDER_MAX_THREADS; a++)
-			if (tree->stack[a])
+		if (tree->stack) {
+			for (a = 0; a < tree->totstack; a++)
 				MEM_freeN(tree->stack[a]);
+			MEM_freeN(tree->stack);
+		}
 		if (tree->occlusion) MEM_freeN(tree->occlusion);
 		if (tree->cache) MEM_freeN(tree->cache);
 		if (tree->face) MEM_freeN(tree->face);
@@ -1260,7 +1265,7 @@ static void *exec_strandsurface_sample(void *data)
 
 void make_occ_tree(Render *re)
 {
-	OcclusionThread othreads[BLENDER_MAX_THREADS];
+	OcclusionThread *othreads;
 	OcclusionTree *tree;
 	StrandSurface *mesh;
 	ListBase threads;
@@ -1292,6 +1297,7 @@ void make_occ_tree(Render *re)
 
 			totthread = (mesh->totface > 10000) ? re->r.threads : 1;
 			totface = mesh->totface / totthread;
+			othreads = MEM_mallocN(sizeof(OcclusionThread) * totthread, "OcclusionThread");
 			for (a = 0; a < totthread; a++) {
 				othreads[a].re = re;
 				othreads[a].faceao = faceao;
@@ -1315,6 +1321,8 @@ void make_occ_tree(Render *re)
 				BLI_end_threads(&threads);
 			}
 
+			MEM_freeN(othreads);
+
 			for (a = 0; a < mesh->totface; a++) {
 				face = mesh->face[a];
 
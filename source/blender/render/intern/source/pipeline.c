@@ -44,6 +44,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "atomic_ops.h"
+
 #include "BLI_math.h"
 #include "BLI_rect.h"
 #include "BLI_listbase.h"
@@ -1030,15 +1032,36 @@ static bool find_next_pano_slice(Render *re, int *slice, int *minx, rctf *viewpl
 	return found;
 }
 
-static RenderPart *find_next_part(Render *re, int minx)
+typedef struct PartOrder {
+	long long int dist;
+	int index;
+	RenderPart *pa;
+} PartOrder;
+
+static int part_order_cmp(const void *a_v, const void *b_v)
 {
-	RenderPart *pa, *best = NULL;
+	const PartOrder *a = a_v, *b = b_v;
+
+	if (a->dist < b->dist) return -1;
+	else if (a->dist > b->dist) return 1;
+	/* keep list order for equal distance */
+	return (a->index < b->index) ? -1 : (a->index > b->index);
+}
+
+/* fills parts with the non-rendering parts of the slice, nearest to
+ * the center of the already rendered parts first, returns the count */
+static int find_next_parts(Render *re, int minx, RenderPart **parts)
+{
+	RenderPart *pa;
+	PartOrder *order;
+	int a, index, tot_order = 0;
 
 	/* long long int's needed because of overflow [#24414] */
 	long long int centx = re->winx / 2, centy = re->winy / 2, tot = 1;
-	long long int mindist = (long long int)re->winx * (long long int)re->winy;
+	const long long int maxdist = (long long int)re->winx * (long long int)re->winy;
 	
-	/* find center of rendered parts, image center counts for 1 too */
+	/* find center of rendered parts, image center counts for 1 too,
+	 * no parts get ready while we gather so this is done once */
 	for (pa = re->parts.first; pa; pa = pa->next) {
 		if (pa->status == PART_STATUS_READY) {
 			centx += BLI_rcti_cent_x(&pa->disprect);
@@ -1048,28 +1071,50 @@ static RenderPart *find_next_part(Render *re, int minx)
 	}
 	centx /= tot;
 	centy /= tot;
+
+	order = MEM_mallocN(sizeof(PartOrder) * BLI_listbase_count(&re->parts), "render part order");
 	
-	/* closest of the non-rendering parts */
-	for (pa = re->parts.first; pa; pa = pa->next) {
+	/* distance of the non-rendering parts */
+	for (pa = re->parts.first, index = 0; pa; pa = pa->next, index++) {
 		if (pa->status == PART_STATUS_NONE && pa->nr == 0) {
 			long long int distx = centx - BLI_rcti_cent_x(&pa->disprect);
 			long long int disty = centy - BLI_rcti_cent_y(&pa->disprect);
 			distx = (long long int)sqrt(distx * distx + disty * disty);
-			if (distx < mindist) {
-				if (re->r.mode & R_PANORAMA) {
-					if (pa->disprect.xmin == minx) {
-						best = pa;
-						mindist = distx;
-					}
-				}
-				else {
-					best = pa;
-					mindist = distx;
-				}
+			if (distx < maxdist) {
+				if ((re->r.mode & R_PANORAMA) && pa->disprect.xmin != minx)
+					continue;
+
+				order[tot_order].dist = distx;
+				order[tot_order].index = index;
+				order[tot_order].pa = pa;
+				tot_order++;
 			}
 		}
 	}
-	return best;
+
+	qsort(order, tot_order, sizeof(PartOrder), part_order_cmp);
+
+	for (a = 0; a < tot_order; a++)
+		parts[a] = order[a].pa;
+
+	MEM_freeN(order);
+
+	return tot_order;
+}
+
+/* Parts of a slice are known before the threads start, so instead of a
+ * locked queue the threads take the next part with an atomic increment */
+typedef struct RenderPartQueue {
+	RenderPart **parts;
+	uint32_t totpart;
+	uint32_t next;
+} RenderPartQueue;
+
+static RenderPart *part_queue_pop(RenderPartQueue *queue)
+{
+	uint32_t index = atomic_add_uint32(&queue->next, 1) - 1;
+
+	return (index < queue->totpart) ? queue->parts[index] : NULL;
 }
 
 static void print_part_stats(Render *re, RenderPart *pa)
@@ -1083,7 +1128,7 @@ static void print_part_stats(Render *re, RenderPart *pa)
 }
 
 typedef struct RenderThread {
-	ThreadQueue *workqueue;
+	RenderPartQueue *workqueue;
 	ThreadQueue *donequeue;
 	
 	int number;
@@ -1097,7 +1142,7 @@ static void *do_render_thread(void *thread_v)
 	RenderThread *thread = thread_v;
 	RenderPart *pa;
 	
-	while ((pa = BLI_thread_queue_pop(thread->workqueue))) {
+	while ((pa = part_queue_pop(thread->workqueue))) {
 		pa->thread = thread->number;
 		do_part_thread(pa);
 
@@ -1116,8 +1161,9 @@ static void *do_render_thread(void *thread_v)
 
 static void threaded_tile_processor(Render *re)
 {
-	RenderThread thread[BLENDER_MAX_THREADS];
-	ThreadQueue *workqueue, *donequeue;
+	RenderThread *thread;
+	RenderPartQueue workqueue;
+	ThreadQueue *donequeue;
 	ListBase threads;
 	RenderPart *pa;
 	rctf viewplane = re->viewplane;
@@ -1157,26 +1203,31 @@ static void threaded_tile_processor(Render *re)
 	/* set threadsafe break */
 	R.test_break = thread_break;
 	
-	/* create and fill work queue */
-	workqueue = BLI_thread_queue_init();
+	/* create work queue, filled per slice */
+	workqueue.parts = MEM_mallocN(sizeof(RenderPart *) * BLI_listbase_count(&re->parts), "render part queue");
 	donequeue = BLI_thread_queue_init();
+
+	thread = MEM_mallocN(sizeof(RenderThread) * re->r.threads, "render threads");
 	
 	/* for panorama we loop over slices */
 	while (find_next_pano_slice(re, &slice, &minx, &viewplane)) {
 		/* gather parts into queue */
-		while ((pa = find_next_part(re, minx))) {
+		int slicepart = find_next_parts(re, minx, workqueue.parts);
+
+		for (a = 0; a < slicepart; a++) {
+			pa = workqueue.parts[a];
 			pa->nr = totpart + 1; /* for nicest part, and for stats */
 			totpart++;
-			BLI_thread_queue_push(workqueue, pa);
 		}
-		
-		BLI_thread_queue_nowait(workqueue);
+
+		workqueue.totpart = slicepart;
+		workqueue.next = 0;
 		
 		/* start all threads */
 		BLI_init_threads(&threads, do_render_thread, re->r.threads);
 		
 		for (a = 0; a < re->r.threads; a++) {
-			thread[a].workqueue = workqueue;
+			thread[a].workqueue = &workqueue;
 			thread[a].donequeue = donequeue;
 			thread[a].number = a;
 
@@ -1253,7 +1304,8 @@ static void threaded_tile_processor(Render *re)
 	}
 
 	BLI_thread_queue_free(donequeue);
-	BLI_thread_queue_free(workqueue);
+	MEM_freeN(workqueue.parts);
+	MEM_freeN(thread);
 	
 	if (re->result->do_exr_tile) {
 		BLI_rw_mutex_lock(&re->resultmutex, THREAD_LOCK_WRITE);
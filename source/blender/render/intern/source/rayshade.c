@@ -44,6 +44,8 @@
 #include "BLI_system.h"
 #include "BLI_math.h"
 #include "BLI_rand.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BLF_translation.h"
@@ -220,6 +222,72 @@ static int is_raytraceable(Render *re, ObjectInstanceRen *obi)
 }
 
 
+static int raytree_object_faces(Render *re, ObjectRen *obr)
+{
+	int v, faces = 0;
+
+	for (v=0;v<obr->totvlak;v++) {
+		VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
+		if (is_raytraceable_vlr(re, vlr))
+			faces++;
+	}
+
+	return faces;
+}
+
+/* creates the acceleration structure of the object, and allocates its primitives */
+static RayObject *raytree_object_create(Render *re, ObjectInstanceRen *obi, int faces)
+{
+	ObjectRen *obr = obi->obr;
+	RayObject *raytree;
+
+	//Create Ray cast accelaration structure
+	raytree = rayobject_create( re,  re->r.raytrace_structure, faces );
+	if (  (re->r.raytrace_options & R_RAYTRACE_USE_LOCAL_COORDS) )
+		obr->rayprimitives = (VlakPrimitive *)MEM_callocN(faces * sizeof(VlakPrimitive), "ObjectRen primitives");
+	else
+		obr->rayfaces = (RayFace *)MEM_callocN(faces * sizeof(RayFace), "ObjectRen faces");
+
+	obr->rayobi = obi;
+
+	return raytree;
+}
+
+/* adds the faces and builds the tree, only touches data of the object so
+ * it can run for several objects at once */
+static void raytree_object_build(Render *re, ObjectRen *obr, RayObject *raytree)
+{
+	ObjectInstanceRen *obi = obr->rayobi;
+	RayFace *face = obr->rayfaces;
+	VlakPrimitive *vlakprimitive = obr->rayprimitives;
+	int v;
+
+	for (v=0;v<obr->totvlak;v++) {
+		VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
+		if (is_raytraceable_vlr(re, vlr)) {
+			if ((re->r.raytrace_options & R_RAYTRACE_USE_LOCAL_COORDS)) {
+				RE_rayobject_add(raytree, RE_vlakprimitive_from_vlak(vlakprimitive, obi, vlr));
+				vlakprimitive++;
+			}
+			else {
+				RE_rayface_from_vlak(face, obi, vlr);
+				RE_rayobject_add(raytree, RE_rayobject_unalignRayFace(face));
+				face++;
+			}
+		}
+	}
+	RE_rayobject_done(raytree);
+}
+
+static void raytree_object_finish(Render *re, ObjectRen *obr, RayObject *raytree)
+{
+	/* in case of cancel during build, raytree is not usable */
+	if (test_break(re))
+		RE_rayobject_free(raytree);
+	else
+		obr->raytree= raytree;
+}
+
 RayObject* makeraytree_object(Render *re, ObjectInstanceRen *obi)
 {
 	/*TODO
@@ -230,51 +298,16 @@ RayObject* makeraytree_object(Render *re, ObjectInstanceRen *obi)
 
 	if (obr->raytree == NULL) {
 		RayObject *raytree;
-		RayFace *face = NULL;
-		VlakPrimitive *vlakprimitive = NULL;
-		int v;
 		
 		//Count faces
-		int faces = 0;
-		for (v=0;v<obr->totvlak;v++) {
-			VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
-			if (is_raytraceable_vlr(re, vlr))
-				faces++;
-		}
+		int faces = raytree_object_faces(re, obr);
 		
 		if (faces == 0)
 			return NULL;
 
-		//Create Ray cast accelaration structure
-		raytree = rayobject_create( re,  re->r.raytrace_structure, faces );
-		if (  (re->r.raytrace_options & R_RAYTRACE_USE_LOCAL_COORDS) )
-			vlakprimitive = obr->rayprimitives = (VlakPrimitive *)MEM_callocN(faces * sizeof(VlakPrimitive), "ObjectRen primitives");
-		else
-			face = obr->rayfaces = (RayFace *)MEM_callocN(faces * sizeof(RayFace), "ObjectRen faces");
-
-		obr->rayobi = obi;
-		
-		for (v=0;v<obr->totvlak;v++) {
-			VlakRen *vlr = obr->vlaknodes[v>>8].vlak + (v&255);
-			if (is_raytraceable_vlr(re, vlr)) {
-				if ((re->r.raytrace_options & R_RAYTRACE_USE_LOCAL_COORDS)) {
-					RE_rayobject_add(raytree, RE_vlakprimitive_from_vlak(vlakprimitive, obi, vlr));
-					vlakprimitive++;
-				}
-				else {
-					RE_rayface_from_vlak(face, obi, vlr);
-					RE_rayobject_add(raytree, RE_rayobject_unalignRayFace(face));
-					face++;
-				}
-			}
-		}
-		RE_rayobject_done(raytree);
-
-		/* in case of cancel during build, raytree is not usable */
-		if (test_break(re))
-			RE_rayobject_free(raytree);
-		else
-			obr->raytree= raytree;
+		raytree = raytree_object_create(re, obi, faces);
+		raytree_object_build(re, obr, raytree);
+		raytree_object_finish(re, obr, raytree);
 	}
 
 	if (obr->raytree) {
@@ -305,6 +338,76 @@ static bool has_special_rayobject(Render *re, ObjectInstanceRen *obi)
 	}
 	return 0;
 }
+typedef struct RayTreeObjectTask {
+	Render *re;
+	ObjectRen *obr;
+	RayObject *raytree;
+} RayTreeObjectTask;
+
+static void raytree_object_task(TaskPool *UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	RayTreeObjectTask *task = taskdata;
+
+	if (!test_break(task->re))
+		raytree_object_build(task->re, task->obr, task->raytree);
+}
+
+/*
+ * build the trees of the objects that get their own instanced tree, since
+ * each only uses data of its own object they're built in parallel
+ */
+static void makeraytree_instanced_objects(Render *re)
+{
+	ObjectInstanceRen *obi;
+	RayTreeObjectTask *tasks;
+	TaskPool *pool;
+	int a, tottask = 0, maxtask = 0;
+
+	for (obi=re->instancetable.first; obi; obi=obi->next)
+		maxtask++;
+
+	if (maxtask < 2)
+		return;
+
+	tasks = MEM_mallocN(sizeof(RayTreeObjectTask) * maxtask, "RayTreeObjectTask");
+
+	/* creating the trees isn't thread safe, adding faces and building is */
+	for (obi=re->instancetable.first; obi; obi=obi->next) {
+		ObjectRen *obr = obi->obr;
+		int faces;
+
+		if (obr->raytree || obr->rayobi || !is_raytraceable(re, obi) || !has_special_rayobject(re, obi))
+			continue;
+
+		faces = raytree_object_faces(re, obr);
+		if (faces == 0)
+			continue;
+
+		tasks[tottask].re = re;
+		tasks[tottask].obr = obr;
+		tasks[tottask].raytree = raytree_object_create(re, obi, faces);
+		tottask++;
+	}
+
+	if (tottask > 1) {
+		pool = BLI_task_pool_create(BLI_task_scheduler_get(), NULL);
+
+		for (a = 0; a < tottask; a++)
+			BLI_task_pool_push(pool, raytree_object_task, &tasks[a], false, TASK_PRIORITY_LOW);
+
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+	}
+	else if (tottask == 1) {
+		raytree_object_task(NULL, &tasks[0], 0);
+	}
+
+	for (a = 0; a < tottask; a++)
+		raytree_object_finish(re, tasks[a].obr, tasks[a].raytree);
+
+	MEM_freeN(tasks);
+}
+
 /*
  * create a single raytrace structure with all faces
  */
@@ -339,6 +442,9 @@ static void makeraytree_single(Render *re)
 		return;
 	}
 	
+	if (special)
+		makeraytree_instanced_objects(re);
+
 	//Create raytree
 	raytree = re->raytree = rayobject_create( re, re->r.raytrace_structure, faces+special );
 
@@ -931,7 +1037,7 @@ static void jitter_plane_offset(float *jitter1, float *jitter2, int tot, float s
 
 /* called from convertBlenderScene.c */
 /* we do this in advance to get consistent random, not alter the render seed, and be threadsafe */
-void init_jitter_plane(LampRen *lar)
+void init_jitter_plane(Render *re, LampRen *lar)
 {
 	float *fp;
 	int x, tot= lar->ray_totsamp;
@@ -939,9 +1045,9 @@ void init_jitter_plane(LampRen *lar)
 	/* test if already initialized */
 	if (lar->jitter) return;
 	
-	/* at least 4, or max threads+1 tables */
-	if (BLENDER_MAX_THREADS < 4) x= 4;
-	else x= BLENDER_MAX_THREADS+1;
+	/* at least 4, or threads+1 tables */
+	if (re->r.threads < 4) x= 4;
+	else x= re->r.threads+1;
 	fp= lar->jitter= MEM_callocN(x*tot*2*sizeof(float), "lamp jitter tab");
 	
 	/* if 1 sample, we leave table to be zero's */
@@ -1063,9 +1169,10 @@ static void QMC_initPixel(QMCSampler *qsa, int thread)
 {
 	if (qsa->type==SAMP_TYPE_HAMMERSLEY) {
 		/* hammersley sequence is fixed, already created in QMCSampler init.
-		 * per pixel, gets a random offset. We create separate offsets per thread, for write-safety */
-		qsa->offs[thread][0] = 0.5f * BLI_thread_frand(thread);
-		qsa->offs[thread][1] = 0.5f * BLI_thread_frand(thread);
+		 * per pixel, gets a random offset. Samplers are only used by the thread
+		 * that owns them, so one offset is write-safe */
+		qsa->offs[0] = 0.5f * BLI_thread_frand(thread);
+		qsa->offs[1] = 0.5f * BLI_thread_frand(thread);
 	}
 	else { 	/* SAMP_TYPE_HALTON */
 		
@@ -1095,11 +1202,11 @@ static void QMC_freeSampler(QMCSampler *qsa)
 	MEM_freeN(qsa);
 }
 
-static void QMC_getSample(double *s, QMCSampler *qsa, int thread, int num)
+static void QMC_getSample(double *s, QMCSampler *qsa, int num)
 {
 	if (qsa->type == SAMP_TYPE_HAMMERSLEY) {
-		s[0] = fmod(qsa->samp2d[2*num+0] + qsa->offs[thread][0], 1.0f);
-		s[1] = fmod(qsa->samp2d[2*num+1] + qsa->offs[thread][1], 1.0f);
+		s[0] = fmod(qsa->samp2d[2*num+0] + qsa->offs[0], 1.0f);
+		s[1] = fmod(qsa->samp2d[2*num+1] + qsa->offs[1], 1.0f);
 	}
 	else { /* SAMP_TYPE_HALTON */
 		s[0] = qsa->samp2d[2*num+0];
@@ -1108,12 +1215,12 @@ static void QMC_getSample(double *s, QMCSampler *qsa, int thread, int num)
 }
 
 /* phong weighted disc using 'blur' for exponent, centred on 0,0 */
-static void QMC_samplePhong(float vec[3], QMCSampler *qsa, int thread, int num, float blur)
+static void QMC_samplePhong(float vec[3], QMCSampler *qsa, int num, float blur)
 {
 	double s[2];
 	float phi, pz, sqr;
 	
-	QMC_getSample(s, qsa, thread, num);
+	QMC_getSample(s, qsa, num);
 
 	phi = s[0]*2*M_PI;
 	pz = pow(s[1], blur);
@@ -1125,11 +1232,11 @@ static void QMC_samplePhong(float vec[3], QMCSampler *qsa, int thread, int num,
 }
 
 /* rect of edge lengths sizex, sizey, centred on 0.0,0.0 i.e. ranging from -sizex/2 to +sizey/2 */
-static void QMC_sampleRect(float vec[3], QMCSampler *qsa, int thread, int num, float sizex, float sizey)
+static void QMC_sampleRect(float vec[3], QMCSampler *qsa, int num, float sizex, float sizey)
 {
 	double s[2];
 
-	QMC_getSample(s, qsa, thread, num);
+	QMC_getSample(s, qsa, num);
 		
 	vec[0] = (float)(s[0] - 0.5) * sizex;
 	vec[1] = (float)(s[1] - 0.5) * sizey;
@@ -1137,12 +1244,12 @@ static void QMC_sampleRect(float vec[3], QMCSampler *qsa, int thread, int num, f
 }
 
 /* disc of radius 'radius', centred on 0,0 */
-static void QMC_sampleDisc(float vec[3], QMCSampler *qsa, int thread, int num, float radius)
+static void QMC_sampleDisc(float vec[3], QMCSampler *qsa, int num, float radius)
 {
 	double s[2];
 	float phi, sqr;
 	
-	QMC_getSample(s, qsa, thread, num);
+	QMC_getSample(s, qsa, num);
 	
 	phi = s[0]*2*M_PI;
 	sqr = sqrt(s[1]);
@@ -1153,12 +1260,12 @@ static void QMC_sampleDisc(float vec[3], QMCSampler *qsa, int thread, int num, f
 }
 
 /* uniform hemisphere sampling */
-static void QMC_sampleHemi(float vec[3], QMCSampler *qsa, int thread, int num)
+static void QMC_sampleHemi(float vec[3], QMCSampler *qsa, int num)
 {
 	double s[2];
 	float phi, sqr;
 	
-	QMC_getSample(s, qsa, thread, num);
+	QMC_getSample(s, qsa, num);
 	
 	phi = s[0]*2.0*M_PI;
 	sqr = sqrt(s[1]);
@@ -1170,12 +1277,12 @@ static void QMC_sampleHemi(float vec[3], QMCSampler *qsa, int thread, int num)
 
 #if 0 /* currently not used */
 /* cosine weighted hemisphere sampling */
-static void QMC_sampleHemiCosine(float vec[3], QMCSampler *qsa, int thread, int num)
+static void QMC_sampleHemiCosine(float vec[3], QMCSampler *qsa, int num)
 {
 	double s[2];
 	float phi, sqr;
 	
-	QMC_getSample(s, qsa, thread, num);
+	QMC_getSample(s, qsa, num);
 	
 	phi = s[0]*2.f*M_PI;
 	sqr = s[1]*sqrt(2-s[1]*s[1]);
@@ -1190,7 +1297,7 @@ static void QMC_sampleHemiCosine(float vec[3], QMCSampler *qsa, int thread, int
 /* called from convertBlenderScene.c */
 void init_render_qmcsampler(Render *re)
 {
-	re->qmcsamplers= MEM_callocN(sizeof(ListBase)*BLENDER_MAX_THREADS, "QMCListBase");
+	re->qmcsamplers= MEM_callocN(sizeof(ListBase)*re->r.threads, "QMCListBase");
 }
 
 static QMCSampler *get_thread_qmcsampler(Render *re, int thread, int type, int tot)
@@ -1223,8 +1330,9 @@ void free_render_qmcsampler(Render *re)
 {
 	if (re->qmcsamplers) {
 		QMCSampler *qsa, *next;
-		int a;
-		for (a=0; a<BLENDER_MAX_THREADS; a++) {
+		/* thread count the lists were made for */
+		int a, tot= MEM_allocN_len(re->qmcsamplers)/sizeof(ListBase);
+		for (a=0; a<tot; a++) {
 			for (qsa=re->qmcsamplers[a].first; qsa; qsa=next) {
 				next= qsa->next;
 				QMC_freeSampler(qsa);
@@ -1338,7 +1446,7 @@ static void trace_refract(float col[4], ShadeInput *shi, ShadeResult *shr)
 		
 		if (max_samples > 1) {
 			/* get a quasi-random vector from a phong-weighted disc */
-			QMC_samplePhong(samp3d, qsa, shi->thread, samples, blur);
+			QMC_samplePhong(samp3d, qsa, samples, blur);
 						
 			ortho_basis_v3v3_v3(orthx, orthy, v_refract);
 			mul_v3_fl(orthx, samp3d[0]);
@@ -1425,7 +1533,7 @@ static void trace_reflect(float col[3], ShadeInput *shi, ShadeResult *shr, float
 				
 		if (max_samples > 1) {
 			/* get a quasi-random vector from a phong-weighted disc */
-			QMC_samplePhong(samp3d, qsa, shi->thread, samples, blur);
+			QMC_samplePhong(samp3d, qsa, samples, blur);
 
 			/* find the normal's perpendicular plane, blurring along tangents
 			 * if tangent shading enabled */
@@ -1698,7 +1806,7 @@ static void DS_energy(float *sphere, int tot, float vec[3])
 /* called from convertBlenderScene.c */
 /* creates an equally distributed spherical sample pattern */
 /* and allocates threadsafe memory */
-void init_ao_sphere(World *wrld)
+void init_ao_sphere(Render *re, World *wrld)
 {
 	/* fixed random */
 	RNG *rng;
@@ -1724,7 +1832,10 @@ void init_ao_sphere(World *wrld)
 	}
 	
 	/* tables */
-	wrld->aotables= MEM_mallocN(BLENDER_MAX_THREADS*3*tot*sizeof(float), "AO tables");
+	wrld->aotables= MEM_mallocN(re->r.threads*3*tot*sizeof(float), "AO tables");
+	/* no pixel yet, see threadsafe_table_sphere() */
+	re->aotable_xy= MEM_mallocN(re->r.threads*sizeof(*re->aotable_xy), "AO table pixels");
+	memset(re->aotable_xy, 255, re->r.threads*sizeof(*re->aotable_xy));
 
 	BLI_rng_free(rng);
 }
@@ -1732,18 +1843,11 @@ void init_ao_sphere(World *wrld)
 /* give per thread a table, we have to compare xs ys because of way OSA works... */
 static float *threadsafe_table_sphere(int test, int thread, int xs, int ys, int tot)
 {
-	static int xso[BLENDER_MAX_THREADS], yso[BLENDER_MAX_THREADS];
-	static int firsttime= 1;
-	
-	if (firsttime) {
-		memset(xso, 255, sizeof(xso));
-		memset(yso, 255, sizeof(yso));
-		firsttime= 0;
-	}
+	int *xyo= R.aotable_xy[thread];
 	
-	if (xs==xso[thread] && ys==yso[thread]) return R.wrld.aotables+ thread*tot*3;
+	if (xs==xyo[0] && ys==xyo[1]) return R.wrld.aotables+ thread*tot*3;
 	if (test) return NULL;
-	xso[thread]= xs; yso[thread]= ys;
+	xyo[0]= xs; xyo[1]= ys;
 	return R.wrld.aotables+ thread*tot*3;
 }
 
@@ -1886,7 +1990,7 @@ static void ray_ao_qmc(ShadeInput *shi, float ao[3], float env[3])
 	while (samples < max_samples) {
 
 		/* sampling, returns quasi-random vector in unit hemisphere */
-		QMC_sampleHemi(samp3d, qsa, shi->thread, samples);
+		QMC_sampleHemi(samp3d, qsa, samples);
 
 		dir[0] = (samp3d[0]*up[0] + samp3d[1]*side[0] + samp3d[2]*nrm[0]);
 		dir[1] = (samp3d[0]*up[1] + samp3d[1]*side[1] + samp3d[2]*nrm[1]);
@@ -2228,7 +2332,7 @@ static void ray_shadow_qmc(ShadeInput *shi, LampRen *lar, const float lampco[3],
 				ortho_basis_v3v3_v3(ru, rv, v);
 				
 				/* sampling, returns quasi-random vector in area_size disc */
-				QMC_sampleDisc(samp3d, qsa, shi->thread, samples, lar->area_size);
+				QMC_sampleDisc(samp3d, qsa, samples, lar->area_size);
 
 				/* distribute disc samples across the tangent plane */
 				s[0] = samp3d[0]*ru[0] + samp3d[1]*rv[0];
@@ -2239,7 +2343,7 @@ static void ray_shadow_qmc(ShadeInput *shi, LampRen *lar, const float lampco[3],
 			}
 			else {
 				/* sampling, returns quasi-random vector in [sizex,sizey]^2 plane */
-				QMC_sampleRect(samp3d, qsa, shi->thread, samples, lar->area_size, lar->area_sizey);
+				QMC_sampleRect(samp3d, qsa, samples, lar->area_size, lar->area_sizey);
 								
 				/* align samples to lamp vector */
 				mul_m3_v3(lar->mat, samp3d);
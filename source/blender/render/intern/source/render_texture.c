@@ -134,12 +134,20 @@ static void init_render_texture(Render *re, Tex *tex)
 void init_render_textures(Render *re)
 {
 	Tex *tex;
+	int a;
 	
 	tex= re->main->tex.first;
 	while (tex) {
 		if (tex->id.us) init_render_texture(re, tex);
 		tex= tex->id.next;
 	}
+
+	/* one per thread, for write-safety */
+	re->realtime_tex= MEM_callocN(sizeof(Tex)*re->r.threads, "realtime textures");
+	for (a=0; a<re->r.threads; a++) {
+		default_tex(&re->realtime_tex[a]);
+		re->realtime_tex[a].type= TEX_IMAGE;
+	}
 }
 
 static void end_render_texture(Tex *tex)
@@ -154,6 +162,11 @@ void end_render_textures(Render *re)
 	for (tex= re->main->tex.first; tex; tex= tex->id.next)
 		if (tex->id.us)
 			end_render_texture(tex);
+
+	if (re->realtime_tex) {
+		MEM_freeN(re->realtime_tex);
+		re->realtime_tex= NULL;
+	}
 }
 
 /* ------------------------------------------------------------------------- */
@@ -3474,30 +3487,13 @@ int externtex(MTex *mtex, const float vec[3], float *tin, float *tr, float *tg,
 void render_realtime_texture(ShadeInput *shi, Image *ima)
 {
 	TexResult texr;
-	static Tex imatex[BLENDER_MAX_THREADS];	/* threadsafe */
-	static int firsttime= 1;
 	Tex *tex;
 	float texvec[3], dx[2], dy[2];
 	ShadeInputUV *suv= &shi->uv[shi->actuv];
-	int a;
 
 	if (R.r.scemode & R_NO_TEX) return;
 
-	if (firsttime) {
-		BLI_lock_thread(LOCK_IMAGE);
-		if (firsttime) {
-			for (a=0; a<BLENDER_MAX_THREADS; a++) {
-				memset(&imatex[a], 0, sizeof(Tex));
-				default_tex(&imatex[a]);
-				imatex[a].type= TEX_IMAGE;
-			}
-
-			firsttime= 0;
-		}
-		BLI_unlock_thread(LOCK_IMAGE);
-	}
-	
-	tex= &imatex[shi->thread];
+	tex= &R.realtime_tex[shi->thread];	/* threadsafe */
 	tex->iuser.ok= ima->ok;
 	tex->ima = ima;
 	
@@ -938,6 +938,7 @@ void freeshadowbuf(LampRen *lar)
 		BLI_freelistN(&shb->buffers);
 		
 		if (shb->weight) MEM_freeN(shb->weight);
+		MEM_freeN(shb->isb_result);
 		MEM_freeN(lar->shb);
 		
 		lar->shb= NULL;
@@ -101,6 +101,7 @@ static void game_copy_pose(bPose **dst, bPose *src, int copy_constraint)
 	out->chanhash = NULL;
 	out->agroups.first= out->agroups.last= NULL;
 	out->ikdata = NULL;
+	out->eval_graph = NULL;
 	out->ikparam = MEM_dupallocN(src->ikparam);
 	out->flag |= POSE_GAME_ENGINE;
 	BLI_duplicatelist(&out->chanbase, &src->chanbase);
@@ -42,6 +42,8 @@
 #include "STR_HashedString.h"
 #include "RAS_IPolygonMaterial.h"
 #include "RAS_MeshObject.h"
+#include "KX_KetsjiEngine.h"
+#include "KX_PythonInit.h"
 
 //#include "BL_ArmatureController.h"
 #include "DNA_armature_types.h"
@@ -62,6 +64,13 @@ extern "C"{
 
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
+
+#include "MEM_guardedalloc.h"
+
+#ifdef __SSE__
+#  include <xmmintrin.h>
+#endif
 
 #define __NLA_DEFNORMALS
 //#undef __NLA_DEFNORMALS
@@ -96,7 +105,10 @@ BL_SkinDeformer::BL_SkinDeformer(BL_DeformableGameObject *gameobj,
 							m_poseApplied(false),
 							m_recalcNormal(true),
 							m_copyNormals(false),
-							m_dfnrToPC(NULL)
+							m_dfnrToPC(NULL),
+							m_dfnrTot(0),
+							m_skinInfluences(NULL),
+							m_skinMats(NULL)
 {
 	copy_m4_m4(m_obmat, bmeshobj->obmat);
 	m_deformflags = get_deformflags(bmeshobj);
@@ -117,7 +129,10 @@ BL_SkinDeformer::BL_SkinDeformer(
 		m_releaseobject(release_object),
 		m_recalcNormal(recalc_normal),
 		m_copyNormals(false),
-		m_dfnrToPC(NULL)
+		m_dfnrToPC(NULL),
+		m_dfnrTot(0),
+		m_skinInfluences(NULL),
+		m_skinMats(NULL)
 	{
 		// this is needed to ensure correct deformation of mesh:
 		// the deformation is done with Blender's armature_deform_verts() function
@@ -134,6 +149,10 @@ BL_SkinDeformer::~BL_SkinDeformer()
 		m_armobj->Release();
 	if (m_dfnrToPC)
 		delete [] m_dfnrToPC;
+	if (m_skinInfluences)
+		MEM_freeN(m_skinInfluences);
+	if (m_skinMats)
+		MEM_freeN(m_skinMats);
 }
 
 void BL_SkinDeformer::Relink(CTR_Map<class CTR_HashedPtr, void*>*map)
@@ -172,6 +191,9 @@ void BL_SkinDeformer::ProcessReplica()
 	m_lastArmaUpdate = -1;
 	m_releaseobject = false;
 	m_dfnrToPC = NULL;
+	m_dfnrTot = 0;
+	m_skinInfluences = NULL;
+	m_skinMats = NULL;
 }
 
 void BL_SkinDeformer::BlenderDeformVerts()
@@ -195,97 +217,197 @@ void BL_SkinDeformer::BlenderDeformVerts()
 #endif
 }
 
-void BL_SkinDeformer::BGEDeformVerts()
+/* Builds the packed weights once the armature is known: the strongest deforming
+ * bones of each vertex, normalized, so skinning doesn't look up MDeformVerts every frame. */
+bool BL_SkinDeformer::VerifySkinInfluences()
 {
 	Object *par_arma = m_armobj->GetArmatureObject();
-	MDeformVert *dverts = m_bmesh->dvert;
+	MDeformVert *dv = m_bmesh->dvert;
 	bDeformGroup *dg;
-	int defbase_tot;
-	Eigen::Matrix4f pre_mat, post_mat, chan_mat, norm_chan_mat;
+	int i;
 
-	if (!dverts)
-		return;
-
-	defbase_tot = BLI_listbase_count(&m_objMesh->defbase);
+	if (m_dfnrToPC)
+		return (m_skinInfluences != NULL);
 
-	if (m_dfnrToPC == NULL)
+	m_dfnrTot = BLI_listbase_count(&m_objMesh->defbase);
+	m_dfnrToPC = new bPoseChannel*[m_dfnrTot];
+	for (i=0, dg=(bDeformGroup*)m_objMesh->defbase.first;
+		dg;
+		++i, dg = dg->next)
 	{
-		m_dfnrToPC = new bPoseChannel*[defbase_tot];
-		int i;
-		for (i=0, dg=(bDeformGroup*)m_objMesh->defbase.first;
-			dg;
-			++i, dg = dg->next)
-		{
-			m_dfnrToPC[i] = BKE_pose_channel_find_name(par_arma->pose, dg->name);
+		m_dfnrToPC[i] = BKE_pose_channel_find_name(par_arma->pose, dg->name);
 
-			if (m_dfnrToPC[i] && m_dfnrToPC[i]->bone->flag & BONE_NO_DEFORM)
-				m_dfnrToPC[i] = NULL;
-		}
+		if (m_dfnrToPC[i] && m_dfnrToPC[i]->bone->flag & BONE_NO_DEFORM)
+			m_dfnrToPC[i] = NULL;
 	}
 
-	post_mat = Eigen::Matrix4f::Map((float*)m_obmat).inverse() * Eigen::Matrix4f::Map((float*)m_armobj->GetArmatureObject()->obmat);
-	pre_mat = post_mat.inverse();
+	if (!dv || m_dfnrTot == 0)
+		return false;
 
-	MDeformVert *dv= dverts;
-	MDeformWeight *dw;
+	m_skinInfluences = (BL_SkinInfluence *)MEM_mallocN(sizeof(*m_skinInfluences) * m_bmesh->totvert, "BL_SkinDeformer influences");
+	m_skinMats = (float (*)[4][4])MEM_mallocN_aligned(sizeof(*m_skinMats) * m_dfnrTot, 16, "BL_SkinDeformer matrices");
 
-	for (int i=0; i<m_bmesh->totvert; ++i, dv++)
-	{
-		float contrib = 0.f, weight, max_weight=-1.f;
-		bPoseChannel *pchan=NULL;
-		Eigen::Map<Eigen::Vector3f> norm = Eigen::Vector3f::Map(m_transnors[i]);
-		Eigen::Vector4f vec(0, 0, 0, 1);
-		Eigen::Vector4f co(m_transverts[i][0],
-							m_transverts[i][1],
-							m_transverts[i][2],
-							1.f);
-
-		if (!dv->totweight)
-			continue;
+	/* groups without a deforming bone only get zero weights, keep their matrix finite */
+	for (i = 0; i < m_dfnrTot; i++)
+		unit_m4(m_skinMats[i]);
 
-		co = pre_mat * co;
+	for (i = 0; i < m_bmesh->totvert; i++, dv++) {
+		BL_SkinInfluence *inf = &m_skinInfluences[i];
+		MDeformWeight *dw = dv->dw;
+		float contrib = 0.0f;
+		int j, k, tot = 0;
 
-		dw= dv->dw;
+		for (k = 0; k < BL_SKIN_MAX_INFLUENCES; k++) {
+			inf->weight[k] = 0.0f;
+			inf->index[k] = 0;
+		}
 
-		for (unsigned int j= dv->totweight; j != 0; j--, dw++)
-		{
+		for (j = dv->totweight; j != 0; j--, dw++) {
 			const int index = dw->def_nr;
+			const float weight = dw->weight;
 
-			if (index < defbase_tot && (pchan=m_dfnrToPC[index]))
-			{
-				weight = dw->weight;
+			if (index >= m_dfnrTot || !m_dfnrToPC[index] || weight == 0.0f)
+				continue;
 
-				if (weight)
-				{
-					chan_mat = Eigen::Matrix4f::Map((float*)pchan->chan_mat);
+			/* insertion sort, the weakest influence is dropped when all slots are used */
+			if (tot == BL_SKIN_MAX_INFLUENCES) {
+				if (weight <= inf->weight[tot - 1])
+					continue;
+				k = tot - 1;
+			}
+			else {
+				k = tot++;
+			}
 
-					// Update Vertex Position
-					vec.noalias() += (chan_mat*co - co)*weight;
+			for (; k > 0 && inf->weight[k - 1] < weight; k--) {
+				inf->weight[k] = inf->weight[k - 1];
+				inf->index[k] = inf->index[k - 1];
+			}
+			inf->weight[k] = weight;
+			inf->index[k] = index;
+		}
 
-					// Save the most influential channel so we can use it to update the vertex normal
-					if (weight > max_weight)
-					{
-						max_weight = weight;
-						norm_chan_mat = chan_mat;
-					}
+		for (k = 0; k < tot; k++)
+			contrib += inf->weight[k];
 
-					contrib += weight;
-				}
-			}
+		if (contrib == 0.0f) {
+			inf->weight[0] = 0.0f;
+			continue;
 		}
-		
-		// Update Vertex Normal
-		norm = norm_chan_mat.topLeftCorner<3, 3>()*norm;
 
-		co.noalias() += vec/contrib;
-		co[3] = 1.f; // Make sure we have a 1 for the w component!
+		for (k = 0; k < BL_SKIN_MAX_INFLUENCES; k++) {
+			inf->weight[k] /= contrib;
+			if (k >= tot)
+				inf->index[k] = inf->index[0];
+		}
+	}
 
-		co = post_mat * co;
+	return true;
+}
 
-		m_transverts[i][0] = co[0];
-		m_transverts[i][1] = co[1];
-		m_transverts[i][2] = co[2];
+typedef struct SkinTaskData {
+	const BL_SkinInfluence *influences;
+	const float (*mats)[4][4];
+	bPoseChannel **dfnrToPC;
+	float (*transverts)[3];
+	float (*transnors)[3];
+	int totvert;
+} SkinTaskData;
+
+/* vertices per task, smaller meshes are skinned in the calling thread */
+#define SKIN_TASK_CHUNK 2048
+
+static void skin_verts(const SkinTaskData *data, int start, int end)
+{
+	for (int i = start; i < end; i++) {
+		const BL_SkinInfluence *inf = &data->influences[i];
+		float *co = data->transverts[i];
+
+		if (inf->weight[0] == 0.0f)
+			continue;
+
+#ifdef __SSE__
+		const __m128 x = _mm_set1_ps(co[0]);
+		const __m128 y = _mm_set1_ps(co[1]);
+		const __m128 z = _mm_set1_ps(co[2]);
+		__m128 acc = _mm_setzero_ps();
+		float r[4];
+
+		for (int k = 0; k < BL_SKIN_MAX_INFLUENCES; k++) {
+			const float (*m)[4] = data->mats[inf->index[k]];
+			const __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(m[0]), x),
+			                                       _mm_mul_ps(_mm_load_ps(m[1]), y)),
+			                            _mm_add_ps(_mm_mul_ps(_mm_load_ps(m[2]), z),
+			                                       _mm_load_ps(m[3])));
+			acc = _mm_add_ps(acc, _mm_mul_ps(t, _mm_set1_ps(inf->weight[k])));
+		}
+		_mm_storeu_ps(r, acc);
+		copy_v3_v3(co, r);
+#else
+		float r[3] = {0.0f, 0.0f, 0.0f}, t[3];
+
+		for (int k = 0; k < BL_SKIN_MAX_INFLUENCES; k++) {
+			mul_v3_m4v3(t, (float (*)[4])data->mats[inf->index[k]], co);
+			madd_v3_v3fl(r, t, inf->weight[k]);
+		}
+		copy_v3_v3(co, r);
+#endif
+
+		// Update Vertex Normal, with the most influential channel
+		mul_mat3_m4_v3(data->dfnrToPC[inf->index[0]]->chan_mat, data->transnors[i]);
+	}
+}
+
+static void skin_task_func(TaskPool *pool, void *taskdata, int UNUSED(threadid))
+{
+	const SkinTaskData *data = (const SkinTaskData *)BLI_task_pool_userdata(pool);
+	const int start = GET_INT_FROM_POINTER(taskdata);
+
+	skin_verts(data, start, min_ii(start + SKIN_TASK_CHUNK, data->totvert));
+}
+
+void BL_SkinDeformer::BGEDeformVerts()
+{
+	KX_KetsjiEngine *engine = KX_GetActiveEngine();
+	Eigen::Matrix4f pre_mat, post_mat;
+	SkinTaskData data;
+
+	if (!VerifySkinInfluences())
+		return;
+
+	post_mat = Eigen::Matrix4f::Map((float*)m_obmat).inverse() * Eigen::Matrix4f::Map((float*)m_armobj->GetArmatureObject()->obmat);
+	pre_mat = post_mat.inverse();
+
+	// One matrix per bone, instead of going in and out of armature space for every weight
+	for (int i = 0; i < m_dfnrTot; i++) {
+		bPoseChannel *pchan = m_dfnrToPC[i];
+
+		if (pchan)
+			Eigen::Matrix4f::Map((float*)m_skinMats[i]) = post_mat * Eigen::Matrix4f::Map((float*)pchan->chan_mat) * pre_mat;
 	}
+
+	data.influences = m_skinInfluences;
+	data.mats = m_skinMats;
+	data.dfnrToPC = m_dfnrToPC;
+	data.transverts = m_transverts;
+	data.transnors = m_transnors;
+	data.totvert = m_bmesh->totvert;
+
+	if (engine && data.totvert > SKIN_TASK_CHUNK) {
+		// The deformers of an armature are already updated in one of the scene animation tasks,
+		// big meshes are split further so that a single character doesn't hold up the frame
+		TaskPool *pool = BLI_task_pool_create(engine->GetTaskScheduler(), &data);
+
+		for (int i = 0; i < data.totvert; i += SKIN_TASK_CHUNK)
+			BLI_task_pool_push(pool, skin_task_func, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH);
+
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+	}
+	else {
+		skin_verts(&data, 0, data.totvert);
+	}
+
 	m_copyNormals = true;
 }
 
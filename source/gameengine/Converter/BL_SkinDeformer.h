@@ -47,6 +47,16 @@
 
 #include "RAS_Deformer.h"
 
+/* Number of bones that can influence a vertex with BGE skinning, the strongest ones are kept */
+#define BL_SKIN_MAX_INFLUENCES 4
+
+/* Packed vertex weights for BGE skinning, sorted by decreasing weight and normalized.
+ * Unused slots have a zero weight and repeat the first index. */
+typedef struct BL_SkinInfluence {
+	float weight[BL_SKIN_MAX_INFLUENCES];
+	int index[BL_SKIN_MAX_INFLUENCES];  /* deform group index, into the skinning matrices */
+} BL_SkinInfluence;
+
 
 class BL_SkinDeformer : public BL_MeshDeformer  
 {
@@ -109,9 +119,13 @@ protected:
 	bool					m_recalcNormal;
 	bool					m_copyNormals; // dirty flag so we know if Apply() needs to copy normal information (used for BGEDeformVerts())
 	struct bPoseChannel**	m_dfnrToPC;
+	int						m_dfnrTot;
+	BL_SkinInfluence*		m_skinInfluences;	// per vertex, NULL when the mesh has no weights
+	float					(*m_skinMats)[4][4];	// per deform group, vertex transform of the current pose
 	short					m_deformflags;
 
 	void BlenderDeformVerts();
+	bool VerifySkinInfluences();
 	void BGEDeformVerts();
 
 	void UpdateTransverts();
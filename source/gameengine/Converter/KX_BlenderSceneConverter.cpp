@@ -104,14 +104,18 @@ extern "C" {
 	#include "DNA_space_types.h"
 	#include "DNA_windowmanager_types.h" /* report api */
 	#include "../../blender/blenlib/BLI_linklist.h"
+	#include "BLI_task.h"
+	#include "BLI_threads.h"
 }
 
-#include <pthread.h>
+/* Objects merged from async loaded scenes each frame, the rest waits
+ * for the next frames so big libraries don't cause a single long frame */
+#define ASYNC_MERGE_MAX_OBJECTS 64
 
-/* This is used to avoid including pthread.h in KX_BlenderSceneConverter.h */
+/* This is used to avoid including BLI_task.h in KX_BlenderSceneConverter.h */
 typedef struct ThreadInfo {
-	vector<pthread_t>	threads;
-	pthread_mutex_t		merge_lock;
+	TaskPool		*pool;
+	ThreadMutex		merge_lock;
 } ThreadInfo;
 
 KX_BlenderSceneConverter::KX_BlenderSceneConverter(
@@ -129,7 +133,8 @@ KX_BlenderSceneConverter::KX_BlenderSceneConverter(
 	BKE_main_id_tag_all(maggie, false);  /* avoid re-tagging later on */
 	m_newfilename = "";
 	m_threadinfo = new ThreadInfo();
-	pthread_mutex_init(&m_threadinfo->merge_lock, NULL);
+	m_threadinfo->pool = BLI_task_pool_create(engine->GetTaskScheduler(), NULL);
+	BLI_mutex_init(&m_threadinfo->merge_lock);
 }
 
 
@@ -140,13 +145,11 @@ KX_BlenderSceneConverter::~KX_BlenderSceneConverter()
 	// delete sumoshapes
 	
 	if (m_threadinfo) {
-		vector<pthread_t>::iterator pit = m_threadinfo->threads.begin();
-		while (pit != m_threadinfo->threads.end()) {
-			pthread_join((*pit), NULL);
-			pit++;
-		}
+		/* wait until all the async conversions are done */
+		BLI_task_pool_work_and_wait(m_threadinfo->pool);
+		BLI_task_pool_free(m_threadinfo->pool);
 
-		pthread_mutex_destroy(&m_threadinfo->merge_lock);
+		BLI_mutex_end(&m_threadinfo->merge_lock);
 		delete m_threadinfo;
 	}
 
@@ -889,40 +892,56 @@ Main* KX_BlenderSceneConverter::GetMainDynamicPath(const char *path)
 void KX_BlenderSceneConverter::MergeAsyncLoads()
 {
 	vector<KX_Scene*> *merge_scenes;
+	KX_LibLoadStatus *status;
+	int maxobjects = ASYNC_MERGE_MAX_OBJECTS;
 
-	vector<KX_LibLoadStatus*>::iterator mit;
-	vector<KX_Scene*>::iterator sit;
+	/* The lock is only held to access the queue, conversions finishing while
+	 * we merge are added behind and picked up in this or the next frame. */
+	while (maxobjects > 0) {
+		BLI_mutex_lock(&m_threadinfo->merge_lock);
+		status = (m_mergequeue.empty()) ? NULL : m_mergequeue.front();
+		BLI_mutex_unlock(&m_threadinfo->merge_lock);
+
+		if (!status)
+			break;
 
-	pthread_mutex_lock(&m_threadinfo->merge_lock);
+		merge_scenes = (vector<KX_Scene*>*)status->GetData();
+
+		while (!merge_scenes->empty()) {
+			KX_Scene *scene = merge_scenes->back();
+
+			if (!status->GetMergeScene()->MergeScenePart(scene, maxobjects))
+				break;
 
-	for (mit=m_mergequeue.begin(); mit!=m_mergequeue.end(); ++mit) {
-		merge_scenes = (vector<KX_Scene*>*)(*mit)->GetData();
+			delete scene;
+			merge_scenes->pop_back();
 
-		for (sit=merge_scenes->begin(); sit!=merge_scenes->end(); ++sit) {
-			(*mit)->GetMergeScene()->MergeScene(*sit);
-			delete (*sit);
+			/* merging takes what's left of the progress after conversion */
+			status->AddProgress((1.0f - status->GetProgress()) / (merge_scenes->size() + 1));
 		}
 
+		if (!merge_scenes->empty())
+			break;
 
 		delete merge_scenes;
-		(*mit)->SetData(NULL);
-
-		(*mit)->Finish();
-	}
+		status->SetData(NULL);
 
-	m_mergequeue.clear();
+		BLI_mutex_lock(&m_threadinfo->merge_lock);
+		m_mergequeue.erase(m_mergequeue.begin());
+		BLI_mutex_unlock(&m_threadinfo->merge_lock);
 
-	pthread_mutex_unlock(&m_threadinfo->merge_lock);
+		status->Finish();
+	}
 }
 
 void KX_BlenderSceneConverter::AddScenesToMergeQueue(KX_LibLoadStatus *status)
 {
-	pthread_mutex_lock(&m_threadinfo->merge_lock);
+	BLI_mutex_lock(&m_threadinfo->merge_lock);
 	m_mergequeue.push_back(status);
-	pthread_mutex_unlock(&m_threadinfo->merge_lock);
+	BLI_mutex_unlock(&m_threadinfo->merge_lock);
 }
 
-static void *async_convert(void *ptr)
+static void async_convert(TaskPool *UNUSED(pool), void *ptr, int UNUSED(threadid))
 {
 	KX_Scene *new_scene = NULL;
 	KX_LibLoadStatus *status = (KX_LibLoadStatus*)ptr;
@@ -942,8 +961,6 @@ static void *async_convert(void *ptr)
 	status->SetData(merge_scenes);
 
 	status->GetConverter()->AddScenesToMergeQueue(status);
-
-	return NULL;
 }
 
 KX_LibLoadStatus *KX_BlenderSceneConverter::LinkBlendFileMemory(void *data, int length, const char *path, char *group, KX_Scene *scene_merge, char **err_str, short options)
@@ -1088,10 +1105,8 @@ KX_LibLoadStatus *KX_BlenderSceneConverter::LinkBlendFile(BlendHandle *bpy_openl
 		}
 
 		if (options & LIB_LOAD_ASYNC) {
-			pthread_t id;
 			status->SetData(scenes);
-			pthread_create(&id, NULL, &async_convert, (void*)status);
-			m_threadinfo->threads.push_back(id);
+			BLI_task_pool_push(m_threadinfo->pool, async_convert, (void*)status, false, TASK_PRIORITY_LOW);
 		}
 
 #ifdef WITH_PYTHON
@@ -514,6 +514,10 @@ void KX_KetsjiEngine::EndFrame()
 		RenderDebugProperties();
 	}
 
+	// Draw statistics are per frame
+	for (KX_SceneList::iterator sceneit = m_scenes.begin(); sceneit != m_scenes.end(); ++sceneit)
+		(*sceneit)->GetBucketManager()->ResetStatistics();
+
 	double tottime = m_logger->GetAverage();
 	if (tottime < 1e-6)
 		tottime = 1e-6;
@@ -1500,6 +1504,29 @@ void KX_KetsjiEngine::RenderDebugProperties()
 			m_rasterizer->RenderBox2D(xcoord + (int)(2.2 * profile_indent), ycoord, m_canvas->GetWidth(), m_canvas->GetHeight(), time/tottime);
 			ycoord += const_ysize;
 		}
+
+		/* Draw statistics of the scenes rendered this frame */
+		unsigned int drawcalls = 0, materialchanges = 0;
+		for (KX_SceneList::iterator sceneit = m_scenes.begin(); sceneit != m_scenes.end(); ++sceneit) {
+			RAS_BucketManager *bucketmgr = (*sceneit)->GetBucketManager();
+			drawcalls += bucketmgr->GetNumDrawCalls();
+			materialchanges += bucketmgr->GetNumMaterialChanges();
+		}
+
+		m_rasterizer->RenderText2D(RAS_IRasterizer::RAS_TEXT_PADDED,
+		                            "Draw calls:",
+		                            xcoord + const_xindent,
+		                            ycoord,
+		                            m_canvas->GetWidth(),
+		                            m_canvas->GetHeight());
+
+		debugtxt.Format("%u | %u materials", drawcalls, materialchanges);
+		m_rasterizer->RenderText2D(RAS_IRasterizer::RAS_TEXT_PADDED,
+		                            debugtxt.ReadPtr(),
+		                            xcoord + const_xindent + profile_indent, ycoord,
+		                            m_canvas->GetWidth(),
+		                            m_canvas->GetHeight());
+		ycoord += const_ysize;
 	}
 	// Add the ymargin for titles below the other section of debug info
 	ycoord += title_y_top_margin;
@@ -100,8 +100,10 @@
 #include "KX_Light.h"
 
 #include <stdio.h>
+#include <algorithm>
 
 #include "BLI_task.h"
+#include "BLI_threads.h"
 
 static void *KX_SceneReplicationFunc(SG_IObject* node,void* gameobj,void* scene)
 {
@@ -120,14 +122,29 @@ static void *KX_SceneDestructionFunc(SG_IObject* node,void* gameobj,void* scene)
 	return NULL;
 };
 
+/* Nodes can be scheduled from several threads during UpdateParents() */
+static ThreadMutex sg_schedule_mutex = BLI_MUTEX_INITIALIZER;
+
 bool KX_Scene::KX_ScenegraphUpdateFunc(SG_IObject* node,void* gameobj,void* scene)
 {
-	return ((SG_Node*)node)->Schedule(((KX_Scene*)scene)->m_sghead);
+	bool result;
+
+	BLI_mutex_lock(&sg_schedule_mutex);
+	result = ((SG_Node*)node)->Schedule(((KX_Scene*)scene)->m_sghead);
+	BLI_mutex_unlock(&sg_schedule_mutex);
+
+	return result;
 }
 
 bool KX_Scene::KX_ScenegraphRescheduleFunc(SG_IObject* node,void* gameobj,void* scene)
 {
-	return ((SG_Node*)node)->Reschedule(((KX_Scene*)scene)->m_sghead);
+	bool result;
+
+	BLI_mutex_lock(&sg_schedule_mutex);
+	result = ((SG_Node*)node)->Reschedule(((KX_Scene*)scene)->m_sghead);
+	BLI_mutex_unlock(&sg_schedule_mutex);
+
+	return result;
 }
 
 SG_Callbacks KX_Scene::m_callbacks = SG_Callbacks(
@@ -1419,18 +1436,15 @@ void KX_Scene::MarkSubTreeVisible(SG_Tree *node, RAS_IRasterizer* rasty, bool vi
 		MarkSubTreeVisible(node->Right(), rasty, visible, cam, layer);
 }
 
-void KX_Scene::MarkVisible(RAS_IRasterizer* rasty, KX_GameObject* gameobj,KX_Camera*  cam,int layer)
+KX_Scene::CullResult KX_Scene::CullTest(KX_GameObject* gameobj, KX_Camera* cam, int layer)
 {
 	// User (Python/Actuator) has forced object invisible...
 	if (!gameobj->GetSGNode() || !gameobj->GetVisible())
-		return;
+		return CULL_IGNORE;
 	
 	// Shadow lamp layers
-	if (layer && !(gameobj->GetLayer() & layer)) {
-		gameobj->SetCulled(true);
-		gameobj->UpdateBuckets(false);
-		return;
-	}
+	if (layer && !(gameobj->GetLayer() & layer))
+		return CULL_CULLED;
 
 	// If Frustum culling is off, the object is always visible.
 	bool vis = !cam->GetFrustumCulling();
@@ -1462,8 +1476,13 @@ void KX_Scene::MarkVisible(RAS_IRasterizer* rasty, KX_GameObject* gameobj,KX_Cam
 				break;
 		}
 	}
-	
-	if (vis)
+
+	return (vis) ? CULL_VISIBLE : CULL_CULLED;
+}
+
+void KX_Scene::ApplyCulling(RAS_IRasterizer* rasty, KX_GameObject* gameobj, CullResult result)
+{
+	if (result == CULL_VISIBLE)
 	{
 		int nummeshes = gameobj->GetMeshCount();
 		
@@ -1476,12 +1495,36 @@ void KX_Scene::MarkVisible(RAS_IRasterizer* rasty, KX_GameObject* gameobj,KX_Cam
 		// elsewhere now.
 		gameobj->SetCulled(false);
 		gameobj->UpdateBuckets(false);
-	} else {
+	}
+	else if (result == CULL_CULLED)
+	{
 		gameobj->SetCulled(true);
 		gameobj->UpdateBuckets(false);
 	}
 }
 
+void KX_Scene::MarkVisible(RAS_IRasterizer* rasty, KX_GameObject* gameobj,KX_Camera*  cam,int layer)
+{
+	ApplyCulling(rasty, gameobj, CullTest(gameobj, cam, layer));
+}
+
+/* Minimum number of objects to test them in parallel when the physics can't cull */
+#define CULLING_THREAD_THRESHOLD 1024
+
+struct CullingTaskData {
+	CListValue *objects;
+	KX_Camera *cam;
+	int layer;
+	std::vector<KX_Scene::CullResult> results;
+};
+
+void KX_Scene::CullTestFunc(void *userdata, int index)
+{
+	CullingTaskData *data = (CullingTaskData*)userdata;
+
+	data->results[index] = CullTest(static_cast<KX_GameObject*>(data->objects->GetValue(index)), data->cam, data->layer);
+}
+
 void KX_Scene::PhysicsCullingCallback(KX_ClientObjectInfo *objectInfo, void* cullingInfo)
 {
 	KX_GameObject* gameobj = objectInfo->m_gameobject;
@@ -1524,7 +1567,28 @@ void KX_Scene::CalculateVisibleMeshes(RAS_IRasterizer* rasty,KX_Camera* cam, int
 		                                                 KX_GetActiveEngine()->GetCanvas()->GetViewPort(),
 		                                                 mvmat, pmat);
 	}
-	if (!dbvt_culling) {
+	if (!dbvt_culling && m_objectlist->GetCount() >= CULLING_THREAD_THRESHOLD) {
+		// the physics engine couldn't help us, do it the hard way,
+		// the tests run in parallel and the results are applied here
+		CullingTaskData data;
+
+		data.objects = m_objectlist;
+		data.cam = cam;
+		data.layer = layer;
+		data.results.resize(m_objectlist->GetCount());
+
+		// the camera computes its frustum lazily, do it before the threads read it
+		cam->ExtractFrustumSphere();
+		cam->GetNormalizedClipPlanes();
+
+		BLI_task_parallel_range_ex(0, m_objectlist->GetCount(), &data, CullTestFunc, CULLING_THREAD_THRESHOLD, false);
+
+		for (int i = 0; i < m_objectlist->GetCount(); i++)
+		{
+			ApplyCulling(rasty, static_cast<KX_GameObject*>(m_objectlist->GetValue(i)), data.results[i]);
+		}
+	}
+	else if (!dbvt_culling) {
 		// the physics engine couldn't help us, do it the hard way
 		for (int i = 0; i < m_objectlist->GetCount(); i++)
 		{
@@ -1700,6 +1764,33 @@ void KX_Scene::LogicEndFrame()
 
 
 
+/* Minimum number of independent subtrees to update them in parallel */
+#define SG_UPDATE_THREAD_THRESHOLD 64
+/* Subtrees updated per task */
+#define SG_UPDATE_TASK_CHUNK 16
+
+struct SG_UpdateChunk {
+	NodeList updated;
+	NodeList scheduled;
+};
+
+struct SG_UpdateTaskData {
+	double curtime;
+	NodeList roots;
+	std::vector<SG_UpdateChunk> chunks;
+};
+
+static void update_parents_thread_func(TaskPool *pool, void *taskdata, int UNUSED(threadid))
+{
+	SG_UpdateTaskData *data = (SG_UpdateTaskData*)BLI_task_pool_userdata(pool);
+	SG_UpdateChunk &chunk = data->chunks[GET_INT_FROM_POINTER(taskdata)];
+	size_t start = GET_INT_FROM_POINTER(taskdata) * SG_UPDATE_TASK_CHUNK;
+	size_t end = std::min(start + SG_UPDATE_TASK_CHUNK, data->roots.size());
+
+	for (size_t i = start; i < end; ++i)
+		data->roots[i]->UpdateWorldDataThread(data->curtime, chunk.updated, chunk.scheduled);
+}
+
 /**
  * UpdateParents: SceneGraph transformation update.
  */
@@ -1707,7 +1798,44 @@ void KX_Scene::UpdateParents(double curtime)
 {
 	// we use the SG dynamic list
 	SG_Node* node;
+	SG_DList::iterator<SG_Node> it(m_sghead);
+	SG_UpdateTaskData data;
+
+	// Only the scheduled nodes without a scheduled ancestor start an update, the others are
+	// updated along with their ancestor. This gives independent subtrees, clean subtrees are
+	// not visited at all.
+	for (it.begin(); !it.end(); ++it) {
+		SG_Node *parent = (*it)->GetSGParent();
+
+		while (parent && parent->Empty())
+			parent = parent->GetSGParent();
+
+		if (!parent)
+			data.roots.push_back(*it);
+	}
+
+	if (data.roots.size() >= SG_UPDATE_THREAD_THRESHOLD) {
+		const int num_chunks = (data.roots.size() + SG_UPDATE_TASK_CHUNK - 1) / SG_UPDATE_TASK_CHUNK;
+		TaskPool *pool;
+
+		// Empty the list first, during the update the threads only add to it (under lock)
+		while (SG_Node::GetNextScheduled(m_sghead) != NULL);
+
+		data.curtime = curtime;
+		data.chunks.resize(num_chunks);
 
+		pool = BLI_task_pool_create(KX_GetActiveEngine()->GetTaskScheduler(), &data);
+		for (int i = 0; i < num_chunks; ++i)
+			BLI_task_pool_push(pool, update_parents_thread_func, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH);
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+
+		// Physics and culling are not thread safe, the transform callbacks are called here
+		for (int i = 0; i < num_chunks; ++i)
+			SG_Node::FinishWorldDataThread(data.chunks[i].updated, data.chunks[i].scheduled);
+	}
+
+	// Serial update, also of nodes that other nodes scheduled during the parallel update
 	while ((node = SG_Node::GetNextScheduled(m_sghead)) != NULL)
 	{
 		node->UpdateWorldData(curtime);
@@ -2001,10 +2129,10 @@ static void MergeScene_GameObject(KX_GameObject* gameobj, KX_Scene *to, KX_Scene
 		to->GetLogicManager()->RegisterGameMeshName(gameobj->GetMesh(i)->GetName(), gameobj->GetBlenderObject());
 }
 
-bool KX_Scene::MergeScene(KX_Scene *other)
+static bool MergeScene_Check(KX_Scene *to, KX_Scene *from)
 {
-	PHY_IPhysicsEnvironment *env = this->GetPhysicsEnvironment();
-	PHY_IPhysicsEnvironment *env_other = other->GetPhysicsEnvironment();
+	PHY_IPhysicsEnvironment *env = to->GetPhysicsEnvironment();
+	PHY_IPhysicsEnvironment *env_other = from->GetPhysicsEnvironment();
 
 	if ((env==NULL) != (env_other==NULL)) /* TODO - even when both scenes have NONE physics, the other is loaded with bullet enabled, ??? */
 	{
@@ -2013,48 +2141,81 @@ bool KX_Scene::MergeScene(KX_Scene *other)
 		return false;
 	}
 
-	if (GetSceneConverter() != other->GetSceneConverter()) {
+	if (to->GetSceneConverter() != from->GetSceneConverter()) {
 		printf("KX_Scene::MergeScene: converters differ, aborting\n");
 		return false;
 	}
 
+	return true;
+}
 
-	GetBucketManager()->MergeBucketManager(other->GetBucketManager(), this);
-
+/* Moves the timer properties of an object to the time event manager of \a to,
+ * MergeScene_Finish() only does this for the ones left in \a from */
+static void MergeScene_TimeProperties(KX_GameObject *gameobj, KX_Scene *to, KX_Scene *from)
+{
+	SCA_TimeEventManager *timemgr = to->GetTimeEventManager();
+	SCA_TimeEventManager *timemgr_other = from->GetTimeEventManager();
+	vector<CValue*> times = timemgr_other->GetTimeValues();
 
-	/* active + inactive == all ??? - lets hope so */
-	for (int i = 0; i < other->GetObjectList()->GetCount(); i++)
-	{
-		KX_GameObject* gameobj = (KX_GameObject*)other->GetObjectList()->GetValue(i);
-		MergeScene_GameObject(gameobj, this, other);
+	for (int i = 0; i < gameobj->GetPropertyCount(); i++) {
+		CValue *prop = gameobj->GetProperty(i);
 
-		/* add properties to debug list for LibLoad objects */
-		if (KX_GetActiveEngine()->GetAutoAddDebugProperties()) {
-			AddObjectDebugProperties(gameobj);
+		if (std::find(times.begin(), times.end(), prop) != times.end()) {
+			timemgr->AddTimeProperty(prop);
+			timemgr_other->RemoveTimeProperty(prop);
 		}
-
-		gameobj->UpdateBuckets(false); /* only for active objects */
 	}
+}
 
-	for (int i = 0; i < other->GetInactiveList()->GetCount(); i++)
-	{
-		KX_GameObject* gameobj = (KX_GameObject*)other->GetInactiveList()->GetValue(i);
-		MergeScene_GameObject(gameobj, this, other);
+/* Moves an active object with its list memberships, for MergeScenePart().
+ * Everything the object needs to run is moved here too: MergeScene_GameObject()
+ * re-registers the sensors with the event managers of \a to and moves the
+ * physics controllers to its environment, the timer properties follow here.
+ * Otherwise the object would be drawn but frozen until MergeScene_Finish(). */
+static void MergeScene_ActiveObject(KX_GameObject *gameobj, KX_Scene *to, KX_Scene *from)
+{
+	if (!from->GetObjectList()->RemoveValue(gameobj))
+		return;
+
+	MergeScene_GameObject(gameobj, to, from);
+	MergeScene_TimeProperties(gameobj, to, from);
+
+	/* add properties to debug list for LibLoad objects */
+	if (KX_GetActiveEngine()->GetAutoAddDebugProperties()) {
+		to->AddObjectDebugProperties(gameobj);
 	}
 
-	GetTempObjectList()->MergeList(other->GetTempObjectList());
+	gameobj->UpdateBuckets(false); /* only for active objects */
+
+	/* the list references are moved along */
+	to->GetObjectList()->Add(gameobj);
+	if (from->GetRootParentList()->RemoveValue(gameobj))
+		to->GetRootParentList()->Add(gameobj);
+	if (from->GetLightList()->RemoveValue(gameobj))
+		to->GetLightList()->Add(gameobj);
+	if (from->GetTempObjectList()->RemoveValue(gameobj))
+		to->GetTempObjectList()->Add(gameobj);
+}
+
+/* Everything but the objects, once they are merged */
+static void MergeScene_Finish(KX_Scene *to, KX_Scene *other)
+{
+	PHY_IPhysicsEnvironment *env = to->GetPhysicsEnvironment();
+	PHY_IPhysicsEnvironment *env_other = other->GetPhysicsEnvironment();
+
+	to->GetTempObjectList()->MergeList(other->GetTempObjectList());
 	other->GetTempObjectList()->ReleaseAndRemoveAll();
 
-	GetObjectList()->MergeList(other->GetObjectList());
+	to->GetObjectList()->MergeList(other->GetObjectList());
 	other->GetObjectList()->ReleaseAndRemoveAll();
 
-	GetInactiveList()->MergeList(other->GetInactiveList());
+	to->GetInactiveList()->MergeList(other->GetInactiveList());
 	other->GetInactiveList()->ReleaseAndRemoveAll();
 
-	GetRootParentList()->MergeList(other->GetRootParentList());
+	to->GetRootParentList()->MergeList(other->GetRootParentList());
 	other->GetRootParentList()->ReleaseAndRemoveAll();
 
-	GetLightList()->MergeList(other->GetLightList());
+	to->GetLightList()->MergeList(other->GetLightList());
 	other->GetLightList()->ReleaseAndRemoveAll();
 
 	if (env)
@@ -2063,11 +2224,11 @@ bool KX_Scene::MergeScene(KX_Scene *other)
 	/* move materials across, assume they both use the same scene-converters
 	 * Do this after lights are merged so materials can use the lights in shaders
 	 */
-	GetSceneConverter()->MergeScene(this, other);
+	to->GetSceneConverter()->MergeScene(to, other);
 
 	/* merge logic */
 	{
-		SCA_LogicManager *logicmgr=			GetLogicManager();
+		SCA_LogicManager *logicmgr=			to->GetLogicManager();
 		SCA_LogicManager *logicmgr_other=	other->GetLogicManager();
 
 		vector<class SCA_EventManager*>evtmgrs= logicmgr->GetEventManagers();
@@ -2086,7 +2247,7 @@ bool KX_Scene::MergeScene(KX_Scene *other)
 		}
 
 		/* grab any timer properties from the other scene */
-		SCA_TimeEventManager *timemgr=		GetTimeEventManager();
+		SCA_TimeEventManager *timemgr=		to->GetTimeEventManager();
 		SCA_TimeEventManager *timemgr_other=	other->GetTimeEventManager();
 		vector<CValue*> times = timemgr_other->GetTimeValues();
 
@@ -2095,6 +2256,86 @@ bool KX_Scene::MergeScene(KX_Scene *other)
 		}
 		
 	}
+}
+
+bool KX_Scene::MergeScene(KX_Scene *other)
+{
+	if (!MergeScene_Check(this, other))
+		return false;
+
+	GetBucketManager()->MergeBucketManager(other->GetBucketManager(), this);
+
+
+	/* active + inactive == all ??? - lets hope so */
+	for (int i = 0; i < other->GetObjectList()->GetCount(); i++)
+	{
+		KX_GameObject* gameobj = (KX_GameObject*)other->GetObjectList()->GetValue(i);
+		MergeScene_GameObject(gameobj, this, other);
+
+		/* add properties to debug list for LibLoad objects */
+		if (KX_GetActiveEngine()->GetAutoAddDebugProperties()) {
+			AddObjectDebugProperties(gameobj);
+		}
+
+		gameobj->UpdateBuckets(false); /* only for active objects */
+	}
+
+	for (int i = 0; i < other->GetInactiveList()->GetCount(); i++)
+	{
+		KX_GameObject* gameobj = (KX_GameObject*)other->GetInactiveList()->GetValue(i);
+		MergeScene_GameObject(gameobj, this, other);
+	}
+
+	MergeScene_Finish(this, other);
+
+	return true;
+}
+
+bool KX_Scene::MergeScenePart(KX_Scene *other, int &maxobjects)
+{
+	CListValue *objects = other->GetObjectList();
+	CListValue *inactive = other->GetInactiveList();
+
+	if (!MergeScene_Check(this, other))
+		return true;
+
+	/* the mesh slots of the objects that aren't merged yet stay culled */
+	GetBucketManager()->MergeBucketManager(other->GetBucketManager(), this);
+
+	while (maxobjects > 0 && objects->GetCount())
+	{
+		KX_GameObject *root = (KX_GameObject*)objects->GetValue(objects->GetCount() - 1);
+		KX_GameObject *parent;
+		CListValue *children;
+
+		while ((parent = root->GetParent()) != NULL)
+			root = parent;
+
+		children = root->GetChildrenRecursive();
+
+		MergeScene_ActiveObject(root, this, other);
+		for (int i = 0; i < children->GetCount(); i++)
+			MergeScene_ActiveObject((KX_GameObject*)children->GetValue(i), this, other);
+
+		maxobjects -= children->GetCount() + 1;
+		children->Release();
+	}
+
+	while (maxobjects > 0 && inactive->GetCount())
+	{
+		KX_GameObject* gameobj = (KX_GameObject*)inactive->GetValue(inactive->GetCount() - 1);
+
+		MergeScene_GameObject(gameobj, this, other);
+		inactive->Remove(inactive->GetCount() - 1);
+		GetInactiveList()->Add(gameobj);
+		maxobjects--;
+	}
+
+	if (objects->GetCount() || inactive->GetCount())
+		return false;
+
+	MergeScene_Finish(this, other);
+
 	return true;
 }
 
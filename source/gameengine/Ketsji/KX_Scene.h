@@ -114,6 +114,12 @@ class KX_Scene : public PyObjectPlus, public SCA_IScene
 		CullingInfo(int layer) : m_layer(layer) {}
 	};
 
+public:
+	/**
+	 * Result of the frustum test of an object, see CullTest().
+	 */
+	enum CullResult { CULL_IGNORE, CULL_VISIBLE, CULL_CULLED };
+
 protected:
 	RAS_BucketManager*	m_bucketmanager;
 	CListValue*			m_tempObjectList;
@@ -286,6 +292,14 @@ protected:
 	void MarkVisible(RAS_IRasterizer* rasty, KX_GameObject* gameobj, KX_Camera*cam, int layer=0);
 	static void PhysicsCullingCallback(KX_ClientObjectInfo* objectInfo, void* cullingInfo);
 
+	/**
+	 * The frustum test of MarkVisible() is split from applying its result
+	 * so that the objects can be tested in parallel.
+	 */
+	static CullResult CullTest(KX_GameObject* gameobj, KX_Camera* cam, int layer);
+	static void CullTestFunc(void *userdata, int index);
+	void ApplyCulling(RAS_IRasterizer* rasty, KX_GameObject* gameobj, CullResult result);
+
 	double				m_suspendedtime;
 	double				m_suspendeddelta;
 
@@ -663,6 +677,15 @@ public:
 
 	bool MergeScene(KX_Scene *other);
 
+	/**
+	 * Incremental MergeScene(), merges about \a maxobjects objects of \a other
+	 * and subtracts the number merged. Whole parent/child hierarchies are moved
+	 * at once so that they are never split between the two scenes. The rest of
+	 * \a other is merged with its last objects. Returns true when \a other is
+	 * completely merged (or can't be merged) and can be deleted.
+	 */
+	bool MergeScenePart(KX_Scene *other, int &maxobjects);
+
 
 	//void PrintStats(int verbose_level) {
 	//	m_bucketmanager->PrintStats(verbose_level)
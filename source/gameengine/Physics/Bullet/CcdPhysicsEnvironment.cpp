@@ -53,6 +53,7 @@ subject to the following restrictions:
 
 extern "C" {
 	#include "BLI_utildefines.h"
+	#include "BLI_task.h"
 	#include "BKE_object.h"
 }
 
@@ -1824,12 +1825,14 @@ struct	DbvtCullingCallback : btDbvt::ICollide
 	PHY_CullingCallback m_clientCallback;
 	void* m_userData;
 	OcclusionBuffer *m_ocb;
+	std::vector<KX_ClientObjectInfo*> *m_visible;	// collect the objects instead of calling the client
 
 	DbvtCullingCallback(PHY_CullingCallback clientCallback, void* userData)
 	{
 		m_clientCallback = clientCallback;
 		m_userData = userData;
 		m_ocb = NULL;
+		m_visible = NULL;
 	}
 	bool Descent(const btDbvtNode* node)
 	{
@@ -1886,11 +1889,61 @@ struct	DbvtCullingCallback : btDbvt::ICollide
 				}
 			}
 		}
-		if (info)
-			(*m_clientCallback)(info, m_userData);
+		if (info) {
+			if (m_visible)
+				m_visible->push_back(info);
+			else
+				(*m_clientCallback)(info, m_userData);
+		}
 	}
 };
 
+/* Minimum number of objects in the culling tree to traverse it in parallel */
+#define DBVT_CULLING_THREAD_THRESHOLD 1024
+/* Number of subtrees the traversal is split in */
+#define DBVT_CULLING_SUBTREES 64
+
+struct DbvtCullingTaskData {
+	std::vector<const btDbvtNode*> nodes;
+	std::vector<std::vector<KX_ClientObjectInfo*> > visible;
+	btVector3 *planes_n;
+	btScalar *planes_o;
+	int nplanes;
+};
+
+static void dbvt_culling_task_cb(void *userdata, int index)
+{
+	DbvtCullingTaskData *data = (DbvtCullingTaskData*)userdata;
+	DbvtCullingCallback dispatcher(NULL, NULL);
+
+	dispatcher.m_visible = &data->visible[index];
+	btDbvt::collideKDOP(data->nodes[index], data->planes_n, data->planes_o, data->nplanes, dispatcher);
+}
+
+/* Splits the trees in independent subtrees, in traversal order, by opening the first internal nodes */
+static void dbvt_culling_subtrees(btDbvtNode *root0, btDbvtNode *root1, std::vector<const btDbvtNode*>& nodes)
+{
+	bool split = true;
+
+	if (root0)
+		nodes.push_back(root0);
+	if (root1)
+		nodes.push_back(root1);
+
+	while (split && nodes.size() < DBVT_CULLING_SUBTREES) {
+		split = false;
+		for (size_t i = 0; i < nodes.size() && nodes.size() < DBVT_CULLING_SUBTREES; ++i) {
+			const btDbvtNode *node = nodes[i];
+
+			if (node->isinternal()) {
+				nodes[i] = node->childs[0];
+				nodes.insert(nodes.begin() + (++i), node->childs[1]);
+				split = true;
+			}
+		}
+	}
+}
+
 static OcclusionBuffer gOcb;
 bool CcdPhysicsEnvironment::CullingTest(PHY_CullingCallback callback, void* userData, MT_Vector4 *planes, int nplanes, int occlusionRes, const int *viewport, double modelview[16], double projection[16])
 {
@@ -1915,6 +1968,24 @@ bool CcdPhysicsEnvironment::CullingTest(PHY_CullingCallback callback, void* user
 		btDbvt::collideOCL(m_cullingTree->m_sets[1].m_root,planes_n,planes_o,planes_n[0],nplanes,dispatcher);
 		btDbvt::collideOCL(m_cullingTree->m_sets[0].m_root,planes_n,planes_o,planes_n[0],nplanes,dispatcher);
 	}
+	else if (m_cullingTree->m_sets[0].m_leaves + m_cullingTree->m_sets[1].m_leaves >= DBVT_CULLING_THREAD_THRESHOLD) {
+		// frustum culling only, the subtrees are tested in parallel and the
+		// client is called from this thread, it is not thread safe
+		DbvtCullingTaskData data;
+
+		dbvt_culling_subtrees(m_cullingTree->m_sets[1].m_root, m_cullingTree->m_sets[0].m_root, data.nodes);
+		data.visible.resize(data.nodes.size());
+		data.planes_n = planes_n;
+		data.planes_o = planes_o;
+		data.nplanes = nplanes;
+
+		BLI_task_parallel_range_ex(0, data.nodes.size(), &data, dbvt_culling_task_cb, 0, true);
+
+		for (size_t i = 0; i < data.visible.size(); i++) {
+			for (size_t j = 0; j < data.visible[i].size(); j++)
+				(*callback)(data.visible[i][j], userData);
+		}
+	}
 	else {
 		btDbvt::collideKDOP(m_cullingTree->m_sets[1].m_root,planes_n,planes_o,nplanes,dispatcher);
 		btDbvt::collideKDOP(m_cullingTree->m_sets[0].m_root,planes_n,planes_o,nplanes,dispatcher);
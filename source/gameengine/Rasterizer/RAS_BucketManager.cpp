@@ -43,47 +43,100 @@
 #include "RAS_BucketManager.h"
 
 #include <algorithm>
+#include <string.h>
 /* sorting */
 
-struct RAS_BucketManager::sortedmeshslot
-{
-public:
-	MT_Scalar m_z;					/* depth */
-	RAS_MeshSlot *m_ms;				/* mesh slot */
-	RAS_MaterialBucket *m_bucket;	/* buck mesh slot came from */
-
-	sortedmeshslot() {}
+/* material flags for the kind of shading, materials sharing them are drawn together */
+#define MATERIAL_SORT_FLAGS (RAS_BLENDERGLSL | RAS_BLENDERMAT | RAS_GLSHADER | RAS_MULTITEX)
 
-	void set(RAS_MeshSlot *ms, RAS_MaterialBucket *bucket, const MT_Vector3& pnorm)
+struct RAS_BucketManager::materialorder
+{
+	bool operator()(const RAS_MaterialBucket *a, const RAS_MaterialBucket *b) const
 	{
-		// would be good to use the actual bounding box center instead
-		MT_Point3 pos(ms->m_OpenGLMatrix[12], ms->m_OpenGLMatrix[13], ms->m_OpenGLMatrix[14]);
-
-		m_z = MT_dot(pnorm, pos);
-		m_ms = ms;
-		m_bucket = bucket;
+		const RAS_IPolyMaterial *mata = a->GetPolyMaterial();
+		const RAS_IPolyMaterial *matb = b->GetPolyMaterial();
+		const unsigned int flaga = mata->GetFlag() & MATERIAL_SORT_FLAGS;
+		const unsigned int flagb = matb->GetFlag() & MATERIAL_SORT_FLAGS;
+
+		if (flaga != flagb)
+			return flaga < flagb;
+		/* texture name */
+		if (mata->hash() != matb->hash())
+			return mata->hash() < matb->hash();
+		/* total order for the rest, materials can be Equals() after merging
+		 * scenes so RAS_IPolyMaterial::Less can't be used here */
+		if (mata->GetPolyMatId() != matb->GetPolyMatId())
+			return mata->GetPolyMatId() < matb->GetPolyMatId();
+
+		return a < b;
 	}
 };
 
-struct RAS_BucketManager::backtofront
+/* depth as unsigned int keeping the order of the floats */
+static unsigned int depth_sort_key(float z)
 {
-	bool operator()(const sortedmeshslot &a, const sortedmeshslot &b)
-	{
-		return (a.m_z < b.m_z) || (a.m_z == b.m_z && a.m_ms < b.m_ms);
-	}
-};
+	union { float f; unsigned int i; } u;
 
-struct RAS_BucketManager::fronttoback
+	u.f = z;
+	return (u.i & 0x80000000) ? ~u.i : (u.i | 0x80000000);
+}
+
+/* LSD radix sort on the 64 bit m_key, a byte per pass, passes where all keys
+ * have the same byte are skipped. It's stable, so slots with equal keys keep
+ * the order they were added in. */
+template <class T>
+static void radix_sort_keys(std::vector<T>& items, std::vector<T>& temp)
 {
-	bool operator()(const sortedmeshslot &a, const sortedmeshslot &b)
-	{
-		return (a.m_z > b.m_z) || (a.m_z == b.m_z && a.m_ms > b.m_ms);
+	const size_t size = items.size();
+	unsigned int count[8][256];
+	T *src, *dst;
+	size_t i;
+	int pass, digit;
+
+	if (size < 2)
+		return;
+
+	memset(count, 0, sizeof(count));
+	for (i = 0; i < size; i++) {
+		const uint64_t key = items[i].m_key;
+		for (pass = 0; pass < 8; pass++)
+			count[pass][(key >> (pass * 8)) & 0xff]++;
 	}
-};
+
+	temp.resize(size);
+	src = &items[0];
+	dst = &temp[0];
+
+	for (pass = 0; pass < 8; pass++) {
+		unsigned int *pcount = count[pass];
+		const int shift = pass * 8;
+		unsigned int offset = 0;
+
+		if (pcount[(src[0].m_key >> shift) & 0xff] == size)
+			continue;
+
+		for (digit = 0; digit < 256; digit++) {
+			const unsigned int num = pcount[digit];
+			pcount[digit] = offset;
+			offset += num;
+		}
+
+		for (i = 0; i < size; i++)
+			dst[pcount[(src[i].m_key >> shift) & 0xff]++] = src[i];
+
+		std::swap(src, dst);
+	}
+
+	if (src != &items[0])
+		items.swap(temp);
+}
 
 /* bucket manager */
 
 RAS_BucketManager::RAS_BucketManager()
+	:m_bucketsSorted(false),
+	m_numDrawCalls(0),
+	m_numMaterialChanges(0)
 {
 
 }
@@ -102,122 +155,103 @@ RAS_BucketManager::~RAS_BucketManager()
 	m_AlphaBuckets.clear();
 }
 
-void RAS_BucketManager::OrderBuckets(const MT_Transform& cameratrans, BucketList& buckets, vector<sortedmeshslot>& slots, bool alpha)
+void RAS_BucketManager::SortBuckets()
+{
+	if (m_bucketsSorted)
+		return;
+
+	sort(m_SolidBuckets.begin(), m_SolidBuckets.end(), materialorder());
+	sort(m_AlphaBuckets.begin(), m_AlphaBuckets.end(), materialorder());
+
+	m_bucketsSorted = true;
+}
+
+void RAS_BucketManager::OrderBuckets(const MT_Transform& cameratrans, BucketList& buckets, bool alpha)
 {
 	BucketList::iterator bit;
-	list<RAS_MeshSlot>::iterator mit;
-	size_t size = 0, i = 0;
+	unsigned int rank = 0;
 
 	/* Camera's near plane equation: pnorm.dot(point) + pval,
 	 * but we leave out pval since it's constant anyway */
 	const MT_Vector3 pnorm(cameratrans.getBasis()[2]);
 
-	for (bit = buckets.begin(); bit != buckets.end(); ++bit)
-	{
-		SG_DList::iterator<RAS_MeshSlot> mit((*bit)->GetActiveMeshSlots());
-		for (mit.begin(); !mit.end(); ++mit)
-			size++;
-	}
-
-	slots.resize(size);
+	/* keeps the memory from the previous frame */
+	m_sortedSlots.clear();
 
-	for (bit = buckets.begin(); bit != buckets.end(); ++bit)
+	for (bit = buckets.begin(); bit != buckets.end(); ++bit, ++rank)
 	{
 		RAS_MaterialBucket* bucket = *bit;
 		RAS_MeshSlot* ms;
 		// remove the mesh slot form the list, it culls them automatically for next frame
 		while ((ms = bucket->GetNextActiveMeshSlot())) {
-			slots[i++].set(ms, bucket, pnorm);
+			// would be good to use the actual bounding box center instead
+			MT_Point3 pos(ms->m_OpenGLMatrix[12], ms->m_OpenGLMatrix[13], ms->m_OpenGLMatrix[14]);
+			const uint64_t depth = depth_sort_key((float)MT_dot(pnorm, pos));
+			sortedmeshslot slot;
+
+			/* alpha is drawn back to front, solid per material and front to back
+			 * within the material to reduce overdraw */
+			if (alpha)
+				slot.m_key = (depth << 32) | rank;
+			else
+				slot.m_key = ((uint64_t)rank << 32) | (~depth & 0xffffffff);
+			slot.m_ms = ms;
+			slot.m_bucket = bucket;
+
+			m_sortedSlots.push_back(slot);
 		}
 	}
-		
-	if (alpha)
-		sort(slots.begin(), slots.end(), backtofront());
-	else
-		sort(slots.begin(), slots.end(), fronttoback());
+
+	radix_sort_keys(m_sortedSlots, m_sortedSlotsTemp);
 }
 
-void RAS_BucketManager::RenderAlphaBuckets(const MT_Transform& cameratrans, RAS_IRasterizer* rasty)
+void RAS_BucketManager::RenderSortedSlots(const MT_Transform& cameratrans, RAS_IRasterizer* rasty)
 {
-	vector<sortedmeshslot> slots;
 	vector<sortedmeshslot>::iterator sit;
+	RAS_MaterialBucket *lastbucket = NULL;
 
-	// Having depth masks disabled/enabled gives different artifacts in
-	// case no sorting is done or is done inexact. For compatibility, we
-	// disable it.
-	if (rasty->GetDrawingMode() != RAS_IRasterizer::KX_SHADOW)
-		rasty->SetDepthMask(RAS_IRasterizer::KX_DEPTHMASK_DISABLED);
-
-	OrderBuckets(cameratrans, m_AlphaBuckets, slots, true);
-	
-	for (sit=slots.begin(); sit!=slots.end(); ++sit) {
+	for (sit = m_sortedSlots.begin(); sit != m_sortedSlots.end(); ++sit) {
 		rasty->SetClientObject(sit->m_ms->m_clientObj);
 
-		while (sit->m_bucket->ActivateMaterial(cameratrans, rasty))
+		if (sit->m_bucket != lastbucket) {
+			lastbucket = sit->m_bucket;
+			m_numMaterialChanges++;
+		}
+
+		while (sit->m_bucket->ActivateMaterial(cameratrans, rasty)) {
 			sit->m_bucket->RenderMeshSlot(cameratrans, rasty, *(sit->m_ms));
+			m_numDrawCalls++;
+		}
 
 		// make this mesh slot culled automatically for next frame
 		// it will be culled out by frustrum culling
 		sit->m_ms->SetCulled(true);
 	}
+}
+
+void RAS_BucketManager::RenderAlphaBuckets(const MT_Transform& cameratrans, RAS_IRasterizer* rasty)
+{
+	// Having depth masks disabled/enabled gives different artifacts in
+	// case no sorting is done or is done inexact. For compatibility, we
+	// disable it.
+	if (rasty->GetDrawingMode() != RAS_IRasterizer::KX_SHADOW)
+		rasty->SetDepthMask(RAS_IRasterizer::KX_DEPTHMASK_DISABLED);
+
+	OrderBuckets(cameratrans, m_AlphaBuckets, true);
+	RenderSortedSlots(cameratrans, rasty);
 
 	rasty->SetDepthMask(RAS_IRasterizer::KX_DEPTHMASK_ENABLED);
 }
 
 void RAS_BucketManager::RenderSolidBuckets(const MT_Transform& cameratrans, RAS_IRasterizer* rasty)
 {
-	BucketList::iterator bit;
-
 	rasty->SetDepthMask(RAS_IRasterizer::KX_DEPTHMASK_ENABLED);
 
-	for (bit = m_SolidBuckets.begin(); bit != m_SolidBuckets.end(); ++bit) {
-#if 1
-		RAS_MaterialBucket* bucket = *bit;
-		RAS_MeshSlot* ms;
-		// remove the mesh slot form the list, it culls them automatically for next frame
-		while ((ms = bucket->GetNextActiveMeshSlot())) {
-			rasty->SetClientObject(ms->m_clientObj);
-			while (bucket->ActivateMaterial(cameratrans, rasty))
-				bucket->RenderMeshSlot(cameratrans, rasty, *ms);
-
-			// make this mesh slot culled automatically for next frame
-			// it will be culled out by frustrum culling
-			ms->SetCulled(true);
-		}
-#else
-		list<RAS_MeshSlot>::iterator mit;
-		for (mit = (*bit)->msBegin(); mit != (*bit)->msEnd(); ++mit) {
-			if (mit->IsCulled())
-				continue;
-
-			rasty->SetClientObject(rasty, mit->m_clientObj);
-
-			while ((*bit)->ActivateMaterial(cameratrans, rasty))
-				(*bit)->RenderMeshSlot(cameratrans, rasty, *mit);
-
-			// make this mesh slot culled automatically for next frame
-			// it will be culled out by frustrum culling
-			mit->SetCulled(true);
-		}
-#endif
-	}
-	
-	/* this code draws meshes order front-to-back instead to reduce overdraw.
-	 * it turned out slower due to much material state switching, a more clever
-	 * algorithm might do better. */
-#if 0
-	vector<sortedmeshslot> slots;
-	vector<sortedmeshslot>::iterator sit;
-
-	OrderBuckets(cameratrans, m_SolidBuckets, slots, false);
-
-	for (sit=slots.begin(); sit!=slots.end(); ++sit) {
-		rendertools->SetClientObject(rasty, sit->m_ms->m_clientObj);
-
-		while (sit->m_bucket->ActivateMaterial(cameratrans, rasty))
-			sit->m_bucket->RenderMeshSlot(cameratrans, rasty, *(sit->m_ms));
-	}
-#endif
+	/* Ordering all slots front-to-back turned out slower due to much material
+	 * state switching, the material stays the primary key so there are no
+	 * more material changes than drawing bucket by bucket. */
+	OrderBuckets(cameratrans, m_SolidBuckets, false);
+	RenderSortedSlots(cameratrans, rasty);
 }
 
 void RAS_BucketManager::Renderbuckets(const MT_Transform& cameratrans, RAS_IRasterizer* rasty)
@@ -225,6 +259,8 @@ void RAS_BucketManager::Renderbuckets(const MT_Transform& cameratrans, RAS_IRast
 	/* beginning each frame, clear (texture/material) caching information */
 	rasty->ClearCachingInfo();
 
+	SortBuckets();
+
 	RenderSolidBuckets(cameratrans, rasty);
 	RenderAlphaBuckets(cameratrans, rasty);
 
@@ -269,6 +305,7 @@ RAS_MaterialBucket *RAS_BucketManager::FindBucket(RAS_IPolyMaterial *material, b
 	
 	RAS_MaterialBucket *bucket = new RAS_MaterialBucket(material);
 	bucketCreated = true;
+	m_bucketsSorted = false;
 
 	if (bucket->IsAlpha())
 		m_AlphaBuckets.push_back(bucket);
@@ -375,6 +412,8 @@ void RAS_BucketManager::MergeBucketManager(RAS_BucketManager *other, SCA_IScene
 
 	GetAlphaBuckets().insert( GetAlphaBuckets().end(), other->GetAlphaBuckets().begin(), other->GetAlphaBuckets().end() );
 	other->GetAlphaBuckets().clear();
+
+	m_bucketsSorted = false;
 	//printf("AFTER %d %d\n", GetSolidBuckets().size(), GetAlphaBuckets().size());
 }
 
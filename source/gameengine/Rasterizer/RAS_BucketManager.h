@@ -35,6 +35,8 @@
 #include "MT_Transform.h"
 #include "RAS_MaterialBucket.h"
 
+#include "BLI_sys_types.h"
+
 #include <vector>
 
 class RAS_BucketManager
@@ -44,10 +46,26 @@ public:
 private:
 	BucketList m_SolidBuckets;
 	BucketList m_AlphaBuckets;
-	
-	struct sortedmeshslot;
-	struct backtofront;
-	struct fronttoback;
+
+	/* Render queue entry, the slots are drawn in order of their key:
+	 * material rank + depth for solid, depth + material rank for alpha */
+	struct sortedmeshslot
+	{
+		uint64_t m_key;					/* sort key */
+		RAS_MeshSlot *m_ms;				/* mesh slot */
+		RAS_MaterialBucket *m_bucket;	/* buck mesh slot came from */
+	};
+	struct materialorder;
+
+	/* Render queue, the buffers are kept between frames */
+	std::vector<sortedmeshslot> m_sortedSlots;
+	std::vector<sortedmeshslot> m_sortedSlotsTemp;
+	/* Bucket lists need sorting on material before drawing */
+	bool m_bucketsSorted;
+
+	/* Statistics, since last ResetStatistics() */
+	unsigned int m_numDrawCalls;
+	unsigned int m_numMaterialChanges;
 
 public:
 	RAS_BucketManager();
@@ -68,6 +86,11 @@ public:
 	BucketList & GetSolidBuckets() {return m_SolidBuckets;}
 	BucketList & GetAlphaBuckets() {return m_AlphaBuckets;}
 
+	/* draw statistics, reset by the engine each frame */
+	unsigned int GetNumDrawCalls() const { return m_numDrawCalls; }
+	unsigned int GetNumMaterialChanges() const { return m_numMaterialChanges; }
+	void ResetStatistics() { m_numDrawCalls = m_numMaterialChanges = 0; }
+
 	/*void PrintStats(int verbose_level) {
 		printf("\nMappings...\n");
 		printf("\t m_SolidBuckets: %d\n", m_SolidBuckets.size());
@@ -77,7 +100,9 @@ public:
 
 
 private:
-	void OrderBuckets(const MT_Transform& cameratrans, BucketList& buckets, vector<sortedmeshslot>& slots, bool alpha);
+	void SortBuckets();
+	void OrderBuckets(const MT_Transform& cameratrans, BucketList& buckets, bool alpha);
+	void RenderSortedSlots(const MT_Transform& cameratrans, RAS_IRasterizer* rasty);
 
 	void RenderSolidBuckets(const MT_Transform& cameratrans,
 		RAS_IRasterizer* rasty);
@@ -199,6 +199,11 @@ unsigned int RAS_IPolyMaterial::hash() const
 	return m_texturename.hash();
 }
 
+unsigned int RAS_IPolyMaterial::GetPolyMatId() const
+{
+	return m_polymatid;
+}
+
 int RAS_IPolyMaterial::GetDrawingMode() const
 {
 	return m_drawingmode;
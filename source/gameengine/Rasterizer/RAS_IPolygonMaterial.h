@@ -158,6 +158,7 @@ public:
 	bool				IsAlpha() const;
 	bool				IsZSort() const;
 	unsigned int		hash() const;
+	unsigned int		GetPolyMatId() const;
 	int					GetDrawingMode() const;
 	const STR_String&	GetMaterialName() const;
 	dword				GetMaterialNameHash() const;
@@ -207,6 +207,38 @@ void SG_Node::UpdateWorldData(double time, bool parentUpdated)
 
 
 
+void SG_Node::UpdateWorldDataThread(double time, NodeList& updated, NodeList& scheduled, bool parentUpdated)
+{
+	if (UpdateSpatialData(GetSGParent(),time,parentUpdated))
+		updated.push_back(this);
+
+	// A controller may have scheduled the node again, UpdateWorldData() would delink it here
+	if (!Empty())
+		scheduled.push_back(this);
+
+	for (NodeList::iterator it = m_children.begin();it!=m_children.end();++it)
+	{
+		(*it)->UpdateWorldDataThread(time, updated, scheduled, parentUpdated);
+	}
+}
+
+
+
+void SG_Node::FinishWorldDataThread(NodeList& updated, NodeList& scheduled)
+{
+	for (NodeList::iterator it = updated.begin();it!=updated.end();++it)
+	{
+		(*it)->ActivateUpdateTransformCallback();
+	}
+
+	for (NodeList::iterator it = scheduled.begin();it!=scheduled.end();++it)
+	{
+		(*it)->Delink();
+	}
+}
+
+
+
 void SG_Node::SetSimulatedTime(double time,bool recurse)
 {
 
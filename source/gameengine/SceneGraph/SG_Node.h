@@ -193,6 +193,34 @@ public:
 		bool parentUpdated=false
 	);
 
+	/**
+	 * Same as UpdateWorldData() but safe to run on independent subtrees
+	 * in parallel: the nodes are not removed from the update list and the
+	 * transform callbacks are not called. Instead the nodes whose transform
+	 * changed are added to \a updated and the nodes that got scheduled
+	 * again during their update are added to \a scheduled, for the caller
+	 * to finish serially.
+	 */
+
+		void
+	UpdateWorldDataThread(
+		double time,
+		NodeList& updated,
+		NodeList& scheduled,
+		bool parentUpdated=false
+	);
+
+	/**
+	 * Serial end of UpdateWorldDataThread(): calls the transform callbacks
+	 * of the updated nodes and removes the scheduled ones from the list.
+	 */
+
+	static void
+	FinishWorldDataThread(
+		NodeList& updated,
+		NodeList& scheduled
+	);
+
 	/**
 	 * Update the simulation time of this node. Iterate through
 	 * the children nodes and update their simulated time.
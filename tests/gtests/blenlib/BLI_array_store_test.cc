@@ -0,0 +1,166 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+#include <string.h>
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_array_store.h"
+}
+
+#define CHUNK_COUNT 32
+
+/* -------------------------------------------------------------------- */
+/* test utility functions */
+
+static int *int_array_create(int len, int seed)
+{
+	int *data = (int *)MEM_mallocN(sizeof(*data) * len, __func__);
+	int i;
+
+	for (i = 0; i < len; i++) {
+		/* distinct values, so chunks can't match at an unexpected offset */
+		data[i] = (i * 7919) ^ seed;
+	}
+	return data;
+}
+
+static void state_expect_data(const BArrayState *state, const int *data, int len)
+{
+	size_t data_len;
+	int *data_test = (int *)BLI_array_store_state_data_get_alloc(state, &data_len);
+
+	ASSERT_EQ(sizeof(*data) * len, data_len);
+	EXPECT_EQ(0, memcmp(data, data_test, data_len));
+	MEM_freeN(data_test);
+}
+
+/* -------------------------------------------------------------------- */
+/* tests */
+
+TEST(array_store, Empty)
+{
+	BArrayStore *bs = BLI_array_store_create(sizeof(int), CHUNK_COUNT);
+	BArrayState *state = BLI_array_store_state_add(bs, NULL, 0, NULL);
+
+	EXPECT_EQ(0, BLI_array_store_state_size_get(state));
+	EXPECT_EQ(0, BLI_array_store_calc_size_compacted_get(bs));
+
+	BLI_array_store_destroy(bs);
+}
+
+TEST(array_store, RoundTrip)
+{
+	const int len = 1000;
+	BArrayStore *bs = BLI_array_store_create(sizeof(int), CHUNK_COUNT);
+	int *data = int_array_create(len, 0);
+	BArrayState *state = BLI_array_store_state_add(bs, data, sizeof(*data) * len, NULL);
+
+	state_expect_data(state, data, len);
+	EXPECT_EQ(sizeof(*data) * len, BLI_array_store_calc_size_compacted_get(bs));
+
+	MEM_freeN(data);
+	BLI_array_store_destroy(bs);
+}
+
+TEST(array_store, Duplicate)
+{
+	const int len = 1000;
+	BArrayStore *bs = BLI_array_store_create(sizeof(int), CHUNK_COUNT);
+	int *data = int_array_create(len, 0);
+	BArrayState *state_a, *state_b;
+
+	state_a = BLI_array_store_state_add(bs, data, sizeof(*data) * len, NULL);
+	state_b = BLI_array_store_state_add(bs, data, sizeof(*data) * len, state_a);
+
+	state_expect_data(state_b, data, len);
+	EXPECT_EQ(sizeof(*data) * len * 2, BLI_array_store_calc_size_expanded_get(bs));
+	EXPECT_EQ(sizeof(*data) * len, BLI_array_store_calc_size_compacted_get(bs));
+
+	MEM_freeN(data);
+	BLI_array_store_destroy(bs);
+}
+
+TEST(array_store, Change)
+{
+	const int len = 1000;
+	BArrayStore *bs = BLI_array_store_create(sizeof(int), CHUNK_COUNT);
+	int *data = int_array_create(len, 0);
+	BArrayState *state_a, *state_b;
+
+	state_a = BLI_array_store_state_add(bs, data, sizeof(*data) * len, NULL);
+	data[len / 2] = -1;
+	state_b = BLI_array_store_state_add(bs, data, sizeof(*data) * len, state_a);
+
+	state_expect_data(state_b, data, len);
+	/* only the changed chunk is stored again */
+	EXPECT_GE(sizeof(*data) * (len + CHUNK_COUNT), BLI_array_store_calc_size_compacted_get(bs));
+
+	MEM_freeN(data);
+	BLI_array_store_destroy(bs);
+}
+
+static void array_store_shift_test(int shift)
+{
+	const int len = 1000;
+	BArrayStore *bs = BLI_array_store_create(sizeof(int), CHUNK_COUNT);
+	int *data = int_array_create(len + abs(shift), 0);
+	BArrayState *state_a, *state_b;
+
+	/* insert or remove elements at the start of the array, the remaining chunks must still be found */
+	state_a = BLI_array_store_state_add(bs, data + abs(shift), sizeof(*data) * len, NULL);
+	if (shift > 0) {
+		state_b = BLI_array_store_state_add(bs, data, sizeof(*data) * (len + shift), state_a);
+		state_expect_data(state_b, data, len + shift);
+	}
+	else {
+		state_b = BLI_array_store_state_add(bs, data - shift * 2, sizeof(*data) * (len + shift), state_a);
+		state_expect_data(state_b, data - shift * 2, len + shift);
+	}
+	state_expect_data(state_a, data + abs(shift), len);
+
+	EXPECT_GE(sizeof(*data) * (len + CHUNK_COUNT * 2), BLI_array_store_calc_size_compacted_get(bs));
+
+	MEM_freeN(data);
+	BLI_array_store_destroy(bs);
+}
+
+TEST(array_store, Insert)
+{
+	array_store_shift_test(3);
+}
+
+TEST(array_store, Remove)
+{
+	array_store_shift_test(-3);
+}
+
+TEST(array_store, StateRemove)
+{
+	const int len = 1000;
+	BArrayStore *bs = BLI_array_store_create(sizeof(int), CHUNK_COUNT);
+	int *data_a = int_array_create(len, 0);
+	int *data_b = int_array_create(len, 1);
+	BArrayState *state_a, *state_b, *state_c;
+
+	state_a = BLI_array_store_state_add(bs, data_a, sizeof(*data_a) * len, NULL);
+	state_b = BLI_array_store_state_add(bs, data_b, sizeof(*data_b) * len, state_a);
+	state_c = BLI_array_store_state_add(bs, data_a, sizeof(*data_a) * len, state_a);
+	EXPECT_EQ(sizeof(*data_a) * len * 2, BLI_array_store_calc_size_compacted_get(bs));
+
+	/* chunks shared with 'state_c' must remain */
+	BLI_array_store_state_remove(bs, state_a);
+	EXPECT_EQ(sizeof(*data_a) * len * 2, BLI_array_store_calc_size_compacted_get(bs));
+	state_expect_data(state_c, data_a, len);
+
+	BLI_array_store_state_remove(bs, state_b);
+	EXPECT_EQ(sizeof(*data_a) * len, BLI_array_store_calc_size_compacted_get(bs));
+
+	BLI_array_store_state_remove(bs, state_c);
+	EXPECT_EQ(0, BLI_array_store_calc_size_compacted_get(bs));
+
+	MEM_freeN(data_a);
+	MEM_freeN(data_b);
+	BLI_array_store_destroy(bs);
+}
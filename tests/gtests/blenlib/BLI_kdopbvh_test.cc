@@ -0,0 +1,239 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "PIL_time.h"
+#include "MEM_guardedalloc.h"
+}
+
+#define POINTS_NUM 100000
+#define QUERY_NUM 20000
+
+/* -------------------------------------------------------------------- */
+/* test utility functions */
+
+static BVHTree *bvhtree_points_create(float (*points)[3], int points_num, RNG *rng)
+{
+	BVHTree *tree = BLI_bvhtree_new(points_num, 0.0f, 2, 6);
+	int i;
+
+	for (i = 0; i < points_num; i++) {
+		BLI_rng_get_float_unit_v3(rng, points[i]);
+		mul_v3_fl(points[i], BLI_rng_get_float(rng));
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+
+	return tree;
+}
+
+static void bvhtree_nearest_point_cb(void *userdata, int index, const float co[3], BVHTreeNearest *nearest)
+{
+	const float (*points)[3] = (const float (*)[3])userdata;
+	const float dist_sq = len_squared_v3v3(co, points[index]);
+
+	if (dist_sq < nearest->dist_sq) {
+		nearest->index = index;
+		nearest->dist_sq = dist_sq;
+		copy_v3_v3(nearest->co, points[index]);
+	}
+}
+
+static void bvhtree_nearest_init(BVHTreeNearest *nearest, int num)
+{
+	int i;
+	for (i = 0; i < num; i++) {
+		nearest[i].index = -1;
+		nearest[i].dist_sq = FLT_MAX;
+	}
+}
+
+static void bvhtree_hit_init(BVHTreeRayHit *hit, int num)
+{
+	int i;
+	for (i = 0; i < num; i++) {
+		hit[i].index = -1;
+		hit[i].dist = FLT_MAX;
+	}
+}
+
+/* -------------------------------------------------------------------- */
+/* tests, batched queries also print their timing against a loop of single queries */
+
+TEST(kdopbvh, Balance)
+{
+	RNG *rng = BLI_rng_new(1234);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * POINTS_NUM, __func__);
+	BVHTree *tree = bvhtree_points_create(points, POINTS_NUM, rng);
+	int i;
+
+	/* every point must be found at its own position */
+	for (i = 0; i < POINTS_NUM; i += 97) {
+		BVHTreeNearest nearest;
+		bvhtree_nearest_init(&nearest, 1);
+		BLI_bvhtree_find_nearest(tree, points[i], &nearest, bvhtree_nearest_point_cb, points);
+		EXPECT_EQ(0.0f, nearest.dist_sq);
+	}
+
+	BLI_bvhtree_free(tree);
+	MEM_freeN(points);
+	BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, FindNearestBatch)
+{
+	RNG *rng = BLI_rng_new(1234);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * POINTS_NUM, __func__);
+	float (*co)[3] = (float (*)[3])MEM_mallocN(sizeof(*co) * QUERY_NUM, __func__);
+	BVHTreeNearest *nearest_single = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest_single) * QUERY_NUM, __func__);
+	BVHTreeNearest *nearest_batch = (BVHTreeNearest *)MEM_mallocN(sizeof(*nearest_batch) * QUERY_NUM, __func__);
+	BVHTree *tree = bvhtree_points_create(points, POINTS_NUM, rng);
+	double time_start, time_single, time_batch;
+	int i;
+
+	for (i = 0; i < QUERY_NUM; i++) {
+		BLI_rng_get_float_unit_v3(rng, co[i]);
+		mul_v3_fl(co[i], 1.5f * BLI_rng_get_float(rng));
+	}
+
+	bvhtree_nearest_init(nearest_single, QUERY_NUM);
+	bvhtree_nearest_init(nearest_batch, QUERY_NUM);
+
+	time_start = PIL_check_seconds_timer();
+	for (i = 0; i < QUERY_NUM; i++) {
+		BLI_bvhtree_find_nearest(tree, co[i], &nearest_single[i], bvhtree_nearest_point_cb, points);
+	}
+	time_single = PIL_check_seconds_timer() - time_start;
+
+	time_start = PIL_check_seconds_timer();
+	BLI_bvhtree_find_nearest_batch(tree, co, nearest_batch, QUERY_NUM, bvhtree_nearest_point_cb, points);
+	time_batch = PIL_check_seconds_timer() - time_start;
+
+	for (i = 0; i < QUERY_NUM; i++) {
+		EXPECT_NE(-1, nearest_batch[i].index);
+		EXPECT_EQ(nearest_single[i].index, nearest_batch[i].index);
+		EXPECT_EQ(nearest_single[i].dist_sq, nearest_batch[i].dist_sq);
+	}
+
+	printf("find nearest, %d queries: single %.6f sec, batch %.6f sec\n", QUERY_NUM, time_single, time_batch);
+
+	BLI_bvhtree_free(tree);
+	MEM_freeN(nearest_batch);
+	MEM_freeN(nearest_single);
+	MEM_freeN(co);
+	MEM_freeN(points);
+	BLI_rng_free(rng);
+}
+
+TEST(kdopbvh, RayCastBatch)
+{
+	RNG *rng = BLI_rng_new(1234);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * POINTS_NUM, __func__);
+	BVHTreeRay *rays = (BVHTreeRay *)MEM_mallocN(sizeof(*rays) * QUERY_NUM, __func__);
+	BVHTreeRayHit *hit_single = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hit_single) * QUERY_NUM, __func__);
+	BVHTreeRayHit *hit_batch = (BVHTreeRayHit *)MEM_mallocN(sizeof(*hit_batch) * QUERY_NUM, __func__);
+	BVHTree *tree = bvhtree_points_create(points, POINTS_NUM, rng);
+	double time_start, time_single, time_batch;
+	int i;
+
+	/* rays from outside the point cloud, aimed roughly at the center */
+	for (i = 0; i < QUERY_NUM; i++) {
+		float target[3];
+		BLI_rng_get_float_unit_v3(rng, rays[i].origin);
+		mul_v3_fl(rays[i].origin, 2.0f);
+		BLI_rng_get_float_unit_v3(rng, target);
+		mul_v3_fl(target, 0.5f);
+		sub_v3_v3v3(rays[i].direction, target, rays[i].origin);
+		rays[i].radius = 0.01f;
+	}
+
+	bvhtree_hit_init(hit_single, QUERY_NUM);
+	bvhtree_hit_init(hit_batch, QUERY_NUM);
+
+	time_start = PIL_check_seconds_timer();
+	for (i = 0; i < QUERY_NUM; i++) {
+		BLI_bvhtree_ray_cast(tree, rays[i].origin, rays[i].direction, rays[i].radius, &hit_single[i], NULL, NULL);
+	}
+	time_single = PIL_check_seconds_timer() - time_start;
+
+	time_start = PIL_check_seconds_timer();
+	BLI_bvhtree_ray_cast_batch(tree, rays, hit_batch, QUERY_NUM, NULL, NULL);
+	time_batch = PIL_check_seconds_timer() - time_start;
+
+	for (i = 0; i < QUERY_NUM; i++) {
+		EXPECT_EQ(hit_single[i].index, hit_batch[i].index);
+		EXPECT_EQ(hit_single[i].dist, hit_batch[i].dist);
+	}
+
+	printf("ray cast, %d queries: single %.6f sec, batch %.6f sec\n", QUERY_NUM, time_single, time_batch);
+
+	BLI_bvhtree_free(tree);
+	MEM_freeN(hit_batch);
+	MEM_freeN(hit_single);
+	MEM_freeN(rays);
+	MEM_freeN(points);
+	BLI_rng_free(rng);
+}
+
+static bool bvhtree_overlap_even_cb(void *UNUSED(userdata), int index_a, int UNUSED(index_b), int UNUSED(thread))
+{
+	return (index_a % 2) == 0;
+}
+
+TEST(kdopbvh, Overlap)
+{
+	RNG *rng = BLI_rng_new(1234);
+	const int points_num = POINTS_NUM / 100;
+	float (*points_a)[3] = (float (*)[3])MEM_mallocN(sizeof(*points_a) * points_num, __func__);
+	float (*points_b)[3] = (float (*)[3])MEM_mallocN(sizeof(*points_b) * points_num, __func__);
+	BVHTree *tree_a = BLI_bvhtree_new(points_num, 0.05f, 2, 6);
+	BVHTree *tree_b = BLI_bvhtree_new(points_num, 0.05f, 4, 6);
+	BVHTreeOverlap *overlap, *overlap_even;
+	unsigned int overlap_tot, overlap_even_tot, even_tot = 0;
+	unsigned int i;
+
+	for (i = 0; i < (unsigned int)points_num; i++) {
+		BLI_rng_get_float_unit_v3(rng, points_a[i]);
+		BLI_rng_get_float_unit_v3(rng, points_b[i]);
+		BLI_bvhtree_insert(tree_a, (int)i, points_a[i], 1);
+		BLI_bvhtree_insert(tree_b, (int)i, points_b[i], 1);
+	}
+	BLI_bvhtree_balance(tree_a);
+	BLI_bvhtree_balance(tree_b);
+
+	overlap = BLI_bvhtree_overlap(tree_a, tree_b, &overlap_tot);
+	overlap_even = BLI_bvhtree_overlap_ex(tree_a, tree_b, &overlap_even_tot, bvhtree_overlap_even_cb, NULL);
+
+	EXPECT_NE(0u, overlap_tot);
+
+	/* every stored pair must really overlap (points inflated by epsilon) */
+	for (i = 0; i < overlap_tot; i++) {
+		const float *co_a = points_a[overlap[i].indexA];
+		const float *co_b = points_b[overlap[i].indexB];
+		EXPECT_LE(fabsf(co_a[0] - co_b[0]), 0.1f + FLT_EPSILON);
+		EXPECT_LE(fabsf(co_a[1] - co_b[1]), 0.1f + FLT_EPSILON);
+		EXPECT_LE(fabsf(co_a[2] - co_b[2]), 0.1f + FLT_EPSILON);
+		if ((overlap[i].indexA % 2) == 0) {
+			even_tot++;
+		}
+	}
+
+	/* the filtered query returns exactly the accepted subset */
+	EXPECT_EQ(even_tot, overlap_even_tot);
+	for (i = 0; i < overlap_even_tot; i++) {
+		EXPECT_EQ(0, overlap_even[i].indexA % 2);
+	}
+
+	MEM_freeN(overlap);
+	MEM_freeN(overlap_even);
+	BLI_bvhtree_free(tree_a);
+	BLI_bvhtree_free(tree_b);
+	MEM_freeN(points_a);
+	MEM_freeN(points_b);
+	BLI_rng_free(rng);
+}
@@ -0,0 +1,193 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_kdopbvh.h"
+#include "BLI_pointgrid.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "PIL_time.h"
+#include "MEM_guardedalloc.h"
+}
+
+#define POINTS_NUM 100000
+/* about 30 neighbors per point for points in a unit cube, as in a dense fluid */
+#define POINTS_RADIUS 0.04f
+
+/* -------------------------------------------------------------------- */
+/* test utility functions */
+
+typedef struct RangeQueryData {
+	int hits;
+	int64_t index_sum;
+} RangeQueryData;
+
+static void points_cube_create(float (*points)[3], int points_num, RNG *rng)
+{
+	int i;
+
+	for (i = 0; i < points_num; i++) {
+		points[i][0] = BLI_rng_get_float(rng);
+		points[i][1] = BLI_rng_get_float(rng);
+		points[i][2] = BLI_rng_get_float(rng);
+	}
+}
+
+static PointGrid *pointgrid_points_create(float (*points)[3], int points_num, float cell_size)
+{
+	PointGrid *grid = BLI_pointgrid_new((unsigned int)points_num);
+	int i;
+
+	for (i = 0; i < points_num; i++) {
+		BLI_pointgrid_insert(grid, i, points[i]);
+	}
+	BLI_pointgrid_balance(grid, cell_size);
+
+	return grid;
+}
+
+static void range_query_cb(void *userdata, int index, float UNUSED(dist_sq))
+{
+	RangeQueryData *data = (RangeQueryData *)userdata;
+
+	data->hits++;
+	data->index_sum += index;
+}
+
+/* -------------------------------------------------------------------- */
+/* tests */
+
+TEST(pointgrid, RangeQuery)
+{
+	RNG *rng = BLI_rng_new(1234);
+	const int points_num = 10000;
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * points_num, __func__);
+	PointGrid *grid;
+	int i, j;
+
+	points_cube_create(points, points_num, rng);
+	grid = pointgrid_points_create(points, points_num, 0.1f);
+
+	/* compare against brute force, including queries outside the points bounds */
+	for (i = 0; i < 200; i++) {
+		RangeQueryData data = {0, 0};
+		RangeQueryData data_test = {0, 0};
+		float co[3];
+		const float radius = 0.2f * BLI_rng_get_float(rng);
+		int hits;
+
+		BLI_rng_get_float_unit_v3(rng, co);
+		mul_v3_fl(co, 1.2f * BLI_rng_get_float(rng));
+		add_v3_fl(co, 0.5f);
+
+		for (j = 0; j < points_num; j++) {
+			if (len_squared_v3v3(co, points[j]) < radius * radius) {
+				range_query_cb(&data_test, j, 0.0f);
+			}
+		}
+
+		hits = BLI_pointgrid_range_query(grid, co, radius, range_query_cb, &data);
+		EXPECT_EQ(data_test.hits, hits);
+		EXPECT_EQ(data_test.hits, data.hits);
+		EXPECT_EQ(data_test.index_sum, data.index_sum);
+	}
+
+	BLI_pointgrid_free(grid);
+	MEM_freeN(points);
+	BLI_rng_free(rng);
+}
+
+TEST(pointgrid, CellSize)
+{
+	RNG *rng = BLI_rng_new(1234);
+	const int points_num = 1000;
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * points_num, __func__);
+	const float cell_sizes[] = {0.0f, 1e-6f, 0.05f, 10.0f};
+	int i, k;
+
+	points_cube_create(points, points_num, rng);
+
+	/* results don't depend on the cell size, tiny cells are limited to a sane number */
+	for (k = 0; k < (int)ARRAY_SIZE(cell_sizes); k++) {
+		PointGrid *grid = pointgrid_points_create(points, points_num, cell_sizes[k]);
+
+		for (i = 0; i < points_num; i += 7) {
+			RangeQueryData data = {0, 0};
+			int j, hits_test = 0;
+
+			for (j = 0; j < points_num; j++) {
+				if (len_squared_v3v3(points[i], points[j]) < 0.1f * 0.1f) {
+					hits_test++;
+				}
+			}
+
+			EXPECT_EQ(hits_test, BLI_pointgrid_range_query(grid, points[i], 0.1f, range_query_cb, &data));
+		}
+
+		BLI_pointgrid_free(grid);
+	}
+
+	MEM_freeN(points);
+	BLI_rng_free(rng);
+}
+
+TEST(pointgrid, Empty)
+{
+	PointGrid *grid = BLI_pointgrid_new(0);
+	RangeQueryData data = {0, 0};
+	const float co[3] = {0.0f, 0.0f, 0.0f};
+
+	BLI_pointgrid_balance(grid, 1.0f);
+	EXPECT_EQ(0, BLI_pointgrid_range_query(grid, co, 1.0f, range_query_cb, &data));
+	EXPECT_EQ(0, data.hits);
+
+	BLI_pointgrid_free(grid);
+}
+
+/* build and query around every point, as a SPH fluid step does, prints the timing against a BVH tree */
+TEST(pointgrid, ParticlesPerSecond)
+{
+	RNG *rng = BLI_rng_new(1234);
+	float (*points)[3] = (float (*)[3])MEM_mallocN(sizeof(*points) * POINTS_NUM, __func__);
+	RangeQueryData data_bvh = {0, 0};
+	RangeQueryData data_grid = {0, 0};
+	double time_start, time_bvh, time_grid;
+	BVHTree *tree;
+	PointGrid *grid;
+	int i;
+
+	points_cube_create(points, POINTS_NUM, rng);
+
+	time_start = PIL_check_seconds_timer();
+	tree = BLI_bvhtree_new(POINTS_NUM, 0.0f, 4, 6);
+	for (i = 0; i < POINTS_NUM; i++) {
+		BLI_bvhtree_insert(tree, i, points[i], 1);
+	}
+	BLI_bvhtree_balance(tree);
+	for (i = 0; i < POINTS_NUM; i++) {
+		BLI_bvhtree_range_query(tree, points[i], POINTS_RADIUS, range_query_cb, &data_bvh);
+	}
+	time_bvh = PIL_check_seconds_timer() - time_start;
+
+	time_start = PIL_check_seconds_timer();
+	grid = pointgrid_points_create(points, POINTS_NUM, POINTS_RADIUS);
+	for (i = 0; i < POINTS_NUM; i++) {
+		BLI_pointgrid_range_query(grid, points[i], POINTS_RADIUS, range_query_cb, &data_grid);
+	}
+	time_grid = PIL_check_seconds_timer() - time_start;
+
+	/* the tree expands its leaves by FLT_EPSILON, so it can find a few more points at the radius */
+	EXPECT_LE(data_grid.hits, data_bvh.hits);
+	EXPECT_GE(data_grid.hits, data_bvh.hits - data_bvh.hits / 10000);
+
+	printf("neighbor search, %d particles (%.1f neighbors each): bvh %.0f particles/sec, grid %.0f particles/sec\n",
+	       POINTS_NUM, (double)data_grid.hits / POINTS_NUM,
+	       POINTS_NUM / time_bvh, POINTS_NUM / time_grid);
+
+	BLI_bvhtree_free(tree);
+	BLI_pointgrid_free(grid);
+	MEM_freeN(points);
+	BLI_rng_free(rng);
+}
@@ -0,0 +1,171 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_math.h"
+
+#include "BKE_customdata.h"
+#include "BKE_pbvh.h"
+
+#include "PIL_time.h"
+
+#include "bmesh.h"
+}
+
+#define GRID_RES 100
+#define STROKE_STEPS 32
+#define STROKE_RADIUS 8.0f
+
+/* -------------------------------------------------------------------- */
+/* test utility functions */
+
+typedef struct DyntopoSession {
+	BMesh *bm;
+	BMLog *log;
+	PBVH *pbvh;
+} DyntopoSession;
+
+static int dyntopo_node_layer_offset(BMesh *bm, CustomData *cdata)
+{
+	const char *layer_id = "_dyntopo_node_id";
+	int layer_index;
+
+	BM_data_layer_add_named(bm, cdata, CD_PROP_INT, layer_id);
+	layer_index = CustomData_get_named_layer_index(cdata, CD_PROP_INT, layer_id);
+	return CustomData_get_n_offset(cdata, CD_PROP_INT, layer_index - CustomData_get_layer_index(cdata, CD_PROP_INT));
+}
+
+/* triangulated grid with a mask layer, set up the same way as sculpt mode */
+static void dyntopo_session_create(DyntopoSession *ds, int res)
+{
+	BMesh *bm = BM_mesh_create(&bm_mesh_allocsize_default);
+	BMVert **verts = (BMVert **)MEM_mallocN(sizeof(*verts) * res * res, __func__);
+	int cd_vert_node_offset, cd_face_node_offset;
+	int x, y;
+
+	BM_data_layer_add(bm, &bm->vdata, CD_PAINT_MASK);
+	cd_vert_node_offset = dyntopo_node_layer_offset(bm, &bm->vdata);
+	cd_face_node_offset = dyntopo_node_layer_offset(bm, &bm->pdata);
+
+	for (y = 0; y < res; y++) {
+		for (x = 0; x < res; x++) {
+			const float co[3] = {(float)x, (float)y, 0.0f};
+			verts[y * res + x] = BM_vert_create(bm, co, NULL, BM_CREATE_NOP);
+		}
+	}
+
+	for (y = 0; y < res - 1; y++) {
+		for (x = 0; x < res - 1; x++) {
+			BMVert *tri_a[3] = {verts[y * res + x], verts[y * res + x + 1], verts[(y + 1) * res + x + 1]};
+			BMVert *tri_b[3] = {verts[y * res + x], verts[(y + 1) * res + x + 1], verts[(y + 1) * res + x]};
+			BM_face_create_verts(bm, tri_a, 3, NULL, BM_CREATE_NOP, true);
+			BM_face_create_verts(bm, tri_b, 3, NULL, BM_CREATE_NOP, true);
+		}
+	}
+
+	BM_mesh_normals_update(bm);
+	MEM_freeN(verts);
+
+	ds->bm = bm;
+	ds->log = BM_log_create(bm);
+	ds->pbvh = BKE_pbvh_new();
+	BKE_pbvh_build_bmesh(ds->pbvh, bm, false, ds->log, cd_vert_node_offset, cd_face_node_offset);
+}
+
+static void dyntopo_session_free(DyntopoSession *ds)
+{
+	BKE_pbvh_free(ds->pbvh);
+	BM_log_free(ds->log);
+	BM_mesh_free(ds->bm);
+}
+
+typedef struct SphereSearchData {
+	const float *center;
+	float radius;
+} SphereSearchData;
+
+static bool node_in_sphere_cb(PBVHNode *node, void *data_v)
+{
+	SphereSearchData *data = (SphereSearchData *)data_v;
+	float bb_min[3], bb_max[3], nearest[3];
+	int i;
+
+	BKE_pbvh_node_get_BB(node, bb_min, bb_max);
+	for (i = 0; i < 3; i++) {
+		nearest[i] = min_ff(max_ff(data->center[i], bb_min[i]), bb_max[i]);
+	}
+	return len_squared_v3v3(nearest, data->center) <= data->radius * data->radius;
+}
+
+/* replay a stroke across the grid, updating topology at each step the way the sculpt brush does,
+ * returning the time spent updating the topology */
+static double dyntopo_stroke_replay(DyntopoSession *ds, float detail_size, PBVHTopologyUpdateMode mode)
+{
+	const float radius = STROKE_RADIUS;
+	double time_total = 0.0;
+	int step;
+
+	BKE_pbvh_bmesh_detail_size_set(ds->pbvh, detail_size);
+	BM_log_entry_add(ds->log);
+
+	for (step = 0; step < STROKE_STEPS; step++) {
+		const float fac = (float)step / (float)(STROKE_STEPS - 1);
+		const float center[3] = {
+		    radius + fac * ((float)GRID_RES - 1.0f - radius * 2.0f),
+		    (float)GRID_RES * 0.5f + sinf(fac * (float)M_PI * 4.0f) * radius,
+		    0.0f};
+		SphereSearchData data = {center, radius};
+		PBVHNode **nodes;
+		int totnode, n;
+		double time_start;
+
+		BKE_pbvh_search_gather(ds->pbvh, node_in_sphere_cb, &data, &nodes, &totnode);
+		for (n = 0; n < totnode; n++) {
+			BKE_pbvh_node_mark_topology_update(nodes[n]);
+		}
+		MEM_SAFE_FREE(nodes);
+
+		time_start = PIL_check_seconds_timer();
+		BKE_pbvh_bmesh_update_topology(ds->pbvh, mode, center, radius);
+		time_total += PIL_check_seconds_timer() - time_start;
+	}
+
+	BKE_pbvh_bmesh_after_stroke(ds->pbvh);
+
+	return time_total;
+}
+
+/* -------------------------------------------------------------------- */
+/* tests, also serve as a benchmark of the topology update */
+
+TEST(bmesh_dyntopo, StrokeReplay)
+{
+	DyntopoSession ds;
+	int totvert_orig, totvert_subdiv;
+	double time_subdiv, time_collapse;
+
+	dyntopo_session_create(&ds, GRID_RES);
+	totvert_orig = ds.bm->totvert;
+
+	time_subdiv = dyntopo_stroke_replay(&ds, 0.25f, PBVH_Subdivide);
+	totvert_subdiv = ds.bm->totvert;
+	EXPECT_GT(totvert_subdiv, totvert_orig);
+#ifdef DEBUG
+	EXPECT_TRUE(BM_mesh_validate(ds.bm));
+#endif
+
+	time_collapse = dyntopo_stroke_replay(&ds, 1.0f, (PBVHTopologyUpdateMode)(PBVH_Collapse | PBVH_Subdivide));
+	EXPECT_LT(ds.bm->totvert, totvert_subdiv);
+#ifdef DEBUG
+	EXPECT_TRUE(BM_mesh_validate(ds.bm));
+#endif
+
+	printf("%d -> %d -> %d verts: subdivide %.6f sec, collapse %.6f sec\n",
+	       totvert_orig, totvert_subdiv, ds.bm->totvert, time_subdiv, time_collapse);
+
+	dyntopo_session_free(&ds);
+}
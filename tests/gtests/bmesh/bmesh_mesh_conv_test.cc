@@ -0,0 +1,326 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"  /* SELECT */
+
+#include "BLI_utildefines.h"
+#include "BLI_math.h"
+
+#include "BKE_customdata.h"
+#include "BKE_global.h"
+#include "BKE_library.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+
+#include "PIL_time.h"
+
+#include "bmesh.h"
+}
+
+/* below the task scheduler threshold in release builds */
+#define GRID_RES_SMALL 16
+/* well above it */
+#define GRID_RES_LARGE 400
+
+/* -------------------------------------------------------------------- */
+/* test utility functions */
+
+/* values the grid is made with, the conversion has to give these back,
+ * so a mistake shared by both directions can't cancel out */
+static void grid_vert_co(int res, int index, float r_co[3])
+{
+	const int x = index % res, y = index / res;
+	r_co[0] = (float)x;
+	r_co[1] = (float)y;
+	r_co[2] = sinf((float)(x * y) * 0.01f);
+}
+
+static unsigned char grid_vert_bweight(int res, int index)
+{
+	return (unsigned char)(((float)((index % res) % 5) / 4.0f) * 255.0f);
+}
+
+static bool grid_vert_select(int res, int index)
+{
+	return ((index % res) + (index / res)) % 3 == 0;
+}
+
+static void grid_face_verts(int res, int index, int r_verts[4])
+{
+	const int x = index % (res - 1), y = index / (res - 1);
+	r_verts[0] = y * res + x;
+	r_verts[1] = y * res + x + 1;
+	r_verts[2] = (y + 1) * res + x + 1;
+	r_verts[3] = (y + 1) * res + x;
+}
+
+static short grid_face_mat_nr(int res, int index)
+{
+	return (short)((index % (res - 1)) % 3);
+}
+
+/* grid of quads with a loop UV layer, bevel weights, creases and some selection */
+static Mesh *mesh_grid_create(int res)
+{
+	BMesh *bm = BM_mesh_create(&bm_mesh_allocsize_default);
+	BMVert **verts = (BMVert **)MEM_mallocN(sizeof(*verts) * res * res, __func__);
+	Mesh *me = BKE_mesh_add(G.main, "Grid");
+	BMFace *f;
+	BMEdge *e;
+	BMIter iter;
+	int cd_loop_uv_offset, cd_vert_bweight_offset, cd_edge_crease_offset;
+	int x, y;
+
+	BM_data_layer_add(bm, &bm->pdata, CD_MTEXPOLY);
+	BM_data_layer_add(bm, &bm->ldata, CD_MLOOPUV);
+	BM_mesh_cd_flag_ensure(bm, NULL, ME_CDFLAG_VERT_BWEIGHT | ME_CDFLAG_EDGE_CREASE);
+
+	cd_loop_uv_offset = CustomData_get_offset(&bm->ldata, CD_MLOOPUV);
+	cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
+	cd_edge_crease_offset = CustomData_get_offset(&bm->edata, CD_CREASE);
+
+	for (y = 0; y < res; y++) {
+		for (x = 0; x < res; x++) {
+			const float co[3] = {(float)x, (float)y, sinf((float)(x * y) * 0.01f)};
+			BMVert *v = verts[y * res + x] = BM_vert_create(bm, co, NULL, BM_CREATE_NOP);
+
+			BM_ELEM_CD_SET_FLOAT(v, cd_vert_bweight_offset, (float)(x % 5) / 4.0f);
+			if ((x + y) % 3 == 0) {
+				BM_vert_select_set(bm, v, true);
+			}
+		}
+	}
+
+	for (y = 0; y < res - 1; y++) {
+		for (x = 0; x < res - 1; x++) {
+			BMVert *quad[4] = {
+			    verts[y * res + x], verts[y * res + x + 1],
+			    verts[(y + 1) * res + x + 1], verts[(y + 1) * res + x]};
+			BMLoop *l_iter, *l_first;
+
+			f = BM_face_create_verts(bm, quad, 4, NULL, BM_CREATE_NOP, true);
+			f->mat_nr = (short)(x % 3);
+
+			l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+			do {
+				MLoopUV *luv = (MLoopUV *)BM_ELEM_CD_GET_VOID_P(l_iter, cd_loop_uv_offset);
+				luv->uv[0] = l_iter->v->co[0] / (float)res;
+				luv->uv[1] = l_iter->v->co[1] / (float)res;
+			} while ((l_iter = l_iter->next) != l_first);
+		}
+	}
+
+	/* BM_ITER_MESH needs an implicit void * cast, not allowed in C++ */
+	for (e = (BMEdge *)BM_iter_new(&iter, bm, BM_EDGES_OF_MESH, NULL); e; e = (BMEdge *)BM_iter_step(&iter)) {
+		BM_ELEM_CD_SET_FLOAT(e, cd_edge_crease_offset, e->v1->co[1] == e->v2->co[1] ? 1.0f : 0.0f);
+	}
+
+	BM_mesh_normals_update(bm);
+	BM_mesh_bm_to_me(bm, me, false);
+
+	BM_mesh_free(bm);
+	MEM_freeN(verts);
+
+	return me;
+}
+
+static void mesh_expect_grid(Mesh *me, int res)
+{
+	MLoopUV *luv = (MLoopUV *)CustomData_get_layer(&me->ldata, CD_MLOOPUV);
+	int i, j;
+
+	ASSERT_EQ(res * res, me->totvert);
+	ASSERT_EQ(2 * res * (res - 1), me->totedge);
+	ASSERT_EQ((res - 1) * (res - 1), me->totpoly);
+	ASSERT_EQ(4 * me->totpoly, me->totloop);
+	ASSERT_TRUE(luv != NULL);
+	EXPECT_EQ(ME_CDFLAG_VERT_BWEIGHT | ME_CDFLAG_EDGE_CREASE, me->cd_flag);
+
+	for (i = 0; i < me->totvert; i++) {
+		const MVert *mv = &me->mvert[i];
+		float co[3];
+
+		grid_vert_co(res, i, co);
+		EXPECT_EQ(0, memcmp(co, mv->co, sizeof(co)));
+		EXPECT_EQ(grid_vert_bweight(res, i), (unsigned char)mv->bweight);
+		EXPECT_EQ(grid_vert_select(res, i), (mv->flag & SELECT) != 0);
+	}
+
+	for (i = 0; i < me->totedge; i++) {
+		const MEdge *med = &me->medge[i];
+		const bool is_x = me->mvert[med->v1].co[1] == me->mvert[med->v2].co[1];
+
+		EXPECT_EQ(is_x ? 255 : 0, (int)(unsigned char)med->crease);
+	}
+
+	for (i = 0; i < me->totpoly; i++) {
+		const MPoly *mp = &me->mpoly[i];
+		int verts[4];
+
+		grid_face_verts(res, i, verts);
+		EXPECT_EQ(grid_face_mat_nr(res, i), mp->mat_nr);
+		ASSERT_EQ(4 * i, mp->loopstart);
+		ASSERT_EQ(4, mp->totloop);
+
+		for (j = 0; j < 4; j++) {
+			const MLoop *ml = &me->mloop[mp->loopstart + j];
+			const MEdge *med = &me->medge[ml->e];
+			const int v_next = verts[(j + 1) % 4];
+
+			EXPECT_EQ(verts[j], (int)ml->v);
+			EXPECT_TRUE((med->v1 == ml->v && (int)med->v2 == v_next) ||
+			            (med->v2 == ml->v && (int)med->v1 == v_next));
+			EXPECT_EQ(me->mvert[ml->v].co[0] / (float)res, luv[mp->loopstart + j].uv[0]);
+			EXPECT_EQ(me->mvert[ml->v].co[1] / (float)res, luv[mp->loopstart + j].uv[1]);
+		}
+	}
+}
+
+static void bmesh_expect_grid(BMesh *bm, int res)
+{
+	const int cd_loop_uv_offset = CustomData_get_offset(&bm->ldata, CD_MLOOPUV);
+	const int cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
+	const int cd_edge_crease_offset = CustomData_get_offset(&bm->edata, CD_CREASE);
+	BMVert *v;
+	BMEdge *e;
+	BMFace *f;
+	BMIter iter;
+	int i, j;
+
+	ASSERT_EQ(res * res, bm->totvert);
+	ASSERT_EQ(2 * res * (res - 1), bm->totedge);
+	ASSERT_EQ((res - 1) * (res - 1), bm->totface);
+	ASSERT_NE(-1, cd_loop_uv_offset);
+	ASSERT_NE(-1, cd_vert_bweight_offset);
+	ASSERT_NE(-1, cd_edge_crease_offset);
+
+	BM_mesh_elem_index_ensure(bm, BM_VERT);
+
+	for (v = (BMVert *)BM_iter_new(&iter, bm, BM_VERTS_OF_MESH, NULL), i = 0; v; v = (BMVert *)BM_iter_step(&iter), i++) {
+		float co[3];
+
+		grid_vert_co(res, i, co);
+		EXPECT_EQ(0, memcmp(co, v->co, sizeof(co)));
+		EXPECT_EQ((float)grid_vert_bweight(res, i) / 255.0f, BM_ELEM_CD_GET_FLOAT(v, cd_vert_bweight_offset));
+		EXPECT_EQ(grid_vert_select(res, i), BM_elem_flag_test_bool(v, BM_ELEM_SELECT));
+	}
+
+	for (e = (BMEdge *)BM_iter_new(&iter, bm, BM_EDGES_OF_MESH, NULL); e; e = (BMEdge *)BM_iter_step(&iter)) {
+		EXPECT_EQ((e->v1->co[1] == e->v2->co[1]) ? 1.0f : 0.0f, BM_ELEM_CD_GET_FLOAT(e, cd_edge_crease_offset));
+	}
+
+	for (f = (BMFace *)BM_iter_new(&iter, bm, BM_FACES_OF_MESH, NULL), i = 0; f; f = (BMFace *)BM_iter_step(&iter), i++) {
+		BMLoop *l_iter = BM_FACE_FIRST_LOOP(f);
+		int verts[4];
+
+		grid_face_verts(res, i, verts);
+		EXPECT_EQ(grid_face_mat_nr(res, i), f->mat_nr);
+		ASSERT_EQ(4, f->len);
+
+		for (j = 0; j < 4; j++, l_iter = l_iter->next) {
+			const MLoopUV *luv = (const MLoopUV *)BM_ELEM_CD_GET_VOID_P(l_iter, cd_loop_uv_offset);
+
+			EXPECT_EQ(verts[j], BM_elem_index_get(l_iter->v));
+			EXPECT_EQ(l_iter->v->co[0] / (float)res, luv->uv[0]);
+			EXPECT_EQ(l_iter->v->co[1] / (float)res, luv->uv[1]);
+		}
+	}
+}
+
+static void mesh_expect_equal(Mesh *me_a, Mesh *me_b)
+{
+	MLoopUV *luv_a, *luv_b;
+	int i;
+
+	ASSERT_EQ(me_a->totvert, me_b->totvert);
+	ASSERT_EQ(me_a->totedge, me_b->totedge);
+	ASSERT_EQ(me_a->totpoly, me_b->totpoly);
+	ASSERT_EQ(me_a->totloop, me_b->totloop);
+	EXPECT_EQ(me_a->cd_flag, me_b->cd_flag);
+
+	for (i = 0; i < me_a->totvert; i++) {
+		const MVert *mv_a = &me_a->mvert[i], *mv_b = &me_b->mvert[i];
+		EXPECT_EQ(0, memcmp(mv_a->co, mv_b->co, sizeof(mv_a->co)));
+		/* short -> float -> short may round */
+		EXPECT_LE(abs(mv_a->no[0] - mv_b->no[0]), 1);
+		EXPECT_LE(abs(mv_a->no[1] - mv_b->no[1]), 1);
+		EXPECT_LE(abs(mv_a->no[2] - mv_b->no[2]), 1);
+		EXPECT_EQ(mv_a->flag, mv_b->flag);
+		EXPECT_EQ(mv_a->bweight, mv_b->bweight);
+	}
+
+	EXPECT_EQ(0, memcmp(me_a->medge, me_b->medge, sizeof(MEdge) * me_a->totedge));
+	EXPECT_EQ(0, memcmp(me_a->mpoly, me_b->mpoly, sizeof(MPoly) * me_a->totpoly));
+	EXPECT_EQ(0, memcmp(me_a->mloop, me_b->mloop, sizeof(MLoop) * me_a->totloop));
+
+	luv_a = (MLoopUV *)CustomData_get_layer(&me_a->ldata, CD_MLOOPUV);
+	luv_b = (MLoopUV *)CustomData_get_layer(&me_b->ldata, CD_MLOOPUV);
+	ASSERT_TRUE(luv_a != NULL);
+	ASSERT_TRUE(luv_b != NULL);
+	EXPECT_EQ(0, memcmp(luv_a, luv_b, sizeof(MLoopUV) * me_a->totloop));
+}
+
+/* mesh -> bmesh -> mesh, returning the time of each direction,
+ * the intermediate BMesh is checked against the grid values */
+static Mesh *mesh_round_trip(Mesh *me, int res, double *r_time_from_me, double *r_time_to_me)
+{
+	const BMAllocTemplate allocsize = BMALLOC_TEMPLATE_FROM_ME(me);
+	BMesh *bm = BM_mesh_create(&allocsize);
+	Mesh *me_dst = BKE_mesh_add(G.main, "Grid");
+	double time_start;
+
+	time_start = PIL_check_seconds_timer();
+	BM_mesh_bm_from_me(bm, me, true, false, 0);
+	*r_time_from_me = PIL_check_seconds_timer() - time_start;
+
+	bmesh_expect_grid(bm, res);
+
+	time_start = PIL_check_seconds_timer();
+	BM_mesh_bm_to_me(bm, me_dst, false);
+	*r_time_to_me = PIL_check_seconds_timer() - time_start;
+
+	BM_mesh_free(bm);
+
+	return me_dst;
+}
+
+static void mesh_round_trip_test(int res)
+{
+	Mesh *me, *me_dst;
+	double time_from_me, time_to_me;
+
+	G.main = BKE_main_new();
+
+	me = mesh_grid_create(res);
+	mesh_expect_grid(me, res);
+
+	me_dst = mesh_round_trip(me, res, &time_from_me, &time_to_me);
+
+	mesh_expect_grid(me_dst, res);
+	mesh_expect_equal(me, me_dst);
+
+	printf("%d verts, %d faces: mesh to bmesh %.6f sec, bmesh to mesh %.6f sec\n",
+	       me->totvert, me->totpoly, time_from_me, time_to_me);
+
+	BKE_main_free(G.main);
+	G.main = NULL;
+}
+
+/* -------------------------------------------------------------------- */
+/* tests, the large grid also serves as a benchmark of both directions */
+
+TEST(bmesh_mesh_conv, RoundTripSmall)
+{
+	mesh_round_trip_test(GRID_RES_SMALL);
+}
+
+TEST(bmesh_mesh_conv, RoundTripLarge)
+{
+	mesh_round_trip_test(GRID_RES_LARGE);
+}
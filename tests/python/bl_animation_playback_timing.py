@@ -0,0 +1,135 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Times animation playback of a generated rig with many F-Curves and drivers,
+# the cost of which is dominated by resolving the RNA paths of the channels.
+#
+# Every bone gets keyframed location/rotation/scale channels,
+# and a driver on its 'ik_stretch' reading the location of the next bone.
+# Playback is timed evaluating the keyframes exactly, then from baked samples.
+# After timing, one more frame is evaluated with depsgraph debugging enabled,
+# which prints the hit rate of the RNA path cache.
+#
+# ./blender.bin --background --factory-startup --python tests/python/bl_animation_playback_timing.py
+
+import bpy
+import time
+
+BONES = (100, 1000, 4000)
+FRAMES = 50
+# take the best of this many playbacks
+REPEAT = 3
+# error allowed for F-Curves evaluated from baked samples
+SAMPLE_TOLERANCE = 0.001
+
+
+def ctx_clear_scene():  # copied from batch_import.py
+    for scene in bpy.data.scenes:
+        for obj in scene.objects[:]:
+            scene.objects.unlink(obj)
+
+    for bpy_data_iter in (bpy.data.objects,
+                          bpy.data.meshes,
+                          bpy.data.armatures,
+                          bpy.data.actions,
+                          bpy.data.lamps,
+                          bpy.data.cameras,
+                          ):
+
+        for id_data in bpy_data_iter:
+            bpy_data_iter.remove(id_data)
+
+
+def make_rig(scene, bones_num):
+    arm = bpy.data.armatures.new("Rig")
+    obj = bpy.data.objects.new("Rig", arm)
+    scene.objects.link(obj)
+    scene.objects.active = obj
+
+    bpy.ops.object.mode_set(mode='EDIT')
+    for i in range(bones_num):
+        ebone = arm.edit_bones.new("Bone%d" % i)
+        ebone.head = (float(i % 100), float(i // 100), 0.0)
+        ebone.tail = (float(i % 100), float(i // 100), 1.0)
+    bpy.ops.object.mode_set(mode='OBJECT')
+
+    act = bpy.data.actions.new("RigAction")
+    obj.animation_data_create().action = act
+
+    for i in range(bones_num):
+        base = 'pose.bones["Bone%d"].' % i
+        for prop, size in (("location", 3), ("rotation_quaternion", 4), ("scale", 3)):
+            for index in range(size):
+                fcu = act.fcurves.new(base + prop, index, "Bone%d" % i)
+                fcu.keyframe_points.add(2)
+                fcu.keyframe_points[0].co = (1.0, 0.0)
+                fcu.keyframe_points[1].co = (FRAMES + 1.0, 1.0 + index)
+
+        fcu = obj.driver_add(base + "ik_stretch")
+        drv = fcu.driver
+        drv.type = 'SUM'
+        var = drv.variables.new()
+        var.type = 'SINGLE_PROP'
+        var.targets[0].id = obj
+        var.targets[0].data_path = 'pose.bones["Bone%d"].location[1]' % ((i + 1) % bones_num)
+
+    return obj
+
+
+def playback_time(scene):
+    time_best = None
+    for _ in range(REPEAT):
+        time_start = time.time()
+        for frame in range(1, FRAMES + 1):
+            scene.frame_set(frame)
+        time_play = time.time() - time_start
+        if time_best is None or time_play < time_best:
+            time_best = time_play
+    return time_best
+
+
+def main():
+    scene = bpy.context.scene
+    edit = bpy.context.user_preferences.edit
+    scene.frame_start = 1
+    scene.frame_end = FRAMES
+
+    for bones_num in BONES:
+        ctx_clear_scene()
+        obj = make_rig(scene, bones_num)
+        fcurves_num = len(obj.animation_data.action.fcurves) + len(obj.animation_data.drivers)
+
+        for tolerance in (0.0, SAMPLE_TOLERANCE):
+            edit.fcurve_sample_tolerance = tolerance
+            time_play = playback_time(scene)
+            print("bones %5d, %6d F-Curves, tolerance %.4f: %8.3f ms/frame, %6.1f fps" %
+                  (bones_num, fcurves_num, tolerance, 1000.0 * time_play / FRAMES, FRAMES / time_play))
+        edit.fcurve_sample_tolerance = 0.0
+
+        # warm up the cache again, then count hits for a single frame
+        scene.frame_set(1)
+        scene.frame_set(2)
+        bpy.app.debug_depsgraph = True
+        scene.frame_set(3)
+        bpy.app.debug_depsgraph = False
+
+
+if __name__ == "__main__":
+    main()
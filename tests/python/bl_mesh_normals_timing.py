@@ -0,0 +1,122 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Times vertex normals (BKE_mesh_calc_normals) and split normals
+# (BKE_mesh_normals_loop_split) on generated meshes of one to a few million polygons.
+#
+# The meshes are generated, so results are reproducible between builds,
+# a checksum of the normals is printed so changes in the result show up too.
+#
+# ./blender.bin --background --factory-startup --python tests/python/bl_mesh_normals_timing.py
+#
+# Pass -t to blender to compare thread counts, e.g. "-t 1".
+
+import bpy
+import time
+import math
+
+# take the best of this many evaluations
+REPEAT = 3
+# split angle for the split normals, so both smooth fans and sharp edges are walked
+SPLIT_ANGLE = math.radians(30.0)
+
+
+def ctx_clear_scene():  # copied from batch_import.py
+    for scene in bpy.data.scenes:
+        for obj in scene.objects[:]:
+            scene.objects.unlink(obj)
+
+    for bpy_data_iter in (bpy.data.objects,
+                          bpy.data.meshes,
+                          bpy.data.lamps,
+                          bpy.data.cameras,
+                          ):
+
+        for id_data in bpy_data_iter:
+            bpy_data_iter.remove(id_data)
+
+
+def make_grid():
+    bpy.ops.mesh.primitive_grid_add(x_subdivisions=1500, y_subdivisions=1500)
+    return bpy.context.active_object
+
+
+def make_icosphere():
+    bpy.ops.mesh.primitive_ico_sphere_add(subdivisions=9)
+    return bpy.context.active_object
+
+
+def make_monkey():
+    bpy.ops.mesh.primitive_monkey_add()
+    obj = bpy.context.active_object
+    mod = obj.modifiers.new(name="Subsurf", type='SUBSURF')
+    mod.levels = 6
+    return obj
+
+
+MESHES = (
+    ("grid", make_grid),
+    ("ico", make_icosphere),
+    ("monkey", make_monkey),
+    )
+
+
+def timeit(func):
+    best = None
+    for i in range(REPEAT):
+        t = time.time()
+        func()
+        t = time.time() - t
+        best = t if best is None else min(best, t)
+    return best
+
+
+def normals_checksum(values):
+    return sum(abs(v) for v in values[::97])
+
+
+def main():
+    scene = bpy.context.scene
+
+    print("%-8s %10s %10s %12s %12s %14s %14s" %
+          ("mesh", "verts", "polys", "normals", "split", "checksum", "checksum split"))
+    for mesh_name, mesh_func in MESHES:
+        ctx_clear_scene()
+        obj = mesh_func()
+        me = obj.to_mesh(scene, True, 'PREVIEW')
+
+        t_normals = timeit(me.calc_normals)
+        t_split = timeit(lambda: me.calc_normals_split(SPLIT_ANGLE))
+
+        nors = [0.0] * (len(me.vertices) * 3)
+        me.vertices.foreach_get("normal", nors)
+        split_nors = [0.0] * (len(me.loops) * 3)
+        me.loops.foreach_get("normal", split_nors)
+
+        print("%-8s %10d %10d %12.4f %12.4f %14.4f %14.4f" %
+              (mesh_name, len(me.vertices), len(me.polygons), t_normals, t_split,
+               normals_checksum(nors), normals_checksum(split_nors)))
+
+        me.free_normals_split()
+        bpy.data.meshes.remove(me)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,114 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Times the remesh modifier on a fixed set of primitive meshes,
+# for every mode and a range of octree depths.
+#
+# The meshes are generated, so results are reproducible between builds,
+# the output vertex/face counts are printed so changes in the result show up too.
+#
+# ./blender.bin --background --factory-startup --python tests/python/bl_remesh_timing.py
+#
+# Set OMP_NUM_THREADS to compare thread counts.
+
+import bpy
+import time
+
+DEPTHS = (6, 7, 8, 9)
+MODES = ("BLOCKS", "SMOOTH", "SHARP")
+# take the best of this many evaluations
+REPEAT = 3
+
+
+def ctx_clear_scene():  # copied from batch_import.py
+    for scene in bpy.data.scenes:
+        for obj in scene.objects[:]:
+            scene.objects.unlink(obj)
+
+    for bpy_data_iter in (bpy.data.objects,
+                          bpy.data.meshes,
+                          bpy.data.lamps,
+                          bpy.data.cameras,
+                          ):
+
+        for id_data in bpy_data_iter:
+            bpy_data_iter.remove(id_data)
+
+
+def make_monkey():
+    bpy.ops.mesh.primitive_monkey_add()
+    obj = bpy.context.active_object
+    mod = obj.modifiers.new(name="Subsurf", type='SUBSURF')
+    mod.levels = 2
+    return obj
+
+
+def make_sphere():
+    bpy.ops.mesh.primitive_uv_sphere_add(segments=128, ring_count=64)
+    return bpy.context.active_object
+
+
+def make_torus():
+    bpy.ops.mesh.primitive_torus_add(major_segments=96, minor_segments=48)
+    return bpy.context.active_object
+
+
+MESHES = (
+    ("monkey", make_monkey),
+    ("sphere", make_sphere),
+    ("torus", make_torus),
+    )
+
+
+def remesh_time(scene, obj, mode, depth):
+    mod = obj.modifiers.new(name="Remesh", type='REMESH')
+    mod.mode = mode
+    mod.octree_depth = depth
+    mod.use_remove_disconnected = False
+
+    best = None
+    for i in range(REPEAT):
+        t = time.time()
+        me = obj.to_mesh(scene, True, 'PREVIEW')
+        t = time.time() - t
+        best = t if best is None else min(best, t)
+
+        totvert, totpoly = len(me.vertices), len(me.polygons)
+        bpy.data.meshes.remove(me)
+
+    obj.modifiers.remove(mod)
+    return best, totvert, totpoly
+
+
+def main():
+    scene = bpy.context.scene
+
+    print("%-8s %-7s %5s %10s %10s %10s" % ("mesh", "mode", "depth", "verts", "faces", "seconds"))
+    for mesh_name, mesh_func in MESHES:
+        ctx_clear_scene()
+        obj = mesh_func()
+        for mode in MODES:
+            for depth in DEPTHS:
+                t, totvert, totpoly = remesh_time(scene, obj, mode, depth)
+                print("%-8s %-7s %5d %10d %10d %10.4f" % (mesh_name, mode, depth, totvert, totpoly, t))
+
+
+if __name__ == "__main__":
+    main()